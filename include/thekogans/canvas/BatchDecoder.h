@@ -0,0 +1,546 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_BatchDecoder_h)
+#define __thekogans_canvas_BatchDecoder_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <type_traits>
+#include "thekogans/util/Types.h"
+#include "thekogans/util/Exception.h"
+#include "thekogans/canvas/Config.h"
+#include "thekogans/canvas/Framebuffer.h"
+#include "thekogans/canvas/RGBAFramebuffer.h"
+#include "thekogans/canvas/MappedFile.h"
+#include "thekogans/canvas/Parallel.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \struct BatchDecoder BatchDecoder.h thekogans/canvas/BatchDecoder.h
+        ///
+        /// \brief
+        /// Decode many png/jpg/bmp/qoi/pnm files (or buffers) on a pool of worker threads.
+        /// Every job goes through three stages on the worker that picks it up:
+        /// - io: map (or read) the file (see \see{MappedFile}).
+        /// - decode: \see{FromBuffer} to a ui8RGBAFramebuffer.
+        /// - transform: turn that in to a Framebuffer<PixelType> (Convert by
+        /// default, pass your own to resample, crop...).
+        /// At most maxInFlight jobs are queued, being decoded or waiting to be
+        /// delivered at any one time. Submit blocks once that many are, which
+        /// bounds memory no matter how fast paths are produced. Results are
+        /// delivered (callback and future) in completion or submission order.
+        /// Use:
+        ///
+        /// \code{.cpp}
+        /// using namespace thekogans;
+        ///
+        /// canvas::BatchDecoder<canvas::ui8RGBAPixel> decoder (
+        ///     [] (const canvas::BatchDecoder<canvas::ui8RGBAPixel>::Result &result) {
+        ///         if (result.framebuffer.Get () != 0) {
+        ///             ...
+        ///         }
+        ///     });
+        /// for (std::size_t i = 0, count = paths.size (); i < count; ++i) {
+        ///     decoder.Submit (paths[i]);
+        /// }
+        /// decoder.Wait ();
+        /// \endcode
+
+        template<typename PixelType = ui8RGBAPixel>
+        struct BatchDecoder {
+            /// \brief
+            /// Result framebuffer pointer.
+            typedef typename Framebuffer<PixelType>::SharedPtr FramebufferPtr;
+
+            /// \struct BatchDecoder::Timings BatchDecoder.h thekogans/canvas/BatchDecoder.h
+            ///
+            /// \brief
+            /// Time (in seconds) spent in each stage.
+            struct Timings {
+                /// \brief
+                /// Waiting for a worker.
+                util::f64 queue;
+                /// \brief
+                /// Mapping/reading the file.
+                util::f64 io;
+                /// \brief
+                /// Decoding.
+                util::f64 decode;
+                /// \brief
+                /// Converting/resampling.
+                util::f64 transform;
+
+                /// \brief
+                /// ctor.
+                Timings () :
+                    queue (0.0),
+                    io (0.0),
+                    decode (0.0),
+                    transform (0.0) {}
+
+                /// \brief
+                /// Accumulate timings.
+                /// \param[in] timings Timings to add.
+                /// \return *this.
+                inline Timings &operator += (const Timings &timings) {
+                    queue += timings.queue;
+                    io += timings.io;
+                    decode += timings.decode;
+                    transform += timings.transform;
+                    return *this;
+                }
+            };
+
+            /// \struct BatchDecoder::Result BatchDecoder.h thekogans/canvas/BatchDecoder.h
+            ///
+            /// \brief
+            /// What became of a submitted job.
+            struct Result {
+                /// \brief
+                /// Submission index (0, 1, 2...).
+                std::size_t index;
+                /// \brief
+                /// File path (empty for buffers).
+                std::string path;
+                /// \brief
+                /// Decoded framebuffer (null on error).
+                FramebufferPtr framebuffer;
+                /// \brief
+                /// Error message (empty on success).
+                std::string error;
+                /// \brief
+                /// Time spent in each stage.
+                Timings timings;
+
+                /// \brief
+                /// ctor.
+                Result () :
+                    index (0) {}
+            };
+
+            /// \brief
+            /// Called with every result. Calls are serialized (one at a time) but
+            /// happen on the worker threads. Must not throw. The callback can Submit
+            /// more jobs (those are never held back by maxInFlight), but it must not
+            /// Wait or destroy the decoder.
+            typedef std::function<void (const Result & /*result*/)> Callback;
+            /// \brief
+            /// The transform stage.
+            typedef std::function<FramebufferPtr (ui8RGBAFramebuffer::SharedPtr /*framebuffer*/)> Transform;
+
+            /// \brief
+            /// Result delivery order.
+            enum Order {
+                /// \brief
+                /// As soon as a job is done.
+                CompletionOrder,
+                /// \brief
+                /// In the order the jobs were submitted. Results that finish early
+                /// are held (and count against maxInFlight) until their turn.
+                SubmissionOrder
+            };
+
+        private:
+            /// \brief
+            /// A submitted job.
+            struct Job {
+                /// \brief
+                /// Submission index.
+                std::size_t index;
+                /// \brief
+                /// File path (empty for buffers).
+                std::string path;
+                /// \brief
+                /// Image data (if path is empty).
+                const util::ui8 *buffer;
+                /// \brief
+                /// Image data size.
+                std::size_t size;
+                /// \brief
+                /// When the job was submitted.
+                std::chrono::steady_clock::time_point submitted;
+                /// \brief
+                /// Fulfilled when the result is delivered.
+                std::promise<Result> promise;
+            };
+            /// \brief
+            /// A finished job waiting for its turn (SubmissionOrder).
+            struct Pending {
+                /// \brief
+                /// Job result.
+                Result result;
+                /// \brief
+                /// Job promise.
+                std::promise<Result> promise;
+            };
+
+            /// \brief
+            /// Called with every result.
+            Callback callback;
+            /// \brief
+            /// Result delivery order.
+            const Order order;
+            /// \brief
+            /// The transform stage.
+            Transform transform;
+            /// \brief
+            /// Max number of jobs queued, in progress or pending delivery.
+            std::size_t maxInFlight;
+            /// \brief
+            /// Protects everything below.
+            std::mutex mutex;
+            /// \brief
+            /// Signaled when a job is queued or we're shutting down.
+            std::condition_variable jobAvailable;
+            /// \brief
+            /// Signaled when a job is delivered.
+            std::condition_variable jobDelivered;
+            /// \brief
+            /// Queued jobs.
+            std::deque<Job> jobs;
+            /// \brief
+            /// Number of jobs submitted and not yet handed to the callback
+            /// (what maxInFlight limits).
+            std::size_t inFlight;
+            /// \brief
+            /// Number of jobs submitted and not yet delivered (what Wait waits for).
+            std::size_t undelivered;
+            /// \brief
+            /// Thread running the callback (Submit from the callback skips backpressure).
+            std::thread::id callbackThread;
+            /// \brief
+            /// Next submission index.
+            std::size_t nextIndex;
+            /// \brief
+            /// true = workers exit once the queue is empty.
+            bool done;
+            /// \brief
+            /// Serializes delivery (callback calls).
+            std::mutex deliveryMutex;
+            /// \brief
+            /// Finished jobs waiting for their turn (SubmissionOrder).
+            std::map<std::size_t, Pending> pending;
+            /// \brief
+            /// Next index to deliver (SubmissionOrder).
+            std::size_t nextDeliveryIndex;
+            /// \brief
+            /// Sum of all delivered results' timings.
+            Timings totalTimings;
+            /// \brief
+            /// Worker pool.
+            std::vector<std::thread> workers;
+
+        public:
+            /// \brief
+            /// ctor.
+            /// \param[in] callback_ Called with every result (optional, see Submit).
+            /// \param[in] order_ Result delivery order.
+            /// \param[in] threads Number of worker threads (0 = \see{GetHardwareConcurrency}).
+            /// \param[in] maxInFlight_ Max number of jobs queued, in progress or
+            /// pending delivery (0 = 2 * threads).
+            /// \param[in] transform_ The transform stage (empty = Convert<PixelType>).
+            BatchDecoder (
+                    const Callback &callback_ = Callback (),
+                    Order order_ = CompletionOrder,
+                    util::ui32 threads = 0,
+                    std::size_t maxInFlight_ = 0,
+                    const Transform &transform_ = Transform ()) :
+                    callback (callback_),
+                    order (order_),
+                    transform (transform_),
+                    maxInFlight (maxInFlight_),
+                    inFlight (0),
+                    undelivered (0),
+                    nextIndex (0),
+                    done (false),
+                    nextDeliveryIndex (0) {
+                if (threads == 0) {
+                    threads = GetHardwareConcurrency ();
+                }
+                if (maxInFlight == 0) {
+                    maxInFlight = 2 * threads;
+                }
+                workers.reserve (threads);
+                try {
+                    for (util::ui32 i = 0; i < threads; ++i) {
+                        workers.push_back (std::thread (&BatchDecoder::Worker, this));
+                    }
+                }
+                catch (...) {
+                    // The dtor won't run, stop the workers that did start.
+                    Stop ();
+                    throw;
+                }
+            }
+            /// \brief
+            /// dtor.
+            /// Wait for all submitted jobs to be delivered and stop the workers.
+            ~BatchDecoder () {
+                Wait ();
+                Stop ();
+            }
+
+            /// \brief
+            /// Queue a file. Blocks while maxInFlight jobs are in flight.
+            /// \param[in] path Image file path.
+            /// \return Future fulfilled when the result is delivered.
+            inline std::future<Result> Submit (const std::string &path) {
+                return Enqueue (path, 0, 0);
+            }
+            /// \brief
+            /// Queue a buffer. Blocks while maxInFlight jobs are in flight.
+            /// The buffer must stay alive until its result is delivered.
+            /// \param[in] buffer Image data.
+            /// \param[in] size Image data size.
+            /// \return Future fulfilled when the result is delivered.
+            inline std::future<Result> Submit (
+                    const util::ui8 *buffer,
+                    std::size_t size) {
+                return Enqueue (std::string (), buffer, size);
+            }
+
+            /// \brief
+            /// Block until every submitted job has been delivered.
+            void Wait () {
+                std::unique_lock<std::mutex> lock (mutex);
+                while (undelivered != 0) {
+                    jobDelivered.wait (lock);
+                }
+            }
+
+            /// \brief
+            /// Return the sum of all delivered results' timings. With more than
+            /// one worker the stages overlap, so the sum exceeds wall clock time.
+            /// \return Sum of all delivered results' timings.
+            Timings GetTotalTimings () {
+                std::lock_guard<std::mutex> guard (deliveryMutex);
+                return totalTimings;
+            }
+
+        private:
+            /// \brief
+            /// Tell the workers to exit (once the queue is empty) and join them.
+            void Stop () {
+                {
+                    std::lock_guard<std::mutex> guard (mutex);
+                    done = true;
+                }
+                jobAvailable.notify_all ();
+                for (std::size_t i = 0, count = workers.size (); i < count; ++i) {
+                    workers[i].join ();
+                }
+            }
+
+            /// \brief
+            /// Queue a job.
+            /// \param[in] path Image file path (empty for buffers).
+            /// \param[in] buffer Image data.
+            /// \param[in] size Image data size.
+            /// \return Future fulfilled when the result is delivered.
+            std::future<Result> Enqueue (
+                    const std::string &path,
+                    const util::ui8 *buffer,
+                    std::size_t size) {
+                std::unique_lock<std::mutex> lock (mutex);
+                // Backpressure. Not for the callback, it would wait
+                // for deliveries that can't happen until it returns.
+                while (inFlight >= maxInFlight &&
+                        callbackThread != std::this_thread::get_id ()) {
+                    jobDelivered.wait (lock);
+                }
+                jobs.push_back (Job ());
+                Job &job = jobs.back ();
+                job.index = nextIndex++;
+                job.path = path;
+                job.buffer = buffer;
+                job.size = size;
+                job.submitted = std::chrono::steady_clock::now ();
+                std::future<Result> future = job.promise.get_future ();
+                ++inFlight;
+                ++undelivered;
+                lock.unlock ();
+                jobAvailable.notify_one ();
+                return future;
+            }
+
+            /// \brief
+            /// Seconds between two time points.
+            static inline util::f64 Seconds (
+                    std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end) {
+                return std::chrono::duration<util::f64> (end - start).count ();
+            }
+
+            /// \brief
+            /// Default transform for ui8RGBAPixel: nothing to do.
+            static inline FramebufferPtr DefaultTransform (
+                    ui8RGBAFramebuffer::SharedPtr framebuffer,
+                    std::true_type /*identity*/) {
+                return framebuffer;
+            }
+            /// \brief
+            /// Default transform for everything else: Convert.
+            static inline FramebufferPtr DefaultTransform (
+                    ui8RGBAFramebuffer::SharedPtr framebuffer,
+                    std::false_type /*identity*/) {
+                return framebuffer->template Convert<PixelType> ();
+            }
+
+            /// \brief
+            /// Run a job through the io, decode and transform stages.
+            /// \param[in] job Job to run.
+            /// \param[out] result Where to put the result.
+            void Run (
+                    const Job &job,
+                    Result &result) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+                result.timings.queue = Seconds (job.submitted, start);
+                try {
+                    ui8RGBAFramebuffer::SharedPtr framebuffer;
+                    std::chrono::steady_clock::time_point decoded;
+                    if (!job.path.empty ()) {
+                        MappedFile file (job.path);
+                        std::chrono::steady_clock::time_point mapped =
+                            std::chrono::steady_clock::now ();
+                        result.timings.io = Seconds (start, mapped);
+                        if (file.size == 0) {
+                            THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                                "Empty image file: %s", job.path.c_str ());
+                        }
+                        // Decode while the file is still mapped.
+                        framebuffer = FromBuffer (file.data, file.size);
+                        decoded = std::chrono::steady_clock::now ();
+                        result.timings.decode = Seconds (mapped, decoded);
+                    }
+                    else {
+                        framebuffer = FromBuffer (job.buffer, job.size);
+                        decoded = std::chrono::steady_clock::now ();
+                        result.timings.decode = Seconds (start, decoded);
+                    }
+                    result.framebuffer = transform ?
+                        transform (framebuffer) :
+                        DefaultTransform (
+                            framebuffer,
+                            std::is_same<PixelType, ui8RGBAPixel> ());
+                    result.timings.transform = Seconds (decoded, std::chrono::steady_clock::now ());
+                }
+                catch (const std::exception &exception) {
+                    result.error = exception.what ();
+                }
+                catch (...) {
+                    result.error = "Unknown exception.";
+                }
+            }
+
+            /// \brief
+            /// Hand a result to the callback and the future.
+            /// Call with deliveryMutex held. The job stops counting against
+            /// maxInFlight before the callback runs, so the callback can
+            /// Submit more work.
+            /// \param[in] result Result to deliver.
+            /// \param[in] promise Job promise.
+            void Complete (
+                    const Result &result,
+                    std::promise<Result> &promise) {
+                totalTimings += result.timings;
+                {
+                    std::lock_guard<std::mutex> guard (mutex);
+                    --inFlight;
+                    callbackThread = std::this_thread::get_id ();
+                }
+                jobDelivered.notify_all ();
+                if (callback) {
+                    callback (result);
+                }
+                promise.set_value (result);
+                {
+                    std::lock_guard<std::mutex> guard (mutex);
+                    callbackThread = std::thread::id ();
+                    --undelivered;
+                }
+                jobDelivered.notify_all ();
+            }
+
+            /// \brief
+            /// Deliver a result (now, or once its predecessors have been).
+            /// \param[in] result Result to deliver.
+            /// \param[in] promise Job promise.
+            void Deliver (
+                    const Result &result,
+                    std::promise<Result> &promise) {
+                std::lock_guard<std::mutex> guard (deliveryMutex);
+                if (order == CompletionOrder) {
+                    Complete (result, promise);
+                }
+                else {
+                    Pending &pending_ = pending[result.index];
+                    pending_.result = result;
+                    pending_.promise = std::move (promise);
+                    for (typename std::map<std::size_t, Pending>::iterator
+                            it = pending.begin (); it != pending.end () &&
+                                it->first == nextDeliveryIndex;
+                            it = pending.erase (it), ++nextDeliveryIndex) {
+                        Complete (it->second.result, it->second.promise);
+                    }
+                }
+            }
+
+            /// \brief
+            /// Worker thread.
+            void Worker () {
+                for (;;) {
+                    Job job;
+                    {
+                        std::unique_lock<std::mutex> lock (mutex);
+                        while (jobs.empty () && !done) {
+                            jobAvailable.wait (lock);
+                        }
+                        if (jobs.empty ()) {
+                            return;
+                        }
+                        job = std::move (jobs.front ());
+                        jobs.pop_front ();
+                    }
+                    Result result;
+                    result.index = job.index;
+                    result.path = job.path;
+                    Run (job, result);
+                    Deliver (result, job.promise);
+                }
+            }
+
+            /// \brief
+            /// BatchDecoder is neither copy constructable, nor assignable.
+            THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (BatchDecoder)
+        };
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_BatchDecoder_h)
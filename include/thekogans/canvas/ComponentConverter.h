@@ -18,7 +18,9 @@
 #if !defined (__thekogans_canvas_ComponentConverter_h)
 #define __thekogans_canvas_ComponentConverter_h
 
+#include <cstddef>
 #include "thekogans/util/Types.h"
+#include "thekogans/canvas/Config.h"
 
 namespace thekogans {
     namespace canvas {
@@ -32,6 +34,14 @@ namespace thekogans {
             static OutComponentType Convert (InComponentType value) {
                 return (OutComponentType)value;
             }
+            static void Convert (
+                    const InComponentType *in,
+                    OutComponentType *out,
+                    std::size_t count) {
+                while (count-- != 0) {
+                    *out++ = (OutComponentType)*in++;
+                }
+            }
         };
 
         // util::ui8 conversion specializations.
@@ -60,55 +70,61 @@ namespace thekogans {
             }
         };
 
-        struct ui8Toui16ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui8Toui16ScaleComponentConverter {
             typedef util::ui8 InComponentType;
             typedef util::ui16 OutComponentType;
+            /// \brief
+            /// Exact: value * 65535 / 255.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[2] = {0, 3};
-                return
-                    (masks[(value >> 0) & 1] << 0) |
-                    (masks[(value >> 1) & 1] << 2) |
-                    (masks[(value >> 2) & 1] << 4) |
-                    (masks[(value >> 3) & 1] << 6) |
-                    (masks[(value >> 4) & 1] << 8) |
-                    (masks[(value >> 5) & 1] << 10) |
-                    (masks[(value >> 6) & 1] << 12) |
-                    (masks[(value >> 7) & 1] << 14);
+                return (OutComponentType)(value * 257);
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
-        struct ui8Toui32ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui8Toui32ScaleComponentConverter {
             typedef util::ui8 InComponentType;
             typedef util::ui32 OutComponentType;
+            /// \brief
+            /// Exact: value * 4294967295 / 255.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[2] = {0, 15};
-                return
-                    (masks[(value >> 0) & 1] << 0) |
-                    (masks[(value >> 1) & 1] << 4) |
-                    (masks[(value >> 2) & 1] << 8) |
-                    (masks[(value >> 3) & 1] << 12) |
-                    (masks[(value >> 4) & 1] << 16) |
-                    (masks[(value >> 5) & 1] << 20) |
-                    (masks[(value >> 6) & 1] << 24) |
-                    (masks[(value >> 7) & 1] << 28);
+                return (OutComponentType)value * 0x01010101;
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
-        struct ui8Toui64ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui8Toui64ScaleComponentConverter {
             typedef util::ui8 InComponentType;
             typedef util::ui64 OutComponentType;
+            /// \brief
+            /// Exact: value * 18446744073709551615 / 255.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[2] = {0, 255};
-                return
-                    (masks[(value >> 0) & 1] << 0) |
-                    (masks[(value >> 1) & 1] << 8) |
-                    (masks[(value >> 2) & 1] << 16) |
-                    (masks[(value >> 3) & 1] << 24) |
-                    (masks[(value >> 4) & 1] << 32) |
-                    (masks[(value >> 5) & 1] << 40) |
-                    (masks[(value >> 6) & 1] << 48) |
-                    (masks[(value >> 7) & 1] << 56);
+                return (OutComponentType)value * 0x0101010101010101ULL;
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
         // util::ui16 conversion specializations.
@@ -137,71 +153,61 @@ namespace thekogans {
             }
         };
 
-        struct ui16Toui8ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui16Toui8ScaleComponentConverter {
             typedef util::ui16 InComponentType;
             typedef util::ui8 OutComponentType;
+            /// \brief
+            /// Rounds value * 255 / 65535 to nearest.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[4] = {0, 0, 1, 1};
-                return
-                    (masks[(value >> 0) & 3] << 0) |
-                    (masks[(value >> 2) & 3] << 1) |
-                    (masks[(value >> 4) & 3] << 2) |
-                    (masks[(value >> 6) & 3] << 3) |
-                    (masks[(value >> 8) & 3] << 4) |
-                    (masks[(value >> 10) & 3] << 5) |
-                    (masks[(value >> 12) & 3] << 6) |
-                    (masks[(value >> 14) & 3] << 7);
+                return (OutComponentType)(((util::ui32)value * 255 + 32895) >> 16);
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
-        struct ui16Toui32ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui16Toui32ScaleComponentConverter {
             typedef util::ui16 InComponentType;
             typedef util::ui32 OutComponentType;
+            /// \brief
+            /// Exact: value * 4294967295 / 65535.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[2] = {0, 3};
-                return
-                    (masks[(value >> 0) & 1] << 0) |
-                    (masks[(value >> 1) & 1] << 2) |
-                    (masks[(value >> 2) & 1] << 4) |
-                    (masks[(value >> 3) & 1] << 6) |
-                    (masks[(value >> 4) & 1] << 8) |
-                    (masks[(value >> 5) & 1] << 10) |
-                    (masks[(value >> 6) & 1] << 12) |
-                    (masks[(value >> 7) & 1] << 14) |
-                    (masks[(value >> 8) & 1] << 16) |
-                    (masks[(value >> 9) & 1] << 18) |
-                    (masks[(value >> 10) & 1] << 20) |
-                    (masks[(value >> 11) & 1] << 22) |
-                    (masks[(value >> 12) & 1] << 24) |
-                    (masks[(value >> 13) & 1] << 26) |
-                    (masks[(value >> 14) & 1] << 28) |
-                    (masks[(value >> 15) & 1] << 30);
+                return (OutComponentType)value * 65537;
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
-        struct ui16Toui64ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui16Toui64ScaleComponentConverter {
             typedef util::ui16 InComponentType;
             typedef util::ui64 OutComponentType;
+            /// \brief
+            /// Exact: value * 18446744073709551615 / 65535.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[2] = {0, 15};
-                return
-                    (masks[(value >> 0) & 1] << 0) |
-                    (masks[(value >> 1) & 1] << 4) |
-                    (masks[(value >> 2) & 1] << 8) |
-                    (masks[(value >> 3) & 1] << 12) |
-                    (masks[(value >> 4) & 1] << 16) |
-                    (masks[(value >> 5) & 1] << 20) |
-                    (masks[(value >> 6) & 1] << 24) |
-                    (masks[(value >> 7) & 1] << 28) |
-                    (masks[(value >> 8) & 1] << 32) |
-                    (masks[(value >> 9) & 1] << 36) |
-                    (masks[(value >> 10) & 1] << 40) |
-                    (masks[(value >> 11) & 1] << 44) |
-                    (masks[(value >> 12) & 1] << 48) |
-                    (masks[(value >> 13) & 1] << 52) |
-                    (masks[(value >> 14) & 1] << 56) |
-                    (masks[(value >> 15) & 1] << 60);
+                return (OutComponentType)value * 0x0001000100010001ULL;
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
         // util::ui32 conversion specializations.
@@ -230,89 +236,61 @@ namespace thekogans {
             }
         };
 
-        struct ui32Toui8ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui32Toui8ScaleComponentConverter {
             typedef util::ui32 InComponentType;
             typedef util::ui8 OutComponentType;
+            /// \brief
+            /// Rounds value * 255 / 4294967295 to nearest.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[16] = {
-                    0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 1, 1
-                };
-                return
-                    (masks[(value >> 0) & 15] << 0) |
-                    (masks[(value >> 4) & 15] << 1) |
-                    (masks[(value >> 8) & 15] << 2) |
-                    (masks[(value >> 12) & 15] << 3) |
-                    (masks[(value >> 16) & 15] << 4) |
-                    (masks[(value >> 20) & 15] << 5) |
-                    (masks[(value >> 24) & 15] << 6) |
-                    (masks[(value >> 28) & 15] << 7);
+                return (OutComponentType)(((util::ui64)value + 8421504) / 16843009);
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
-        struct ui32Toui16ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui32Toui16ScaleComponentConverter {
             typedef util::ui32 InComponentType;
             typedef util::ui16 OutComponentType;
+            /// \brief
+            /// Rounds value * 65535 / 4294967295 to nearest.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[4] = {0, 0, 1, 1};
-                return
-                    (masks[(value >> 0) & 3] << 0) |
-                    (masks[(value >> 2) & 3] << 1) |
-                    (masks[(value >> 4) & 3] << 2) |
-                    (masks[(value >> 6) & 3] << 3) |
-                    (masks[(value >> 8) & 3] << 4) |
-                    (masks[(value >> 10) & 3] << 5) |
-                    (masks[(value >> 12) & 3] << 6) |
-                    (masks[(value >> 14) & 3] << 7) |
-                    (masks[(value >> 16) & 3] << 8) |
-                    (masks[(value >> 18) & 3] << 9) |
-                    (masks[(value >> 20) & 3] << 10) |
-                    (masks[(value >> 22) & 3] << 11) |
-                    (masks[(value >> 24) & 3] << 12) |
-                    (masks[(value >> 26) & 3] << 13) |
-                    (masks[(value >> 28) & 3] << 14) |
-                    (masks[(value >> 30) & 3] << 15);
+                return (OutComponentType)(((util::ui64)value + 32768) / 65537);
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
-        struct ui32Toui64ScaleComponentConverter {
+        struct _LIB_THEKOGANS_CANVAS_DECL ui32Toui64ScaleComponentConverter {
             typedef util::ui32 InComponentType;
             typedef util::ui64 OutComponentType;
+            /// \brief
+            /// Exact: value * 18446744073709551615 / 4294967295.
             static OutComponentType Convert (InComponentType value) {
-                static const OutComponentType masks[2] = {0, 3};
-                return
-                    (masks[(value >> 0) & 1] << 0) |
-                    (masks[(value >> 1) & 1] << 2) |
-                    (masks[(value >> 2) & 1] << 4) |
-                    (masks[(value >> 3) & 1] << 6) |
-                    (masks[(value >> 4) & 1] << 8) |
-                    (masks[(value >> 5) & 1] << 10) |
-                    (masks[(value >> 6) & 1] << 12) |
-                    (masks[(value >> 7) & 1] << 14) |
-                    (masks[(value >> 8) & 1] << 16) |
-                    (masks[(value >> 9) & 1] << 18) |
-                    (masks[(value >> 10) & 1] << 20) |
-                    (masks[(value >> 11) & 1] << 22) |
-                    (masks[(value >> 12) & 1] << 24) |
-                    (masks[(value >> 13) & 1] << 26) |
-                    (masks[(value >> 14) & 1] << 28) |
-                    (masks[(value >> 15) & 1] << 30) |
-                    (masks[(value >> 16) & 1] << 32) |
-                    (masks[(value >> 17) & 1] << 34) |
-                    (masks[(value >> 18) & 1] << 36) |
-                    (masks[(value >> 19) & 1] << 38) |
-                    (masks[(value >> 20) & 1] << 40) |
-                    (masks[(value >> 21) & 1] << 42) |
-                    (masks[(value >> 22) & 1] << 44) |
-                    (masks[(value >> 23) & 1] << 46) |
-                    (masks[(value >> 24) & 1] << 48) |
-                    (masks[(value >> 25) & 1] << 50) |
-                    (masks[(value >> 26) & 1] << 52) |
-                    (masks[(value >> 27) & 1] << 54) |
-                    (masks[(value >> 28) & 1] << 56) |
-                    (masks[(value >> 29) & 1] << 58) |
-                    (masks[(value >> 30) & 1] << 60) |
-                    (masks[(value >> 31) & 1] << 62);
+                return (OutComponentType)value * 0x0000000100000001ULL;
             }
+            /// \brief
+            /// Convert a span of components.
+            /// \param[in] in Components to convert.
+            /// \param[out] out Where to put the converted components.
+            /// \param[in] count Number of components in the span.
+            static void Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count);
         };
 
         // util::ui64 conversion specializations.
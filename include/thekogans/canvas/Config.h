@@ -43,4 +43,28 @@
     #define _LIB_THEKOGANS_CANVAS_DECL
 #endif // defined (TOOLCHAIN_OS_Windows)
 
+/// \brief
+/// SIMD instruction sets available to the span kernels (see \see{SpanConverter}).
+/// Define THEKOGANS_CANVAS_NO_SIMD to force the portable scalar paths.
+#if !defined (THEKOGANS_CANVAS_NO_SIMD)
+    #if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define THEKOGANS_CANVAS_HAVE_SSE2
+    #endif // defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+    #if defined (__ARM_NEON) || defined (__ARM_NEON__)
+        #define THEKOGANS_CANVAS_HAVE_NEON
+    #endif // defined (__ARM_NEON) || defined (__ARM_NEON__)
+#endif // !defined (THEKOGANS_CANVAS_NO_SIMD)
+
+/// \brief
+/// YUV encoding used by the \see{Converter} chain and the YUV span kernels
+/// (see YUVAConverter.h). THEKOGANS_CANVAS_YUV_MATRIX is one of 601, 709 or 2020.
+/// THEKOGANS_CANVAS_YUV_FULL_RANGE is 0 for limited (studio, Y in [16, 235])
+/// or 1 for full (JPEG, Y in [0, 255]) range. The default is BT.601 limited range.
+#if !defined (THEKOGANS_CANVAS_YUV_MATRIX)
+    #define THEKOGANS_CANVAS_YUV_MATRIX 601
+#endif // !defined (THEKOGANS_CANVAS_YUV_MATRIX)
+#if !defined (THEKOGANS_CANVAS_YUV_FULL_RANGE)
+    #define THEKOGANS_CANVAS_YUV_FULL_RANGE 0
+#endif // !defined (THEKOGANS_CANVAS_YUV_FULL_RANGE)
+
 #endif // !defined (__thekogans_canvas_Config_h)
@@ -19,6 +19,7 @@
 #define __thekogans_canvas_Converter_h
 
 #include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/YUVAColor.h"
 
 namespace thekogans {
     namespace canvas {
@@ -32,6 +33,29 @@ namespace thekogans {
             static OutColorType Convert (const InColorType &inColor);
         };
 
+        // YUVA converters are declared here, next to the primary template,
+        // so that every translation unit sees the same Converter whether or
+        // not it includes YUVAConverter.h. They are defined in
+        // YUVAConverter.cpp.
+
+        template<>
+        struct Converter<ui8YUVAColor> {
+            typedef ui8YUVAColor OutColorType;
+            typedef f32RGBAColor IntermediateColorType;
+
+            template<typename InColorType>
+            static OutColorType Convert (const InColorType &inColor);
+        };
+
+        template<>
+        struct Converter<f32YUVAColor> {
+            typedef f32YUVAColor OutColorType;
+            typedef f32RGBAColor IntermediateColorType;
+
+            template<typename InColorType>
+            static OutColorType Convert (const InColorType &inColor);
+        };
+
     } // namespace canvas
 } // namespace thekogans
 
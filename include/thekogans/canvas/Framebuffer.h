@@ -18,7 +18,10 @@
 #if !defined (__thekogans_canvas_Framebuffer_h)
 #define __thekogans_canvas_Framebuffer_h
 
+#include <cstddef>
 #include <memory>
+#include <functional>
+#include <algorithm>
 #include <type_traits>
 #include "thekogans/util/Types.h"
 #include "thekogans/util/Array.h"
@@ -26,8 +29,10 @@
 #include "thekogans/util/RefCounted.h"
 #include "thekogans/util/Heap.h"
 #include "thekogans/util/SpinLock.h"
+#include "thekogans/util/Exception.h"
 #include "thekogans/canvas/Config.h"
 #include "thekogans/canvas/Converter.h"
+#include "thekogans/canvas/SpanConverter.h"
 
 namespace thekogans {
     namespace canvas {
@@ -81,7 +86,7 @@ namespace thekogans {
                 const typename util::Array<PixelType>::Deleter &deleter =
                     [] (PixelType * /*array*/) {}) :
                 extents (extents_),
-                buffer (extents.height * extents.width, buffer_, deleter) {}
+                buffer ((std::size_t)extents.height * extents.width, buffer_, deleter) {}
 
             /// \brief
             /// Return a pixel reference at the given coordinates.
@@ -164,7 +169,9 @@ namespace thekogans {
             /// Framebuffer pixel color space and component type conversion template.
             /// Depending on the number of pixel color formats and component
             /// types you use, this algorithm can potentially be specialized
-            /// many times.
+            /// many times. If a \see{SpanConverter} is specialized for the
+            /// PixelType -> OutPixelType pair (ex: ui8RGBAPixel -> ui16RGBAPixel)
+            /// its bulk kernel is used instead of the per pixel Converter chain.
             ///
             /// Ex:
             ///
@@ -191,12 +198,56 @@ namespace thekogans {
             typename Framebuffer<OutPixelType>::SharedPtr Convert () const {
                 typename Framebuffer<OutPixelType>::SharedPtr framebuffer (
                     new Framebuffer<OutPixelType> (extents));
-                const PixelType *src = buffer.array;
-                OutPixelType *dst = framebuffer->buffer.array;
-                for (std::size_t length = buffer.length; length-- != 0;) {
-                    typedef typename OutPixelType::ColorType::ConverterColorType ConverterOutColorType;
-                    typedef typename Converter<ColorType>::IntermediateColorType
-                        ConverterIntermediateColorType;
+                // If a \see{SpanConverter} exists for this pixel pair, and
+                // the caller did not ask for custom converters, use it.
+                ConvertSpan<
+                    OutPixelType,
+                    ConverterIntermediateColorConverterType,
+                    OutColorConverterType> (
+                        buffer.array,
+                        framebuffer->buffer.array,
+                        buffer.length,
+                        std::integral_constant<bool,
+                            SpanConverter<PixelType, OutPixelType>::Specialized &&
+                            std::is_same<
+                                ConverterIntermediateColorConverterType,
+                                Converter<typename Converter<ColorType>::IntermediateColorType>>::value &&
+                            std::is_same<
+                                OutColorConverterType,
+                                Converter<typename OutPixelType::ColorType>>::value> ());
+                return framebuffer;
+            }
+
+        private:
+            /// \brief
+            /// Convert a span of pixels using the \see{SpanConverter} kernel.
+            template<
+                typename OutPixelType,
+                typename ConverterIntermediateColorConverterType,
+                typename OutColorConverterType>
+            static void ConvertSpan (
+                    const PixelType *src,
+                    OutPixelType *dst,
+                    std::size_t length,
+                    std::true_type) {
+                SpanConverter<PixelType, OutPixelType>::Convert (src, dst, length);
+            }
+
+            /// \brief
+            /// Convert a span of pixels using the \see{Converter} chain.
+            template<
+                typename OutPixelType,
+                typename ConverterIntermediateColorConverterType,
+                typename OutColorConverterType>
+            static void ConvertSpan (
+                    const PixelType *src,
+                    OutPixelType *dst,
+                    std::size_t length,
+                    std::false_type) {
+                typedef typename OutPixelType::ColorType::ConverterColorType ConverterOutColorType;
+                typedef typename Converter<ColorType>::IntermediateColorType
+                    ConverterIntermediateColorType;
+                while (length-- != 0) {
                     // This statement contains 6 separate conversions.
                     //
                     // 1 - Swizzle src pixel to color
@@ -231,9 +282,9 @@ namespace thekogans {
                                         // 1 - Swizzle src pixel to color
                                         (*src++).ToColor ()))));
                 }
-                return framebuffer;
             }
 
+        public:
             /// \brief
             /// There's no need to go through all the trouble of duplicating code
             /// for copy ctor and = operator. If you need a deep copy of a framebuffer
@@ -249,6 +300,75 @@ namespace thekogans {
             THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (Framebuffer)
         };
 
+        /// \struct FramebufferAllocator Framebuffer.h thekogans/canvas/Framebuffer.h
+        ///
+        /// \brief
+        /// Lets decoders put pixels in memory the caller owns (pools, huge pages,
+        /// shared memory, pinned staging buffers...). The framebuffers returned by
+        /// Allocate wrap that memory and hand it back to deallocate when they die.
+        /// Leaving allocate empty falls back to the framebuffer's own allocation.
+        struct FramebufferAllocator {
+            /// \brief
+            /// Return size bytes aligned on alignment (0 on failure).
+            typedef std::function<void * (std::size_t size, std::size_t alignment)> AllocateFunc;
+            /// \brief
+            /// Release a pointer returned by AllocateFunc.
+            typedef std::function<void (void *ptr, std::size_t size)> DeallocateFunc;
+
+            /// \brief
+            /// Allocation hook.
+            AllocateFunc allocate;
+            /// \brief
+            /// Deallocation hook.
+            DeallocateFunc deallocate;
+            /// \brief
+            /// Minimum pixel alignment (cache line by default).
+            std::size_t alignment;
+
+            /// \brief
+            /// ctor.
+            /// \param[in] allocate_ Allocation hook.
+            /// \param[in] deallocate_ Deallocation hook.
+            /// \param[in] alignment_ Minimum pixel alignment.
+            FramebufferAllocator (
+                const AllocateFunc &allocate_ = AllocateFunc (),
+                const DeallocateFunc &deallocate_ = DeallocateFunc (),
+                std::size_t alignment_ = 64) :
+                allocate (allocate_),
+                deallocate (deallocate_),
+                alignment (alignment_) {}
+
+            /// \brief
+            /// Allocate a framebuffer of the given extents.
+            /// \param[in] extents Framebuffer width and height.
+            /// \return Framebuffer wrapping the allocated pixels.
+            template<typename PixelType>
+            typename Framebuffer<PixelType>::SharedPtr Allocate (
+                    const util::Rectangle::Extents &extents) const {
+                if (!allocate) {
+                    return typename Framebuffer<PixelType>::SharedPtr (
+                        new Framebuffer<PixelType> (extents));
+                }
+                std::size_t size = (std::size_t)extents.width * extents.height * sizeof (PixelType);
+                void *ptr = allocate (size, std::max<std::size_t> (alignment, alignof (PixelType)));
+                if (ptr == 0) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Unable to allocate a %u x %u framebuffer.",
+                        extents.width, extents.height);
+                }
+                DeallocateFunc deallocate_ = deallocate;
+                return typename Framebuffer<PixelType>::SharedPtr (
+                    new Framebuffer<PixelType> (
+                        extents,
+                        (PixelType *)ptr,
+                        [deallocate_, size] (PixelType *array) {
+                            if (deallocate_) {
+                                deallocate_ (array, size);
+                            }
+                        }));
+            }
+        };
+
     } // namespace canvas
 } // namespace thekogans
 
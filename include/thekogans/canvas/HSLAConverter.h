@@ -18,8 +18,13 @@
 #if !defined (__thekogans_canvas_HSLAConverter_h)
 #define __thekogans_canvas_HSLAConverter_h
 
+#include <cstddef>
+#include "thekogans/canvas/Config.h"
+#include "thekogans/canvas/RGBAPixel.h"
 #include "thekogans/canvas/HSLAColor.h"
+#include "thekogans/canvas/HSLAPixel.h"
 #include "thekogans/canvas/Converter.h"
+#include "thekogans/canvas/SpanConverter.h"
 
 namespace thekogans {
     namespace canvas {
@@ -20,6 +20,7 @@
 
 #include "thekogans/canvas/Framebuffer.h"
 #include "thekogans/canvas/HSLAPixel.h"
+#include "thekogans/canvas/HSLAConverter.h"
 
 namespace thekogans {
     namespace canvas {
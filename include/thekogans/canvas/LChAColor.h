@@ -0,0 +1,65 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_LChAColor_h)
+#define __thekogans_canvas_LChAColor_h
+
+#include "thekogans/util/Types.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \struct LChAColor LChAColor.h thekogans/canvas/LChAColor.h
+        ///
+        /// \brief
+        /// CIE LCh(ab), the cylindrical form of \see{LabAColor}, with alpha.
+        /// l is in [0, 100], c (chroma) is >= 0, h (hue) is in degrees [0, 360)
+        /// and a is in [0, 1].
+
+        template<typename T>
+        struct LChAColor {
+            typedef T ComponentType;
+            typedef LChAColor<util::f32> ConverterColorType;
+
+            ComponentType l;
+            ComponentType c;
+            ComponentType h;
+            ComponentType a;
+
+            LChAColor () {}
+            LChAColor (
+                ComponentType l_,
+                ComponentType c_,
+                ComponentType h_,
+                ComponentType a_) :
+                l (l_),
+                c (c_),
+                h (h_),
+                a (a_) {}
+
+            static const LChAColor Black;
+        };
+
+        template<typename T>
+        const LChAColor<T> LChAColor<T>::Black (0, 0, 0, 0);
+
+        typedef LChAColor<util::f32> f32LChAColor;
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_LChAColor_h)
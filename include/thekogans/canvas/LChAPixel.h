@@ -0,0 +1,102 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_LChAPixel_h)
+#define __thekogans_canvas_LChAPixel_h
+
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/LChAColor.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        template<typename T>
+        struct LChAPixel {
+            typedef T ComponentType;
+            typedef LChAColor<ComponentType> ColorType;
+
+            ComponentType l;
+            ComponentType c;
+            ComponentType h;
+            ComponentType a;
+
+            /// \brief
+            /// ctor.
+            /// NOTE: We don't initialize anything here. We want to be as close as we can to POTs.
+            /// Smart compilers will understand that and will elide the ctor when we allocate large
+            /// arrays of pixels (see \see{Framebuffer}). It's undestood that initialization will be
+            /// performed soon aftor allocation and doing it twice would just be a waste of time.
+            LChAPixel () {}
+            LChAPixel (const ColorType &color) :
+                l (color.l),
+                c (color.c),
+                h (color.h),
+                a (color.a) {}
+
+            inline ColorType ToColor () const {
+                return ColorType (l, c, h, a);
+            }
+
+            inline LChAPixel &operator = (const ColorType &color) {
+                l = color.l;
+                c = color.c;
+                h = color.h;
+                a = color.a;
+                return *this;
+            }
+        };
+
+        typedef LChAPixel<util::f32> f32LChAPixel;
+
+        template<typename T>
+        struct ALChPixel {
+            typedef T ComponentType;
+            typedef LChAColor<ComponentType> ColorType;
+
+            ComponentType a;
+            ComponentType l;
+            ComponentType c;
+            ComponentType h;
+
+            /// \brief
+            /// ctor.
+            ALChPixel () {}
+            ALChPixel (const ColorType &color) :
+                a (color.a),
+                l (color.l),
+                c (color.c),
+                h (color.h) {}
+
+            inline ColorType ToColor () const {
+                return ColorType (l, c, h, a);
+            }
+
+            inline ALChPixel &operator = (const ColorType &color) {
+                a = color.a;
+                l = color.l;
+                c = color.c;
+                h = color.h;
+                return *this;
+            }
+        };
+
+        typedef ALChPixel<util::f32> f32ALChPixel;
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_LChAPixel_h)
@@ -0,0 +1,303 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_LUT3D_h)
+#define __thekogans_canvas_LUT3D_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "thekogans/util/Types.h"
+#include "thekogans/util/Heap.h"
+#include "thekogans/util/SpinLock.h"
+#include "thekogans/util/RefCounted.h"
+#include "thekogans/util/Array.h"
+#include "thekogans/canvas/Config.h"
+#include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/Converter.h"
+#include "thekogans/canvas/RGBAConverter.h"
+#include "thekogans/canvas/Framebuffer.h"
+#include "thekogans/canvas/Parallel.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \struct LUT3D LUT3D.h thekogans/canvas/LUT3D.h
+        ///
+        /// \brief
+        /// LUT3D is a size x size x size lattice of RGB samples of an arbitrary
+        /// RGB -> RGB transform. Once baked (from a function or a \see{Converter}
+        /// chain) or loaded (from an Adobe/Resolve .cube file), applying it costs
+        /// the same (4 lattice fetches and a tetrahedral interpolation per pixel)
+        /// regardless of how expensive the original transform was. Alpha is passed
+        /// through untouched.
+        ///
+        /// Ex:
+        ///
+        /// \code{.cpp}
+        /// // Bake a 30 degree hue rotation.
+        /// LUT3D::SharedPtr lut = LUT3D::BakeConverter<f32HSLAColor> (
+        ///     LUT3D::DEFAULT_SIZE,
+        ///     [] (const f32HSLAColor &color) -> f32HSLAColor {
+        ///         return f32HSLAColor (fmod (color.h + 30.0f, 360.0f), color.s, color.l, color.a);
+        ///     });
+        /// // Apply it (in place, using all cores).
+        /// lut->Apply (*framebuffer);
+        /// \endcode
+        struct _LIB_THEKOGANS_CANVAS_DECL LUT3D : public util::RefCounted {
+            /// \brief
+            /// Declare \see{RefCounted} pointers.
+            THEKOGANS_UTIL_DECLARE_REF_COUNTED_POINTERS (LUT3D)
+            /// \brief
+            /// LUT3D has a private heap to help with performance and memory fragmentation.
+            THEKOGANS_UTIL_DECLARE_HEAP_WITH_LOCK (LUT3D, util::SpinLock)
+
+            enum {
+                /// \brief
+                /// Smallest lattice.
+                MIN_SIZE = 2,
+                /// \brief
+                /// Largest lattice.
+                MAX_SIZE = 256,
+                /// \brief
+                /// Common lattice sizes. 17 is good enough for
+                /// smooth transforms, 65 for display calibration.
+                SMALL_SIZE = 17,
+                DEFAULT_SIZE = 33,
+                LARGE_SIZE = 65
+            };
+
+            /// \brief
+            /// Number of samples along each axis.
+            const util::ui32 size;
+            /// \brief
+            /// Input value mapped to the first lattice sample (per channel).
+            const f32RGBAColor domainMin;
+            /// \brief
+            /// Input value mapped to the last lattice sample (per channel).
+            const f32RGBAColor domainMax;
+            /// \brief
+            /// size^3 samples, 4 f32 each (r, g, b, 0), red varies fastest
+            /// (same order as .cube files). The 4th component pads each
+            /// sample to a SIMD register.
+            util::Array<util::f32> table;
+
+            /// \brief
+            /// ctor. Create an identity LUT.
+            /// \param[in] size_ Number of samples along each axis [MIN_SIZE, MAX_SIZE].
+            /// \param[in] domainMin_ Input value mapped to the first sample.
+            /// \param[in] domainMax_ Input value mapped to the last sample.
+            LUT3D (
+                util::ui32 size_,
+                const f32RGBAColor &domainMin_ = f32RGBAColor (0.0f, 0.0f, 0.0f, 0.0f),
+                const f32RGBAColor &domainMax_ = f32RGBAColor (1.0f, 1.0f, 1.0f, 1.0f));
+
+            /// \brief
+            /// Return the lattice input color for the given sample.
+            /// \param[in] r Red index.
+            /// \param[in] g Green index.
+            /// \param[in] b Blue index.
+            /// \return Lattice input color.
+            inline f32RGBAColor GetInput (
+                    util::ui32 r,
+                    util::ui32 g,
+                    util::ui32 b) const {
+                util::f32 scale = 1.0f / (size - 1);
+                return f32RGBAColor (
+                    domainMin.r + (domainMax.r - domainMin.r) * r * scale,
+                    domainMin.g + (domainMax.g - domainMin.g) * g * scale,
+                    domainMin.b + (domainMax.b - domainMin.b) * b * scale,
+                    1.0f);
+            }
+
+            /// \brief
+            /// Set the given lattice sample.
+            /// \param[in] r Red index.
+            /// \param[in] g Green index.
+            /// \param[in] b Blue index.
+            /// \param[in] color Transformed color for this sample.
+            inline void SetSample (
+                    util::ui32 r,
+                    util::ui32 g,
+                    util::ui32 b,
+                    const f32RGBAColor &color) {
+                util::f32 *sample = &table[(((std::size_t)b * size + g) * size + r) * 4];
+                sample[0] = color.r;
+                sample[1] = color.g;
+                sample[2] = color.b;
+                sample[3] = 0.0f;
+            }
+
+            /// \brief
+            /// Bake an arbitrary RGB -> RGB transform.
+            /// \param[in] size Number of samples along each axis.
+            /// \param[in] function f32RGBAColor (const f32RGBAColor &) to sample.
+            /// \param[in] threads Maximum number of threads to bake with (0 = all cores).
+            /// \return Baked LUT3D.
+            template<typename Function>
+            static SharedPtr Bake (
+                    util::ui32 size,
+                    Function function,
+                    util::ui32 threads = 0) {
+                SharedPtr lut (new LUT3D (size));
+                LUT3D &lut_ = *lut;
+                ParallelFor (0, size,
+                    [&lut_, &function] (std::size_t begin, std::size_t end) {
+                        for (util::ui32 b = (util::ui32)begin; b < end; ++b) {
+                            for (util::ui32 g = 0; g < lut_.size; ++g) {
+                                for (util::ui32 r = 0; r < lut_.size; ++r) {
+                                    lut_.SetSample (r, g, b, function (lut_.GetInput (r, g, b)));
+                                }
+                            }
+                        }
+                    },
+                    1,
+                    threads);
+                return lut;
+            }
+
+            /// \brief
+            /// Bake a transform expressed in another color space. Every lattice
+            /// sample goes f32RGBAColor -> Converter<ColorType> -> function ->
+            /// Converter<f32RGBAColor>.
+            /// \param[in] size Number of samples along each axis.
+            /// \param[in] function ColorType (const ColorType &) to sample.
+            /// \param[in] threads Maximum number of threads to bake with (0 = all cores).
+            /// \return Baked LUT3D.
+            template<
+                typename ColorType,
+                typename Function>
+            static SharedPtr BakeConverter (
+                    util::ui32 size,
+                    Function function,
+                    util::ui32 threads = 0) {
+                return Bake (size,
+                    [&function] (const f32RGBAColor &color) -> f32RGBAColor {
+                        return Converter<f32RGBAColor>::Convert (
+                            function (Converter<ColorType>::Convert (color)));
+                    },
+                    threads);
+            }
+
+            /// \brief
+            /// Load a LUT from the contents of a .cube file (LUT_3D_SIZE,
+            /// DOMAIN_MIN/MAX and LUT_3D_INPUT_RANGE are recognized).
+            /// \param[in] buffer .cube file contents.
+            /// \param[in] length buffer length.
+            /// \return LUT3D.
+            static SharedPtr FromCubeBuffer (
+                const char *buffer,
+                std::size_t length);
+            /// \brief
+            /// Load a LUT from a .cube file.
+            /// \param[in] path .cube file path.
+            /// \return LUT3D.
+            static SharedPtr FromCubeFile (const std::string &path);
+
+            /// \brief
+            /// Apply the LUT to a single color.
+            /// \param[in] color Color to transform.
+            /// \return Transformed color.
+            f32RGBAColor Apply (const f32RGBAColor &color) const;
+            /// \brief
+            /// Apply the LUT to a span of pixels. in and out can be the same.
+            /// \param[in] in Pixels to transform.
+            /// \param[out] out Transformed pixels.
+            /// \param[in] count Number of pixels.
+            void Apply (
+                const f32RGBAPixel *in,
+                f32RGBAPixel *out,
+                std::size_t count) const;
+            /// \brief
+            /// Apply the LUT to a span of pixels. in and out can be the same.
+            /// \param[in] in Pixels to transform.
+            /// \param[out] out Transformed pixels.
+            /// \param[in] count Number of pixels.
+            void Apply (
+                const ui8RGBAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count) const;
+
+            /// \brief
+            /// Apply the LUT to the framebuffer (in place). Rows are split in
+            /// to bands processed in parallel (see \see{ParallelFor}). Any ui8
+            /// or f32 RGBA family pixel layout is supported. ui8RGBAPixel and
+            /// f32RGBAPixel are processed directly, others are swizzled a row
+            /// at a time.
+            /// \param[in] framebuffer Framebuffer to transform.
+            /// \param[in] threads Maximum number of threads (0 = all cores).
+            template<typename T>
+            void Apply (
+                    Framebuffer<T> &framebuffer,
+                    util::ui32 threads = 0) const {
+                const util::ui32 width = framebuffer.extents.width;
+                T *pixels = framebuffer.buffer.array;
+                ParallelFor (0, framebuffer.extents.height,
+                    [this, width, pixels] (std::size_t begin, std::size_t end) {
+                        ApplyRows (pixels + begin * width, width, end - begin);
+                    },
+                    std::max<std::size_t> (1, MIN_PIXELS_PER_BAND / std::max<util::ui32> (width, 1)),
+                    threads);
+            }
+
+        private:
+            enum {
+                /// \brief
+                /// Don't bother spinning up a thread for less than this many pixels.
+                MIN_PIXELS_PER_BAND = 16384
+            };
+
+            inline void ApplyRows (
+                    ui8RGBAPixel *pixels,
+                    util::ui32 width,
+                    std::size_t rows) const {
+                Apply (pixels, pixels, width * rows);
+            }
+            inline void ApplyRows (
+                    f32RGBAPixel *pixels,
+                    util::ui32 width,
+                    std::size_t rows) const {
+                Apply (pixels, pixels, width * rows);
+            }
+            template<typename T>
+            void ApplyRows (
+                    T *pixels,
+                    util::ui32 width,
+                    std::size_t rows) const {
+                std::vector<RGBAPixel<typename T::ComponentType>> row (width);
+                for (; rows-- != 0; pixels += width) {
+                    for (util::ui32 i = 0; i < width; ++i) {
+                        row[i] = pixels[i].ToColor ();
+                    }
+                    Apply (row.data (), row.data (), width);
+                    for (util::ui32 i = 0; i < width; ++i) {
+                        pixels[i] = row[i].ToColor ();
+                    }
+                }
+            }
+
+            /// \brief
+            /// LUT3D is neither copy constructable, nor assignable.
+            THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (LUT3D)
+        };
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_LUT3D_h)
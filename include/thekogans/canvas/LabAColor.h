@@ -0,0 +1,65 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_LabAColor_h)
+#define __thekogans_canvas_LabAColor_h
+
+#include "thekogans/util/Types.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \struct LabAColor LabAColor.h thekogans/canvas/LabAColor.h
+        ///
+        /// \brief
+        /// CIE L*a*b* (D65 white point) color with alpha. l is in [0, 100],
+        /// a and b are (roughly) in [-128, 127] and alpha is in [0, 1].
+        /// NOTE: Because a is taken by the green-red axis, alpha is spelled out.
+
+        template<typename T>
+        struct LabAColor {
+            typedef T ComponentType;
+            typedef LabAColor<util::f32> ConverterColorType;
+
+            ComponentType l;
+            ComponentType a;
+            ComponentType b;
+            ComponentType alpha;
+
+            LabAColor () {}
+            LabAColor (
+                ComponentType l_,
+                ComponentType a_,
+                ComponentType b_,
+                ComponentType alpha_) :
+                l (l_),
+                a (a_),
+                b (b_),
+                alpha (alpha_) {}
+
+            static const LabAColor Black;
+        };
+
+        template<typename T>
+        const LabAColor<T> LabAColor<T>::Black (0, 0, 0, 0);
+
+        typedef LabAColor<util::f32> f32LabAColor;
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_LabAColor_h)
@@ -0,0 +1,102 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_LabAPixel_h)
+#define __thekogans_canvas_LabAPixel_h
+
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/LabAColor.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        template<typename T>
+        struct LabAPixel {
+            typedef T ComponentType;
+            typedef LabAColor<ComponentType> ColorType;
+
+            ComponentType l;
+            ComponentType a;
+            ComponentType b;
+            ComponentType alpha;
+
+            /// \brief
+            /// ctor.
+            /// NOTE: We don't initialize anything here. We want to be as close as we can to POTs.
+            /// Smart compilers will understand that and will elide the ctor when we allocate large
+            /// arrays of pixels (see \see{Framebuffer}). It's undestood that initialization will be
+            /// performed soon aftor allocation and doing it twice would just be a waste of time.
+            LabAPixel () {}
+            LabAPixel (const ColorType &color) :
+                l (color.l),
+                a (color.a),
+                b (color.b),
+                alpha (color.alpha) {}
+
+            inline ColorType ToColor () const {
+                return ColorType (l, a, b, alpha);
+            }
+
+            inline LabAPixel &operator = (const ColorType &color) {
+                l = color.l;
+                a = color.a;
+                b = color.b;
+                alpha = color.alpha;
+                return *this;
+            }
+        };
+
+        typedef LabAPixel<util::f32> f32LabAPixel;
+
+        template<typename T>
+        struct ALabPixel {
+            typedef T ComponentType;
+            typedef LabAColor<ComponentType> ColorType;
+
+            ComponentType alpha;
+            ComponentType l;
+            ComponentType a;
+            ComponentType b;
+
+            /// \brief
+            /// ctor.
+            ALabPixel () {}
+            ALabPixel (const ColorType &color) :
+                alpha (color.alpha),
+                l (color.l),
+                a (color.a),
+                b (color.b) {}
+
+            inline ColorType ToColor () const {
+                return ColorType (l, a, b, alpha);
+            }
+
+            inline ALabPixel &operator = (const ColorType &color) {
+                alpha = color.alpha;
+                l = color.l;
+                a = color.a;
+                b = color.b;
+                return *this;
+            }
+        };
+
+        typedef ALabPixel<util::f32> f32ALabPixel;
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_LabAPixel_h)
@@ -0,0 +1,104 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_MappedFile_h)
+#define __thekogans_canvas_MappedFile_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/Config.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \struct MappedFile MappedFile.h thekogans/canvas/MappedFile.h
+        ///
+        /// \brief
+        /// Read only view of a whole file for the From*File loaders. Files of
+        /// MAP_THRESHOLD bytes and up are memory mapped (and the kernel is told
+        /// they will be read sequentially) so the decoders work straight out of
+        /// the page cache. Smaller files are cheaper to read (pread) in to a
+        /// private buffer than to map. Opened copy on write, the contents can
+        /// be modified (see \see{GetWritableData}) without the changes ever
+        /// reaching the file. Loaders use that to hand out framebuffers that
+        /// alias the file (see \see{FromPNMFile}).
+        struct _LIB_THEKOGANS_CANVAS_DECL MappedFile {
+            /// \brief
+            /// Files smaller than this are read, not mapped.
+            static const std::size_t MAP_THRESHOLD = 64 * 1024;
+
+            /// \brief
+            /// File contents (0 if the file is empty).
+            const util::ui8 *data;
+            /// \brief
+            /// File size.
+            std::size_t size;
+
+        private:
+            /// \brief
+            /// Start of the mapping (0 if the file was read).
+            void *mapping;
+            /// \brief
+            /// Small file contents.
+            std::vector<util::ui8> buffer;
+            /// \brief
+            /// true = the contents are private and writable.
+            bool copyOnWrite;
+
+        public:
+            /// \brief
+            /// ctor.
+            /// \param[in] path File to map.
+            /// \param[in] sequential true = the file will be read front to back
+            /// (decoders), false = only parts of it will be touched (probing headers).
+            /// \param[in] copyOnWrite_ true = map the file copy on write so its
+            /// contents can be modified in place.
+            explicit MappedFile (
+                const std::string &path,
+                bool sequential = true,
+                bool copyOnWrite_ = false);
+            /// \brief
+            /// dtor.
+            /// Unmap the file.
+            ~MappedFile ();
+
+            /// \brief
+            /// Return true if the file is mapped (as opposed to read).
+            /// \return true if the file is mapped.
+            inline bool IsMapped () const {
+                return mapping != 0;
+            }
+
+            /// \brief
+            /// Return the contents for writing. Pages are copied the first time
+            /// they are written to, the file is never modified.
+            /// \return The contents (0 unless opened copy on write).
+            inline util::ui8 *GetWritableData () const {
+                return copyOnWrite ? (util::ui8 *)data : 0;
+            }
+
+            /// \brief
+            /// MappedFile is neither copy constructable, nor assignable.
+            THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (MappedFile)
+        };
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_MappedFile_h)
@@ -0,0 +1,121 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_PNGUtils_h)
+#define __thekogans_canvas_PNGUtils_h
+
+#include <cstddef>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/Config.h"
+#include "thekogans/canvas/lodepng.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \brief
+        /// lodepng ships its own (bit at a time) inflate/deflate. These are
+        /// drop in replacements (see LodePNGDecompressSettings::custom_zlib)
+        /// backed by the zlib toolchain, which is several times faster at
+        /// inflating. Building the zlib toolchain from zlib-ng (in its zlib
+        /// compatible mode) makes them faster still without any changes here.
+        /// The output is allocated with malloc, as lodepng expects.
+        /// settings->ignore_adler32 is honored.
+        /// \param[out] out Inflated data.
+        /// \param[out] outsize Inflated data size.
+        /// \param[in] in zlib stream.
+        /// \param[in] insize zlib stream size.
+        /// \param[in] settings lodepng decompress settings.
+        /// \return 0 = success, otherwise a lodepng error code.
+        _LIB_THEKOGANS_CANVAS_DECL unsigned _LIB_THEKOGANS_CANVAS_API ZlibDecompress (
+            unsigned char **out,
+            std::size_t *outsize,
+            const unsigned char *in,
+            std::size_t insize,
+            const LodePNGDecompressSettings *settings);
+
+        /// \struct ZlibCompressContext PNGUtils.h thekogans/canvas/PNGUtils.h
+        ///
+        /// \brief
+        /// Optional ZlibCompress settings. Point LodePNGCompressSettings::custom_context
+        /// at one to pick the zlib level and strategy, and to deflate on more than one
+        /// thread. In parallel mode the input is cut in to blocks that are deflated
+        /// independently (each primed with the 32K of input before it, pigz style),
+        /// ended with a sync flush, and stitched together in to a single zlib stream.
+        /// The result is a little bigger than a serial deflate.
+        struct _LIB_THEKOGANS_CANVAS_DECL ZlibCompressContext {
+            /// \brief
+            /// Default parallel block size.
+            static const std::size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+            /// \brief
+            /// zlib level (-1 = Z_DEFAULT_COMPRESSION, 0 - 9).
+            util::i32 level;
+            /// \brief
+            /// zlib strategy (0 = Z_DEFAULT_STRATEGY).
+            util::i32 strategy;
+            /// \brief
+            /// Maximum number of threads to deflate on (0 = \see{GetHardwareConcurrency}).
+            util::ui32 threads;
+            /// \brief
+            /// Input bytes per parallel block.
+            std::size_t blockSize;
+
+            /// \brief
+            /// ctor.
+            /// \param[in] level_ zlib level.
+            /// \param[in] strategy_ zlib strategy.
+            /// \param[in] threads_ Maximum number of threads to deflate on.
+            /// \param[in] blockSize_ Input bytes per parallel block.
+            ZlibCompressContext (
+                util::i32 level_ = -1,
+                util::i32 strategy_ = 0,
+                util::ui32 threads_ = 1,
+                std::size_t blockSize_ = DEFAULT_BLOCK_SIZE) :
+                level (level_),
+                strategy (strategy_),
+                threads (threads_),
+                blockSize (blockSize_) {}
+        };
+
+        /// \brief
+        /// zlib toolchain backed compressor (see LodePNGCompressSettings::custom_zlib).
+        /// If settings->custom_context points to a \see{ZlibCompressContext}, it
+        /// decides the level, strategy and threads. Otherwise btype == 0 stores,
+        /// use_lz77 == 0 uses huffman only, everything else uses zlib's default level.
+        /// \param[out] out zlib stream.
+        /// \param[out] outsize zlib stream size.
+        /// \param[in] in Data to deflate.
+        /// \param[in] insize Data size.
+        /// \param[in] settings lodepng compress settings.
+        /// \return 0 = success, otherwise a lodepng error code.
+        _LIB_THEKOGANS_CANVAS_DECL unsigned _LIB_THEKOGANS_CANVAS_API ZlibCompress (
+            unsigned char **out,
+            std::size_t *outsize,
+            const unsigned char *in,
+            std::size_t insize,
+            const LodePNGCompressSettings *settings);
+
+        /// \brief
+        /// Point the state's decoder and encoder at ZlibDecompress and ZlibCompress.
+        /// \param[in, out] state lodepng state to modify.
+        _LIB_THEKOGANS_CANVAS_DECL void _LIB_THEKOGANS_CANVAS_API UseZlib (
+            LodePNGState &state);
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_PNGUtils_h)
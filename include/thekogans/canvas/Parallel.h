@@ -0,0 +1,59 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_Parallel_h)
+#define __thekogans_canvas_Parallel_h
+
+#include <cstddef>
+#include <functional>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/Config.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \brief
+        /// Return the number of hardware threads (at least 1).
+        /// \return Number of hardware threads.
+        _LIB_THEKOGANS_CANVAS_DECL util::ui32 _LIB_THEKOGANS_CANVAS_API
+            GetHardwareConcurrency ();
+
+        /// \brief
+        /// Split [begin, end) in to contiguous bands and call body (bandBegin, bandEnd)
+        /// on each band concurrently. Bands run on a pool of worker threads shared by
+        /// all calls (started on first use, at most \see{GetHardwareConcurrency} - 1
+        /// of them) and on the calling thread, which takes part in the work. Calls
+        /// can be nested. ParallelFor returns after all bands are done. If body throws, the first
+        /// exception is rethrown on the calling thread (after all bands are done).
+        /// Use it for embarrassingly parallel, row oriented framebuffer work.
+        /// \param[in] begin First index.
+        /// \param[in] end One past last index.
+        /// \param[in] body Function to call for each band.
+        /// \param[in] grain Minimum band size. Ranges shorter than 2 * grain
+        /// are processed on the calling thread.
+        /// \param[in] threads Maximum number of bands (0 = \see{GetHardwareConcurrency}).
+        _LIB_THEKOGANS_CANVAS_DECL void _LIB_THEKOGANS_CANVAS_API ParallelFor (
+            std::size_t begin,
+            std::size_t end,
+            const std::function<void (std::size_t /*bandBegin*/, std::size_t /*bandEnd*/)> &body,
+            std::size_t grain = 1,
+            util::ui32 threads = 0);
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_Parallel_h)
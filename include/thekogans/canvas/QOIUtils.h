@@ -0,0 +1,322 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_QOIUtils_h)
+#define __thekogans_canvas_QOIUtils_h
+
+#include <cstddef>
+#include <vector>
+#include "thekogans/util/Types.h"
+#include "thekogans/util/Rectangle.h"
+#include "thekogans/canvas/Config.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \brief
+        /// QOI (https://qoiformat.org) is a simple lossless run/index/diff
+        /// codec. It compresses about as well as a fast png and encodes and
+        /// decodes many times faster, which makes it a good fit for scratch
+        /// caches. Besides plain qoi files ("qoif") we read and write a chunked
+        /// variant ("qoic") whose rows are split in to bands that are coded
+        /// independently, so they can be encoded and decoded in parallel:
+        ///
+        /// "qoic" | width (BE32) | height (BE32) | channels | colorspace |
+        /// band rows (BE32) | band count (BE32) | band count * band size (BE32) |
+        /// bands | qoi end marker
+        ///
+        /// Every band is a qoi op stream (starting from the initial qoi state,
+        /// without the end marker) for band rows rows (fewer for the last band).
+
+        /// \brief
+        /// Size of the qoi (and the fixed part of the qoic) header.
+        const std::size_t QOI_HEADER_SIZE = 14;
+        /// \brief
+        /// Size of the fixed qoic band info that follows the header.
+        const std::size_t QOI_BAND_INFO_SIZE = 8;
+        /// \brief
+        /// Size of the qoi end marker.
+        const std::size_t QOI_END_MARKER_SIZE = 8;
+
+        /// \struct QOIHeader QOIUtils.h thekogans/canvas/QOIUtils.h
+        ///
+        /// \brief
+        /// Parsed qoi/qoic header.
+        struct _LIB_THEKOGANS_CANVAS_DECL QOIHeader {
+            /// \brief
+            /// Image width and height.
+            util::Rectangle::Extents extents;
+            /// \brief
+            /// 3 = RGB, 4 = RGBA (informative only).
+            util::ui8 channels;
+            /// \brief
+            /// 0 = sRGB with linear alpha, 1 = all linear (informative only).
+            util::ui8 colorspace;
+            /// \brief
+            /// Rows per band (0 = plain qoi).
+            util::ui32 bandRows;
+            /// \brief
+            /// Size of each band (empty = plain qoi).
+            std::vector<util::ui32> bandSizes;
+
+            /// \brief
+            /// ctor.
+            QOIHeader () :
+                channels (4),
+                colorspace (0),
+                bandRows (0) {}
+
+            /// \brief
+            /// Throw if extents is empty or larger than the qoi pixel limit, or
+            /// channels or colorspace are out of range.
+            void Validate () const;
+            /// \brief
+            /// Parse the header at the beginning of buffer. Throws if it's not
+            /// a valid qoi/qoic header.
+            /// \param[in] buffer Qoi data.
+            /// \param[in] size Qoi data size.
+            /// \return Size of the header (qoic band info included).
+            std::size_t Read (
+                const util::ui8 *buffer,
+                std::size_t size);
+            /// \brief
+            /// Append the header to buffer. If bandSizes is not empty, a qoic
+            /// header (with band info) is written.
+            /// \param[out] buffer Where to append the header.
+            void Write (std::vector<util::ui8> &buffer) const;
+        };
+
+        /// \struct QOIEncoder QOIUtils.h thekogans/canvas/QOIUtils.h
+        ///
+        /// \brief
+        /// Streaming qoi encoder. Pixels (ui8 RGBA, BGRA, ARGB or ABGR) can be
+        /// fed in bands of any size as they are produced, the qoi stream is
+        /// appended to the caller's buffer. Use:
+        ///
+        /// \code{.cpp}
+        /// using namespace thekogans;
+        ///
+        /// std::vector<util::ui8> buffer;
+        /// canvas::QOIEncoder encoder (buffer, extents);
+        /// while (...) {
+        ///     encoder.Encode (rows, rowCount * extents.width);
+        /// }
+        /// encoder.End ();
+        /// \endcode
+        struct _LIB_THEKOGANS_CANVAS_DECL QOIEncoder {
+            /// \struct QOIEncoder::State QOIUtils.h thekogans/canvas/QOIUtils.h
+            ///
+            /// \brief
+            /// Coder state. Also used to code headerless qoic bands.
+            struct _LIB_THEKOGANS_CANVAS_DECL State {
+                /// \brief
+                /// Recently seen pixels (RGBA in memory order).
+                util::ui32 index[64];
+                /// \brief
+                /// Previous pixel (RGBA in memory order).
+                util::ui32 prev;
+                /// \brief
+                /// Length of the current run.
+                util::ui32 run;
+
+                /// \brief
+                /// ctor.
+                State () {
+                    Reset ();
+                }
+
+                /// \brief
+                /// Back to the initial qoi state.
+                void Reset ();
+
+                /// \brief
+                /// Encode count pixels.
+                /// \param[in] pixels Pixels to encode.
+                /// \param[in] count Number of pixels to encode.
+                /// \param[out] out Where to put the ops (room for
+                /// \see{GetMaxEncodedSize} (count) bytes).
+                /// \return Number of bytes written.
+                template<typename PixelType>
+                std::size_t Encode (
+                    const PixelType *pixels,
+                    std::size_t count,
+                    util::ui8 *out);
+                /// \brief
+                /// Flush the pending run (if any).
+                /// \param[out] out Where to put the op (room for 1 byte).
+                /// \return Number of bytes written.
+                std::size_t Flush (util::ui8 *out);
+
+                /// \brief
+                /// Worst case number of bytes count pixels encode to
+                /// (a QOI_OP_RGBA each, plus a run flush).
+                /// \param[in] count Number of pixels.
+                /// \return Worst case encoded size.
+                static std::size_t GetMaxEncodedSize (std::size_t count) {
+                    return count * 5 + 1;
+                }
+            };
+
+        private:
+            /// \brief
+            /// Where to append the stream.
+            std::vector<util::ui8> &buffer;
+            /// \brief
+            /// Coder state.
+            State state;
+            /// \brief
+            /// Pixels still expected.
+            std::size_t pixelsLeft;
+
+        public:
+            /// \brief
+            /// ctor. Append the qoi header to buffer. Throws if the header
+            /// is not valid (see QOIHeader::Validate).
+            /// \param[out] buffer_ Where to append the stream.
+            /// \param[in] extents Image width and height.
+            /// \param[in] channels 3 = RGB, 4 = RGBA (informative only).
+            /// \param[in] colorspace 0 = sRGB with linear alpha, 1 = all linear.
+            QOIEncoder (
+                std::vector<util::ui8> &buffer_,
+                const util::Rectangle::Extents &extents,
+                util::ui8 channels = 4,
+                util::ui8 colorspace = 0);
+
+            /// \brief
+            /// Encode the next count pixels.
+            /// \param[in] pixels Pixels to encode.
+            /// \param[in] count Number of pixels to encode.
+            template<typename PixelType>
+            void Encode (
+                const PixelType *pixels,
+                std::size_t count);
+            /// \brief
+            /// Flush the pending run and append the end marker. Throws if
+            /// fewer pixels than the header promised were encoded.
+            void End ();
+
+            /// \brief
+            /// QOIEncoder is neither copy constructable, nor assignable.
+            THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (QOIEncoder)
+        };
+
+        /// \struct QOIDecoder QOIUtils.h thekogans/canvas/QOIUtils.h
+        ///
+        /// \brief
+        /// Streaming qoi decoder. Pixels (ui8 RGBA, BGRA, ARGB or ABGR) can be
+        /// pulled in bands of any size. Use:
+        ///
+        /// \code{.cpp}
+        /// using namespace thekogans;
+        ///
+        /// canvas::QOIDecoder decoder (buffer, size);
+        /// while (...) {
+        ///     decoder.Decode (rows, rowCount * decoder.header.extents.width);
+        /// }
+        /// \endcode
+        ///
+        /// Only plain qoi streams can be decoded this way. Use \see{FromQOIBuffer}
+        /// for qoic.
+        struct _LIB_THEKOGANS_CANVAS_DECL QOIDecoder {
+            /// \struct QOIDecoder::State QOIUtils.h thekogans/canvas/QOIUtils.h
+            ///
+            /// \brief
+            /// Decoder state. Also used to decode headerless qoic bands.
+            struct _LIB_THEKOGANS_CANVAS_DECL State {
+                /// \brief
+                /// Recently seen pixels (RGBA in memory order).
+                util::ui32 index[64];
+                /// \brief
+                /// Previous pixel (RGBA in memory order).
+                util::ui32 prev;
+                /// \brief
+                /// Repeats of prev still to be output.
+                util::ui32 run;
+
+                /// \brief
+                /// ctor.
+                State () {
+                    Reset ();
+                }
+
+                /// \brief
+                /// Back to the initial qoi state.
+                void Reset ();
+
+                /// \brief
+                /// Decode count pixels. Throws if the ops run out first.
+                /// \param[in] in Ops.
+                /// \param[in] size Ops size.
+                /// \param[out] pixels Where to put the pixels.
+                /// \param[in] count Number of pixels to decode.
+                /// \return Number of bytes consumed.
+                template<typename PixelType>
+                std::size_t Decode (
+                    const util::ui8 *in,
+                    std::size_t size,
+                    PixelType *pixels,
+                    std::size_t count);
+            };
+
+            /// \brief
+            /// Parsed header.
+            QOIHeader header;
+
+        private:
+            /// \brief
+            /// Qoi data.
+            const util::ui8 *buffer;
+            /// \brief
+            /// Qoi data size.
+            std::size_t size;
+            /// \brief
+            /// Next op.
+            std::size_t offset;
+            /// \brief
+            /// Pixels still to be decoded.
+            std::size_t pixelsLeft;
+            /// \brief
+            /// Decoder state.
+            State state;
+
+        public:
+            /// \brief
+            /// ctor. Parse the header.
+            /// \param[in] buffer_ Qoi data (must outlive the decoder).
+            /// \param[in] size_ Qoi data size.
+            QOIDecoder (
+                const util::ui8 *buffer_,
+                std::size_t size_);
+
+            /// \brief
+            /// Decode the next count pixels.
+            /// \param[out] pixels Where to put the pixels.
+            /// \param[in] count Number of pixels to decode.
+            template<typename PixelType>
+            void Decode (
+                PixelType *pixels,
+                std::size_t count);
+
+            /// \brief
+            /// QOIDecoder is neither copy constructable, nor assignable.
+            THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (QOIDecoder)
+        };
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_QOIUtils_h)
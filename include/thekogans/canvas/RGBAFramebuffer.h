@@ -18,8 +18,11 @@
 #if !defined (__thekogans_canvas_RGBAFramebuffer_h)
 #define __thekogans_canvas_RGBAFramebuffer_h
 
+#include <string>
+#include <vector>
 #include "thekogans/canvas/Framebuffer.h"
 #include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/TJUtils.h"
 
 namespace thekogans {
     namespace canvas {
@@ -44,18 +47,505 @@ namespace thekogans {
         typedef Framebuffer<ui32ABGRPixel> ui32ABGRFramebuffer;
         typedef Framebuffer<f32ABGRPixel> f32ABGRFramebuffer;
 
+        typedef Framebuffer<ui8GrayAPixel> ui8GrayAFramebuffer;
+        typedef Framebuffer<ui16GrayAPixel> ui16GrayAFramebuffer;
+        typedef Framebuffer<ui32GrayAPixel> ui32GrayAFramebuffer;
+        typedef Framebuffer<f32GrayAPixel> f32GrayAFramebuffer;
+
         ui8RGBAFramebuffer::SharedPtr FromPNGBuffer (
             const util::ui8 *buffer,
             std::size_t size);
         ui8RGBAFramebuffer::SharedPtr FromPNGFile (const std::string &path);
+        /// \brief
+        /// Decode a png in to a framebuffer of the given pixel type without
+        /// going through 8 bits. PixelType is one of ui8RGBAPixel, ui16RGBAPixel,
+        /// ui8GrayAPixel or ui16GrayAPixel. The png header is inspected first:
+        /// - A png already in PixelType's layout (ex: 16 bit RGBA for ui16RGBAPixel)
+        /// is unfiltered straight in to the framebuffer. 16 bit samples are byte
+        /// swapped to host order as they are unfiltered.
+        /// - A png with the same bit depth but no alpha (RGB or gray) is expanded
+        /// in place (tRNS color key honored).
+        /// - Everything else (palette, 1, 2 and 4 bit gray...) is converted by lodepng.
+        /// Gray pixel types require a grayscale png.
+        /// \param[in] buffer Png data.
+        /// \param[in] size Png data size.
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNGBuffer (
+            const util::ui8 *buffer,
+            std::size_t size);
+        /// \brief
+        /// Decode a png file in to a framebuffer of the given pixel type (see above).
+        /// \param[in] path Png file path.
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNGFile (const std::string &path);
+        /// \brief
+        /// Decode a png in to the caller's framebuffer (see above). Use it to put
+        /// the pixels in pooled, huge page or shared memory (see \see{ProbeImage}
+        /// and \see{FramebufferAllocator}). The framebuffer extents must match
+        /// the png's.
+        /// \param[in] buffer Png data.
+        /// \param[in] size Png data size.
+        /// \param[out] framebuffer Where to put the pixels.
+        template<typename PixelType>
+        void FromPNGBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            Framebuffer<PixelType> &framebuffer);
+        /// \brief
+        /// Decode a png in to memory from the given allocator (see
+        /// \see{FramebufferAllocator}). The header is probed, the pixels are
+        /// allocated and the png is decoded straight in to them.
+        /// \param[in] buffer Png data.
+        /// \param[in] size Png data size.
+        /// \param[in] allocator Where to get the pixel memory from.
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNGBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            const FramebufferAllocator &allocator);
+
+        /// \brief
+        /// Png encoder size/speed trade off.
+        enum PNGProfile {
+            /// \brief
+            /// Smallest color type that holds the pixels, adaptive (minsum)
+            /// row filters and zlib's default level.
+            PNGProfileDefault,
+            /// \brief
+            /// Color type as is, Up filter on every row and zlib level 1.
+            /// Several times faster, files are somewhat bigger.
+            PNGProfileFast
+        };
+
+        /// \brief
+        /// Compress a ui8RGBA, ui16RGBA, ui8GrayA or ui16GrayA framebuffer to a png.
+        /// With threads != 1, images big enough to benefit are deflated on more than
+        /// one thread (see \see{ZlibCompressContext}). The png is written in to the
+        /// caller's buffer (its capacity is reused).
+        /// \param[in] framebuffer Framebuffer to compress.
+        /// \param[out] buffer Where to put the png.
+        /// \param[in] profile Size/speed trade off.
+        /// \param[in] threads Maximum number of threads to deflate on (0 = all).
+        template<typename PixelType>
+        void ToPNGBuffer (
+            const Framebuffer<PixelType> &framebuffer,
+            std::vector<util::ui8> &buffer,
+            PNGProfile profile = PNGProfileDefault,
+            util::ui32 threads = 1);
+        /// \brief
+        /// Compress a ui8RGBA, ui16RGBA, ui8GrayA or ui16GrayA framebuffer to a png file.
+        /// \param[in] framebuffer Framebuffer to compress.
+        /// \param[in] path Png file path.
+        /// \param[in] profile Size/speed trade off.
+        /// \param[in] threads Maximum number of threads to deflate on (0 = all).
+        template<typename PixelType>
+        void ToPNGFile (
+            const Framebuffer<PixelType> &framebuffer,
+            const std::string &path,
+            PNGProfile profile = PNGProfileDefault,
+            util::ui32 threads = 1);
         ui8RGBAFramebuffer::SharedPtr FromJPGBuffer (
             const util::ui8 *buffer,
             std::size_t size);
         ui8RGBAFramebuffer::SharedPtr FromJPGFile (const std::string &path);
+        /// \brief
+        /// Decode a jpeg in to the caller's ui8 RGBA/BGRA/ARGB/ABGR framebuffer
+        /// (alpha is set to 255). The framebuffer extents must match the jpeg's.
+        /// \param[in] buffer Jpeg data.
+        /// \param[in] size Jpeg data size.
+        /// \param[out] framebuffer Where to put the pixels.
+        template<typename PixelType>
+        void FromJPGBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            Framebuffer<PixelType> &framebuffer);
+        /// \brief
+        /// Decode a jpeg in to memory from the given allocator (see
+        /// \see{FramebufferAllocator}). The header is probed, the pixels are
+        /// allocated and the jpeg is decoded straight in to them.
+        /// \param[in] buffer Jpeg data.
+        /// \param[in] size Jpeg data size.
+        /// \param[in] allocator Where to get the pixel memory from.
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromJPGBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            const FramebufferAllocator &allocator);
+        /// \brief
+        /// Decode a jpeg for a thumbnail. libjpeg-turbo can scale (by 1/2, 1/4,
+        /// 1/8...) during the IDCT which is a lot cheaper than decoding the whole
+        /// image and throwing most of it away. The smallest scale that still
+        /// covers targetExtents is used. If exact == true, the result is then
+        /// box filtered down to targetExtents.
+        /// \param[in] buffer Jpeg data.
+        /// \param[in] size Jpeg data size.
+        /// \param[in] targetExtents Desired framebuffer width and height.
+        /// \param[in] exact true = resample to exactly targetExtents.
+        /// \return ui8RGBAFramebuffer::SharedPtr.
+        ui8RGBAFramebuffer::SharedPtr FromJPGBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            const util::Rectangle::Extents &targetExtents,
+            bool exact = false);
+        /// \brief
+        /// Decode a jpeg file for a thumbnail (see above).
+        /// \param[in] path Jpeg file path.
+        /// \param[in] targetExtents Desired framebuffer width and height.
+        /// \param[in] exact true = resample to exactly targetExtents.
+        /// \return ui8RGBAFramebuffer::SharedPtr.
+        ui8RGBAFramebuffer::SharedPtr FromJPGFile (
+            const std::string &path,
+            const util::Rectangle::Extents &targetExtents,
+            bool exact = false);
+        /// \brief
+        /// Decode a region of a jpeg. Only the iMCU rows and columns that
+        /// intersect the region are decoded (the rest are skipped without
+        /// running the IDCT), which makes cropping small tiles out of large
+        /// jpegs cheap. The region is clipped to the image.
+        /// \param[in] buffer Jpeg data.
+        /// \param[in] size Jpeg data size.
+        /// \param[in] region Region of the image to decode.
+        /// \return ui8RGBAFramebuffer::SharedPtr.
+        ui8RGBAFramebuffer::SharedPtr FromJPGBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            const util::Rectangle &region);
+        /// \brief
+        /// Decode a region of a jpeg file (see above).
+        /// \param[in] path Jpeg file path.
+        /// \param[in] region Region of the image to decode.
+        /// \return ui8RGBAFramebuffer::SharedPtr.
+        ui8RGBAFramebuffer::SharedPtr FromJPGFile (
+            const std::string &path,
+            const util::Rectangle &region);
+        /// \brief
+        /// Compress a ui8 RGBA/BGRA/ARGB/ABGR framebuffer to a jpeg. The pixels
+        /// are handed to turbojpeg as is (see \see{TJPixelFormat}), alpha is
+        /// ignored. The jpeg is written in to the caller's buffer which is only
+        /// (re)allocated if it's too small.
+        /// \param[in] framebuffer Framebuffer to compress.
+        /// \param[out] buffer Where to put the jpeg.
+        /// \param[in] quality Jpeg quality [1, 100].
+        /// \param[in] subsamp Chroma subsampling (one of TJSAMP_*).
+        template<typename PixelType>
+        void ToJPGBuffer (
+            const Framebuffer<PixelType> &framebuffer,
+            TJBuffer &buffer,
+            util::ui32 quality = 90,
+            util::i32 subsamp = TJSAMP_420);
+        /// \brief
+        /// Compress a ui8 RGBA/BGRA/ARGB/ABGR framebuffer to a jpeg file.
+        /// \param[in] framebuffer Framebuffer to compress.
+        /// \param[in] path Jpeg file path.
+        /// \param[in] quality Jpeg quality [1, 100].
+        /// \param[in] subsamp Chroma subsampling (one of TJSAMP_*).
+        template<typename PixelType>
+        void ToJPGFile (
+            const Framebuffer<PixelType> &framebuffer,
+            const std::string &path,
+            util::ui32 quality = 90,
+            util::i32 subsamp = TJSAMP_420);
+
         ui8RGBAFramebuffer::SharedPtr FromBMPBuffer (
             const util::ui8 *buffer,
             std::size_t size);
         ui8RGBAFramebuffer::SharedPtr FromBMPFile (const std::string &path);
+        /// \brief
+        /// Decode an uncompressed 24 or 32 bpp bmp (bottom-up or top-down) in to
+        /// the caller's ui8 RGBA or BGRA framebuffer. The framebuffer extents must
+        /// match the bmp's. Rows are converted straight out of buffer (32 bpp in to
+        /// BGRA is a plain copy). A 32 bpp BI_RGB bmp whose alpha is 0 everywhere
+        /// is treated as opaque.
+        /// \param[in] buffer Bmp data.
+        /// \param[in] size Bmp data size.
+        /// \param[out] framebuffer Where to put the pixels.
+        template<typename PixelType>
+        void FromBMPBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            Framebuffer<PixelType> &framebuffer);
+        /// \brief
+        /// Decode a bmp in to memory from the given allocator (see
+        /// \see{FramebufferAllocator}). The header is probed, the pixels are
+        /// allocated and the bmp is decoded straight in to them.
+        /// \param[in] buffer Bmp data.
+        /// \param[in] size Bmp data size.
+        /// \param[in] allocator Where to get the pixel memory from.
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromBMPBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            const FramebufferAllocator &allocator);
+        /// \brief
+        /// Write a ui8 RGBA or BGRA framebuffer as an uncompressed bottom-up bmp.
+        /// The bmp is written in to the caller's buffer (its capacity is reused).
+        /// \param[in] framebuffer Framebuffer to write.
+        /// \param[out] buffer Where to put the bmp.
+        /// \param[in] alpha true = 32 bpp (keep alpha), false = 24 bpp.
+        template<typename PixelType>
+        void ToBMPBuffer (
+            const Framebuffer<PixelType> &framebuffer,
+            std::vector<util::ui8> &buffer,
+            bool alpha = true);
+        /// \brief
+        /// Write a ui8 RGBA or BGRA framebuffer to a bmp file.
+        /// \param[in] framebuffer Framebuffer to write.
+        /// \param[in] path Bmp file path.
+        /// \param[in] alpha true = 32 bpp (keep alpha), false = 24 bpp.
+        template<typename PixelType>
+        void ToBMPFile (
+            const Framebuffer<PixelType> &framebuffer,
+            const std::string &path,
+            bool alpha = true);
+
+        /// \brief
+        /// Decode a qoi (or chunked qoic, see \see{QOIUtils.h}) in to the caller's
+        /// ui8 RGBA/BGRA/ARGB/ABGR framebuffer. The framebuffer extents must match
+        /// the image's. The bands of a qoic are decoded on up to threads threads.
+        /// \param[in] buffer Qoi data.
+        /// \param[in] size Qoi data size.
+        /// \param[out] framebuffer Where to put the pixels.
+        /// \param[in] threads Maximum number of threads to decode on (0 = all).
+        template<typename PixelType>
+        void FromQOIBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            Framebuffer<PixelType> &framebuffer,
+            util::ui32 threads = 1);
+        /// \brief
+        /// Decode a qoi (or qoic).
+        /// \param[in] buffer Qoi data.
+        /// \param[in] size Qoi data size.
+        /// \param[in] threads Maximum number of threads to decode on (0 = all).
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType = ui8RGBAPixel>
+        typename Framebuffer<PixelType>::SharedPtr FromQOIBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            util::ui32 threads = 1);
+        /// \brief
+        /// Decode a qoi (or qoic) file.
+        /// \param[in] path Qoi file path.
+        /// \param[in] threads Maximum number of threads to decode on (0 = all).
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType = ui8RGBAPixel>
+        typename Framebuffer<PixelType>::SharedPtr FromQOIFile (
+            const std::string &path,
+            util::ui32 threads = 1);
+        /// \brief
+        /// Encode a ui8 RGBA/BGRA/ARGB/ABGR framebuffer. With bandRows == 0 (or
+        /// >= the framebuffer height) a plain qoi is written. Otherwise a qoic
+        /// with bandRows rows per band, encoded on up to threads threads. The
+        /// image is written in to the caller's buffer (its capacity is reused).
+        /// \param[in] framebuffer Framebuffer to encode.
+        /// \param[out] buffer Where to put the image.
+        /// \param[in] bandRows Rows per qoic band (0 = plain qoi).
+        /// \param[in] threads Maximum number of threads to encode on (0 = all).
+        template<typename PixelType>
+        void ToQOIBuffer (
+            const Framebuffer<PixelType> &framebuffer,
+            std::vector<util::ui8> &buffer,
+            util::ui32 bandRows = 0,
+            util::ui32 threads = 1);
+        /// \brief
+        /// Encode a ui8 RGBA/BGRA/ARGB/ABGR framebuffer to a qoi (or qoic) file.
+        /// \param[in] framebuffer Framebuffer to encode.
+        /// \param[in] path Qoi file path.
+        /// \param[in] bandRows Rows per qoic band (0 = plain qoi).
+        /// \param[in] threads Maximum number of threads to encode on (0 = all).
+        template<typename PixelType>
+        void ToQOIFile (
+            const Framebuffer<PixelType> &framebuffer,
+            const std::string &path,
+            util::ui32 bandRows = 0,
+            util::ui32 threads = 1);
+
+        /// \brief
+        /// Decode a binary Netpbm (P5 gray, P6 RGB or P7 gray, gray + alpha,
+        /// RGB or RGBA) in to the caller's ui8RGBA, ui16RGBA, ui8GrayA or
+        /// ui16GrayA framebuffer. The framebuffer extents must match the image's.
+        /// A raster already in PixelType's layout is copied (16 bit samples are
+        /// swapped from big endian on the way), anything else is converted:
+        /// samples are scaled from maxval to the full component range, missing
+        /// alpha is opaque and gray is replicated to RGB. Gray pixel types
+        /// require a gray image.
+        /// \param[in] buffer Netpbm data.
+        /// \param[in] size Netpbm data size.
+        /// \param[out] framebuffer Where to put the pixels.
+        template<typename PixelType>
+        void FromPNMBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            Framebuffer<PixelType> &framebuffer);
+        /// \brief
+        /// Decode a binary Netpbm (see above).
+        /// \param[in] buffer Netpbm data.
+        /// \param[in] size Netpbm data size.
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType = ui8RGBAPixel>
+        typename Framebuffer<PixelType>::SharedPtr FromPNMBuffer (
+            const util::ui8 *buffer,
+            std::size_t size);
+        /// \brief
+        /// Decode a binary Netpbm file (see above). The file is mapped copy on
+        /// write (see \see{MappedFile}). If the raster is already in PixelType's
+        /// layout (ex: a P7 RGB_ALPHA with maxval 255 for ui8RGBAPixel) the
+        /// returned framebuffer aliases the mapping, no pixel is copied (16 bit
+        /// samples are swapped in place) and the file stays mapped for as long
+        /// as the framebuffer lives. The file itself is never modified.
+        /// \param[in] path Netpbm file path.
+        /// \return Framebuffer<PixelType>::SharedPtr.
+        template<typename PixelType = ui8RGBAPixel>
+        typename Framebuffer<PixelType>::SharedPtr FromPNMFile (const std::string &path);
+        /// \brief
+        /// Write a ui8RGBA, ui16RGBA, ui8GrayA or ui16GrayA framebuffer as a
+        /// binary Netpbm with maxval 255 (or 65535 for 16 bit pixel types).
+        /// Without alpha RGBA is written as P6 and gray as P5, with alpha both
+        /// are written as P7 (RGB_ALPHA and GRAYSCALE_ALPHA). The image is
+        /// written in to the caller's buffer (its capacity is reused).
+        /// \param[in] framebuffer Framebuffer to write.
+        /// \param[out] buffer Where to put the image.
+        /// \param[in] alpha true = P7 (keep alpha), false = P5/P6.
+        template<typename PixelType>
+        void ToPNMBuffer (
+            const Framebuffer<PixelType> &framebuffer,
+            std::vector<util::ui8> &buffer,
+            bool alpha = false);
+        /// \brief
+        /// Write a framebuffer to a binary Netpbm file (see above). Rows are
+        /// converted and written a band at a time.
+        /// \param[in] framebuffer Framebuffer to write.
+        /// \param[in] path Netpbm file path.
+        /// \param[in] alpha true = P7 (keep alpha), false = P5/P6.
+        template<typename PixelType>
+        void ToPNMFile (
+            const Framebuffer<PixelType> &framebuffer,
+            const std::string &path,
+            bool alpha = false);
+
+        /// \brief
+        /// Image file formats recognized by \see{GetImageFormat}.
+        enum ImageFormat {
+            /// \brief
+            /// Not an image format we know about.
+            ImageFormatUnknown,
+            /// \brief
+            /// Portable Network Graphics.
+            ImageFormatPNG,
+            /// \brief
+            /// JPEG (JFIF/Exif).
+            ImageFormatJPG,
+            /// \brief
+            /// Windows bitmap.
+            ImageFormatBMP,
+            /// \brief
+            /// Quite OK Image format (plain or chunked, see \see{QOIUtils.h}).
+            ImageFormatQOI,
+            /// \brief
+            /// Binary Netpbm (P5 PGM, P6 PPM and P7 PAM).
+            ImageFormatPNM
+        };
+
+        /// \brief
+        /// Identify the image format by its magic bytes.
+        /// \param[in] buffer Image data (at least the first few bytes).
+        /// \param[in] size Image data size.
+        /// \return ImageFormat.
+        ImageFormat GetImageFormat (
+            const util::ui8 *buffer,
+            std::size_t size);
+
+        /// \struct ImageInfo RGBAFramebuffer.h thekogans/canvas/RGBAFramebuffer.h
+        ///
+        /// \brief
+        /// What \see{ProbeImage} learns from an image header.
+        struct ImageInfo {
+            /// \brief
+            /// Image format.
+            ImageFormat format;
+            /// \brief
+            /// Image width and height.
+            util::Rectangle::Extents extents;
+            /// \brief
+            /// Number of channels stored in the image (palette images have one).
+            util::ui32 channels;
+            /// \brief
+            /// Bits per channel.
+            util::ui32 bitDepth;
+            /// \brief
+            /// Jpeg chroma subsampling (one of TJSAMP_*), -1 for other formats.
+            util::i32 subsamp;
+
+            /// \brief
+            /// ctor.
+            ImageInfo () :
+                format (ImageFormatUnknown),
+                channels (0),
+                bitDepth (0),
+                subsamp (-1) {}
+        };
+
+        /// \brief
+        /// Read an image header without decoding any pixels. Use it to budget
+        /// memory before committing to a decode. Throws if the format is not
+        /// recognized or the header is bad.
+        /// \param[in] buffer Image data.
+        /// \param[in] size Image data size.
+        /// \return ImageInfo.
+        ImageInfo ProbeImage (
+            const util::ui8 *buffer,
+            std::size_t size);
+        /// \brief
+        /// Read an image file header without decoding any pixels. The file is
+        /// mapped (see \see{MappedFile}) so only the pages holding the header
+        /// are read.
+        /// \param[in] path Image file path.
+        /// \return ImageInfo.
+        ImageInfo ProbeImageFile (const std::string &path);
+
+        /// \brief
+        /// Decode an image picking the decoder by its magic bytes
+        /// (see \see{GetImageFormat}).
+        /// \param[in] buffer Image data.
+        /// \param[in] size Image data size.
+        /// \return ui8RGBAFramebuffer::SharedPtr.
+        ui8RGBAFramebuffer::SharedPtr FromBuffer (
+            const util::ui8 *buffer,
+            std::size_t size);
+        /// \brief
+        /// Decode an image file picking the decoder by its magic bytes
+        /// (see \see{GetImageFormat}).
+        /// \param[in] path Image file path.
+        /// \return ui8RGBAFramebuffer::SharedPtr.
+        ui8RGBAFramebuffer::SharedPtr FromFile (const std::string &path);
+        /// \brief
+        /// Decode an image in to the caller's framebuffer picking the decoder by
+        /// its magic bytes. The framebuffer extents must match the image's
+        /// (see \see{ProbeImage}).
+        /// \param[in] buffer Image data.
+        /// \param[in] size Image data size.
+        /// \param[out] framebuffer Where to put the pixels.
+        void FromBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            ui8RGBAFramebuffer &framebuffer);
+        /// \brief
+        /// Decode an image in to memory from the given allocator (pools, huge
+        /// pages, shared memory...). The header is probed, the pixels are
+        /// allocated and the matching decoder writes straight in to them.
+        /// \param[in] buffer Image data.
+        /// \param[in] size Image data size.
+        /// \param[in] allocator Where to get the pixel memory from.
+        /// \return ui8RGBAFramebuffer::SharedPtr.
+        ui8RGBAFramebuffer::SharedPtr FromBuffer (
+            const util::ui8 *buffer,
+            std::size_t size,
+            const FramebufferAllocator &allocator);
 
     } // namespace canvas
 } // namespace thekogans
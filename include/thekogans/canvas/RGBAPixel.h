@@ -18,6 +18,7 @@
 #if !defined (__thekogans_canvas_RGBAPixel_h)
 #define __thekogans_canvas_RGBAPixel_h
 
+#include <type_traits>
 #include "thekogans/util/Types.h"
 #include "thekogans/canvas/RGBAColor.h"
 
@@ -187,6 +188,58 @@ namespace thekogans {
         typedef ABGRPixel<util::ui32> ui32ABGRPixel;
         typedef ABGRPixel<util::f32> f32ABGRPixel;
 
+        /// \struct GrayAPixel RGBAPixel.h thekogans/canvas/RGBAPixel.h
+        ///
+        /// \brief
+        /// Gray (luminance) and alpha. This is the layout of grayscale pngs.
+        /// The color type is RGBA so gray framebuffers convert to and from
+        /// every other color space. ToColor replicates gray to r, g and b,
+        /// assigning a color takes its (BT.601) luma.
+        template<typename T>
+        struct GrayAPixel {
+            typedef T ComponentType;
+            typedef RGBAColor<ComponentType> ColorType;
+
+            ComponentType y;
+            ComponentType a;
+
+            /// \brief
+            /// ctor.
+            GrayAPixel () {}
+            GrayAPixel (const ColorType &color) :
+                y (Luma (color)),
+                a (color.a) {}
+
+            inline ColorType ToColor () const {
+                return ColorType (y, y, y, a);
+            }
+
+            inline GrayAPixel &operator = (const ColorType &color) {
+                y = Luma (color);
+                a = color.a;
+                return *this;
+            }
+
+            static inline ComponentType Luma (const ColorType &color) {
+                // The weights add up to 1, so integer components can't overflow.
+                return (ComponentType)(
+                    0.299 * color.r + 0.587 * color.g + 0.114 * color.b +
+                    (std::is_integral<ComponentType>::value ? 0.5 : 0.0));
+            }
+        };
+
+        typedef GrayAPixel<util::ui8> ui8GrayAPixel;
+        typedef GrayAPixel<util::ui16> ui16GrayAPixel;
+        typedef GrayAPixel<util::ui32> ui32GrayAPixel;
+        typedef GrayAPixel<util::f32> f32GrayAPixel;
+
+        static_assert (
+            sizeof (ui8GrayAPixel) == 2 * util::UI8_SIZE,
+            "Invalid assumption about ui8GrayAPixel component packing.");
+        static_assert (
+            sizeof (ui16GrayAPixel) == 2 * util::UI16_SIZE,
+            "Invalid assumption about ui16GrayAPixel component packing.");
+
     } // namespace canvas
 } // namespace thekogans
 
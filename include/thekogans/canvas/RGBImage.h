@@ -25,7 +25,7 @@
 #include "thekogans/util/Heap.h"
 #include "thekogans/util/SpinLock.h"
 #include "thekogans/canvas/Config.h"
-#include "thekogans/canvas/Color.h"
+#include "thekogans/canvas/RGBAColor.h"
 
 namespace thekogans {
     namespace canvas {
@@ -174,7 +174,7 @@ namespace thekogans {
 
             void Clear (
                 const util::Rectangle &rectangle,
-                const Color &color = Color ());
+                const ui8RGBAColor &color = ui8RGBAColor (0, 0, 0, 255));
 
             enum Filter {
                 UnknownFilter,
@@ -209,7 +209,7 @@ namespace thekogans {
             UniquePtr Rotate (
                 util::f32 angle,
                 const util::Point &centerOfRotation,
-                const Color &fillColor = Color (0, 0, 0)) const;
+                const ui8RGBAColor &fillColor = ui8RGBAColor (0, 0, 0, 255)) const;
 
             enum Axis {
                 UnknownAxis,
@@ -262,7 +262,7 @@ namespace thekogans {
             }
 
             void ColorToPixel (
-                const Color &color,
+                const ui8RGBAColor &color,
                 std::vector<util::ui8> &pixel) const;
 
         protected:
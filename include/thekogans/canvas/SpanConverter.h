@@ -0,0 +1,301 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_SpanConverter_h)
+#define __thekogans_canvas_SpanConverter_h
+
+#include <cstddef>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/Config.h"
+#include "thekogans/canvas/ComponentConverter.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/HSLAPixel.h"
+#include "thekogans/canvas/LabAPixel.h"
+#include "thekogans/canvas/LChAPixel.h"
+#include "thekogans/canvas/YUVAPixel.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        /// \struct SpanConverter SpanConverter.h thekogans/canvas/SpanConverter.h
+        ///
+        /// \brief
+        /// SpanConverter is the bulk counterpart of \see{Converter}. Where Converter
+        /// works one color at a time, SpanConverter converts a whole run of pixels
+        /// in one call. This is where hand tuned (SIMD) kernels for the conversions
+        /// that matter live. The primary template is not Specialized and
+        /// \see{Framebuffer::Convert} falls back to the per pixel Converter chain.
+        /// Specialize it (and set Specialized = 1) to plug in a faster path.
+        /// \tparam InPixelType Pixel type to convert from.
+        /// \tparam OutPixelType Pixel type to convert to.
+
+        template<
+            typename InPixelType,
+            typename OutPixelType>
+        struct SpanConverter {
+            enum {
+                /// \brief
+                /// 1 if Convert below does the real work.
+                Specialized = 0
+            };
+
+            /// \brief
+            /// Convert a span of pixels.
+            /// \param[in] in Pixels to convert.
+            /// \param[out] out Where to put the converted pixels.
+            /// \param[in] count Number of pixels in the span.
+            static void Convert (
+                const InPixelType * /*in*/,
+                OutPixelType * /*out*/,
+                std::size_t /*count*/) {}
+        };
+
+        /// \struct ComponentSpanConverter SpanConverter.h thekogans/canvas/SpanConverter.h
+        ///
+        /// \brief
+        /// Helper used to convert between two pixels of identical layout
+        /// that only differ in their component type (ex: ui8RGBAPixel ->
+        /// ui16RGBAPixel). Such pixels are just flat arrays of components
+        /// and we convert them as such.
+        /// \tparam InPixelType Pixel type to convert from.
+        /// \tparam OutPixelType Pixel type to convert to.
+        /// \tparam ComponentConverterType One of the *ScaleComponentConverter.
+
+        template<
+            typename InPixelType,
+            typename OutPixelType,
+            typename ComponentConverterType>
+        struct ComponentSpanConverter {
+            enum {
+                Specialized = 1
+            };
+
+            typedef typename ComponentConverterType::InComponentType InComponentType;
+            typedef typename ComponentConverterType::OutComponentType OutComponentType;
+
+            enum {
+                /// \brief
+                /// Number of components in a pixel.
+                ComponentCount = sizeof (InPixelType) / sizeof (InComponentType)
+            };
+
+            static_assert (
+                sizeof (InPixelType) == ComponentCount * sizeof (InComponentType) &&
+                sizeof (OutPixelType) == ComponentCount * sizeof (OutComponentType),
+                "Invalid assumption about pixel component packing.");
+
+            static void Convert (
+                    const InPixelType *in,
+                    OutPixelType *out,
+                    std::size_t count) {
+                ComponentConverterType::Convert (
+                    (const InComponentType *)in,
+                    (OutComponentType *)out,
+                    count * ComponentCount);
+            }
+        };
+
+        // Component depth changes between pixels of the same layout.
+
+        template<template<typename> class PixelType>
+        struct SpanConverter<PixelType<util::ui8>, PixelType<util::ui16>> :
+            public ComponentSpanConverter<
+                PixelType<util::ui8>,
+                PixelType<util::ui16>,
+                ui8Toui16ScaleComponentConverter> {};
+
+        template<template<typename> class PixelType>
+        struct SpanConverter<PixelType<util::ui8>, PixelType<util::ui32>> :
+            public ComponentSpanConverter<
+                PixelType<util::ui8>,
+                PixelType<util::ui32>,
+                ui8Toui32ScaleComponentConverter> {};
+
+        template<template<typename> class PixelType>
+        struct SpanConverter<PixelType<util::ui16>, PixelType<util::ui8>> :
+            public ComponentSpanConverter<
+                PixelType<util::ui16>,
+                PixelType<util::ui8>,
+                ui16Toui8ScaleComponentConverter> {};
+
+        template<template<typename> class PixelType>
+        struct SpanConverter<PixelType<util::ui16>, PixelType<util::ui32>> :
+            public ComponentSpanConverter<
+                PixelType<util::ui16>,
+                PixelType<util::ui32>,
+                ui16Toui32ScaleComponentConverter> {};
+
+        template<template<typename> class PixelType>
+        struct SpanConverter<PixelType<util::ui32>, PixelType<util::ui8>> :
+            public ComponentSpanConverter<
+                PixelType<util::ui32>,
+                PixelType<util::ui8>,
+                ui32Toui8ScaleComponentConverter> {};
+
+        template<template<typename> class PixelType>
+        struct SpanConverter<PixelType<util::ui32>, PixelType<util::ui16>> :
+            public ComponentSpanConverter<
+                PixelType<util::ui32>,
+                PixelType<util::ui16>,
+                ui32Toui16ScaleComponentConverter> {};
+
+        // Kernels for pixel pairs of different color spaces are declared
+        // here, next to the primary template, so that every translation
+        // unit sees the same SpanConverter whether or not it includes the
+        // color space's converter header. They are defined in the matching
+        // *Converter.cpp.
+
+        // Branchless (SIMD where available) HSLA <-> RGBA span kernels
+        // (HSLAConverter.cpp). Color ranges match the \see{Converter} chain
+        // (h in [0, 360), s and l in [0, 100]).
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<f32RGBAPixel, f32HSLAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const f32RGBAPixel *in,
+                f32HSLAPixel *out,
+                std::size_t count);
+        };
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<ui8RGBAPixel, f32HSLAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const ui8RGBAPixel *in,
+                f32HSLAPixel *out,
+                std::size_t count);
+        };
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<f32HSLAPixel, f32RGBAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const f32HSLAPixel *in,
+                f32RGBAPixel *out,
+                std::size_t count);
+        };
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<f32HSLAPixel, ui8RGBAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const f32HSLAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count);
+        };
+
+        // RGBA -> LabA span kernels (LabAConverter.cpp). They go straight
+        // from (s)RGB to Lab, without stopping at \see{XYZAColor}, and
+        // replace cbrt with a vectorized approximation + Newton refinement.
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<f32RGBAPixel, f32LabAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const f32RGBAPixel *in,
+                f32LabAPixel *out,
+                std::size_t count);
+        };
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<ui8RGBAPixel, f32LabAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const ui8RGBAPixel *in,
+                f32LabAPixel *out,
+                std::size_t count);
+        };
+
+        // LabA <-> LChA span kernels (LChAConverter.cpp). It's a cartesian
+        // <-> polar change of coordinates, there is no need to take the round
+        // trip through RGBA.
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<f32LabAPixel, f32LChAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const f32LabAPixel *in,
+                f32LChAPixel *out,
+                std::size_t count);
+        };
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<f32LChAPixel, f32LabAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const f32LChAPixel *in,
+                f32LabAPixel *out,
+                std::size_t count);
+        };
+
+        // Fixed point (SIMD where available) RGBA <-> YUVA span kernels
+        // (YUVAConverter.cpp), in the library's DefaultYUVEncoding. Use
+        // \see{YUVASpanConverter} directly for the other encodings.
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<ui8RGBAPixel, ui8YUVAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const ui8RGBAPixel *in,
+                ui8YUVAPixel *out,
+                std::size_t count);
+        };
+
+        template<>
+        struct _LIB_THEKOGANS_CANVAS_DECL SpanConverter<ui8YUVAPixel, ui8RGBAPixel> {
+            enum {
+                Specialized = 1
+            };
+
+            static void Convert (
+                const ui8YUVAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count);
+        };
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_SpanConverter_h)
@@ -18,54 +18,194 @@
 #if !defined (__thekogans_canvas_TJUtils_h)
 #define __thekogans_canvas_TJUtils_h
 
+#include <cstddef>
 #include <turbojpeg.h>
 #include "thekogans/util/Types.h"
 #include "thekogans/util/Exception.h"
 #include "thekogans/canvas/Config.h"
-//#include "thekogans/canvas/RGBImage.h"
+#include "thekogans/canvas/RGBAPixel.h"
 
 namespace thekogans {
     namespace canvas {
 
+        /// \struct TJHandleCache TJUtils.h thekogans/canvas/TJUtils.h
+        ///
+        /// \brief
+        /// tjInit[De]Compress allocates (and tjDestroy frees) the whole codec
+        /// state. For small images that's a good chunk of the decode time.
+        /// TJHandleCache keeps a few released handles per thread and hands them
+        /// back out on the next acquire. Handles are not thread safe, so they
+        /// are never shared between threads. Cached handles are destroyed when
+        /// their thread exits. \see{TJCompressHandle} and \see{TJDecompressHandle}
+        /// go through the cache, so every jpeg entry point benefits transparently.
+        struct _LIB_THEKOGANS_CANVAS_DECL TJHandleCache {
+            enum {
+                /// \brief
+                /// Max number of idle handles (of each kind) kept per thread.
+                MAX_CACHED_HANDLES = 4
+            };
+
+            /// \struct TJHandleCache::Stats TJUtils.h thekogans/canvas/TJUtils.h
+            ///
+            /// \brief
+            /// Process wide handle counters.
+            struct _LIB_THEKOGANS_CANVAS_DECL Stats {
+                /// \brief
+                /// Number of compress handles created.
+                util::ui64 compressCreated;
+                /// \brief
+                /// Number of compress handles reused.
+                util::ui64 compressReused;
+                /// \brief
+                /// Number of decompress handles created.
+                util::ui64 decompressCreated;
+                /// \brief
+                /// Number of decompress handles reused.
+                util::ui64 decompressReused;
+
+                /// \brief
+                /// ctor.
+                Stats () :
+                    compressCreated (0),
+                    compressReused (0),
+                    decompressCreated (0),
+                    decompressReused (0) {}
+            };
+
+            /// \brief
+            /// Return a compress handle (cached or new).
+            /// \return Compress handle.
+            static tjhandle AcquireCompressHandle ();
+            /// \brief
+            /// Give a compress handle back to this thread's cache.
+            /// \param[in] handle Handle returned by AcquireCompressHandle.
+            static void ReleaseCompressHandle (tjhandle handle);
+
+            /// \brief
+            /// Return a decompress handle (cached or new).
+            /// \return Decompress handle.
+            static tjhandle AcquireDecompressHandle ();
+            /// \brief
+            /// Give a decompress handle back to this thread's cache.
+            /// \param[in] handle Handle returned by AcquireDecompressHandle.
+            static void ReleaseDecompressHandle (tjhandle handle);
+
+            /// \brief
+            /// Return a snapshot of the counters.
+            /// \return Snapshot of the counters.
+            static Stats GetStats ();
+            /// \brief
+            /// Zero the counters.
+            static void ResetStats ();
+        };
+
         struct _LIB_THEKOGANS_CANVAS_DECL TJCompressHandle {
             tjhandle handle;
             TJCompressHandle () :
-                    handle (tjInitCompress ()) {
-                if (handle == 0) {
-                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
-                        "%s", tjGetErrorStr ());
-                }
-            }
+                handle (TJHandleCache::AcquireCompressHandle ()) {}
             ~TJCompressHandle () {
-                tjDestroy (handle);
+                TJHandleCache::ReleaseCompressHandle (handle);
             }
         };
 
         struct _LIB_THEKOGANS_CANVAS_DECL TJDecompressHandle {
             tjhandle handle;
             TJDecompressHandle () :
-                    handle (tjInitDecompress ()) {
-                if (handle == 0) {
-                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
-                        "%s", tjGetErrorStr ());
-                }
-            }
+                handle (TJHandleCache::AcquireDecompressHandle ()) {}
             ~TJDecompressHandle () {
-                tjDestroy (handle);
+                TJHandleCache::ReleaseDecompressHandle (handle);
+            }
+        };
+
+        /// \struct TJBuffer TJUtils.h thekogans/canvas/TJUtils.h
+        ///
+        /// \brief
+        /// Caller owned, growable jpeg output buffer. The encoders size it (with
+        /// tjBufSize) and compress in to it with TJFLAG_NOREALLOC. It only grows,
+        /// so a streaming encoder that keeps one around allocates nothing once
+        /// it has seen its largest frame.
+        struct _LIB_THEKOGANS_CANVAS_DECL TJBuffer {
+            /// \brief
+            /// Buffer allocated with tjAlloc.
+            util::ui8 *data;
+            /// \brief
+            /// Allocated size.
+            std::size_t capacity;
+            /// \brief
+            /// Size of the jpeg in data.
+            std::size_t size;
+
+            /// \brief
+            /// ctor.
+            TJBuffer () :
+                data (0),
+                capacity (0),
+                size (0) {}
+            /// \brief
+            /// dtor.
+            ~TJBuffer () {
+                if (data != 0) {
+                    tjFree (data);
+                }
             }
+
+            /// \brief
+            /// Make sure the buffer can hold at least capacity_ bytes.
+            /// The contents are not preserved when the buffer grows.
+            /// \param[in] capacity_ Minimum capacity.
+            void Reserve (std::size_t capacity_);
+            /// \brief
+            /// Make sure the buffer can hold the largest jpeg (tjBufSize) turbojpeg
+            /// can produce for the given image. Throws if the size is invalid.
+            /// \param[in] width Image width.
+            /// \param[in] height Image height.
+            /// \param[in] subsamp TJSAMP_* chroma subsampling.
+            void Reserve (
+                util::ui32 width,
+                util::ui32 height,
+                util::i32 subsamp);
+
+            /// \brief
+            /// TJBuffer is neither copy constructable, nor assignable.
+            THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (TJBuffer)
         };
 
-        _LIB_THEKOGANS_CANVAS_DECL int _LIB_THEKOGANS_CANVAS_API ComponentIndicesToTJPixelFormat (
-            util::ui32 componentIndices,
-            util::ui32 pixelStride);
-
-        // inline int ChromaToTJChroma (RGBImage::Chroma chroma) {
-        //     return
-        //         chroma == RGBImage::CHROMA_NONE ? TJSAMP_444 :
-        //         chroma == RGBImage::CHROMA_2x1 ? TJSAMP_422 :
-        //         chroma == RGBImage::CHROMA_1x2 ? TJSAMP_440 :
-        //         chroma == RGBImage::CHROMA_2x2 ? TJSAMP_420 : 0;
-        // }
+        /// \struct TJPixelFormat TJUtils.h thekogans/canvas/TJUtils.h
+        ///
+        /// \brief
+        /// Maps a packed ui8 pixel layout to the TJPF_* turbojpeg reads
+        /// and writes directly (no swizzle). Only defined for the layouts
+        /// turbojpeg understands.
+        template<typename PixelType>
+        struct TJPixelFormat;
+
+        template<>
+        struct TJPixelFormat<ui8RGBAPixel> {
+            enum {
+                Value = TJPF_RGBX
+            };
+        };
+
+        template<>
+        struct TJPixelFormat<ui8BGRAPixel> {
+            enum {
+                Value = TJPF_BGRX
+            };
+        };
+
+        template<>
+        struct TJPixelFormat<ui8ARGBPixel> {
+            enum {
+                Value = TJPF_XRGB
+            };
+        };
+
+        template<>
+        struct TJPixelFormat<ui8ABGRPixel> {
+            enum {
+                Value = TJPF_XBGR
+            };
+        };
 
     } // namespace canvas
 } // namespace thekogans
@@ -26,6 +26,7 @@ namespace thekogans {
         template<typename T>
         struct YUVAColor {
             typedef T ComponentType;
+            typedef YUVAColor<util::f32> ConverterColorType;
 
             ComponentType y;
             ComponentType u;
@@ -0,0 +1,351 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#if !defined (__thekogans_canvas_YUVAConverter_h)
+#define __thekogans_canvas_YUVAConverter_h
+
+#include <cstddef>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/Config.h"
+#include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/YUVAColor.h"
+#include "thekogans/canvas/YUVAPixel.h"
+#include "thekogans/canvas/Converter.h"
+#include "thekogans/canvas/SpanConverter.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        // YUV matrices. Kr and Kb are the red and blue luma weights.
+
+        /// \struct YUVMatrixBT601 YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// SD video, JPEG.
+        struct YUVMatrixBT601 {
+            static util::f32 Kr () {
+                return 0.299f;
+            }
+            static util::f32 Kb () {
+                return 0.114f;
+            }
+        };
+
+        /// \struct YUVMatrixBT709 YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// HD video.
+        struct YUVMatrixBT709 {
+            static util::f32 Kr () {
+                return 0.2126f;
+            }
+            static util::f32 Kb () {
+                return 0.0722f;
+            }
+        };
+
+        /// \struct YUVMatrixBT2020 YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// UHD video (non-constant luminance).
+        struct YUVMatrixBT2020 {
+            static util::f32 Kr () {
+                return 0.2627f;
+            }
+            static util::f32 Kb () {
+                return 0.0593f;
+            }
+        };
+
+        // ui8 YUV ranges. Y = Y_OFFSET + Y_SCALE * y, U = 128 + C_SCALE * u.
+
+        /// \struct YUVRangeFull YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// Full (JPEG) range.
+        struct YUVRangeFull {
+            enum {
+                Y_OFFSET = 0,
+                Y_SCALE = 255,
+                C_SCALE = 255
+            };
+        };
+
+        /// \struct YUVRangeLimited YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// Limited (studio/video) range.
+        struct YUVRangeLimited {
+            enum {
+                Y_OFFSET = 16,
+                Y_SCALE = 219,
+                C_SCALE = 224
+            };
+        };
+
+        /// \struct YUVEncoding YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// A matrix and a range. f32YUVAColor is always normalized (y in [0, 1],
+        /// u and v in [-0.5, 0.5]) and only depends on the matrix. The range
+        /// is only used for ui8YUVAColor.
+        /// \tparam MatrixType_ One of YUVMatrixBT601, YUVMatrixBT709 or YUVMatrixBT2020.
+        /// \tparam RangeType_ One of YUVRangeFull or YUVRangeLimited.
+        template<
+            typename MatrixType_,
+            typename RangeType_>
+        struct YUVEncoding {
+            typedef MatrixType_ MatrixType;
+            typedef RangeType_ RangeType;
+
+            /// \brief
+            /// f32RGBAColor -> f32YUVAColor.
+            static f32YUVAColor FromRGBA (const f32RGBAColor &color) {
+                const util::f32 kr = MatrixType::Kr ();
+                const util::f32 kb = MatrixType::Kb ();
+                util::f32 y = kr * color.r + (1.0f - kr - kb) * color.g + kb * color.b;
+                return f32YUVAColor (
+                    y,
+                    (color.b - y) / (2.0f * (1.0f - kb)),
+                    (color.r - y) / (2.0f * (1.0f - kr)),
+                    color.a);
+            }
+
+            /// \brief
+            /// f32YUVAColor -> f32RGBAColor.
+            static f32RGBAColor ToRGBA (const f32YUVAColor &color) {
+                const util::f32 kr = MatrixType::Kr ();
+                const util::f32 kb = MatrixType::Kb ();
+                const util::f32 kg = 1.0f - kr - kb;
+                return f32RGBAColor (
+                    color.y + 2.0f * (1.0f - kr) * color.v,
+                    color.y -
+                        2.0f * kb * (1.0f - kb) / kg * color.u -
+                        2.0f * kr * (1.0f - kr) / kg * color.v,
+                    color.y + 2.0f * (1.0f - kb) * color.u,
+                    color.a);
+            }
+
+            /// \brief
+            /// ui8YUVAColor -> f32YUVAColor.
+            static f32YUVAColor Normalize (const ui8YUVAColor &color) {
+                return f32YUVAColor (
+                    ((util::f32)color.y - RangeType::Y_OFFSET) / RangeType::Y_SCALE,
+                    ((util::f32)color.u - 128.0f) / RangeType::C_SCALE,
+                    ((util::f32)color.v - 128.0f) / RangeType::C_SCALE,
+                    color.a / 255.0f);
+            }
+
+            /// \brief
+            /// f32YUVAColor -> ui8YUVAColor (rounded and clamped).
+            static ui8YUVAColor Quantize (const f32YUVAColor &color) {
+                return ui8YUVAColor (
+                    Clamp (RangeType::Y_OFFSET + color.y * RangeType::Y_SCALE),
+                    Clamp (128.0f + color.u * RangeType::C_SCALE),
+                    Clamp (128.0f + color.v * RangeType::C_SCALE),
+                    Clamp (color.a * 255.0f));
+            }
+
+        private:
+            static util::ui8 Clamp (util::f32 value) {
+                value += 0.5f;
+                return (util::ui8)(value > 0.0f ? (value < 255.0f ? value : 255.0f) : 0.0f);
+            }
+        };
+
+        /// \brief
+        /// Encoding used by the \see{Converter} chain (see Config.h).
+    #if THEKOGANS_CANVAS_YUV_MATRIX == 601
+        typedef YUVMatrixBT601 DefaultYUVMatrix;
+    #elif THEKOGANS_CANVAS_YUV_MATRIX == 709
+        typedef YUVMatrixBT709 DefaultYUVMatrix;
+    #elif THEKOGANS_CANVAS_YUV_MATRIX == 2020
+        typedef YUVMatrixBT2020 DefaultYUVMatrix;
+    #else // THEKOGANS_CANVAS_YUV_MATRIX == 601
+        #error "THEKOGANS_CANVAS_YUV_MATRIX must be one of 601, 709 or 2020."
+    #endif // THEKOGANS_CANVAS_YUV_MATRIX == 601
+    #if THEKOGANS_CANVAS_YUV_FULL_RANGE
+        typedef YUVEncoding<DefaultYUVMatrix, YUVRangeFull> DefaultYUVEncoding;
+    #else // THEKOGANS_CANVAS_YUV_FULL_RANGE
+        typedef YUVEncoding<DefaultYUVMatrix, YUVRangeLimited> DefaultYUVEncoding;
+    #endif // THEKOGANS_CANVAS_YUV_FULL_RANGE
+
+        /// \brief
+        /// Encoding of the samples inside a (JFIF) jpeg.
+        typedef YUVEncoding<YUVMatrixBT601, YUVRangeFull> JPEGYUVEncoding;
+
+        /// \struct PackedRGBALayout YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// Describes a packed 8 bit per component rgb(a) pixel; its size and the
+        /// byte offsets of its components. Lets the planar kernels read any of
+        /// the ui8 RGBA/BGRA/ARGB/ABGR pixels (and \see{RGBImage}) in place.
+        struct PackedRGBALayout {
+            /// \brief
+            /// Distance (in bytes) between consecutive pixels (3 or 4).
+            util::ui32 pixelStride;
+            /// \brief
+            /// Red offset.
+            util::ui32 r;
+            /// \brief
+            /// Green offset.
+            util::ui32 g;
+            /// \brief
+            /// Blue offset.
+            util::ui32 b;
+            /// \brief
+            /// Alpha offset (>= pixelStride = no alpha, treated as opaque).
+            util::ui32 a;
+
+            /// \brief
+            /// ctor.
+            /// \param[in] pixelStride_ Distance (in bytes) between consecutive pixels.
+            /// \param[in] r_ Red offset.
+            /// \param[in] g_ Green offset.
+            /// \param[in] b_ Blue offset.
+            /// \param[in] a_ Alpha offset.
+            PackedRGBALayout (
+                util::ui32 pixelStride_ = 4,
+                util::ui32 r_ = 0,
+                util::ui32 g_ = 1,
+                util::ui32 b_ = 2,
+                util::ui32 a_ = 3) :
+                pixelStride (pixelStride_),
+                r (r_),
+                g (g_),
+                b (b_),
+                a (a_) {}
+
+            /// \brief
+            /// Return the layout of one of the ui8 rgba pixel types.
+            /// \return Layout of PixelType.
+            template<typename PixelType>
+            static PackedRGBALayout Get () {
+                static_assert (sizeof (PixelType) == 4,
+                    "Invalid assumption about pixel component packing.");
+                return PackedRGBALayout (
+                    sizeof (PixelType),
+                    offsetof (PixelType, r),
+                    offsetof (PixelType, g),
+                    offsetof (PixelType, b),
+                    offsetof (PixelType, a));
+            }
+        };
+
+        /// \struct YUVASpanConverter YUVAConverter.h thekogans/canvas/YUVAConverter.h
+        ///
+        /// \brief
+        /// Fixed point (SIMD where available) ui8RGBAPixel <-> ui8YUVAPixel kernels,
+        /// and their planar (see \see{Framebuffer<PlanarYUVAPixel>}) row counterparts.
+        /// Instantiated for all combinations of matrix and range.
+        /// \tparam Encoding \see{YUVEncoding} to use.
+        template<typename Encoding>
+        struct YUVASpanConverter {
+            /// \brief
+            /// Convert a span of RGBA pixels to YUVA.
+            /// \param[in] in Pixels to convert.
+            /// \param[out] out Where to put the converted pixels.
+            /// \param[in] count Number of pixels in the span.
+            static void FromRGBA (
+                const ui8RGBAPixel *in,
+                ui8YUVAPixel *out,
+                std::size_t count);
+            /// \brief
+            /// Convert a span of YUVA pixels to RGBA.
+            /// \param[in] in Pixels to convert.
+            /// \param[out] out Where to put the converted pixels.
+            /// \param[in] count Number of pixels in the span.
+            static void ToRGBA (
+                const ui8YUVAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count);
+
+            /// \brief
+            /// Convert one row (or two rows if chroma is vertically subsampled)
+            /// of packed rgb(a) pixels to planar YUV(A) in a single pass. Chroma is
+            /// computed from the average color of the 1, 2 or 4 pixels each sample
+            /// covers. SSE2 handles 4 byte pixels 8 at a time.
+            /// \param[in] row0 First row.
+            /// \param[in] row1 Second row (0 = no vertical chroma subsampling,
+            /// or last row of an odd height image).
+            /// \param[in] layout Pixel layout of both rows.
+            /// \param[in] width Number of pixels in a row.
+            /// \param[out] y0 Luma for row0.
+            /// \param[out] y1 Luma for row1 (ignored if row1 == 0).
+            /// \param[out] u First u sample.
+            /// \param[out] v First v sample.
+            /// \param[in] uvStep Distance between consecutive u (v) samples
+            /// (1 for planar, 2 for interleaved (NV12/NV21) chroma).
+            /// \param[in] subsampleX true = one chroma sample per two pixels.
+            /// \param[out] a0 Optional alpha for row0.
+            /// \param[out] a1 Optional alpha for row1.
+            static void FromRGBA (
+                const util::ui8 *row0,
+                const util::ui8 *row1,
+                const PackedRGBALayout &layout,
+                util::ui32 width,
+                util::ui8 *y0,
+                util::ui8 *y1,
+                util::ui8 *u,
+                util::ui8 *v,
+                util::ui32 uvStep,
+                bool subsampleX,
+                util::ui8 *a0,
+                util::ui8 *a1);
+            /// \brief
+            /// Convert one row of planar YUV(A) to RGBA.
+            /// \param[in] y Luma.
+            /// \param[in] u First u sample.
+            /// \param[in] v First v sample.
+            /// \param[in] uvStep Distance between consecutive u (v) samples.
+            /// \param[in] subsampleX true = one chroma sample per two pixels.
+            /// \param[in] a Optional alpha (0 = opaque).
+            /// \param[out] out Where to put the converted pixels.
+            /// \param[in] width Number of pixels in a row.
+            static void ToRGBA (
+                const util::ui8 *y,
+                const util::ui8 *u,
+                const util::ui8 *v,
+                util::ui32 uvStep,
+                bool subsampleX,
+                const util::ui8 *a,
+                ui8RGBAPixel *out,
+                util::ui32 width);
+        };
+
+        /// \brief
+        /// The kernels are compiled in to the library (see YUVAConverter.cpp)
+        /// for every matrix and range. These declarations keep clients from
+        /// instantiating them and, when built as a dll, import them.
+        extern template struct _LIB_THEKOGANS_CANVAS_DECL
+            YUVASpanConverter<YUVEncoding<YUVMatrixBT601, YUVRangeLimited>>;
+        extern template struct _LIB_THEKOGANS_CANVAS_DECL
+            YUVASpanConverter<YUVEncoding<YUVMatrixBT601, YUVRangeFull>>;
+        extern template struct _LIB_THEKOGANS_CANVAS_DECL
+            YUVASpanConverter<YUVEncoding<YUVMatrixBT709, YUVRangeLimited>>;
+        extern template struct _LIB_THEKOGANS_CANVAS_DECL
+            YUVASpanConverter<YUVEncoding<YUVMatrixBT709, YUVRangeFull>>;
+        extern template struct _LIB_THEKOGANS_CANVAS_DECL
+            YUVASpanConverter<YUVEncoding<YUVMatrixBT2020, YUVRangeLimited>>;
+        extern template struct _LIB_THEKOGANS_CANVAS_DECL
+            YUVASpanConverter<YUVEncoding<YUVMatrixBT2020, YUVRangeFull>>;
+
+    } // namespace canvas
+} // namespace thekogans
+
+#endif // !defined (__thekogans_canvas_YUVAConverter_h)
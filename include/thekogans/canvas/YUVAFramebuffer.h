@@ -18,118 +18,593 @@
 #if !defined (__thekogans_canvas_YUVAFramebuffer_h)
 #define __thekogans_canvas_YUVAFramebuffer_h
 
-#include <memory>
+#include <cassert>
 #include <string>
+#include <type_traits>
 #include "thekogans/util/Types.h"
-#include "thekogans/util/Point.h"
+#include "thekogans/util/Array.h"
 #include "thekogans/util/Rectangle.h"
+#include "thekogans/util/RefCounted.h"
 #include "thekogans/util/Heap.h"
-#include "thekogans/util/SpinLock.h"
 #include "thekogans/canvas/Config.h"
 #include "thekogans/canvas/Framebuffer.h"
+#include "thekogans/canvas/Parallel.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/RGBAFramebuffer.h"
 #include "thekogans/canvas/YUVAColor.h"
 #include "thekogans/canvas/YUVAPixel.h"
+#include "thekogans/canvas/YUVAConverter.h"
 
 namespace thekogans {
     namespace canvas {
 
-        struct RGBImage;
+        typedef Framebuffer<ui8YUVAPixel> ui8YUVAFramebuffer;
+        typedef Framebuffer<ui16YUVAPixel> ui16YUVAFramebuffer;
+        typedef Framebuffer<ui32YUVAPixel> ui32YUVAFramebuffer;
+        typedef Framebuffer<f32YUVAPixel> f32YUVAFramebuffer;
 
-        // NOTE: The one and only format supported by Framebuffer<YUVAPixel> is I420!
+        typedef Framebuffer<ui8VUYAPixel> ui8VUYAFramebuffer;
+        typedef Framebuffer<ui16VUYAPixel> ui16VUYAFramebuffer;
+        typedef Framebuffer<ui32VUYAPixel> ui32VUYAFramebuffer;
+        typedef Framebuffer<f32VUYAPixel> f32VUYAFramebuffer;
+
+        typedef Framebuffer<ui8AYUVPixel> ui8AYUVFramebuffer;
+        typedef Framebuffer<ui16AYUVPixel> ui16AYUVFramebuffer;
+        typedef Framebuffer<ui32AYUVPixel> ui32AYUVFramebuffer;
+        typedef Framebuffer<f32AYUVPixel> f32AYUVFramebuffer;
+
+        typedef Framebuffer<ui8AVUYPixel> ui8AVUYFramebuffer;
+        typedef Framebuffer<ui16AVUYPixel> ui16AVUYFramebuffer;
+        typedef Framebuffer<ui32AVUYPixel> ui32AVUYFramebuffer;
+        typedef Framebuffer<f32AVUYPixel> f32AVUYFramebuffer;
+
+        /// \struct Framebuffer<PlanarYUVAPixel> YUVAFramebuffer.h thekogans/canvas/YUVAFramebuffer.h
+        ///
+        /// \brief
+        /// Planar yuv(a) framebuffer. This is the format video decoders, capture
+        /// devices and jpeg (de)compressors speak. Every plane has its own stride
+        /// and the chroma planes are (optionally) subsampled:
+        ///
+        /// Format | Chroma samples        | Chroma planes
+        /// -------|-----------------------|-------------------------------
+        /// I420   | 1 per 2x2 pixels      | U, V
+        /// I422   | 1 per 2x1 pixels      | U, V
+        /// I444   | 1 per pixel           | U, V
+        /// NV12   | 1 per 2x2 pixels      | U (interleaved UVUV...)
+        /// NV21   | 1 per 2x2 pixels      | U (interleaved VUVU...)
+        ///
+        /// An optional full resolution alpha plane can accompany any format.
+        /// Odd widths and heights are rounded up when computing chroma extents.
+        /// The samples are encoded using one of the \see{YUVEncoding}s. As planar
+        /// buffers don't record it, the encoding is a template parameter of the
+        /// RGBA conversion methods (default = \see{DefaultYUVEncoding}).
 
         template<>
-        struct _LIB_THEKOGANS_CANVAS_DECL Framebuffer<YUVAPixel> {
-            THEKOGANS_UTIL_DECLARE_HEAP_WITH_LOCK (YUVImage, util::SpinLock)
+        struct _LIB_THEKOGANS_CANVAS_DECL Framebuffer<PlanarYUVAPixel> : public util::RefCounted {
+            /// \brief
+            /// Declare \see{RefCounted} pointers.
+            THEKOGANS_UTIL_DECLARE_REF_COUNTED_POINTERS (Framebuffer)
+            /// \brief
+            /// Framebuffer has a private heap to help with performance and memory fragmentation.
+            THEKOGANS_UTIL_DECLARE_STD_ALLOCATOR_FUNCTIONS
+
+            /// \brief
+            /// Framebuffer pixel type.
+            typedef PlanarYUVAPixel PixelType;
+            /// \brief
+            /// Pixel color type.
+            typedef PixelType::ColorType ColorType;
+
+            /// \enum
+            /// Plane layouts.
+            enum Format {
+                /// \brief
+                /// 4:2:0 planar.
+                I420,
+                /// \brief
+                /// 4:2:2 planar.
+                I422,
+                /// \brief
+                /// 4:4:4 planar.
+                I444,
+                /// \brief
+                /// 4:2:0 semi-planar, u first.
+                NV12,
+                /// \brief
+                /// 4:2:0 semi-planar, v first.
+                NV21
+            };
 
             enum {
+                /// \brief
+                /// Luma plane index.
                 Y_INDEX,
+                /// \brief
+                /// U plane index (interleaved chroma plane for NV12/NV21).
                 U_INDEX,
+                /// \brief
+                /// V plane index (unused for NV12/NV21).
                 V_INDEX,
-                A_INDEX
+                /// \brief
+                /// Alpha plane index (optional).
+                A_INDEX,
+                /// \brief
+                /// Number of planes.
+                PLANE_COUNT
             };
 
-            const util::Rectangle::Extents extents;
-            util::Array<util::ui8> buffer;
+            enum {
+                /// \brief
+                /// Row alignment of the planes we allocate.
+                STRIDE_ALIGNMENT = 16,
+                /// \brief
+                /// Minimum number of chroma rows handed to a \see{ParallelFor} band.
+                PARALLEL_GRAIN = 32
+            };
+
+            /// \struct Framebuffer<PlanarYUVAPixel>::Planes YUVAFramebuffer.h thekogans/canvas/YUVAFramebuffer.h
+            ///
+            /// \brief
+            /// Pointers to the first row of each plane.
             struct _LIB_THEKOGANS_CANVAS_DECL Planes {
-                util::ui8 *planes[4];
+                /// \brief
+                /// Plane pointers.
+                util::ui8 *planes[PLANE_COUNT];
 
+                /// \brief
+                /// ctor.
                 Planes () {
                     planes[Y_INDEX] =
                     planes[U_INDEX] =
                     planes[V_INDEX] =
                     planes[A_INDEX] = 0;
                 }
-                Planes (util::ui8 *planes_[4]) {
-                    planes[Y_INDEX] = planes_[Y_INDEX];
-                    planes[U_INDEX] = planes_[U_INDEX];
-                    planes[V_INDEX] = planes_[V_INDEX];
-                    planes[A_INDEX] = planes_[A_INDEX];
-                }
+                /// \brief
+                /// ctor.
+                /// \param[in] y Luma plane.
+                /// \param[in] u U (or interleaved chroma) plane.
+                /// \param[in] v V plane.
+                /// \param[in] a Optional alpha plane.
                 Planes (
                         util::ui8 *y,
                         util::ui8 *u,
                         util::ui8 *v,
-                        util::ui8 *a) {
+                        util::ui8 *a = 0) {
                     planes[Y_INDEX] = y;
                     planes[U_INDEX] = u;
                     planes[V_INDEX] = v;
                     planes[A_INDEX] = a;
                 }
 
-                inline util::ui8 *operator [] (std::size_t index) {
-                    assert (index < 4);
-                    return planes[index];
-                }
+                /// \brief
+                /// Return the plane at the given index.
+                /// \param[in] index Plane index.
+                /// \return Plane at the given index.
                 inline util::ui8 *operator [] (std::size_t index) const {
-                    assert (index < 4);
+                    assert (index < PLANE_COUNT);
                     return planes[index];
                 }
-            } planes;
+            };
 
+            /// \struct Framebuffer<PlanarYUVAPixel>::Strides YUVAFramebuffer.h thekogans/canvas/YUVAFramebuffer.h
+            ///
+            /// \brief
+            /// Distance (in bytes) between consecutive rows of each plane.
             struct _LIB_THEKOGANS_CANVAS_DECL Strides {
-                util::ui32 strides[4];
+                /// \brief
+                /// Plane strides.
+                util::ui32 strides[PLANE_COUNT];
 
+                /// \brief
+                /// ctor.
                 Strides () {
                     strides[Y_INDEX] =
                     strides[U_INDEX] =
                     strides[V_INDEX] =
                     strides[A_INDEX] = 0;
                 }
-                Strides (util::ui32 strides_[4]) {
-                    strides[Y_INDEX] = strides_[Y_INDEX];
-                    strides[U_INDEX] = strides_[U_INDEX];
-                    strides[V_INDEX] = strides_[V_INDEX];
-                    strides[A_INDEX] = strides_[A_INDEX];
-                }
+                /// \brief
+                /// ctor.
+                /// \param[in] y Luma stride.
+                /// \param[in] u U (or interleaved chroma) stride.
+                /// \param[in] v V stride.
+                /// \param[in] a Optional alpha stride.
                 Strides (
                         util::ui32 y,
                         util::ui32 u,
                         util::ui32 v,
-                        util::ui32 a) {
+                        util::ui32 a = 0) {
                     strides[Y_INDEX] = y;
                     strides[U_INDEX] = u;
                     strides[V_INDEX] = v;
                     strides[A_INDEX] = a;
                 }
 
-                inline util::ui32 operator [] (std::size_t index) {
-                    assert (index < 4);
-                    return strides[index];
-                }
+                /// \brief
+                /// Return the stride at the given index.
+                /// \param[in] index Plane index.
+                /// \return Stride at the given index.
                 inline util::ui32 operator [] (std::size_t index) const {
-                    assert (index < 4);
+                    assert (index < PLANE_COUNT);
                     return strides[index];
                 }
-            } strides;
+            };
 
-            YUVImage (const util::Rectangle::Extents &extents_);
+            /// \brief
+            /// Width and height of framebuffer in pixels. They are unchangable.
+            const util::Rectangle::Extents extents;
+            /// \brief
+            /// Plane layout.
+            const Format format;
+            /// \brief
+            /// Plane pointers.
+            Planes planes;
+            /// \brief
+            /// Plane strides.
+            Strides strides;
+            /// \brief
+            /// Framebuffer data. All planes we allocate live in this one block.
+            /// When wrapping, this is the caller's block given to the deleter.
+            util::Array<util::ui8> buffer;
 
-            void Clear (const YUVAColor &color);
+            /// \brief
+            /// ctor.
+            /// Allocate a framebuffer with given extents and format.
+            /// \param[in] extents_ Framebuffer width and height.
+            /// \param[in] format_ Plane layout.
+            /// \param[in] hasAlpha true = allocate an alpha plane.
+            Framebuffer (
+                const util::Rectangle::Extents &extents_,
+                Format format_ = I420,
+                bool hasAlpha = false);
+            /// \brief
+            /// ctor.
+            /// Wrap (zero-copy) planes that belong to someone else (a decoder
+            /// or a capture device). The planes are not copied and must outlive
+            /// the framebuffer. Use the deleter to have the framebuffer release
+            /// them when it's done.
+            /// \param[in] extents_ Framebuffer width and height.
+            /// \param[in] format_ Plane layout.
+            /// \param[in] planes_ Plane pointers.
+            /// \param[in] strides_ Plane strides.
+            /// \param[in] buffer_ Optional block the planes live in.
+            /// \param[in] deleter Deleter used to deallocate the buffer_ pointer.
+            Framebuffer (
+                const util::Rectangle::Extents &extents_,
+                Format format_,
+                const Planes &planes_,
+                const Strides &strides_,
+                util::ui8 *buffer_ = 0,
+                const util::Array<util::ui8>::Deleter &deleter =
+                    [] (util::ui8 * /*array*/) {});
 
-            std::unique_ptr<RGBImage> ToRGBImage (
-                util::ui32 componentIndices) const;
+            /// \brief
+            /// Return true if the chroma planes are horizontally subsampled.
+            /// \return true if the chroma planes are horizontally subsampled.
+            inline bool IsSubsampledX () const {
+                return format != I444;
+            }
+            /// \brief
+            /// Return true if the chroma planes are vertically subsampled.
+            /// \return true if the chroma planes are vertically subsampled.
+            inline bool IsSubsampledY () const {
+                return format == I420 || format == NV12 || format == NV21;
+            }
+            /// \brief
+            /// Return true if u and v share an interleaved plane (NV12/NV21).
+            /// \return true if u and v share an interleaved plane.
+            inline bool IsSemiPlanar () const {
+                return format == NV12 || format == NV21;
+            }
+            /// \brief
+            /// Return true if the framebuffer has an alpha plane.
+            /// \return true if the framebuffer has an alpha plane.
+            inline bool HasAlpha () const {
+                return planes[A_INDEX] != 0;
+            }
+            /// \brief
+            /// Return the chroma plane extents (in samples).
+            /// \return Chroma plane extents.
+            inline util::Rectangle::Extents GetChromaExtents () const {
+                return util::Rectangle::Extents (
+                    IsSubsampledX () ? (extents.width + 1) / 2 : extents.width,
+                    IsSubsampledY () ? (extents.height + 1) / 2 : extents.height);
+            }
+
+            /// \brief
+            /// Return the color at the given coordinates.
+            /// \param[in] x x coordinate of the pixel.
+            /// \param[in] y y coordinate of the pixel.
+            /// \return Color at the given coordinates (alpha = 255 if
+            /// the framebuffer has no alpha plane).
+            ColorType ColorAt (
+                util::ui32 x,
+                util::ui32 y) const;
+
+            /// \brief
+            /// Return a deep copy of the framebuffer (same format, tightly packed planes).
+            /// \return A deep copy of the framebuffer.
+            SharedPtr Copy () const;
+
+            /// \brief
+            /// Clear the framebuffer using the given (encoded) color.
+            /// \param[in] color Color to set every pixel too.
+            void Clear (const ColorType &color);
+
+            /// \brief
+            /// Convert the framebuffer to ui8RGBA.
+            /// \tparam Encoding One of the \see{YUVEncoding}s.
+            /// \return ui8RGBAFramebuffer::SharedPtr.
+            template<typename Encoding = DefaultYUVEncoding>
+            ui8RGBAFramebuffer::SharedPtr ToRGBA () const {
+                ui8RGBAFramebuffer::SharedPtr framebuffer (
+                    new ui8RGBAFramebuffer (extents));
+                const util::ui32 chromaShift = IsSubsampledY () ? 1 : 0;
+                ui8RGBAPixel *dst = framebuffer->buffer.array;
+                ParallelFor (0, extents.height,
+                    [this, chromaShift, dst] (std::size_t begin, std::size_t end) {
+                        for (std::size_t row = begin; row < end; ++row) {
+                            const util::ui8 *u;
+                            const util::ui8 *v;
+                            GetChromaRow ((util::ui32)row >> chromaShift, u, v);
+                            YUVASpanConverter<Encoding>::ToRGBA (
+                                planes[Y_INDEX] + row * strides[Y_INDEX],
+                                u,
+                                v,
+                                IsSemiPlanar () ? 2 : 1,
+                                IsSubsampledX (),
+                                HasAlpha () ? planes[A_INDEX] + row * strides[A_INDEX] : 0,
+                                dst + row * extents.width,
+                                extents.width);
+                        }
+                    },
+                    PARALLEL_GRAIN);
+                return framebuffer;
+            }
+
+            /// \brief
+            /// Convert the framebuffer to any packed pixel type. The trip
+            /// goes through ui8RGBA and \see{Framebuffer::Convert}.
+            /// \tparam OutPixelType Out framebuffer pixel type.
+            /// \tparam Encoding One of the \see{YUVEncoding}s.
+            /// \return Framebuffer<OutPixelType>::SharedPtr.
+            template<
+                typename OutPixelType,
+                typename Encoding = DefaultYUVEncoding>
+            typename Framebuffer<OutPixelType>::SharedPtr Convert () const {
+                return ConvertRGBA<OutPixelType> (
+                    ToRGBA<Encoding> (),
+                    std::is_same<OutPixelType, ui8RGBAPixel> ());
+            }
+
+            /// \brief
+            /// Create a planar framebuffer from packed 8 bit rgb(a) pixels. Rows are
+            /// converted two at a time (Y, subsampled U/V and A written directly)
+            /// by bands running on \see{ParallelFor}.
+            /// \param[in] data First row of pixels.
+            /// \param[in] extents Image width and height.
+            /// \param[in] rowStride Distance (in bytes) between consecutive rows.
+            /// \param[in] layout Pixel layout.
+            /// \param[in] format Plane layout.
+            /// \param[in] hasAlpha true = also copy the alpha channel.
+            /// \tparam Encoding One of the \see{YUVEncoding}s.
+            /// \return Framebuffer<PlanarYUVAPixel>::SharedPtr.
+            template<typename Encoding = DefaultYUVEncoding>
+            static SharedPtr FromPacked (
+                    const util::ui8 *data,
+                    const util::Rectangle::Extents &extents,
+                    std::size_t rowStride,
+                    const PackedRGBALayout &layout,
+                    Format format = I420,
+                    bool hasAlpha = false) {
+                SharedPtr planar (new Framebuffer (extents, format, hasAlpha));
+                const Framebuffer &dst = *planar;
+                const util::ui32 rowStep = dst.IsSubsampledY () ? 2 : 1;
+                ParallelFor (0, dst.GetChromaExtents ().height,
+                    [&dst, data, rowStride, &layout, rowStep] (std::size_t begin, std::size_t end) {
+                        for (std::size_t chromaRow = begin; chromaRow < end; ++chromaRow) {
+                            std::size_t row = chromaRow * rowStep;
+                            // The last row of an odd height 4:2:0 image has no partner.
+                            bool twoRows = rowStep == 2 && row + 1 < dst.extents.height;
+                            util::ui8 *u;
+                            util::ui8 *v;
+                            dst.GetChromaRow ((util::ui32)chromaRow, u, v);
+                            const util::ui8 *row0 = data + row * rowStride;
+                            util::ui8 *y0 = dst.planes[Y_INDEX] + row * dst.strides[Y_INDEX];
+                            util::ui8 *a0 = dst.HasAlpha () ?
+                                dst.planes[A_INDEX] + row * dst.strides[A_INDEX] : 0;
+                            YUVASpanConverter<Encoding>::FromRGBA (
+                                row0,
+                                twoRows ? row0 + rowStride : 0,
+                                layout,
+                                dst.extents.width,
+                                y0,
+                                y0 + dst.strides[Y_INDEX],
+                                u,
+                                v,
+                                dst.IsSemiPlanar () ? 2 : 1,
+                                dst.IsSubsampledX (),
+                                a0,
+                                a0 != 0 ? a0 + dst.strides[A_INDEX] : 0);
+                        }
+                    },
+                    PARALLEL_GRAIN);
+                return planar;
+            }
+
+            /// \brief
+            /// Create a planar framebuffer from a ui8RGBA one.
+            /// \param[in] framebuffer Framebuffer to convert.
+            /// \param[in] format Plane layout.
+            /// \param[in] hasAlpha true = also copy the alpha channel.
+            /// \tparam Encoding One of the \see{YUVEncoding}s.
+            /// \return Framebuffer<PlanarYUVAPixel>::SharedPtr.
+            template<typename Encoding = DefaultYUVEncoding>
+            static SharedPtr FromRGBA (
+                    const ui8RGBAFramebuffer &framebuffer,
+                    Format format = I420,
+                    bool hasAlpha = false) {
+                return FromPacked<Encoding> (
+                    (const util::ui8 *)framebuffer.buffer.array,
+                    framebuffer.extents,
+                    framebuffer.extents.width * sizeof (ui8RGBAPixel),
+                    PackedRGBALayout::Get<ui8RGBAPixel> (),
+                    format,
+                    hasAlpha);
+            }
+
+            /// \brief
+            /// Create a planar framebuffer from any packed one. The ui8
+            /// RGBA/BGRA/ARGB/ABGR framebuffers are read in place, others
+            /// are first converted to ui8RGBA using \see{Framebuffer::Convert}.
+            /// \param[in] framebuffer Framebuffer to convert.
+            /// \param[in] format Plane layout.
+            /// \param[in] hasAlpha true = also copy the alpha channel.
+            /// \tparam InPixelType In framebuffer pixel type.
+            /// \tparam Encoding One of the \see{YUVEncoding}s.
+            /// \return Framebuffer<PlanarYUVAPixel>::SharedPtr.
+            template<
+                typename InPixelType,
+                typename Encoding = DefaultYUVEncoding>
+            static SharedPtr FromFramebuffer (
+                    const Framebuffer<InPixelType> &framebuffer,
+                    Format format = I420,
+                    bool hasAlpha = false) {
+                return FromFramebuffer<Encoding> (
+                    framebuffer,
+                    format,
+                    hasAlpha,
+                    std::integral_constant<bool,
+                        std::is_same<typename InPixelType::ColorType, ui8RGBAColor>::value &&
+                        sizeof (InPixelType) == 4> ());
+            }
+
+            /// \brief
+            /// Decode a jpeg straight in to planes, skipping the inverse (and,
+            /// in a yuv pipeline, the following forward) color transform. 4:2:0,
+            /// 4:2:2 and 4:4:4 jpegs keep their native subsampling (I420, I422,
+            /// I444). Grayscale jpegs become I420 with neutral chroma. The rare
+            /// 4:4:0 and 4:1:1 jpegs are decoded to rgb and resampled to I420.
+            /// The samples are encoded using \see{JPEGYUVEncoding}.
+            /// \param[in] buffer Jpeg data.
+            /// \param[in] size Jpeg data size.
+            /// \return Framebuffer<PlanarYUVAPixel>::SharedPtr.
+            static SharedPtr FromJPGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size);
+            /// \brief
+            /// Decode a jpeg file straight in to planes (see FromJPGBuffer).
+            /// \param[in] path Jpeg file path.
+            /// \return Framebuffer<PlanarYUVAPixel>::SharedPtr.
+            static SharedPtr FromJPGFile (const std::string &path);
+
+            /// \brief
+            /// Compress the planes to a jpeg without going through rgb. The
+            /// jpeg subsampling follows the format (NV12/NV21 chroma is
+            /// deinterleaved first). Alpha is dropped. The samples are
+            /// assumed to be encoded using \see{JPEGYUVEncoding}. The jpeg
+            /// is written in to the caller's buffer which is only
+            /// (re)allocated if it's too small.
+            /// \param[out] buffer Where to put the jpeg.
+            /// \param[in] quality Jpeg quality [1, 100].
+            void ToJPGBuffer (
+                TJBuffer &buffer,
+                util::ui32 quality = 90) const;
+            /// \brief
+            /// Compress the planes to a jpeg file (see ToJPGBuffer).
+            /// \param[in] path Jpeg file path.
+            /// \param[in] quality Jpeg quality [1, 100].
+            void ToJPGFile (
+                const std::string &path,
+                util::ui32 quality = 90) const;
+
+        private:
+            /// \brief
+            /// Return the u and v sample pointers of the given chroma row.
+            /// For semi-planar formats they point in to the same interleaved row.
+            /// \param[in] row Chroma row.
+            /// \param[out] u First u sample.
+            /// \param[out] v First v sample.
+            template<typename T>
+            inline void GetChromaRow (
+                    util::ui32 row,
+                    T *&u,
+                    T *&v) const {
+                util::ui8 *uRow = planes[U_INDEX] + (std::size_t)row * strides[U_INDEX];
+                if (format == NV12) {
+                    u = uRow;
+                    v = uRow + 1;
+                }
+                else if (format == NV21) {
+                    v = uRow;
+                    u = uRow + 1;
+                }
+                else {
+                    u = uRow;
+                    v = planes[V_INDEX] + (std::size_t)row * strides[V_INDEX];
+                }
+            }
+
+            /// \brief
+            /// The ToRGBA result is the answer.
+            template<typename OutPixelType>
+            static typename Framebuffer<OutPixelType>::SharedPtr ConvertRGBA (
+                    const ui8RGBAFramebuffer::SharedPtr &framebuffer,
+                    std::true_type) {
+                return framebuffer;
+            }
+
+            /// \brief
+            /// Convert the ToRGBA result to OutPixelType.
+            template<typename OutPixelType>
+            static typename Framebuffer<OutPixelType>::SharedPtr ConvertRGBA (
+                    const ui8RGBAFramebuffer::SharedPtr &framebuffer,
+                    std::false_type) {
+                return framebuffer->template Convert<OutPixelType> ();
+            }
+
+            /// \brief
+            /// Read a packed ui8 rgba framebuffer in place.
+            template<
+                typename Encoding,
+                typename InPixelType>
+            static SharedPtr FromFramebuffer (
+                    const Framebuffer<InPixelType> &framebuffer,
+                    Format format,
+                    bool hasAlpha,
+                    std::true_type) {
+                return FromPacked<Encoding> (
+                    (const util::ui8 *)framebuffer.buffer.array,
+                    framebuffer.extents,
+                    framebuffer.extents.width * sizeof (InPixelType),
+                    PackedRGBALayout::Get<InPixelType> (),
+                    format,
+                    hasAlpha);
+            }
+
+            /// \brief
+            /// Go through ui8RGBA.
+            template<
+                typename Encoding,
+                typename InPixelType>
+            static SharedPtr FromFramebuffer (
+                    const Framebuffer<InPixelType> &framebuffer,
+                    Format format,
+                    bool hasAlpha,
+                    std::false_type) {
+                return FromRGBA<Encoding> (
+                    *framebuffer.template Convert<ui8RGBAPixel> (), format, hasAlpha);
+            }
+
+        public:
+            /// \brief
+            /// Framebuffer is neither copy constructable, nor assignable.
+            /// Use Copy for a deep copy.
+            THEKOGANS_UTIL_DISALLOW_COPY_AND_ASSIGN (Framebuffer)
         };
 
+        typedef Framebuffer<PlanarYUVAPixel> PlanarYUVAFramebuffer;
+
     } // namespace canvas
 } // namespace thekogans
 
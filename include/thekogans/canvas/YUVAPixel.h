@@ -49,7 +49,7 @@ namespace thekogans {
                 a (color.a) {}
 
             inline ColorType ToColor () const {
-                return ColorType (r, g, b, a);
+                return ColorType (y, u, v, a);
             }
 
             inline YUVAPixel &operator = (const ColorType &color) {
@@ -104,7 +104,7 @@ namespace thekogans {
                 a (color.a) {}
 
             inline ColorType ToColor () const {
-                return ColorType (r, g, b, a);
+                return ColorType (y, u, v, a);
             }
 
             inline VUYAPixel &operator = (const ColorType &color) {
@@ -144,7 +144,7 @@ namespace thekogans {
                 v (color.v) {}
 
             inline ColorType ToColor () const {
-                return ColorType (r, g, b, a);
+                return ColorType (y, u, v, a);
             }
 
             inline AYUVPixel &operator = (const ColorType &color) {
@@ -184,7 +184,7 @@ namespace thekogans {
                 y (color.y) {}
 
             inline ColorType ToColor () const {
-                return ColorType (r, g, b, a);
+                return ColorType (y, u, v, a);
             }
 
             inline AVUYPixel &operator = (const ColorType &color) {
@@ -203,6 +203,18 @@ namespace thekogans {
         typedef AVUYPixel<util::f32> f32AVUYPixel;
         typedef AVUYPixel<util::f64> f64AVUYPixel;
 
+        /// \struct PlanarYUVAPixel YUVAPixel.h thekogans/canvas/YUVAPixel.h
+        ///
+        /// \brief
+        /// Planar (and semi-planar) yuv keeps each component in its own plane,
+        /// usually with subsampled chroma. There is no addressable pixel, and
+        /// this type is only a tag used to select the planar specialization of
+        /// \see{Framebuffer} (see YUVAFramebuffer.h).
+        struct PlanarYUVAPixel {
+            typedef util::ui8 ComponentType;
+            typedef YUVAColor<ComponentType> ColorType;
+        };
+
     } // namespace canvas
 } // namespace thekogans
 
@@ -26,7 +26,7 @@
 #include "thekogans/util/Heap.h"
 #include "thekogans/util/SpinLock.h"
 #include "thekogans/canvas/Config.h"
-#include "thekogans/canvas/Color.h"
+#include "thekogans/canvas/RGBAColor.h"
 
 namespace thekogans {
     namespace canvas {
@@ -204,7 +204,7 @@ namespace thekogans {
 
             void Clear (
                 const util::Rectangle &rectangle,
-                const Color &color = Color ());
+                const ui8RGBAColor &color = ui8RGBAColor (0, 0, 0, 255));
 
             enum Filter {
                 UnknownFilter,
@@ -237,7 +237,7 @@ namespace thekogans {
             UniquePtr Rotate (
                 util::f32 angle,
                 const util::Point &centerOfRotation,
-                const Color &fillColor = Color (0, 0, 0)) const;
+                const ui8RGBAColor &fillColor = ui8RGBAColor (0, 0, 0, 255)) const;
 
             enum Axis {
                 UnknownAxis,
@@ -256,6 +256,36 @@ namespace thekogans {
                 YUVImage &dst,
                 bool hasAlpha = false) const;
 
+            // YUV domain operations. These work directly on the planes
+            // and only touch the pixels inside the given rectangle.
+
+            // Map every luma sample through the given 256 entry curve.
+            void ApplyLumaCurve (
+                const util::ui8 *curve,
+                const util::Rectangle &rectangle);
+            // y' = (y - 128) * contrast + 128 + brightness.
+            void AdjustBrightnessContrast (
+                util::f32 brightness,
+                util::f32 contrast,
+                const util::Rectangle &rectangle);
+            // c' = (c - 128) * saturation + 128 for both chroma planes.
+            // 0 = grey, 1 = unchanged.
+            void ScaleSaturation (
+                util::f32 saturation,
+                const util::Rectangle &rectangle);
+            // Alpha blend the overlay on to this image with its top left
+            // corner at origin. The overlay must have an alpha plane (if
+            // it doesn't, it's copied). Convert static overlays (logos,
+            // captions) once with RGBImage::ToYUVImage (true) and reuse
+            // them for every frame. NOTE: Chroma is blended on the 2x2
+            // grid, so use even origins for exact chroma registration.
+            void Overlay (
+                const YUVImage &overlay,
+                const util::Point &origin);
+            void Overlay (
+                const RGBImage &overlay,
+                const util::Point &origin);
+
             std::unique_ptr<RGBImage> ToRGBImage (
                 util::ui32 componentIndices) const;
 
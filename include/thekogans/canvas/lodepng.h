@@ -526,6 +526,20 @@ typedef struct LodePNGDecoderSettings
   */
   unsigned fix_png;
   unsigned color_convert; /*whether to convert the PNG to the color type you want. Default: yes*/
+  /*
+  thekogans addition: if 1, 16 bit images that are returned in the PNG's own color mode (no color
+  conversion) have their samples in host byte order instead of big endian. The byte swap is done
+  while unfiltering, so it costs no extra pass over the image. Default: 0
+  */
+  unsigned host_endian_16;
+  /*
+  thekogans addition: if not NULL, the decoded image is written to out_buffer instead of to a
+  lodepng_malloc-ed buffer and *out is set to out_buffer. out_capacity must be at least
+  lodepng_get_raw_size(w, h, &info_raw) (error 90 otherwise). out_buffer belongs to the caller,
+  lodepng never frees it. Default: NULL
+  */
+  unsigned char* out_buffer;
+  size_t out_capacity;
 
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   unsigned read_text_chunks; /*if false but remember_unknown_chunks is true, they're stored in the unknown chunks*/
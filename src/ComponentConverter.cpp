@@ -0,0 +1,194 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include "thekogans/canvas/Config.h"
+#if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+    #include <emmintrin.h>
+#elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+    #include <arm_neon.h>
+#endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/ComponentConverter.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        // NOTE: The SIMD kernels below produce bit identical results to
+        // their scalar Convert (InComponentType) counterparts. They handle
+        // the bulk of the span and leave the (< 16 component) tail to the
+        // scalar loop.
+
+        void ui8Toui16ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            // Interleaving a byte with itself yields value | value << 8 == value * 257.
+            for (; count >= 16; count -= 16, in += 16, out += 16) {
+                __m128i value = _mm_loadu_si128 ((const __m128i *)in);
+                _mm_storeu_si128 ((__m128i *)out, _mm_unpacklo_epi8 (value, value));
+                _mm_storeu_si128 ((__m128i *)(out + 8), _mm_unpackhi_epi8 (value, value));
+            }
+        #elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+            for (; count >= 16; count -= 16, in += 16, out += 16) {
+                uint8x16_t value = vld1q_u8 (in);
+                uint8x16x2_t zipped = vzipq_u8 (value, value);
+                vst1q_u16 (out, vreinterpretq_u16_u8 (zipped.val[0]));
+                vst1q_u16 (out + 8, vreinterpretq_u16_u8 (zipped.val[1]));
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui8Toui32ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 16; count -= 16, in += 16, out += 16) {
+                __m128i value = _mm_loadu_si128 ((const __m128i *)in);
+                __m128i lo = _mm_unpacklo_epi8 (value, value);
+                __m128i hi = _mm_unpackhi_epi8 (value, value);
+                _mm_storeu_si128 ((__m128i *)out, _mm_unpacklo_epi16 (lo, lo));
+                _mm_storeu_si128 ((__m128i *)(out + 4), _mm_unpackhi_epi16 (lo, lo));
+                _mm_storeu_si128 ((__m128i *)(out + 8), _mm_unpacklo_epi16 (hi, hi));
+                _mm_storeu_si128 ((__m128i *)(out + 12), _mm_unpackhi_epi16 (hi, hi));
+            }
+        #elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+            for (; count >= 16; count -= 16, in += 16, out += 16) {
+                uint8x16_t value = vld1q_u8 (in);
+                uint8x16x2_t zipped8 = vzipq_u8 (value, value);
+                uint16x8x2_t lo = vzipq_u16 (
+                    vreinterpretq_u16_u8 (zipped8.val[0]),
+                    vreinterpretq_u16_u8 (zipped8.val[0]));
+                uint16x8x2_t hi = vzipq_u16 (
+                    vreinterpretq_u16_u8 (zipped8.val[1]),
+                    vreinterpretq_u16_u8 (zipped8.val[1]));
+                vst1q_u32 (out, vreinterpretq_u32_u16 (lo.val[0]));
+                vst1q_u32 (out + 4, vreinterpretq_u32_u16 (lo.val[1]));
+                vst1q_u32 (out + 8, vreinterpretq_u32_u16 (hi.val[0]));
+                vst1q_u32 (out + 12, vreinterpretq_u32_u16 (hi.val[1]));
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui8Toui64ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui16Toui8ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+            // (value * 255 + 32895) >> 16 does not fit in 16 bit lanes.
+            // The equivalent t = value + 128 (saturating); (t - (t >> 8)) >> 8
+            // does, and was verified against the scalar form for all 65536 inputs.
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            const __m128i half = _mm_set1_epi16 (128);
+            for (; count >= 16; count -= 16, in += 16, out += 16) {
+                __m128i lo = _mm_adds_epu16 (_mm_loadu_si128 ((const __m128i *)in), half);
+                __m128i hi = _mm_adds_epu16 (_mm_loadu_si128 ((const __m128i *)(in + 8)), half);
+                lo = _mm_srli_epi16 (_mm_sub_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+                hi = _mm_srli_epi16 (_mm_sub_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+                _mm_storeu_si128 ((__m128i *)out, _mm_packus_epi16 (lo, hi));
+            }
+        #elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+            const uint16x8_t half = vdupq_n_u16 (128);
+            for (; count >= 16; count -= 16, in += 16, out += 16) {
+                uint16x8_t lo = vqaddq_u16 (vld1q_u16 (in), half);
+                uint16x8_t hi = vqaddq_u16 (vld1q_u16 (in + 8), half);
+                lo = vsubq_u16 (lo, vshrq_n_u16 (lo, 8));
+                hi = vsubq_u16 (hi, vshrq_n_u16 (hi, 8));
+                vst1q_u8 (out, vcombine_u8 (vshrn_n_u16 (lo, 8), vshrn_n_u16 (hi, 8)));
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui16Toui32ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 8; count -= 8, in += 8, out += 8) {
+                __m128i value = _mm_loadu_si128 ((const __m128i *)in);
+                _mm_storeu_si128 ((__m128i *)out, _mm_unpacklo_epi16 (value, value));
+                _mm_storeu_si128 ((__m128i *)(out + 4), _mm_unpackhi_epi16 (value, value));
+            }
+        #elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+            for (; count >= 8; count -= 8, in += 8, out += 8) {
+                uint16x8_t value = vld1q_u16 (in);
+                uint16x8x2_t zipped = vzipq_u16 (value, value);
+                vst1q_u32 (out, vreinterpretq_u32_u16 (zipped.val[0]));
+                vst1q_u32 (out + 4, vreinterpretq_u32_u16 (zipped.val[1]));
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui16Toui64ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui32Toui8ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui32Toui16ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+        void ui32Toui64ScaleComponentConverter::Convert (
+                const InComponentType *in,
+                OutComponentType *out,
+                std::size_t count) {
+            while (count-- != 0) {
+                *out++ = Convert (*in++);
+            }
+        }
+
+    } // namespace canvas
+} // namespace thekogans
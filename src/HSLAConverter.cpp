@@ -17,9 +17,15 @@
 
 #include <cmath>
 #include <algorithm>
+#include "thekogans/canvas/Config.h"
+#if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+    #include <emmintrin.h>
+#endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
 #include "thekogans/util/Types.h"
 #include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/RGBAPixel.h"
 #include "thekogans/canvas/HSLAColor.h"
+#include "thekogans/canvas/HSLAPixel.h"
 #include "thekogans/canvas/HSLAConverter.h"
 
 namespace thekogans {
@@ -40,7 +46,7 @@ namespace thekogans {
             util::f32 delta = max - min;
             util::f32 l = (max + min) / 2.0f;
             if (delta == 0.0f) {
-                return f32HSLAColor (0.0f, 0.0f, l, inColor.a);
+                return f32HSLAColor (0.0f, 0.0f, l * 100.f, inColor.a);
             }
             else {
                 util::f32 s = l < 0.5f ? delta / (max + min) : delta / (1.0f - std::abs (2.0f * l - 1.0f));
@@ -53,5 +59,312 @@ namespace thekogans {
             }
         }
 
+        // The span kernels below compute the same thing as the per color
+        // Converter<f32HSLAColor>::Convert (const f32RGBAColor &) and
+        // Converter<f32RGBAColor>::Convert (const f32HSLAColor &), but
+        // without data dependent branches. Every case is computed and the
+        // result is picked with a select mask. This makes them friendly to
+        // SIMD (four pixels at a time) and keeps the scalar tail from
+        // stalling on mispredicted branches. Two identities make this work:
+        // - s = delta / (1 - |max + min - 1|) covers both l < 0.5 and
+        //   l >= 0.5 cases.
+        // - Hue_2_RGB (v1, v2, vh) == v1 + (v2 - v1) * clamp (min (6vh, 4 - 6vh), 0, 1)
+        //   for vh in [0, 1], and s == 0 needs no special case (temp1 == temp2 == l).
+
+        namespace {
+            const util::f32 ONE_OVER_255 = 1.0f / 255.0f;
+
+            inline util::f32 Select (
+                    bool mask,
+                    util::f32 a,
+                    util::f32 b) {
+                return mask ? a : b;
+            }
+
+            inline util::f32 Clamp01 (util::f32 value) {
+                return std::min (std::max (value, 0.0f), 1.0f);
+            }
+
+            inline util::ui8 ToComponent (util::f32 value) {
+                return (util::ui8)(Clamp01 (value) * 255.0f + 0.5f);
+            }
+
+            inline void RGBToHSL (
+                    util::f32 r,
+                    util::f32 g,
+                    util::f32 b,
+                    util::f32 &h,
+                    util::f32 &s,
+                    util::f32 &l) {
+                util::f32 max = std::max (r, std::max (g, b));
+                util::f32 min = std::min (r, std::min (g, b));
+                util::f32 sum = max + min;
+                util::f32 delta = max - min;
+                bool chromatic = delta != 0.0f;
+                util::f32 safeDelta = Select (chromatic, delta, 1.0f);
+                util::f32 denominator = Select (chromatic, 1.0f - std::abs (sum - 1.0f), 1.0f);
+                bool rmax = r == max;
+                bool gmax = !rmax && g == max;
+                util::f32 hue = Select (rmax, g - b, Select (gmax, b - r, r - g)) / safeDelta +
+                    Select (rmax, 0.0f, Select (gmax, 2.0f, 4.0f));
+                hue = 60.0f * hue + 360.0f;
+                hue -= Select (hue >= 360.0f, 360.0f, 0.0f);
+                h = Select (chromatic, hue, 0.0f);
+                s = Select (chromatic, delta / denominator * 100.0f, 0.0f);
+                l = sum * 50.0f;
+            }
+
+            inline util::f32 HueToRGB (
+                    util::f32 v1,
+                    util::f32 v2,
+                    util::f32 vh) {
+                vh += Select (vh < 0.0f, 1.0f, 0.0f) - Select (vh > 1.0f, 1.0f, 0.0f);
+                util::f32 vh6 = 6.0f * vh;
+                return v1 + (v2 - v1) * Clamp01 (std::min (vh6, 4.0f - vh6));
+            }
+
+            inline void HSLToRGB (
+                    util::f32 h,
+                    util::f32 s,
+                    util::f32 l,
+                    util::f32 &r,
+                    util::f32 &g,
+                    util::f32 &b) {
+                h *= 1.0f / 360.0f;
+                s *= 0.01f;
+                l *= 0.01f;
+                util::f32 ls = l * s;
+                util::f32 temp2 = Select (l < 0.5f, l + ls, l + s - ls);
+                util::f32 temp1 = 2.0f * l - temp2;
+                r = HueToRGB (temp1, temp2, h + 1.0f / 3.0f);
+                g = HueToRGB (temp1, temp2, h);
+                b = HueToRGB (temp1, temp2, h - 1.0f / 3.0f);
+            }
+
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            inline __m128 Select (
+                    __m128 mask,
+                    __m128 a,
+                    __m128 b) {
+                return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+            }
+
+            inline __m128 Clamp01 (__m128 value) {
+                return _mm_min_ps (_mm_max_ps (value, _mm_setzero_ps ()), _mm_set1_ps (1.0f));
+            }
+
+            inline __m128 Abs (__m128 value) {
+                return _mm_andnot_ps (_mm_set1_ps (-0.0f), value);
+            }
+
+            // r, g, b in and h, s, l out hold the same component of four pixels.
+            inline void RGBToHSL (
+                    __m128 r,
+                    __m128 g,
+                    __m128 b,
+                    __m128 &h,
+                    __m128 &s,
+                    __m128 &l) {
+                const __m128 one = _mm_set1_ps (1.0f);
+                const __m128 deg360 = _mm_set1_ps (360.0f);
+                __m128 max = _mm_max_ps (r, _mm_max_ps (g, b));
+                __m128 min = _mm_min_ps (r, _mm_min_ps (g, b));
+                __m128 sum = _mm_add_ps (max, min);
+                __m128 delta = _mm_sub_ps (max, min);
+                __m128 chromatic = _mm_cmpneq_ps (delta, _mm_setzero_ps ());
+                __m128 safeDelta = Select (chromatic, delta, one);
+                __m128 denominator = Select (chromatic,
+                    _mm_sub_ps (one, Abs (_mm_sub_ps (sum, one))), one);
+                __m128 rmax = _mm_cmpeq_ps (r, max);
+                __m128 gmax = _mm_andnot_ps (rmax, _mm_cmpeq_ps (g, max));
+                __m128 numerator = Select (rmax, _mm_sub_ps (g, b),
+                    Select (gmax, _mm_sub_ps (b, r), _mm_sub_ps (r, g)));
+                __m128 offset = Select (rmax, _mm_setzero_ps (),
+                    Select (gmax, _mm_set1_ps (2.0f), _mm_set1_ps (4.0f)));
+                __m128 hue = _mm_add_ps (_mm_div_ps (numerator, safeDelta), offset);
+                hue = _mm_add_ps (_mm_mul_ps (hue, _mm_set1_ps (60.0f)), deg360);
+                hue = _mm_sub_ps (hue, _mm_and_ps (_mm_cmpge_ps (hue, deg360), deg360));
+                h = _mm_and_ps (chromatic, hue);
+                s = _mm_and_ps (chromatic,
+                    _mm_mul_ps (_mm_div_ps (delta, denominator), _mm_set1_ps (100.0f)));
+                l = _mm_mul_ps (sum, _mm_set1_ps (50.0f));
+            }
+
+            inline __m128 HueToRGB (
+                    __m128 v1,
+                    __m128 v2,
+                    __m128 vh) {
+                const __m128 one = _mm_set1_ps (1.0f);
+                vh = _mm_add_ps (vh, _mm_and_ps (_mm_cmplt_ps (vh, _mm_setzero_ps ()), one));
+                vh = _mm_sub_ps (vh, _mm_and_ps (_mm_cmpgt_ps (vh, one), one));
+                __m128 vh6 = _mm_mul_ps (vh, _mm_set1_ps (6.0f));
+                __m128 t = Clamp01 (_mm_min_ps (vh6, _mm_sub_ps (_mm_set1_ps (4.0f), vh6)));
+                return _mm_add_ps (v1, _mm_mul_ps (_mm_sub_ps (v2, v1), t));
+            }
+
+            inline void HSLToRGB (
+                    __m128 h,
+                    __m128 s,
+                    __m128 l,
+                    __m128 &r,
+                    __m128 &g,
+                    __m128 &b) {
+                const __m128 third = _mm_set1_ps (1.0f / 3.0f);
+                h = _mm_mul_ps (h, _mm_set1_ps (1.0f / 360.0f));
+                s = _mm_mul_ps (s, _mm_set1_ps (0.01f));
+                l = _mm_mul_ps (l, _mm_set1_ps (0.01f));
+                __m128 ls = _mm_mul_ps (l, s);
+                __m128 temp2 = Select (_mm_cmplt_ps (l, _mm_set1_ps (0.5f)),
+                    _mm_add_ps (l, ls), _mm_sub_ps (_mm_add_ps (l, s), ls));
+                __m128 temp1 = _mm_sub_ps (_mm_add_ps (l, l), temp2);
+                r = HueToRGB (temp1, temp2, _mm_add_ps (h, third));
+                g = HueToRGB (temp1, temp2, h);
+                b = HueToRGB (temp1, temp2, _mm_sub_ps (h, third));
+            }
+
+            // Load four ui8 pixels as four f32 pixels in [0, 1].
+            inline void Load4 (
+                    const util::ui8 *in,
+                    __m128 &p0,
+                    __m128 &p1,
+                    __m128 &p2,
+                    __m128 &p3) {
+                const __m128i zero = _mm_setzero_si128 ();
+                const __m128 scale = _mm_set1_ps (ONE_OVER_255);
+                __m128i value = _mm_loadu_si128 ((const __m128i *)in);
+                __m128i lo = _mm_unpacklo_epi8 (value, zero);
+                __m128i hi = _mm_unpackhi_epi8 (value, zero);
+                p0 = _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (lo, zero)), scale);
+                p1 = _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (lo, zero)), scale);
+                p2 = _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (hi, zero)), scale);
+                p3 = _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (hi, zero)), scale);
+            }
+
+            // Store four f32 pixels in [0, 1] as four ui8 pixels. Rounds
+            // like ToComponent (+ 0.5 and truncate) so that results don't
+            // depend on which pixels of a span take the SIMD path. Out of
+            // range values are clamped by the saturating packs.
+            inline __m128i ToComponent (__m128 value) {
+                return _mm_cvttps_epi32 (
+                    _mm_add_ps (_mm_mul_ps (value, _mm_set1_ps (255.0f)), _mm_set1_ps (0.5f)));
+            }
+
+            inline void Store4 (
+                    util::ui8 *out,
+                    __m128 p0,
+                    __m128 p1,
+                    __m128 p2,
+                    __m128 p3) {
+                __m128i lo = _mm_packs_epi32 (ToComponent (p0), ToComponent (p1));
+                __m128i hi = _mm_packs_epi32 (ToComponent (p2), ToComponent (p3));
+                _mm_storeu_si128 ((__m128i *)out, _mm_packus_epi16 (lo, hi));
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+        }
+
+        void SpanConverter<f32RGBAPixel, f32HSLAPixel>::Convert (
+                const f32RGBAPixel *in,
+                f32HSLAPixel *out,
+                std::size_t count) {
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 4; count -= 4, in += 4, out += 4) {
+                __m128 p0 = _mm_loadu_ps (&in[0].r);
+                __m128 p1 = _mm_loadu_ps (&in[1].r);
+                __m128 p2 = _mm_loadu_ps (&in[2].r);
+                __m128 p3 = _mm_loadu_ps (&in[3].r);
+                // p0 = r, p1 = g, p2 = b, p3 = a
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                RGBToHSL (p0, p1, p2, p0, p1, p2);
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                _mm_storeu_ps (&out[0].h, p0);
+                _mm_storeu_ps (&out[1].h, p1);
+                _mm_storeu_ps (&out[2].h, p2);
+                _mm_storeu_ps (&out[3].h, p3);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count != 0; --count, ++in, ++out) {
+                RGBToHSL (in->r, in->g, in->b, out->h, out->s, out->l);
+                out->a = in->a;
+            }
+        }
+
+        void SpanConverter<ui8RGBAPixel, f32HSLAPixel>::Convert (
+                const ui8RGBAPixel *in,
+                f32HSLAPixel *out,
+                std::size_t count) {
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 4; count -= 4, in += 4, out += 4) {
+                __m128 p0, p1, p2, p3;
+                Load4 (&in[0].r, p0, p1, p2, p3);
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                RGBToHSL (p0, p1, p2, p0, p1, p2);
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                _mm_storeu_ps (&out[0].h, p0);
+                _mm_storeu_ps (&out[1].h, p1);
+                _mm_storeu_ps (&out[2].h, p2);
+                _mm_storeu_ps (&out[3].h, p3);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count != 0; --count, ++in, ++out) {
+                RGBToHSL (
+                    in->r * ONE_OVER_255,
+                    in->g * ONE_OVER_255,
+                    in->b * ONE_OVER_255,
+                    out->h, out->s, out->l);
+                out->a = in->a * ONE_OVER_255;
+            }
+        }
+
+        void SpanConverter<f32HSLAPixel, f32RGBAPixel>::Convert (
+                const f32HSLAPixel *in,
+                f32RGBAPixel *out,
+                std::size_t count) {
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 4; count -= 4, in += 4, out += 4) {
+                __m128 p0 = _mm_loadu_ps (&in[0].h);
+                __m128 p1 = _mm_loadu_ps (&in[1].h);
+                __m128 p2 = _mm_loadu_ps (&in[2].h);
+                __m128 p3 = _mm_loadu_ps (&in[3].h);
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                HSLToRGB (p0, p1, p2, p0, p1, p2);
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                _mm_storeu_ps (&out[0].r, p0);
+                _mm_storeu_ps (&out[1].r, p1);
+                _mm_storeu_ps (&out[2].r, p2);
+                _mm_storeu_ps (&out[3].r, p3);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count != 0; --count, ++in, ++out) {
+                HSLToRGB (in->h, in->s, in->l, out->r, out->g, out->b);
+                out->a = in->a;
+            }
+        }
+
+        void SpanConverter<f32HSLAPixel, ui8RGBAPixel>::Convert (
+                const f32HSLAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count) {
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 4; count -= 4, in += 4, out += 4) {
+                __m128 p0 = _mm_loadu_ps (&in[0].h);
+                __m128 p1 = _mm_loadu_ps (&in[1].h);
+                __m128 p2 = _mm_loadu_ps (&in[2].h);
+                __m128 p3 = _mm_loadu_ps (&in[3].h);
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                HSLToRGB (p0, p1, p2, p0, p1, p2);
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                Store4 (&out[0].r, p0, p1, p2, p3);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count != 0; --count, ++in, ++out) {
+                util::f32 r, g, b;
+                HSLToRGB (in->h, in->s, in->l, r, g, b);
+                out->r = ToComponent (r);
+                out->g = ToComponent (g);
+                out->b = ToComponent (b);
+                out->a = ToComponent (in->a);
+            }
+        }
+
     } // namespace canvas
 } // namespace thekogans
@@ -0,0 +1,90 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/LabAColor.h"
+#include "thekogans/canvas/LabAPixel.h"
+#include "thekogans/canvas/LChAColor.h"
+#include "thekogans/canvas/LChAPixel.h"
+#include "thekogans/canvas/LabAConverter.h"
+#include "thekogans/canvas/LChAConverter.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        namespace {
+            const util::f32 DEGREES_PER_RADIAN = 180.0f / 3.14159265358979323846f;
+            const util::f32 RADIANS_PER_DEGREE = 3.14159265358979323846f / 180.0f;
+
+            inline void LChFromLab (
+                    util::f32 a,
+                    util::f32 b,
+                    util::f32 &c,
+                    util::f32 &h) {
+                c = std::sqrt (a * a + b * b);
+                h = std::atan2 (b, a) * DEGREES_PER_RADIAN;
+                if (h < 0.0f) {
+                    h += 360.0f;
+                }
+            }
+        }
+
+        template<>
+        f32LChAColor Converter<f32LChAColor>::Convert (const f32LChAColor &inColor) {
+            return inColor;
+        }
+
+        template<>
+        f32LChAColor Converter<f32LChAColor>::Convert (const f32LabAColor &inColor) {
+            f32LChAColor outColor (inColor.l, 0.0f, 0.0f, inColor.alpha);
+            LChFromLab (inColor.a, inColor.b, outColor.c, outColor.h);
+            return outColor;
+        }
+
+        template<>
+        f32LChAColor Converter<f32LChAColor>::Convert (const f32RGBAColor &inColor) {
+            return Convert (Converter<f32LabAColor>::Convert (inColor));
+        }
+
+        void SpanConverter<f32LabAPixel, f32LChAPixel>::Convert (
+                const f32LabAPixel *in,
+                f32LChAPixel *out,
+                std::size_t count) {
+            for (; count != 0; --count, ++in, ++out) {
+                out->l = in->l;
+                LChFromLab (in->a, in->b, out->c, out->h);
+                out->a = in->alpha;
+            }
+        }
+
+        void SpanConverter<f32LChAPixel, f32LabAPixel>::Convert (
+                const f32LChAPixel *in,
+                f32LabAPixel *out,
+                std::size_t count) {
+            for (; count != 0; --count, ++in, ++out) {
+                util::f32 h = in->h * RADIANS_PER_DEGREE;
+                out->l = in->l;
+                out->a = in->c * std::cos (h);
+                out->b = in->c * std::sin (h);
+                out->alpha = in->a;
+            }
+        }
+
+    } // namespace canvas
+} // namespace thekogans
@@ -0,0 +1,404 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "thekogans/canvas/Config.h"
+#if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+    #include <emmintrin.h>
+#endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+#include "thekogans/util/Exception.h"
+#include "thekogans/util/File.h"
+#include "thekogans/canvas/LUT3D.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_WITH_LOCK (LUT3D, util::SpinLock)
+
+        LUT3D::LUT3D (
+                util::ui32 size_,
+                const f32RGBAColor &domainMin_,
+                const f32RGBAColor &domainMax_) :
+                size (size_),
+                domainMin (domainMin_),
+                domainMax (domainMax_),
+                table ((std::size_t)size_ * size_ * size_ * 4) {
+            if (size < MIN_SIZE || size > MAX_SIZE ||
+                    domainMax.r <= domainMin.r ||
+                    domainMax.g <= domainMin.g ||
+                    domainMax.b <= domainMin.b) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Invalid LUT3D size (%u) or domain.", size);
+            }
+            for (util::ui32 b = 0; b < size; ++b) {
+                for (util::ui32 g = 0; g < size; ++g) {
+                    for (util::ui32 r = 0; r < size; ++r) {
+                        SetSample (r, g, b, GetInput (r, g, b));
+                    }
+                }
+            }
+        }
+
+        namespace {
+            const util::f32 ONE_OVER_255 = 1.0f / 255.0f;
+
+            // Location of a color in the lattice: the sample at the origin of
+            // the enclosing cube, the two intermediate corners of the tetrahedron
+            // containing the color, and the barycentric weights of the four
+            // tetrahedron vertices (origin, corner1, corner2, far corner).
+            struct Tetrahedron {
+                const util::f32 *origin;
+                std::size_t corner1;
+                std::size_t corner2;
+                std::size_t corner3;
+                util::f32 weights[4];
+            };
+
+            struct Lattice {
+                const util::f32 *table;
+                util::f32 max;
+                util::f32 scale[3];
+                util::f32 offset[3];
+                std::size_t strides[3];
+
+                explicit Lattice (const LUT3D &lut) :
+                        table (lut.table.array),
+                        max ((util::f32)(lut.size - 1)) {
+                    scale[0] = max / (lut.domainMax.r - lut.domainMin.r);
+                    scale[1] = max / (lut.domainMax.g - lut.domainMin.g);
+                    scale[2] = max / (lut.domainMax.b - lut.domainMin.b);
+                    offset[0] = -lut.domainMin.r * scale[0];
+                    offset[1] = -lut.domainMin.g * scale[1];
+                    offset[2] = -lut.domainMin.b * scale[2];
+                    strides[0] = 4;
+                    strides[1] = 4 * (std::size_t)lut.size;
+                    strides[2] = 4 * (std::size_t)lut.size * lut.size;
+                }
+
+                inline util::f32 Coordinate (
+                        util::f32 value,
+                        util::ui32 channel,
+                        std::size_t &index) const {
+                    util::f32 x = value * scale[channel] + offset[channel];
+                    x = x > 0.0f ? (x < max ? x : max) : 0.0f;
+                    // The last sample is reached with a fraction of 1
+                    // from the cube below it.
+                    util::ui32 i = (util::ui32)x;
+                    if (i == (util::ui32)max) {
+                        --i;
+                    }
+                    index += i * strides[channel];
+                    return x - i;
+                }
+
+                inline void Locate (
+                        util::f32 r,
+                        util::f32 g,
+                        util::f32 b,
+                        Tetrahedron &tetrahedron) const {
+                    std::size_t index = 0;
+                    util::f32 fr = Coordinate (r, 0, index);
+                    util::f32 fg = Coordinate (g, 1, index);
+                    util::f32 fb = Coordinate (b, 2, index);
+                    tetrahedron.origin = table + index;
+                    tetrahedron.corner3 = strides[0] + strides[1] + strides[2];
+                    // Sort the fractions. The axis with the largest fraction
+                    // is stepped along first, then the middle one.
+                    util::ui32 first, second;
+                    util::f32 max, mid, min;
+                    if (fr >= fg) {
+                        if (fg >= fb) {
+                            first = 0; second = 1; max = fr; mid = fg; min = fb;
+                        }
+                        else if (fr >= fb) {
+                            first = 0; second = 2; max = fr; mid = fb; min = fg;
+                        }
+                        else {
+                            first = 2; second = 0; max = fb; mid = fr; min = fg;
+                        }
+                    }
+                    else {
+                        if (fb >= fg) {
+                            first = 2; second = 1; max = fb; mid = fg; min = fr;
+                        }
+                        else if (fb >= fr) {
+                            first = 1; second = 2; max = fg; mid = fb; min = fr;
+                        }
+                        else {
+                            first = 1; second = 0; max = fg; mid = fr; min = fb;
+                        }
+                    }
+                    tetrahedron.corner1 = strides[first];
+                    tetrahedron.corner2 = strides[first] + strides[second];
+                    tetrahedron.weights[0] = 1.0f - max;
+                    tetrahedron.weights[1] = max - mid;
+                    tetrahedron.weights[2] = mid - min;
+                    tetrahedron.weights[3] = min;
+                }
+
+                inline void Interpolate (
+                        util::f32 r,
+                        util::f32 g,
+                        util::f32 b,
+                        util::f32 out[3]) const {
+                    Tetrahedron tetrahedron;
+                    Locate (r, g, b, tetrahedron);
+                    const util::f32 *c0 = tetrahedron.origin;
+                    const util::f32 *c1 = c0 + tetrahedron.corner1;
+                    const util::f32 *c2 = c0 + tetrahedron.corner2;
+                    const util::f32 *c3 = c0 + tetrahedron.corner3;
+                    for (util::ui32 i = 0; i < 3; ++i) {
+                        out[i] =
+                            tetrahedron.weights[0] * c0[i] +
+                            tetrahedron.weights[1] * c1[i] +
+                            tetrahedron.weights[2] * c2[i] +
+                            tetrahedron.weights[3] * c3[i];
+                    }
+                }
+
+            #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                // Samples are padded to 4 f32 so one sample is one register,
+                // and all three channels are interpolated at once. The padding
+                // is 0 so the result has 0 in the 4th lane.
+                inline __m128 Interpolate (
+                        util::f32 r,
+                        util::f32 g,
+                        util::f32 b) const {
+                    Tetrahedron tetrahedron;
+                    Locate (r, g, b, tetrahedron);
+                    const util::f32 *c0 = tetrahedron.origin;
+                    __m128 result = _mm_mul_ps (
+                        _mm_loadu_ps (c0), _mm_set1_ps (tetrahedron.weights[0]));
+                    result = _mm_add_ps (result, _mm_mul_ps (
+                        _mm_loadu_ps (c0 + tetrahedron.corner1),
+                        _mm_set1_ps (tetrahedron.weights[1])));
+                    result = _mm_add_ps (result, _mm_mul_ps (
+                        _mm_loadu_ps (c0 + tetrahedron.corner2),
+                        _mm_set1_ps (tetrahedron.weights[2])));
+                    return _mm_add_ps (result, _mm_mul_ps (
+                        _mm_loadu_ps (c0 + tetrahedron.corner3),
+                        _mm_set1_ps (tetrahedron.weights[3])));
+                }
+            #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            };
+
+            inline util::ui8 ToComponent (util::f32 value) {
+                value = value * 255.0f + 0.5f;
+                return (util::ui8)(value > 0.0f ? (value < 255.0f ? value : 255.0f) : 0.0f);
+            }
+        }
+
+        f32RGBAColor LUT3D::Apply (const f32RGBAColor &color) const {
+            util::f32 out[3];
+            Lattice (*this).Interpolate (color.r, color.g, color.b, out);
+            return f32RGBAColor (out[0], out[1], out[2], color.a);
+        }
+
+        void LUT3D::Apply (
+                const f32RGBAPixel *in,
+                f32RGBAPixel *out,
+                std::size_t count) const {
+            Lattice lattice (*this);
+            for (; count-- != 0; ++in, ++out) {
+            #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                // Put alpha in the (0) 4th lane.
+                __m128 alpha = _mm_setr_ps (0.0f, 0.0f, 0.0f, in->a);
+                _mm_storeu_ps (&out->r,
+                    _mm_add_ps (lattice.Interpolate (in->r, in->g, in->b), alpha));
+            #else // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                util::f32 rgb[3];
+                lattice.Interpolate (in->r, in->g, in->b, rgb);
+                out->r = rgb[0];
+                out->g = rgb[1];
+                out->b = rgb[2];
+                out->a = in->a;
+            #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            }
+        }
+
+        void LUT3D::Apply (
+                const ui8RGBAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count) const {
+            Lattice lattice (*this);
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            const __m128 scale = _mm_setr_ps (255.0f, 255.0f, 255.0f, 1.0f);
+            const __m128 half = _mm_set1_ps (0.5f);
+            for (; count-- != 0; ++in, ++out) {
+                __m128 alpha = _mm_setr_ps (0.0f, 0.0f, 0.0f, in->a);
+                // Round like ToComponent (+ 0.5 and truncate), the
+                // saturating packs clamp.
+                __m128i result = _mm_cvttps_epi32 (_mm_add_ps (_mm_add_ps (_mm_mul_ps (
+                    lattice.Interpolate (
+                        in->r * ONE_OVER_255,
+                        in->g * ONE_OVER_255,
+                        in->b * ONE_OVER_255),
+                    scale), alpha), half));
+                result = _mm_packs_epi32 (result, result);
+                util::ui32 pixel = (util::ui32)_mm_cvtsi128_si32 (_mm_packus_epi16 (result, result));
+                memcpy (&out->r, &pixel, sizeof (pixel));
+            }
+        #else // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count-- != 0; ++in, ++out) {
+                util::f32 rgb[3];
+                lattice.Interpolate (
+                    in->r * ONE_OVER_255,
+                    in->g * ONE_OVER_255,
+                    in->b * ONE_OVER_255,
+                    rgb);
+                out->r = ToComponent (rgb[0]);
+                out->g = ToComponent (rgb[1]);
+                out->b = ToComponent (rgb[2]);
+                out->a = in->a;
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+        }
+
+        namespace {
+            inline bool IsSpace (char c) {
+                return c == ' ' || c == '\t' || c == '\r';
+            }
+
+            inline const char *SkipSpace (const char *c) {
+                while (IsSpace (*c)) {
+                    ++c;
+                }
+                return c;
+            }
+
+            inline bool IsKeyword (
+                    const char *line,
+                    const char *keyword) {
+                std::size_t length = strlen (keyword);
+                return strncmp (line, keyword, length) == 0 && IsSpace (line[length]);
+            }
+
+            bool ParseFloats (
+                    const char *c,
+                    util::f32 *values,
+                    util::ui32 count) {
+                for (util::ui32 i = 0; i < count; ++i) {
+                    char *end;
+                    values[i] = strtof (c, &end);
+                    if (end == c) {
+                        return false;
+                    }
+                    c = end;
+                }
+                c = SkipSpace (c);
+                return *c == '\0' || *c == '\n' || *c == '#';
+            }
+        }
+
+        LUT3D::SharedPtr LUT3D::FromCubeBuffer (
+                const char *buffer,
+                std::size_t length) {
+            // strtof needs a terminator.
+            std::string text (buffer, length);
+            util::ui32 size = 0;
+            f32RGBAColor domainMin (0.0f, 0.0f, 0.0f, 0.0f);
+            f32RGBAColor domainMax (1.0f, 1.0f, 1.0f, 1.0f);
+            SharedPtr lut;
+            std::size_t sample = 0;
+            std::size_t sampleCount = 0;
+            util::ui32 lineNumber = 0;
+            for (const char *line = text.c_str (); *line != '\0';) {
+                const char *next = strchr (line, '\n');
+                next = next != 0 ? next + 1 : line + strlen (line);
+                ++lineNumber;
+                line = SkipSpace (line);
+                if (*line == '\0' || *line == '\n' || *line == '#' || IsKeyword (line, "TITLE")) {
+                    // Blank, comment or title.
+                }
+                else if (IsKeyword (line, "LUT_3D_SIZE")) {
+                    char *end;
+                    size = (util::ui32)strtoul (line + 11, &end, 10);
+                    if (lut.Get () != 0 || size < MIN_SIZE || size > MAX_SIZE) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "Invalid LUT_3D_SIZE at line %u.", lineNumber);
+                    }
+                }
+                else if (IsKeyword (line, "DOMAIN_MIN") || IsKeyword (line, "DOMAIN_MAX")) {
+                    util::f32 values[3];
+                    if (lut.Get () != 0 || !ParseFloats (line + 10, values, 3)) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "Invalid %.10s at line %u.", line, lineNumber);
+                    }
+                    (line[8] == 'I' ? domainMin : domainMax) =
+                        f32RGBAColor (values[0], values[1], values[2], line[8] == 'I' ? 0.0f : 1.0f);
+                }
+                else if (IsKeyword (line, "LUT_3D_INPUT_RANGE")) {
+                    util::f32 values[2];
+                    if (lut.Get () != 0 || !ParseFloats (line + 18, values, 2)) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "Invalid LUT_3D_INPUT_RANGE at line %u.", lineNumber);
+                    }
+                    domainMin = f32RGBAColor (values[0], values[0], values[0], 0.0f);
+                    domainMax = f32RGBAColor (values[1], values[1], values[1], 1.0f);
+                }
+                else if (IsKeyword (line, "LUT_1D_SIZE") || IsKeyword (line, "LUT_1D_INPUT_RANGE")) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "1D LUTs are not supported (line %u).", lineNumber);
+                }
+                else {
+                    util::f32 values[3];
+                    if (size == 0 || !ParseFloats (line, values, 3)) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "Invalid .cube data at line %u.", lineNumber);
+                    }
+                    if (lut.Get () == 0) {
+                        lut.Reset (new LUT3D (size, domainMin, domainMax));
+                        sampleCount = (std::size_t)size * size * size;
+                    }
+                    if (sample == sampleCount) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "Too many .cube samples at line %u.", lineNumber);
+                    }
+                    util::f32 *entry = &lut->table[sample++ * 4];
+                    entry[0] = values[0];
+                    entry[1] = values[1];
+                    entry[2] = values[2];
+                    entry[3] = 0.0f;
+                }
+                line = next;
+            }
+            if (lut.Get () == 0 || sample != sampleCount) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Incomplete .cube data (%u of %u samples).",
+                    (util::ui32)sample, (util::ui32)sampleCount);
+            }
+            return lut;
+        }
+
+        LUT3D::SharedPtr LUT3D::FromCubeFile (const std::string &path) {
+            util::ReadOnlyFile file (util::HostEndian, path);
+            util::ui64 size = file.GetSize ();
+            if (size > 0) {
+                std::vector<char> buffer (size);
+                file.Read (buffer.data (), size);
+                return FromCubeBuffer (buffer.data (), size);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty cube file: %s", path.c_str ());
+            }
+        }
+
+    } // namespace canvas
+} // namespace thekogans
@@ -0,0 +1,322 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstring>
+#include "thekogans/canvas/Config.h"
+#if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+    #include <emmintrin.h>
+#endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/XYZAColor.h"
+#include "thekogans/canvas/LabAColor.h"
+#include "thekogans/canvas/LabAPixel.h"
+#include "thekogans/canvas/LChAColor.h"
+#include "thekogans/canvas/LabAConverter.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        namespace {
+            const util::f32 RADIANS_PER_DEGREE = 3.14159265358979323846f / 180.0f;
+
+            // D65 reference white.
+            const util::f32 Xn = 0.95047f;
+            const util::f32 Yn = 1.0f;
+            const util::f32 Zn = 1.08883f;
+
+            // sRGB (linear) -> XYZ matrix (see XYZAConverter.cpp) with
+            // the reference white folded in.
+            const util::f32 M00 = 0.4124564f / Xn;
+            const util::f32 M01 = 0.3575761f / Xn;
+            const util::f32 M02 = 0.1804375f / Xn;
+            const util::f32 M10 = 0.2126729f / Yn;
+            const util::f32 M11 = 0.7151522f / Yn;
+            const util::f32 M12 = 0.0721750f / Yn;
+            const util::f32 M20 = 0.0193339f / Zn;
+            const util::f32 M21 = 0.1191920f / Zn;
+            const util::f32 M22 = 0.9503041f / Zn;
+
+            // f (t) = t > EPSILON ? cbrt (t) : KAPPA_OVER_116 * t + 16 / 116
+            const util::f32 EPSILON = 216.0f / 24389.0f;
+            const util::f32 KAPPA_OVER_116 = 24389.0f / 27.0f / 116.0f;
+            const util::f32 SIXTEEN_OVER_116 = 16.0f / 116.0f;
+
+            inline util::f32 Linearize (util::f32 value) {
+                return value > 0.04045f ?
+                    std::pow ((value + 0.055f) / 1.055f, 2.4f) : value / 12.92f;
+            }
+
+            // sRGB gamma expansion is the most expensive part of RGB -> Lab.
+            // Tabulate it. ui8 components index the 256 entry table directly.
+            // f32 components in [0, 1] interpolate the 4096 entry table (max
+            // error < 1e-7). Anything out of range is computed exactly.
+            struct LinearizeTables {
+                enum {
+                    F32_TABLE_SIZE = 4096
+                };
+                util::f32 ui8Table[256];
+                util::f32 f32Table[F32_TABLE_SIZE + 1];
+
+                LinearizeTables () {
+                    for (util::ui32 i = 0; i < 256; ++i) {
+                        ui8Table[i] = Linearize (i / 255.0f);
+                    }
+                    for (util::ui32 i = 0; i <= F32_TABLE_SIZE; ++i) {
+                        f32Table[i] = Linearize ((util::f32)i / F32_TABLE_SIZE);
+                    }
+                }
+
+                static const LinearizeTables &Instance () {
+                    static const LinearizeTables instance;
+                    return instance;
+                }
+
+                inline util::f32 operator () (util::ui8 value) const {
+                    return ui8Table[value];
+                }
+
+                inline util::f32 operator () (util::f32 value) const {
+                    if (value >= 0.0f && value <= 1.0f) {
+                        util::f32 index = value * F32_TABLE_SIZE;
+                        util::ui32 i = (util::ui32)index;
+                        if (i == F32_TABLE_SIZE) {
+                            return f32Table[F32_TABLE_SIZE];
+                        }
+                        util::f32 fraction = index - i;
+                        return f32Table[i] + (f32Table[i + 1] - f32Table[i]) * fraction;
+                    }
+                    return Linearize (value);
+                }
+            };
+
+            // Cube root of a positive, normal value. The initial estimate
+            // comes from dividing the exponent by 3 in the integer domain
+            // (~3.5% relative error) and two Newton steps bring it to
+            // within 1.2e-6 relative error (up to ~13 ulp) over the
+            // [EPSILON, 1.2] range F sees. That is well under what L, a
+            // and b need (~1.5e-4 in L).
+            inline util::f32 CubeRoot (util::f32 x) {
+                util::ui32 i;
+                memcpy (&i, &x, sizeof (i));
+                i = i / 3 + 0x2a514067;
+                util::f32 y;
+                memcpy (&y, &i, sizeof (y));
+                y = (2.0f * y + x / (y * y)) * (1.0f / 3.0f);
+                y = (2.0f * y + x / (y * y)) * (1.0f / 3.0f);
+                return y;
+            }
+
+            inline util::f32 F (util::f32 t) {
+                return t > EPSILON ? CubeRoot (t) : KAPPA_OVER_116 * t + SIXTEEN_OVER_116;
+            }
+
+            inline void LabFromNormalizedXYZ (
+                    util::f32 x,
+                    util::f32 y,
+                    util::f32 z,
+                    util::f32 &l,
+                    util::f32 &a,
+                    util::f32 &b) {
+                util::f32 fx = F (x);
+                util::f32 fy = F (y);
+                util::f32 fz = F (z);
+                l = 116.0f * fy - 16.0f;
+                a = 500.0f * (fx - fy);
+                b = 200.0f * (fy - fz);
+            }
+
+            inline void LabFromLinearRGB (
+                    util::f32 r,
+                    util::f32 g,
+                    util::f32 b,
+                    f32LabAPixel &lab) {
+                LabFromNormalizedXYZ (
+                    M00 * r + M01 * g + M02 * b,
+                    M10 * r + M11 * g + M12 * b,
+                    M20 * r + M21 * g + M22 * b,
+                    lab.l, lab.a, lab.b);
+            }
+
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            inline __m128 CubeRoot (__m128 x) {
+                // SSE2 has no integer divide. i / 3 is done in floating point,
+                // which is plenty for an initial estimate.
+                const __m128 third = _mm_set1_ps (1.0f / 3.0f);
+                const __m128 two = _mm_set1_ps (2.0f);
+                __m128i i = _mm_cvttps_epi32 (
+                    _mm_mul_ps (_mm_cvtepi32_ps (_mm_castps_si128 (x)), third));
+                __m128 y = _mm_castsi128_ps (_mm_add_epi32 (i, _mm_set1_epi32 (0x2a514067)));
+                y = _mm_mul_ps (_mm_add_ps (_mm_mul_ps (two, y),
+                    _mm_div_ps (x, _mm_mul_ps (y, y))), third);
+                y = _mm_mul_ps (_mm_add_ps (_mm_mul_ps (two, y),
+                    _mm_div_ps (x, _mm_mul_ps (y, y))), third);
+                return y;
+            }
+
+            inline __m128 F (__m128 t) {
+                __m128 cube = _mm_cmpgt_ps (t, _mm_set1_ps (EPSILON));
+                // Keep the cube root away from zero/negative lanes that will
+                // be discarded anyway.
+                __m128 root = CubeRoot (_mm_max_ps (t, _mm_set1_ps (EPSILON)));
+                __m128 linear = _mm_add_ps (
+                    _mm_mul_ps (t, _mm_set1_ps (KAPPA_OVER_116)),
+                    _mm_set1_ps (SIXTEEN_OVER_116));
+                return _mm_or_ps (_mm_and_ps (cube, root), _mm_andnot_ps (cube, linear));
+            }
+
+            // r, g, b hold the same (linear) component of four pixels.
+            // Writes four f32LabAPixels to out.
+            inline void LabFromLinearRGB (
+                    __m128 r,
+                    __m128 g,
+                    __m128 b,
+                    __m128 alpha,
+                    f32LabAPixel *out) {
+                __m128 fx = F (_mm_add_ps (_mm_add_ps (
+                    _mm_mul_ps (r, _mm_set1_ps (M00)),
+                    _mm_mul_ps (g, _mm_set1_ps (M01))),
+                    _mm_mul_ps (b, _mm_set1_ps (M02))));
+                __m128 fy = F (_mm_add_ps (_mm_add_ps (
+                    _mm_mul_ps (r, _mm_set1_ps (M10)),
+                    _mm_mul_ps (g, _mm_set1_ps (M11))),
+                    _mm_mul_ps (b, _mm_set1_ps (M12))));
+                __m128 fz = F (_mm_add_ps (_mm_add_ps (
+                    _mm_mul_ps (r, _mm_set1_ps (M20)),
+                    _mm_mul_ps (g, _mm_set1_ps (M21))),
+                    _mm_mul_ps (b, _mm_set1_ps (M22))));
+                __m128 p0 = _mm_sub_ps (_mm_mul_ps (fy, _mm_set1_ps (116.0f)), _mm_set1_ps (16.0f));
+                __m128 p1 = _mm_mul_ps (_mm_sub_ps (fx, fy), _mm_set1_ps (500.0f));
+                __m128 p2 = _mm_mul_ps (_mm_sub_ps (fy, fz), _mm_set1_ps (200.0f));
+                __m128 p3 = alpha;
+                _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+                _mm_storeu_ps (&out[0].l, p0);
+                _mm_storeu_ps (&out[1].l, p1);
+                _mm_storeu_ps (&out[2].l, p2);
+                _mm_storeu_ps (&out[3].l, p3);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+        }
+
+        template<>
+        f32LabAColor Converter<f32LabAColor>::Convert (const f32LabAColor &inColor) {
+            return inColor;
+        }
+
+        template<>
+        f32LabAColor Converter<f32LabAColor>::Convert (const f32RGBAColor &inColor) {
+            const LinearizeTables &linearize = LinearizeTables::Instance ();
+            f32LabAPixel lab;
+            LabFromLinearRGB (
+                linearize (inColor.r),
+                linearize (inColor.g),
+                linearize (inColor.b),
+                lab);
+            return f32LabAColor (lab.l, lab.a, lab.b, inColor.a);
+        }
+
+        template<>
+        f32LabAColor Converter<f32LabAColor>::Convert (const f32XYZAColor &inColor) {
+            // XYZAColor is scaled to [0, 100].
+            util::f32 l, a, b;
+            LabFromNormalizedXYZ (
+                inColor.x / (Xn * 100.0f),
+                inColor.y / (Yn * 100.0f),
+                inColor.z / (Zn * 100.0f),
+                l, a, b);
+            return f32LabAColor (l, a, b, inColor.a);
+        }
+
+        template<>
+        f32LabAColor Converter<f32LabAColor>::Convert (const f32LChAColor &inColor) {
+            util::f32 h = inColor.h * RADIANS_PER_DEGREE;
+            return f32LabAColor (
+                inColor.l,
+                inColor.c * std::cos (h),
+                inColor.c * std::sin (h),
+                inColor.a);
+        }
+
+        void SpanConverter<f32RGBAPixel, f32LabAPixel>::Convert (
+                const f32RGBAPixel *in,
+                f32LabAPixel *out,
+                std::size_t count) {
+            const LinearizeTables &linearize = LinearizeTables::Instance ();
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 4; count -= 4, in += 4, out += 4) {
+                LabFromLinearRGB (
+                    _mm_setr_ps (
+                        linearize (in[0].r), linearize (in[1].r),
+                        linearize (in[2].r), linearize (in[3].r)),
+                    _mm_setr_ps (
+                        linearize (in[0].g), linearize (in[1].g),
+                        linearize (in[2].g), linearize (in[3].g)),
+                    _mm_setr_ps (
+                        linearize (in[0].b), linearize (in[1].b),
+                        linearize (in[2].b), linearize (in[3].b)),
+                    _mm_setr_ps (in[0].a, in[1].a, in[2].a, in[3].a),
+                    out);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count != 0; --count, ++in, ++out) {
+                LabFromLinearRGB (
+                    linearize (in->r),
+                    linearize (in->g),
+                    linearize (in->b),
+                    *out);
+                out->alpha = in->a;
+            }
+        }
+
+        void SpanConverter<ui8RGBAPixel, f32LabAPixel>::Convert (
+                const ui8RGBAPixel *in,
+                f32LabAPixel *out,
+                std::size_t count) {
+            const LinearizeTables &linearize = LinearizeTables::Instance ();
+            const util::f32 ONE_OVER_255 = 1.0f / 255.0f;
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count >= 4; count -= 4, in += 4, out += 4) {
+                LabFromLinearRGB (
+                    _mm_setr_ps (
+                        linearize (in[0].r), linearize (in[1].r),
+                        linearize (in[2].r), linearize (in[3].r)),
+                    _mm_setr_ps (
+                        linearize (in[0].g), linearize (in[1].g),
+                        linearize (in[2].g), linearize (in[3].g)),
+                    _mm_setr_ps (
+                        linearize (in[0].b), linearize (in[1].b),
+                        linearize (in[2].b), linearize (in[3].b)),
+                    _mm_mul_ps (
+                        _mm_setr_ps (in[0].a, in[1].a, in[2].a, in[3].a),
+                        _mm_set1_ps (ONE_OVER_255)),
+                    out);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count != 0; --count, ++in, ++out) {
+                LabFromLinearRGB (
+                    linearize (in->r),
+                    linearize (in->g),
+                    linearize (in->b),
+                    *out);
+                out->alpha = in->a * ONE_OVER_255;
+            }
+        }
+
+    } // namespace canvas
+} // namespace thekogans
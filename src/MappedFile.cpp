@@ -0,0 +1,179 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include "thekogans/util/Environment.h"
+#if defined (TOOLCHAIN_OS_Windows)
+    #include "thekogans/util/os/windows/WindowsHeader.h"
+    #include "thekogans/util/StringUtils.h"
+#else // defined (TOOLCHAIN_OS_Windows)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <cerrno>
+#endif // defined (TOOLCHAIN_OS_Windows)
+#include <limits>
+#include <algorithm>
+#include "thekogans/util/Exception.h"
+#include "thekogans/canvas/MappedFile.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        namespace {
+        #if defined (TOOLCHAIN_OS_Windows)
+            struct HandleCloser {
+                HANDLE handle;
+                explicit HandleCloser (HANDLE handle_) :
+                    handle (handle_) {}
+                ~HandleCloser () {
+                    if (handle != 0 && handle != INVALID_HANDLE_VALUE) {
+                        CloseHandle (handle);
+                    }
+                }
+            };
+        #else // defined (TOOLCHAIN_OS_Windows)
+            struct HandleCloser {
+                int handle;
+                explicit HandleCloser (int handle_) :
+                    handle (handle_) {}
+                ~HandleCloser () {
+                    if (handle >= 0) {
+                        close (handle);
+                    }
+                }
+            };
+        #endif // defined (TOOLCHAIN_OS_Windows)
+        }
+
+        MappedFile::MappedFile (
+                const std::string &path,
+                bool sequential,
+                bool copyOnWrite_) :
+                data (0),
+                size (0),
+                mapping (0),
+                copyOnWrite (copyOnWrite_) {
+        #if defined (TOOLCHAIN_OS_Windows)
+            HandleCloser file (
+                CreateFileW (
+                    util::UTF8ToUTF16 (path).c_str (),
+                    GENERIC_READ,
+                    FILE_SHARE_READ,
+                    0,
+                    OPEN_EXISTING,
+                    sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS,
+                    0));
+            if (file.handle == INVALID_HANDLE_VALUE) {
+                THEKOGANS_UTIL_THROW_ERROR_CODE_AND_MESSAGE_EXCEPTION (
+                    THEKOGANS_UTIL_OS_ERROR_CODE, " (%s)", path.c_str ());
+            }
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx (file.handle, &fileSize)) {
+                THEKOGANS_UTIL_THROW_ERROR_CODE_AND_MESSAGE_EXCEPTION (
+                    THEKOGANS_UTIL_OS_ERROR_CODE, " (%s)", path.c_str ());
+            }
+            if ((util::ui64)fileSize.QuadPart > std::numeric_limits<std::size_t>::max ()) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "File too big to map: %s", path.c_str ());
+            }
+            size = (std::size_t)fileSize.QuadPart;
+            if (size >= MAP_THRESHOLD) {
+                HandleCloser fileMapping (
+                    CreateFileMappingW (
+                        file.handle, 0, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0));
+                if (fileMapping.handle != 0) {
+                    mapping = MapViewOfFile (
+                        fileMapping.handle, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+                }
+            }
+            if (mapping == 0 && size > 0) {
+                buffer.resize (size);
+                for (std::size_t offset = 0; offset < size;) {
+                    DWORD chunk = (DWORD)(std::min) (size - offset, (std::size_t)1 << 30);
+                    DWORD bytesRead = 0;
+                    if (!ReadFile (file.handle, buffer.data () + offset, chunk, &bytesRead, 0) ||
+                            bytesRead == 0) {
+                        THEKOGANS_UTIL_THROW_ERROR_CODE_AND_MESSAGE_EXCEPTION (
+                            THEKOGANS_UTIL_OS_ERROR_CODE, " (%s)", path.c_str ());
+                    }
+                    offset += bytesRead;
+                }
+            }
+        #else // defined (TOOLCHAIN_OS_Windows)
+            HandleCloser file (open (path.c_str (), O_RDONLY | O_CLOEXEC));
+            if (file.handle < 0) {
+                THEKOGANS_UTIL_THROW_ERROR_CODE_AND_MESSAGE_EXCEPTION (
+                    THEKOGANS_UTIL_OS_ERROR_CODE, " (%s)", path.c_str ());
+            }
+            struct stat fileStat;
+            if (fstat (file.handle, &fileStat) < 0) {
+                THEKOGANS_UTIL_THROW_ERROR_CODE_AND_MESSAGE_EXCEPTION (
+                    THEKOGANS_UTIL_OS_ERROR_CODE, " (%s)", path.c_str ());
+            }
+            if ((util::ui64)fileStat.st_size > std::numeric_limits<std::size_t>::max ()) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "File too big to map: %s", path.c_str ());
+            }
+            size = (std::size_t)fileStat.st_size;
+            if (size >= MAP_THRESHOLD) {
+                // The mapping outlives the descriptor. MAP_PRIVATE makes
+                // writes copy on write.
+                void *ptr = mmap (
+                    0, size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_PRIVATE, file.handle, 0);
+                if (ptr != MAP_FAILED) {
+                    mapping = ptr;
+                    // Only a hint, failure is harmless.
+                    madvise (mapping, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                }
+            }
+            // Small files, and the ones that can't be mapped, are read.
+            if (mapping == 0 && size > 0) {
+                buffer.resize (size);
+                for (std::size_t offset = 0; offset < size;) {
+                    ssize_t bytesRead = pread (
+                        file.handle, buffer.data () + offset, size - offset, (off_t)offset);
+                    if (bytesRead < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (bytesRead <= 0) {
+                        THEKOGANS_UTIL_THROW_ERROR_CODE_AND_MESSAGE_EXCEPTION (
+                            bytesRead < 0 ? THEKOGANS_UTIL_OS_ERROR_CODE : EIO,
+                            " (%s)", path.c_str ());
+                    }
+                    offset += bytesRead;
+                }
+            }
+        #endif // defined (TOOLCHAIN_OS_Windows)
+            data = mapping != 0 ? (const util::ui8 *)mapping :
+                size > 0 ? buffer.data () : 0;
+        }
+
+        MappedFile::~MappedFile () {
+            if (mapping != 0) {
+            #if defined (TOOLCHAIN_OS_Windows)
+                UnmapViewOfFile (mapping);
+            #else // defined (TOOLCHAIN_OS_Windows)
+                munmap (mapping, size);
+            #endif // defined (TOOLCHAIN_OS_Windows)
+            }
+        }
+
+    } // namespace canvas
+} // namespace thekogans
@@ -0,0 +1,318 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <zlib.h>
+#include "thekogans/canvas/Parallel.h"
+#include "thekogans/canvas/PNGUtils.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        namespace {
+            // lodepng error codes we map zlib errors to.
+            const unsigned ERROR_DEFLATE_BLOCK = 20;
+            const unsigned ERROR_END_OF_INPUT = 23;
+            const unsigned ERROR_ZLIB_TOO_SMALL = 53;
+            const unsigned ERROR_ALLOCATION = 83;
+
+            // zlib counts in uInt. Feed it in chunks that fit.
+            const std::size_t MAX_CHUNK = UINT_MAX;
+
+            unsigned ZlibErrorToLodePNGError (int error) {
+                return
+                    error == Z_MEM_ERROR ? ERROR_ALLOCATION :
+                    error == Z_BUF_ERROR ? ERROR_END_OF_INPUT : ERROR_DEFLATE_BLOCK;
+            }
+        }
+
+        _LIB_THEKOGANS_CANVAS_DECL unsigned _LIB_THEKOGANS_CANVAS_API ZlibDecompress (
+                unsigned char **out,
+                std::size_t *outsize,
+                const unsigned char *in,
+                std::size_t insize,
+                const LodePNGDecompressSettings *settings) {
+            if (insize < 2) {
+                return ERROR_ZLIB_TOO_SMALL;
+            }
+            z_stream stream;
+            stream.zalloc = Z_NULL;
+            stream.zfree = Z_NULL;
+            stream.opaque = Z_NULL;
+            stream.next_in = Z_NULL;
+            stream.avail_in = 0;
+            // zlib has no switch to skip the adler32 check. Inflate the raw
+            // deflate stream after the 2 byte header instead.
+            bool raw = settings != 0 && settings->ignore_adler32;
+            int error = inflateInit2 (&stream, raw ? -MAX_WBITS : MAX_WBITS);
+            if (error != Z_OK) {
+                return ZlibErrorToLodePNGError (error);
+            }
+            if (raw) {
+                in += 2;
+                insize -= 2;
+            }
+            // Filtered scanlines usually deflate 2-4x. Start there and double.
+            std::size_t capacity = std::max<std::size_t> (insize * 4, 16384);
+            unsigned char *buffer = (unsigned char *)malloc (capacity);
+            std::size_t size = 0;
+            while (buffer != 0) {
+                if (stream.avail_in == 0 && insize > 0) {
+                    stream.next_in = (Bytef *)in;
+                    stream.avail_in = (uInt)std::min (insize, MAX_CHUNK);
+                    in += stream.avail_in;
+                    insize -= stream.avail_in;
+                }
+                stream.next_out = buffer + size;
+                stream.avail_out = (uInt)std::min (capacity - size, MAX_CHUNK);
+                std::size_t avail_out = stream.avail_out;
+                error = inflate (&stream, Z_NO_FLUSH);
+                size += avail_out - stream.avail_out;
+                if (error == Z_STREAM_END) {
+                    break;
+                }
+                if (error != Z_OK && error != Z_BUF_ERROR) {
+                    break;
+                }
+                if (error == Z_BUF_ERROR && stream.avail_in == 0 && insize == 0) {
+                    // Truncated stream.
+                    break;
+                }
+                if (size == capacity) {
+                    capacity *= 2;
+                    unsigned char *newBuffer = (unsigned char *)realloc (buffer, capacity);
+                    if (newBuffer == 0) {
+                        free (buffer);
+                    }
+                    buffer = newBuffer;
+                }
+            }
+            inflateEnd (&stream);
+            if (buffer == 0) {
+                return ERROR_ALLOCATION;
+            }
+            if (error != Z_STREAM_END) {
+                free (buffer);
+                return ZlibErrorToLodePNGError (error);
+            }
+            free (*out);
+            *out = buffer;
+            *outsize = size;
+            return 0;
+        }
+
+        namespace {
+            // Deflate one block of a parallel stream. Blocks other than the
+            // first are primed with the input that precedes them, and all but
+            // the last end with a sync flush so that they can be concatenated.
+            int DeflateBlock (
+                    const unsigned char *in,
+                    std::size_t insize,
+                    std::size_t dictionarySize,
+                    bool last,
+                    int level,
+                    int strategy,
+                    std::vector<unsigned char> &out) {
+                z_stream stream;
+                stream.zalloc = Z_NULL;
+                stream.zfree = Z_NULL;
+                stream.opaque = Z_NULL;
+                int error = deflateInit2 (&stream, level, Z_DEFLATED, -MAX_WBITS, 8, strategy);
+                if (error != Z_OK) {
+                    return error;
+                }
+                if (dictionarySize > 0) {
+                    error = deflateSetDictionary (
+                        &stream, in - dictionarySize, (uInt)dictionarySize);
+                }
+                if (error == Z_OK) {
+                    // deflateBound covers Z_FINISH. Leave room for the sync flush marker.
+                    out.resize (deflateBound (&stream, (uLong)insize) + 16);
+                    stream.next_in = (Bytef *)in;
+                    stream.avail_in = (uInt)insize;
+                    std::size_t size = 0;
+                    for (;;) {
+                        if (size == out.size ()) {
+                            out.resize (out.size () * 2);
+                        }
+                        stream.next_out = out.data () + size;
+                        stream.avail_out = (uInt)(out.size () - size);
+                        error = deflate (&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+                        size = out.size () - stream.avail_out;
+                        if (error == Z_STREAM_END ||
+                                (!last && error == Z_OK && stream.avail_out != 0)) {
+                            error = Z_OK;
+                            break;
+                        }
+                        if (error != Z_OK && error != Z_BUF_ERROR) {
+                            break;
+                        }
+                    }
+                    out.resize (size);
+                }
+                deflateEnd (&stream);
+                return error;
+            }
+
+            unsigned ParallelZlibCompress (
+                    unsigned char **out,
+                    std::size_t *outsize,
+                    const unsigned char *in,
+                    std::size_t insize,
+                    const ZlibCompressContext &context) {
+                const std::size_t DICTIONARY_SIZE = 32768;
+                std::size_t blockCount = (insize + context.blockSize - 1) / context.blockSize;
+                std::vector<std::vector<unsigned char>> blocks (blockCount);
+                std::vector<uLong> adlers (blockCount);
+                std::vector<int> errors (blockCount, Z_OK);
+                ParallelFor (0, blockCount,
+                    [&] (std::size_t begin, std::size_t end) {
+                        for (std::size_t i = begin; i < end; ++i) {
+                            std::size_t offset = i * context.blockSize;
+                            std::size_t size = std::min (context.blockSize, insize - offset);
+                            adlers[i] = adler32 (adler32 (0, Z_NULL, 0), in + offset, (uInt)size);
+                            errors[i] = DeflateBlock (
+                                in + offset,
+                                size,
+                                std::min (offset, DICTIONARY_SIZE),
+                                i == blockCount - 1,
+                                context.level,
+                                context.strategy,
+                                blocks[i]);
+                        }
+                    },
+                    1,
+                    context.threads);
+                uLong adler = adler32 (0, Z_NULL, 0);
+                std::size_t size = 2 + 4;
+                for (std::size_t i = 0; i < blockCount; ++i) {
+                    if (errors[i] != Z_OK) {
+                        return ZlibErrorToLodePNGError (errors[i]);
+                    }
+                    std::size_t offset = i * context.blockSize;
+                    adler = adler32_combine (adler, adlers[i],
+                        (z_off_t)std::min (context.blockSize, insize - offset));
+                    size += blocks[i].size ();
+                }
+                unsigned char *buffer = (unsigned char *)malloc (size);
+                if (buffer == 0) {
+                    return ERROR_ALLOCATION;
+                }
+                // zlib header: deflate, 32K window, FLEVEL from the level and
+                // FCHECK making the 16 bit header a multiple of 31.
+                unsigned flevel =
+                    context.level < 0 || context.level == 6 ? 2 :
+                    context.level < 2 ? 0 :
+                    context.level < 6 ? 1 : 3;
+                unsigned header = 0x7800 | (flevel << 6);
+                header += 31 - header % 31;
+                unsigned char *ptr = buffer;
+                *ptr++ = (unsigned char)(header >> 8);
+                *ptr++ = (unsigned char)header;
+                for (std::size_t i = 0; i < blockCount; ++i) {
+                    if (!blocks[i].empty ()) {
+                        memcpy (ptr, blocks[i].data (), blocks[i].size ());
+                        ptr += blocks[i].size ();
+                    }
+                }
+                *ptr++ = (unsigned char)(adler >> 24);
+                *ptr++ = (unsigned char)(adler >> 16);
+                *ptr++ = (unsigned char)(adler >> 8);
+                *ptr++ = (unsigned char)adler;
+                free (*out);
+                *out = buffer;
+                *outsize = size;
+                return 0;
+            }
+        }
+
+        _LIB_THEKOGANS_CANVAS_DECL unsigned _LIB_THEKOGANS_CANVAS_API ZlibCompress (
+                unsigned char **out,
+                std::size_t *outsize,
+                const unsigned char *in,
+                std::size_t insize,
+                const LodePNGCompressSettings *settings) {
+            int level = Z_DEFAULT_COMPRESSION;
+            int strategy = Z_DEFAULT_STRATEGY;
+            const ZlibCompressContext *context = settings != 0 ?
+                (const ZlibCompressContext *)settings->custom_context : 0;
+            if (context != 0) {
+                level = context->level;
+                strategy = context->strategy;
+                util::ui32 threads = context->threads == 0 ?
+                    GetHardwareConcurrency () : context->threads;
+                if (threads > 1 && context->blockSize > 0 &&
+                        insize > 2 * context->blockSize) {
+                    return ParallelZlibCompress (out, outsize, in, insize, *context);
+                }
+            }
+            else if (settings != 0) {
+                if (settings->btype == 0) {
+                    level = Z_NO_COMPRESSION;
+                }
+                else if (!settings->use_lz77) {
+                    strategy = Z_HUFFMAN_ONLY;
+                }
+            }
+            if (insize > MAX_CHUNK) {
+                // No png gets anywhere near this.
+                return ERROR_ALLOCATION;
+            }
+            z_stream stream;
+            stream.zalloc = Z_NULL;
+            stream.zfree = Z_NULL;
+            stream.opaque = Z_NULL;
+            int error = deflateInit2 (&stream, level, Z_DEFLATED, MAX_WBITS, 8, strategy);
+            if (error != Z_OK) {
+                return ZlibErrorToLodePNGError (error);
+            }
+            std::size_t capacity = deflateBound (&stream, (uLong)insize);
+            unsigned char *buffer = (unsigned char *)malloc (capacity);
+            if (buffer == 0) {
+                deflateEnd (&stream);
+                return ERROR_ALLOCATION;
+            }
+            // deflateBound guarantees a single Z_FINISH call fits.
+            stream.next_in = (Bytef *)in;
+            stream.avail_in = (uInt)insize;
+            stream.next_out = buffer;
+            stream.avail_out = (uInt)capacity;
+            error = deflate (&stream, Z_FINISH);
+            std::size_t size = capacity - stream.avail_out;
+            deflateEnd (&stream);
+            if (error != Z_STREAM_END) {
+                free (buffer);
+                return ZlibErrorToLodePNGError (error);
+            }
+            free (*out);
+            *out = buffer;
+            *outsize = size;
+            return 0;
+        }
+
+        _LIB_THEKOGANS_CANVAS_DECL void _LIB_THEKOGANS_CANVAS_API UseZlib (
+                LodePNGState &state) {
+            state.decoder.zlibsettings.custom_zlib = ZlibDecompress;
+            state.encoder.zlibsettings.custom_zlib = ZlibCompress;
+        }
+
+    } // namespace canvas
+} // namespace thekogans
@@ -0,0 +1,205 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include "thekogans/canvas/Parallel.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        _LIB_THEKOGANS_CANVAS_DECL util::ui32 _LIB_THEKOGANS_CANVAS_API
+                GetHardwareConcurrency () {
+            util::ui32 concurrency = std::thread::hardware_concurrency ();
+            return concurrency > 0 ? concurrency : 1;
+        }
+
+        namespace {
+            // One ParallelFor call. Bands are claimed (by the calling
+            // thread and the pool workers) through next, so whoever is
+            // free picks up the next band.
+            struct Batch {
+                const std::function<void (std::size_t, std::size_t)> &body;
+                const std::size_t begin;
+                const std::size_t bandSize;
+                const std::size_t remainder;
+                const std::size_t bands;
+                std::atomic<std::size_t> next;
+                std::vector<std::exception_ptr> exceptions;
+                std::mutex mutex;
+                std::condition_variable finished;
+                std::size_t done;
+
+                Batch (
+                    const std::function<void (std::size_t, std::size_t)> &body_,
+                    std::size_t begin_,
+                    std::size_t count,
+                    std::size_t bands_) :
+                    body (body_),
+                    begin (begin_),
+                    bandSize (count / bands_),
+                    remainder (count % bands_),
+                    bands (bands_),
+                    next (0),
+                    exceptions (bands_),
+                    done (0) {}
+
+                inline bool IsExhausted () const {
+                    return next >= bands;
+                }
+
+                // Run the next unclaimed band. Return false if there are none.
+                bool RunBand () {
+                    std::size_t band = next++;
+                    if (band >= bands) {
+                        return false;
+                    }
+                    // Spread the remainder over the first bands so that
+                    // no band is more than one index larger than another.
+                    std::size_t bandBegin = begin + band * bandSize + std::min (band, remainder);
+                    std::size_t bandEnd = bandBegin + bandSize + (band < remainder ? 1 : 0);
+                    try {
+                        body (bandBegin, bandEnd);
+                    }
+                    catch (...) {
+                        exceptions[band] = std::current_exception ();
+                    }
+                    std::lock_guard<std::mutex> guard (mutex);
+                    if (++done == bands) {
+                        finished.notify_all ();
+                    }
+                    return true;
+                }
+
+                void Wait () {
+                    std::unique_lock<std::mutex> lock (mutex);
+                    finished.wait (lock, [this] () {return done == bands;});
+                }
+            };
+
+            // Worker threads shared by all ParallelFor calls. They are
+            // started on demand (up to GetHardwareConcurrency () - 1, the
+            // calling thread being the last one) and live for the rest of
+            // the process. The pool is never destroyed so that no worker
+            // is joined during static destruction or dll unload.
+            struct WorkerPool {
+                std::mutex mutex;
+                std::condition_variable work;
+                std::deque<std::shared_ptr<Batch>> queue;
+                std::size_t workerCount;
+                const std::size_t maxWorkerCount;
+
+                WorkerPool () :
+                    workerCount (0),
+                    maxWorkerCount (std::max<util::ui32> (GetHardwareConcurrency (), 2) - 1) {}
+
+                static WorkerPool &Instance () {
+                    static WorkerPool *pool = new WorkerPool;
+                    return *pool;
+                }
+
+                // Queue the batch and make sure up to helpers workers
+                // are there to help with it. Failing to start a worker
+                // is not an error, the calling thread runs whatever
+                // bands are left.
+                void Enqueue (
+                        const std::shared_ptr<Batch> &batch,
+                        std::size_t helpers) {
+                    std::lock_guard<std::mutex> guard (mutex);
+                    queue.push_back (batch);
+                    helpers = std::min (helpers, maxWorkerCount);
+                    try {
+                        for (; workerCount < helpers; ++workerCount) {
+                            std::thread (&WorkerPool::Run, this).detach ();
+                        }
+                    }
+                    catch (...) {
+                    }
+                    work.notify_all ();
+                }
+
+                void Remove (const std::shared_ptr<Batch> &batch) {
+                    std::lock_guard<std::mutex> guard (mutex);
+                    std::deque<std::shared_ptr<Batch>>::iterator it =
+                        std::find (queue.begin (), queue.end (), batch);
+                    if (it != queue.end ()) {
+                        queue.erase (it);
+                    }
+                }
+
+                void Run () {
+                    while (true) {
+                        std::shared_ptr<Batch> batch;
+                        {
+                            std::unique_lock<std::mutex> lock (mutex);
+                            work.wait (lock, [this] () {return !queue.empty ();});
+                            batch = queue.front ();
+                            if (batch->IsExhausted ()) {
+                                queue.pop_front ();
+                                continue;
+                            }
+                        }
+                        while (batch->RunBand ()) {
+                        }
+                    }
+                }
+            };
+        }
+
+        _LIB_THEKOGANS_CANVAS_DECL void _LIB_THEKOGANS_CANVAS_API ParallelFor (
+                std::size_t begin,
+                std::size_t end,
+                const std::function<void (std::size_t, std::size_t)> &body,
+                std::size_t grain,
+                util::ui32 threads) {
+            if (begin >= end) {
+                return;
+            }
+            std::size_t count = end - begin;
+            std::size_t bands = std::min<std::size_t> (
+                threads > 0 ? threads : GetHardwareConcurrency (),
+                count / std::max<std::size_t> (grain, 1));
+            if (bands < 2) {
+                body (begin, end);
+                return;
+            }
+            std::shared_ptr<Batch> batch (new Batch (body, begin, count, bands));
+            WorkerPool &pool = WorkerPool::Instance ();
+            pool.Enqueue (batch, bands - 1);
+            // The calling thread works on the batch too and, because it
+            // only ever waits for bands that are already running, nested
+            // ParallelFor calls can't deadlock.
+            while (batch->RunBand ()) {
+            }
+            batch->Wait ();
+            pool.Remove (batch);
+            for (std::size_t i = 0; i < bands; ++i) {
+                if (batch->exceptions[i] != 0) {
+                    std::rethrow_exception (batch->exceptions[i]);
+                }
+            }
+        }
+
+    } // namespace canvas
+} // namespace thekogans
@@ -0,0 +1,439 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <algorithm>
+#include "thekogans/util/Exception.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/QOIUtils.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        namespace {
+            const util::ui8 QOI_OP_INDEX = 0x00;
+            const util::ui8 QOI_OP_DIFF = 0x40;
+            const util::ui8 QOI_OP_LUMA = 0x80;
+            const util::ui8 QOI_OP_RUN = 0xc0;
+            const util::ui8 QOI_OP_RGB = 0xfe;
+            const util::ui8 QOI_OP_RGBA = 0xff;
+            const util::ui8 QOI_MASK = 0xc0;
+            const util::ui32 QOI_MAX_RUN = 62;
+            // Same limit as the reference implementation. Protects against
+            // headers that would have us allocate absurd framebuffers.
+            const util::ui64 QOI_MAX_PIXELS = 400000000;
+            const util::ui8 QOI_MAGIC[] = {'q', 'o', 'i', 'f'};
+            const util::ui8 QOIC_MAGIC[] = {'q', 'o', 'i', 'c'};
+            const util::ui8 QOI_END_MARKER[QOI_END_MARKER_SIZE] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+            struct RGBA {
+                util::ui8 r;
+                util::ui8 g;
+                util::ui8 b;
+                util::ui8 a;
+            };
+
+            inline util::ui32 Pack (const RGBA &rgba) {
+                util::ui32 value;
+                memcpy (&value, &rgba, sizeof (value));
+                return value;
+            }
+
+            inline RGBA Unpack (util::ui32 value) {
+                RGBA rgba;
+                memcpy (&rgba, &value, sizeof (rgba));
+                return rgba;
+            }
+
+            inline util::ui32 Hash (const RGBA &rgba) {
+                return (rgba.r * 3 + rgba.g * 5 + rgba.b * 7 + rgba.a * 11) & 63;
+            }
+
+            inline util::ui32 ReadBE32 (const util::ui8 *buffer) {
+                return
+                    ((util::ui32)buffer[0] << 24) |
+                    ((util::ui32)buffer[1] << 16) |
+                    ((util::ui32)buffer[2] << 8) |
+                    (util::ui32)buffer[3];
+            }
+
+            inline void WriteBE32 (
+                    std::vector<util::ui8> &buffer,
+                    util::ui32 value) {
+                buffer.push_back ((util::ui8)(value >> 24));
+                buffer.push_back ((util::ui8)(value >> 16));
+                buffer.push_back ((util::ui8)(value >> 8));
+                buffer.push_back ((util::ui8)value);
+            }
+
+            void ThrowTruncated () {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                    "Truncated qoi stream.");
+            }
+        }
+
+        void QOIHeader::Validate () const {
+            if (extents.width == 0 || extents.height == 0 ||
+                    (util::ui64)extents.width * extents.height > QOI_MAX_PIXELS ||
+                    (channels != 3 && channels != 4) ||
+                    colorspace > 1) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Invalid qoi header (%u x %u, %u channels, colorspace %u).",
+                    extents.width, extents.height, channels, colorspace);
+            }
+        }
+
+        std::size_t QOIHeader::Read (
+                const util::ui8 *buffer,
+                std::size_t size) {
+            bool chunked = false;
+            if (size < QOI_HEADER_SIZE ||
+                    (memcmp (buffer, QOI_MAGIC, sizeof (QOI_MAGIC)) != 0 &&
+                        !(chunked = memcmp (buffer, QOIC_MAGIC, sizeof (QOIC_MAGIC)) == 0))) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                    "Not a qoi stream.");
+            }
+            extents = util::Rectangle::Extents (ReadBE32 (buffer + 4), ReadBE32 (buffer + 8));
+            channels = buffer[12];
+            colorspace = buffer[13];
+            Validate ();
+            bandRows = 0;
+            bandSizes.clear ();
+            if (!chunked) {
+                return QOI_HEADER_SIZE;
+            }
+            if (size < QOI_HEADER_SIZE + QOI_BAND_INFO_SIZE) {
+                ThrowTruncated ();
+            }
+            bandRows = ReadBE32 (buffer + QOI_HEADER_SIZE);
+            util::ui32 bandCount = ReadBE32 (buffer + QOI_HEADER_SIZE + 4);
+            if (bandRows == 0 ||
+                    bandCount != ((util::ui64)extents.height + bandRows - 1) / bandRows) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Invalid qoic bands (%u rows, %u bands for %u rows).",
+                    bandRows, bandCount, extents.height);
+            }
+            std::size_t headerSize =
+                QOI_HEADER_SIZE + QOI_BAND_INFO_SIZE + (std::size_t)bandCount * 4;
+            if (size < headerSize) {
+                ThrowTruncated ();
+            }
+            bandSizes.resize (bandCount);
+            for (util::ui32 i = 0; i < bandCount; ++i) {
+                bandSizes[i] = ReadBE32 (buffer + QOI_HEADER_SIZE + QOI_BAND_INFO_SIZE + i * 4);
+            }
+            return headerSize;
+        }
+
+        void QOIHeader::Write (std::vector<util::ui8> &buffer) const {
+            const util::ui8 *magic = bandSizes.empty () ? QOI_MAGIC : QOIC_MAGIC;
+            buffer.insert (buffer.end (), magic, magic + sizeof (QOI_MAGIC));
+            WriteBE32 (buffer, extents.width);
+            WriteBE32 (buffer, extents.height);
+            buffer.push_back (channels);
+            buffer.push_back (colorspace);
+            if (!bandSizes.empty ()) {
+                WriteBE32 (buffer, bandRows);
+                WriteBE32 (buffer, (util::ui32)bandSizes.size ());
+                for (std::size_t i = 0, count = bandSizes.size (); i < count; ++i) {
+                    WriteBE32 (buffer, bandSizes[i]);
+                }
+            }
+        }
+
+        void QOIEncoder::State::Reset () {
+            memset (index, 0, sizeof (index));
+            RGBA rgba = {0, 0, 0, 255};
+            prev = Pack (rgba);
+            run = 0;
+        }
+
+        template<typename PixelType>
+        std::size_t QOIEncoder::State::Encode (
+                const PixelType *pixels,
+                std::size_t count,
+                util::ui8 *out) {
+            util::ui8 *start = out;
+            RGBA prevRGBA = Unpack (prev);
+            for (const PixelType *end = pixels + count; pixels != end; ++pixels) {
+                RGBA rgba = {pixels->r, pixels->g, pixels->b, pixels->a};
+                util::ui32 value = Pack (rgba);
+                if (value == prev) {
+                    if (++run == QOI_MAX_RUN) {
+                        *out++ = QOI_OP_RUN | (QOI_MAX_RUN - 1);
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    *out++ = (util::ui8)(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                util::ui32 hash = Hash (rgba);
+                if (index[hash] == value) {
+                    *out++ = (util::ui8)(QOI_OP_INDEX | hash);
+                }
+                else {
+                    index[hash] = value;
+                    if (rgba.a == prevRGBA.a) {
+                        util::i8 dr = (util::i8)(rgba.r - prevRGBA.r);
+                        util::i8 dg = (util::i8)(rgba.g - prevRGBA.g);
+                        util::i8 db = (util::i8)(rgba.b - prevRGBA.b);
+                        util::i8 dr_dg = (util::i8)(dr - dg);
+                        util::i8 db_dg = (util::i8)(db - dg);
+                        if (dr > -3 && dr < 2 &&
+                                dg > -3 && dg < 2 &&
+                                db > -3 && db < 2) {
+                            *out++ = (util::ui8)(QOI_OP_DIFF |
+                                (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                        }
+                        else if (dr_dg > -9 && dr_dg < 8 &&
+                                dg > -33 && dg < 32 &&
+                                db_dg > -9 && db_dg < 8) {
+                            *out++ = (util::ui8)(QOI_OP_LUMA | (dg + 32));
+                            *out++ = (util::ui8)((dr_dg + 8) << 4 | (db_dg + 8));
+                        }
+                        else {
+                            *out++ = QOI_OP_RGB;
+                            *out++ = rgba.r;
+                            *out++ = rgba.g;
+                            *out++ = rgba.b;
+                        }
+                    }
+                    else {
+                        *out++ = QOI_OP_RGBA;
+                        *out++ = rgba.r;
+                        *out++ = rgba.g;
+                        *out++ = rgba.b;
+                        *out++ = rgba.a;
+                    }
+                }
+                prev = value;
+                prevRGBA = rgba;
+            }
+            return out - start;
+        }
+
+        std::size_t QOIEncoder::State::Flush (util::ui8 *out) {
+            if (run > 0) {
+                *out = (util::ui8)(QOI_OP_RUN | (run - 1));
+                run = 0;
+                return 1;
+            }
+            return 0;
+        }
+
+        QOIEncoder::QOIEncoder (
+                std::vector<util::ui8> &buffer_,
+                const util::Rectangle::Extents &extents,
+                util::ui8 channels,
+                util::ui8 colorspace) :
+                buffer (buffer_),
+                pixelsLeft ((std::size_t)extents.width * extents.height) {
+            QOIHeader header;
+            header.extents = extents;
+            header.channels = channels;
+            header.colorspace = colorspace;
+            header.Validate ();
+            header.Write (buffer);
+        }
+
+        template<typename PixelType>
+        void QOIEncoder::Encode (
+                const PixelType *pixels,
+                std::size_t count) {
+            if (count > pixelsLeft) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Encoding %u pixels past the end of the image.",
+                    (util::ui32)(count - pixelsLeft));
+            }
+            std::size_t size = buffer.size ();
+            buffer.resize (size + State::GetMaxEncodedSize (count));
+            size += state.Encode (pixels, count, buffer.data () + size);
+            buffer.resize (size);
+            pixelsLeft -= count;
+        }
+
+        void QOIEncoder::End () {
+            if (pixelsLeft != 0) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "%u pixels short of the end of the image.",
+                    (util::ui32)pixelsLeft);
+            }
+            util::ui8 op;
+            if (state.Flush (&op) != 0) {
+                buffer.push_back (op);
+            }
+            buffer.insert (buffer.end (), QOI_END_MARKER, QOI_END_MARKER + QOI_END_MARKER_SIZE);
+        }
+
+        void QOIDecoder::State::Reset () {
+            memset (index, 0, sizeof (index));
+            RGBA rgba = {0, 0, 0, 255};
+            prev = Pack (rgba);
+            run = 0;
+        }
+
+        template<typename PixelType>
+        std::size_t QOIDecoder::State::Decode (
+                const util::ui8 *in,
+                std::size_t size,
+                PixelType *pixels,
+                std::size_t count) {
+            const util::ui8 *start = in;
+            const util::ui8 *end = in + size;
+            RGBA rgba = Unpack (prev);
+            for (PixelType *last = pixels + count; pixels != last;) {
+                if (run > 0) {
+                    // Runs are frequent in synthetic and flat images,
+                    // fill them in one go.
+                    std::size_t length = std::min<std::size_t> (run, last - pixels);
+                    PixelType pixel;
+                    pixel.r = rgba.r;
+                    pixel.g = rgba.g;
+                    pixel.b = rgba.b;
+                    pixel.a = rgba.a;
+                    std::fill (pixels, pixels + length, pixel);
+                    pixels += length;
+                    run -= (util::ui32)length;
+                    continue;
+                }
+                if (in == end) {
+                    ThrowTruncated ();
+                }
+                util::ui8 b1 = *in++;
+                if (b1 == QOI_OP_RGB) {
+                    if (end - in < 3) {
+                        ThrowTruncated ();
+                    }
+                    rgba.r = in[0];
+                    rgba.g = in[1];
+                    rgba.b = in[2];
+                    in += 3;
+                }
+                else if (b1 == QOI_OP_RGBA) {
+                    if (end - in < 4) {
+                        ThrowTruncated ();
+                    }
+                    rgba.r = in[0];
+                    rgba.g = in[1];
+                    rgba.b = in[2];
+                    rgba.a = in[3];
+                    in += 4;
+                }
+                else {
+                    switch (b1 & QOI_MASK) {
+                        case QOI_OP_INDEX:
+                            rgba = Unpack (index[b1]);
+                            break;
+                        case QOI_OP_DIFF:
+                            rgba.r += ((b1 >> 4) & 0x03) - 2;
+                            rgba.g += ((b1 >> 2) & 0x03) - 2;
+                            rgba.b += (b1 & 0x03) - 2;
+                            break;
+                        case QOI_OP_LUMA: {
+                            if (in == end) {
+                                ThrowTruncated ();
+                            }
+                            util::ui8 b2 = *in++;
+                            util::i32 dg = (b1 & 0x3f) - 32;
+                            rgba.r += dg - 8 + ((b2 >> 4) & 0x0f);
+                            rgba.g += dg;
+                            rgba.b += dg - 8 + (b2 & 0x0f);
+                            break;
+                        }
+                        case QOI_OP_RUN:
+                            // This pixel and (b1 & 0x3f) more.
+                            run = b1 & 0x3f;
+                            break;
+                    }
+                }
+                index[Hash (rgba)] = Pack (rgba);
+                pixels->r = rgba.r;
+                pixels->g = rgba.g;
+                pixels->b = rgba.b;
+                pixels->a = rgba.a;
+                ++pixels;
+            }
+            prev = Pack (rgba);
+            return in - start;
+        }
+
+        QOIDecoder::QOIDecoder (
+                const util::ui8 *buffer_,
+                std::size_t size_) :
+                buffer (buffer_),
+                size (size_),
+                offset (header.Read (buffer_, size_)),
+                pixelsLeft ((std::size_t)header.extents.width * header.extents.height) {
+            if (!header.bandSizes.empty ()) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                    "Chunked (qoic) streams can't be decoded incrementally.");
+            }
+        }
+
+        template<typename PixelType>
+        void QOIDecoder::Decode (
+                PixelType *pixels,
+                std::size_t count) {
+            if (count > pixelsLeft) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Decoding %u pixels past the end of the image.",
+                    (util::ui32)(count - pixelsLeft));
+            }
+            offset += state.Decode (buffer + offset, size - offset, pixels, count);
+            pixelsLeft -= count;
+        }
+
+        template std::size_t QOIEncoder::State::Encode<ui8RGBAPixel> (
+            const ui8RGBAPixel *, std::size_t, util::ui8 *);
+        template std::size_t QOIEncoder::State::Encode<ui8BGRAPixel> (
+            const ui8BGRAPixel *, std::size_t, util::ui8 *);
+        template std::size_t QOIEncoder::State::Encode<ui8ARGBPixel> (
+            const ui8ARGBPixel *, std::size_t, util::ui8 *);
+        template std::size_t QOIEncoder::State::Encode<ui8ABGRPixel> (
+            const ui8ABGRPixel *, std::size_t, util::ui8 *);
+
+        template void QOIEncoder::Encode<ui8RGBAPixel> (
+            const ui8RGBAPixel *, std::size_t);
+        template void QOIEncoder::Encode<ui8BGRAPixel> (
+            const ui8BGRAPixel *, std::size_t);
+        template void QOIEncoder::Encode<ui8ARGBPixel> (
+            const ui8ARGBPixel *, std::size_t);
+        template void QOIEncoder::Encode<ui8ABGRPixel> (
+            const ui8ABGRPixel *, std::size_t);
+
+        template std::size_t QOIDecoder::State::Decode<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, ui8RGBAPixel *, std::size_t);
+        template std::size_t QOIDecoder::State::Decode<ui8BGRAPixel> (
+            const util::ui8 *, std::size_t, ui8BGRAPixel *, std::size_t);
+        template std::size_t QOIDecoder::State::Decode<ui8ARGBPixel> (
+            const util::ui8 *, std::size_t, ui8ARGBPixel *, std::size_t);
+        template std::size_t QOIDecoder::State::Decode<ui8ABGRPixel> (
+            const util::ui8 *, std::size_t, ui8ABGRPixel *, std::size_t);
+
+        template void QOIDecoder::Decode<ui8RGBAPixel> (
+            ui8RGBAPixel *, std::size_t);
+        template void QOIDecoder::Decode<ui8BGRAPixel> (
+            ui8BGRAPixel *, std::size_t);
+        template void QOIDecoder::Decode<ui8ARGBPixel> (
+            ui8ARGBPixel *, std::size_t);
+        template void QOIDecoder::Decode<ui8ABGRPixel> (
+            ui8ABGRPixel *, std::size_t);
+
+    } // namespace canvas
+} // namespace thekogans
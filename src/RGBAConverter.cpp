@@ -16,51 +16,56 @@
 // along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
 
 #include <cmath>
+#include <algorithm>
 #include "thekogans/util/Types.h"
 #include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/ComponentConverter.h"
 #include "thekogans/canvas/XYZAColor.h"
 #include "thekogans/canvas/HSLAColor.h"
+#include "thekogans/canvas/LabAColor.h"
+#include "thekogans/canvas/LChAColor.h"
+#include "thekogans/canvas/LabAConverter.h"
+#include "thekogans/canvas/YUVAColor.h"
+#include "thekogans/canvas/YUVAConverter.h"
 #include "thekogans/canvas/RGBAConverter.h"
 
 namespace thekogans {
     namespace canvas {
 
+        namespace {
+            // Clamp to [0, 1] and round to nearest. The f32 -> ui8 span
+            // kernels (HSLAConverter.cpp) round the same way, so the per
+            // pixel and the span paths produce the same pixels.
+            inline util::ui8 Convertf32Toui8 (util::f32 value) {
+                return (util::ui8)(std::min (std::max (value, 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+        }
+
         template<>
         ui8RGBAColor Converter<ui8RGBAColor>::Convert (const f32RGBAColor &inColor) {
             return ui8RGBAColor (
-                (typename ui8RGBAColor::ComponentType)(inColor.r * 255.0f),
-                (typename ui8RGBAColor::ComponentType)(inColor.g * 255.0f),
-                (typename ui8RGBAColor::ComponentType)(inColor.b * 255.0f),
-                (typename ui8RGBAColor::ComponentType)(inColor.a * 255.0f));
-        }
-
-        namespace {
-            inline util::ui8 Convertui16Toui8 (util::ui16 value) {
-                static const util::ui8 masks[4] = {0, 0, 1, 1};
-                return
-                    (masks[(value >> 0) & 3] << 0) |
-                    (masks[(value >> 2) & 3] << 1) |
-                    (masks[(value >> 4) & 3] << 2) |
-                    (masks[(value >> 6) & 3] << 3) |
-                    (masks[(value >> 8) & 3] << 4) |
-                    (masks[(value >> 10) & 3] << 5) |
-                    (masks[(value >> 12) & 3] << 6) |
-                    (masks[(value >> 14) & 3] << 7);
-            }
+                Convertf32Toui8 (inColor.r),
+                Convertf32Toui8 (inColor.g),
+                Convertf32Toui8 (inColor.b),
+                Convertf32Toui8 (inColor.a));
         }
 
         template<>
         ui8RGBAColor Converter<ui8RGBAColor>::Convert (const ui16RGBAColor &inColor) {
             return ui8RGBAColor (
-                Convertui16Toui8 (inColor.r),
-                Convertui16Toui8 (inColor.g),
-                Convertui16Toui8 (inColor.b),
-                Convertui16Toui8 (inColor.a));
+                ui16Toui8ScaleComponentConverter::Convert (inColor.r),
+                ui16Toui8ScaleComponentConverter::Convert (inColor.g),
+                ui16Toui8ScaleComponentConverter::Convert (inColor.b),
+                ui16Toui8ScaleComponentConverter::Convert (inColor.a));
         };
 
         template<>
         f32RGBAColor Converter<f32RGBAColor>::Convert (const ui8RGBAColor &inColor) {
-            return f32RGBAColor (inColor.r / 255.f, inColor.g, inColor.b, inColor.a);
+            return f32RGBAColor (
+                inColor.r / 255.f,
+                inColor.g / 255.f,
+                inColor.b / 255.f,
+                inColor.a / 255.f);
         }
 
         template<>
@@ -125,5 +130,40 @@ namespace thekogans {
             }
         }
 
+        template<>
+        f32RGBAColor Converter<f32RGBAColor>::Convert (const f32LabAColor &inColor) {
+            // Inverse of the fused sRGB -> Lab in LabAConverter.cpp
+            // (D65 reference white).
+            const util::f32 DELTA = 6.0f / 29.0f;
+            util::f32 fy = (inColor.l + 16.0f) / 116.0f;
+            util::f32 fx = fy + inColor.a / 500.0f;
+            util::f32 fz = fy - inColor.b / 200.0f;
+            util::f32 x = 0.95047f * (fx > DELTA ? fx * fx * fx : 3.0f * DELTA * DELTA * (fx - 4.0f / 29.0f));
+            util::f32 y = fy > DELTA ? fy * fy * fy : 3.0f * DELTA * DELTA * (fy - 4.0f / 29.0f);
+            util::f32 z = 1.08883f * (fz > DELTA ? fz * fz * fz : 3.0f * DELTA * DELTA * (fz - 4.0f / 29.0f));
+            util::f32 r = x * 3.2404542f + y * -1.5371385f + z * -0.4985314f;
+            util::f32 g = x * -0.9692660f + y * 1.8760108f + z * 0.0415560f;
+            util::f32 b = x * 0.0556434f + y * -0.2040259f + z * 1.0572252f;
+            r = r > 0.0031308f ? 1.055f * pow (r, 1.0f / 2.4f) - 0.055f : 12.92f * r;
+            g = g > 0.0031308f ? 1.055f * pow (g, 1.0f / 2.4f) - 0.055f : 12.92f * g;
+            b = b > 0.0031308f ? 1.055f * pow (b, 1.0f / 2.4f) - 0.055f : 12.92f * b;
+            return f32RGBAColor (r, g, b, inColor.alpha);
+        }
+
+        template<>
+        f32RGBAColor Converter<f32RGBAColor>::Convert (const f32LChAColor &inColor) {
+            return Convert (Converter<f32LabAColor>::Convert (inColor));
+        }
+
+        template<>
+        f32RGBAColor Converter<f32RGBAColor>::Convert (const f32YUVAColor &inColor) {
+            return DefaultYUVEncoding::ToRGBA (inColor);
+        }
+
+        template<>
+        f32RGBAColor Converter<f32RGBAColor>::Convert (const ui8YUVAColor &inColor) {
+            return DefaultYUVEncoding::ToRGBA (DefaultYUVEncoding::Normalize (inColor));
+        }
+
     } // namespace canvas
 } // namespace thekogans
@@ -15,12 +15,32 @@
 // You should have received a copy of the GNU General Public License
 // along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
 
+#include "thekogans/canvas/Config.h"
+#if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+    #include <emmintrin.h>
+#elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+    #include <arm_neon.h>
+#endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+#include <cstdio>
+#include <csetjmp>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <libyuv.h>
+#include <jpeglib.h>
 #include "thekogans/util/Heap.h"
 #include "thekogans/util/File.h"
+#include "thekogans/util/StringUtils.h"
 #include "thekogans/canvas/RGBAFramebuffer.h"
 #include "thekogans/canvas/XYZAFramebuffer.h"
 #include "thekogans/canvas/lodepng.h"
+#include "thekogans/canvas/PNGUtils.h"
 #include "thekogans/canvas/TJUtils.h"
+#include "thekogans/canvas/MappedFile.h"
+#include "thekogans/canvas/QOIUtils.h"
+#include "thekogans/canvas/Parallel.h"
 
 namespace thekogans {
     namespace canvas {
@@ -45,6 +65,11 @@ namespace thekogans {
         THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui32ABGRFramebuffer)
         THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (f32ABGRFramebuffer)
 
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui8GrayAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui16GrayAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui32GrayAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (f32GrayAFramebuffer)
+
         void foo () {
             ui8RGBAFramebuffer::SharedPtr fb1 (
                 new ui8RGBAFramebuffer (util::Rectangle::Extents (10, 10)));
@@ -56,11 +81,15 @@ namespace thekogans {
         ui8RGBAFramebuffer::SharedPtr FromPNGBuffer (
                 const util::ui8 *buffer,
                 std::size_t size) {
+            LodePNGState state;
+            lodepng_state_init (&state);
+            UseZlib (state);
             ui8RGBAPixel *array = 0;
             util::ui32 width = 0;
             util::ui32 height = 0;
-            util::ui32 error = lodepng_decode32 (
-                (util::ui8 **)&array, &width, &height, buffer, size);
+            util::ui32 error = lodepng_decode (
+                (util::ui8 **)&array, &width, &height, &state, buffer, size);
+            lodepng_state_cleanup (&state);
             if (error == 0) {
                 return ui8RGBAFramebuffer::SharedPtr (
                     new ui8RGBAFramebuffer (
@@ -69,6 +98,7 @@ namespace thekogans {
                         [] (ui8RGBAPixel *array) {free (array);}));
             }
             else {
+                free (array);
                 THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
                     "Unable to load a PNG image from buffer (%s)",
                     lodepng_error_text (error));
@@ -76,25 +106,427 @@ namespace thekogans {
         }
 
         ui8RGBAFramebuffer::SharedPtr FromPNGFile (const std::string &path) {
-            ui8RGBAPixel *array = 0;
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromPNGBuffer (file.data, file.size);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty png file: %s", path.c_str ());
+            }
+        }
+
+        namespace {
+            // lodepng color modes with and without alpha that match the
+            // memory layout of a given pixel type.
+            template<typename PixelType>
+            struct PNGPixelLayout;
+
+            template<>
+            struct PNGPixelLayout<ui8RGBAPixel> {
+                static const LodePNGColorType colorType = LCT_RGBA;
+                static const LodePNGColorType opaqueColorType = LCT_RGB;
+                static const util::ui32 bitDepth = 8;
+            };
+
+            template<>
+            struct PNGPixelLayout<ui16RGBAPixel> {
+                static const LodePNGColorType colorType = LCT_RGBA;
+                static const LodePNGColorType opaqueColorType = LCT_RGB;
+                static const util::ui32 bitDepth = 16;
+            };
+
+            template<>
+            struct PNGPixelLayout<ui8GrayAPixel> {
+                static const LodePNGColorType colorType = LCT_GREY_ALPHA;
+                static const LodePNGColorType opaqueColorType = LCT_GREY;
+                static const util::ui32 bitDepth = 8;
+            };
+
+            template<>
+            struct PNGPixelLayout<ui16GrayAPixel> {
+                static const LodePNGColorType colorType = LCT_GREY_ALPHA;
+                static const LodePNGColorType opaqueColorType = LCT_GREY;
+                static const util::ui32 bitDepth = 16;
+            };
+
+            // Add an alpha sample to count opaque (RGB or gray) pixels. The
+            // expansion is done in place, back to front, so samples must have
+            // room for count * components. Pixels matching the tRNS color key
+            // become transparent.
+            template<typename T>
+            void AddAlpha (
+                    T *samples,
+                    std::size_t count,
+                    std::size_t components,
+                    const LodePNGColorMode &color) {
+                const T *src = samples + count * (components - 1);
+                T *dst = samples + count * components;
+                const bool key = color.key_defined != 0;
+                if (components == 4) {
+                    while (count-- != 0) {
+                        src -= 3;
+                        dst -= 4;
+                        T r = src[0];
+                        T g = src[1];
+                        T b = src[2];
+                        dst[3] = key && r == color.key_r && g == color.key_g && b == color.key_b ?
+                            0 : (T)-1;
+                        dst[2] = b;
+                        dst[1] = g;
+                        dst[0] = r;
+                    }
+                }
+                else {
+                    while (count-- != 0) {
+                        src -= 1;
+                        dst -= 2;
+                        T y = src[0];
+                        dst[1] = key && y == color.key_r ? 0 : (T)-1;
+                        dst[0] = y;
+                    }
+                }
+            }
+
+            // Widen 8 bit samples to 16 bits (in place, back to front). samples
+            // must have room for count ui16s.
+            void Widen (
+                    util::ui8 *samples,
+                    std::size_t count) {
+                const util::ui8 *src = samples + count;
+                util::ui16 *dst = (util::ui16 *)samples + count;
+                while (count-- != 0) {
+                    *--dst = (util::ui16)(*--src * 257);
+                }
+            }
+
+            // Convert count 16 bit samples between big endian and host
+            // order. src may be dst and neither needs to be aligned.
+            void SwapBigEndian (
+                    const util::ui8 *src,
+                    util::ui8 *dst,
+                    std::size_t count) {
+                if (util::HostEndian == util::LittleEndian) {
+                    std::size_t i = 0;
+                #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                    for (; i + 8 <= count; i += 8, src += 16, dst += 16) {
+                        __m128i p = _mm_loadu_si128 ((const __m128i *)src);
+                        _mm_storeu_si128 ((__m128i *)dst,
+                            _mm_or_si128 (_mm_slli_epi16 (p, 8), _mm_srli_epi16 (p, 8)));
+                    }
+                #elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+                    for (; i + 8 <= count; i += 8, src += 16, dst += 16) {
+                        vst1q_u8 (dst, vrev16q_u8 (vld1q_u8 (src)));
+                    }
+                #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                    for (; i < count; ++i, src += 2, dst += 2) {
+                        util::ui8 high = src[0];
+                        dst[0] = src[1];
+                        dst[1] = high;
+                    }
+                }
+                else if (src != dst) {
+                    memcpy (dst, src, count * 2);
+                }
+            }
+
+            // Swap big endian 16 bit samples to host order (in place).
+            inline void SwapBigEndian (
+                    util::ui16 *samples,
+                    std::size_t count) {
+                SwapBigEndian ((const util::ui8 *)samples, (util::ui8 *)samples, count);
+            }
+
+            // Decode a png. If framebuffer != 0, the pixels go in to it (its
+            // extents must match the png's). Otherwise they go in to a
+            // malloc-ed array returned in array.
+            template<typename PixelType>
+            void DecodePNG (
+                    const util::ui8 *buffer,
+                    std::size_t size,
+                    Framebuffer<PixelType> *framebuffer,
+                    util::ui8 *&array,
+                    util::ui32 &width,
+                    util::ui32 &height) {
+                typedef PNGPixelLayout<PixelType> Layout;
+                typedef typename PixelType::ComponentType ComponentType;
+                const std::size_t components = sizeof (PixelType) / sizeof (ComponentType);
+                enum {
+                    None,
+                    AddAlphaPass,
+                    SwapPass,
+                    WidenPass
+                } pass = None;
+                LodePNGState state;
+                lodepng_state_init (&state);
+                UseZlib (state);
+                array = 0;
+                util::ui32 error = lodepng_inspect (&width, &height, &state, buffer, size);
+                if (error == 0) {
+                    const LodePNGColorMode &color = state.info_png.color;
+                    if (Layout::colorType == LCT_GREY_ALPHA &&
+                            color.colortype != LCT_GREY && color.colortype != LCT_GREY_ALPHA) {
+                        lodepng_state_cleanup (&state);
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                            "Unable to load a color PNG image in to a gray framebuffer.");
+                    }
+                    if (framebuffer != 0) {
+                        if (framebuffer->extents.width != width ||
+                                framebuffer->extents.height != height) {
+                            lodepng_state_cleanup (&state);
+                            THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                                "Framebuffer (%u x %u) does not match the PNG image (%u x %u).",
+                                framebuffer->extents.width, framebuffer->extents.height,
+                                width, height);
+                        }
+                        // Passes below expand the decoded samples in place.
+                        state.decoder.out_buffer = (util::ui8 *)framebuffer->buffer.array;
+                        state.decoder.out_capacity = framebuffer->buffer.length * sizeof (PixelType);
+                    }
+                    if (color.bitdepth == Layout::bitDepth &&
+                            (color.colortype == Layout::colorType ||
+                                color.colortype == Layout::opaqueColorType)) {
+                        // Native layout. Unfilter straight in to the pixels.
+                        state.decoder.color_convert = 0;
+                        state.decoder.host_endian_16 = 1;
+                        if (color.colortype == Layout::opaqueColorType) {
+                            pass = AddAlphaPass;
+                        }
+                    }
+                    else {
+                        // lodepng only converts to 16 bits for RGB(A), and upconverting
+                        // 8 bit samples is the same as widening them afterwards.
+                        state.info_raw.colortype = Layout::colorType;
+                        if (Layout::bitDepth == 16 && color.bitdepth == 16) {
+                            state.info_raw.bitdepth = 16;
+                            pass = SwapPass;
+                        }
+                        else {
+                            state.info_raw.bitdepth = 8;
+                            if (Layout::bitDepth == 16) {
+                                pass = WidenPass;
+                            }
+                        }
+                    }
+                    error = lodepng_decode (&array, &width, &height, &state, buffer, size);
+                }
+                if (error == 0) {
+                    const std::size_t count = (std::size_t)width * height;
+                    if (framebuffer == 0 && (pass == AddAlphaPass || pass == WidenPass)) {
+                        util::ui8 *expanded = (util::ui8 *)realloc (array, count * sizeof (PixelType));
+                        if (expanded != 0) {
+                            array = expanded;
+                        }
+                        else {
+                            error = 83;
+                        }
+                    }
+                    if (error == 0) {
+                        switch (pass) {
+                            case None:
+                                break;
+                            case AddAlphaPass:
+                                AddAlpha ((ComponentType *)array, count, components, state.info_png.color);
+                                break;
+                            case SwapPass:
+                                SwapBigEndian ((util::ui16 *)array, count * components);
+                                break;
+                            case WidenPass:
+                                Widen (array, count * components);
+                                break;
+                        }
+                    }
+                }
+                lodepng_state_cleanup (&state);
+                if (error != 0) {
+                    if (framebuffer == 0) {
+                        free (array);
+                    }
+                    array = 0;
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Unable to load a PNG image from buffer (%s)",
+                        lodepng_error_text (error));
+                }
+            }
+        }
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size) {
+            util::ui8 *array = 0;
+            util::ui32 width = 0;
+            util::ui32 height = 0;
+            DecodePNG<PixelType> (buffer, size, 0, array, width, height);
+            return typename Framebuffer<PixelType>::SharedPtr (
+                new Framebuffer<PixelType> (
+                    util::Rectangle::Extents (width, height),
+                    (PixelType *)array,
+                    [] (PixelType *array) {free (array);}));
+        }
+
+        template<typename PixelType>
+        void FromPNGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                Framebuffer<PixelType> &framebuffer) {
+            util::ui8 *array = 0;
             util::ui32 width = 0;
             util::ui32 height = 0;
-            util::ui32 error = lodepng_decode32_file (
-                (util::ui8 **)&array, &width, &height, path.c_str ());
+            DecodePNG<PixelType> (buffer, size, &framebuffer, array, width, height);
+        }
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNGFile (const std::string &path) {
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromPNGBuffer<PixelType> (file.data, file.size);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty png file: %s", path.c_str ());
+            }
+        }
+
+        template ui8RGBAFramebuffer::SharedPtr FromPNGBuffer<ui8RGBAPixel> (
+            const util::ui8 *buffer,
+            std::size_t size);
+        template ui16RGBAFramebuffer::SharedPtr FromPNGBuffer<ui16RGBAPixel> (
+            const util::ui8 *buffer,
+            std::size_t size);
+        template ui8GrayAFramebuffer::SharedPtr FromPNGBuffer<ui8GrayAPixel> (
+            const util::ui8 *buffer,
+            std::size_t size);
+        template ui16GrayAFramebuffer::SharedPtr FromPNGBuffer<ui16GrayAPixel> (
+            const util::ui8 *buffer,
+            std::size_t size);
+
+        template ui8RGBAFramebuffer::SharedPtr FromPNGFile<ui8RGBAPixel> (const std::string &path);
+        template ui16RGBAFramebuffer::SharedPtr FromPNGFile<ui16RGBAPixel> (const std::string &path);
+        template ui8GrayAFramebuffer::SharedPtr FromPNGFile<ui8GrayAPixel> (const std::string &path);
+        template ui16GrayAFramebuffer::SharedPtr FromPNGFile<ui16GrayAPixel> (const std::string &path);
+
+        template void FromPNGBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, ui8RGBAFramebuffer &);
+        template void FromPNGBuffer<ui16RGBAPixel> (
+            const util::ui8 *, std::size_t, ui16RGBAFramebuffer &);
+        template void FromPNGBuffer<ui8GrayAPixel> (
+            const util::ui8 *, std::size_t, ui8GrayAFramebuffer &);
+        template void FromPNGBuffer<ui16GrayAPixel> (
+            const util::ui8 *, std::size_t, ui16GrayAFramebuffer &);
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                const FramebufferAllocator &allocator) {
+            typename Framebuffer<PixelType>::SharedPtr framebuffer =
+                allocator.Allocate<PixelType> (ProbeImage (buffer, size).extents);
+            FromPNGBuffer (buffer, size, *framebuffer);
+            return framebuffer;
+        }
+
+        template ui8RGBAFramebuffer::SharedPtr FromPNGBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+        template ui16RGBAFramebuffer::SharedPtr FromPNGBuffer<ui16RGBAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+        template ui8GrayAFramebuffer::SharedPtr FromPNGBuffer<ui8GrayAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+        template ui16GrayAFramebuffer::SharedPtr FromPNGBuffer<ui16GrayAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+
+        template<typename PixelType>
+        void ToPNGBuffer (
+                const Framebuffer<PixelType> &framebuffer,
+                std::vector<util::ui8> &buffer,
+                PNGProfile profile,
+                util::ui32 threads) {
+            typedef PNGPixelLayout<PixelType> Layout;
+            typedef typename PixelType::ComponentType ComponentType;
+            const std::size_t components = sizeof (PixelType) / sizeof (ComponentType);
+            LodePNGState state;
+            lodepng_state_init (&state);
+            UseZlib (state);
+            state.info_raw.colortype = Layout::colorType;
+            state.info_raw.bitdepth = Layout::bitDepth;
+            state.info_png.color.colortype = Layout::colorType;
+            state.info_png.color.bitdepth = Layout::bitDepth;
+            ZlibCompressContext context;
+            context.threads = threads;
+            std::vector<util::ui8> filters;
+            if (profile == PNGProfileFast) {
+                const util::ui8 FILTER_UP = 2;
+                filters.assign (framebuffer.extents.height, FILTER_UP);
+                state.encoder.auto_convert = LAC_NO;
+                state.encoder.filter_palette_zero = 0;
+                state.encoder.filter_strategy = LFS_PREDEFINED;
+                state.encoder.predefined_filters = filters.data ();
+                context.level = 1;
+            }
+            state.encoder.zlibsettings.custom_context = &context;
+            // png samples are big endian.
+            const util::ui8 *pixels = (const util::ui8 *)framebuffer.buffer.array;
+            std::vector<util::ui16> swapped;
+            if (Layout::bitDepth == 16 && util::HostEndian == util::LittleEndian) {
+                swapped.resize (framebuffer.buffer.length * components);
+                SwapBigEndian (
+                    (const util::ui8 *)framebuffer.buffer.array,
+                    (util::ui8 *)swapped.data (),
+                    swapped.size ());
+                pixels = (const util::ui8 *)swapped.data ();
+            }
+            util::ui8 *png = 0;
+            std::size_t size = 0;
+            util::ui32 error = lodepng_encode (
+                &png,
+                &size,
+                pixels,
+                framebuffer.extents.width,
+                framebuffer.extents.height,
+                &state);
+            lodepng_state_cleanup (&state);
             if (error == 0) {
-                return ui8RGBAFramebuffer::SharedPtr (
-                    new ui8RGBAFramebuffer (
-                        util::Rectangle::Extents (width, height),
-                        array,
-                        [] (ui8RGBAPixel *array) {free (array);}));
+                buffer.assign (png, png + size);
+                free (png);
             }
             else {
+                free (png);
                 THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
-                    "Unable to load a PNG image from %s (%s)",
-                    path.c_str (), lodepng_error_text (error));
+                    "Unable to save a PNG image to buffer (%s)",
+                    lodepng_error_text (error));
             }
         }
 
+        template<typename PixelType>
+        void ToPNGFile (
+                const Framebuffer<PixelType> &framebuffer,
+                const std::string &path,
+                PNGProfile profile,
+                util::ui32 threads) {
+            std::vector<util::ui8> buffer;
+            ToPNGBuffer (framebuffer, buffer, profile, threads);
+            util::File file (util::HostEndian, path);
+            file.Write (buffer.data (), buffer.size ());
+        }
+
+        template void ToPNGBuffer<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, std::vector<util::ui8> &, PNGProfile, util::ui32);
+        template void ToPNGBuffer<ui16RGBAPixel> (
+            const ui16RGBAFramebuffer &, std::vector<util::ui8> &, PNGProfile, util::ui32);
+        template void ToPNGBuffer<ui8GrayAPixel> (
+            const ui8GrayAFramebuffer &, std::vector<util::ui8> &, PNGProfile, util::ui32);
+        template void ToPNGBuffer<ui16GrayAPixel> (
+            const ui16GrayAFramebuffer &, std::vector<util::ui8> &, PNGProfile, util::ui32);
+
+        template void ToPNGFile<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, const std::string &, PNGProfile, util::ui32);
+        template void ToPNGFile<ui16RGBAPixel> (
+            const ui16RGBAFramebuffer &, const std::string &, PNGProfile, util::ui32);
+        template void ToPNGFile<ui8GrayAPixel> (
+            const ui8GrayAFramebuffer &, const std::string &, PNGProfile, util::ui32);
+        template void ToPNGFile<ui16GrayAPixel> (
+            const ui16GrayAFramebuffer &, const std::string &, PNGProfile, util::ui32);
+
         ui8RGBAFramebuffer::SharedPtr FromJPGBuffer (
                 const util::ui8 *buffer,
                 std::size_t size) {
@@ -116,7 +548,7 @@ namespace thekogans {
                         (util::ui8 *)buffer,
                         size,
                         (util::ui8 *)framebuffer->buffer.array,
-                        width, width * util::UI8_SIZE,
+                        width, width * sizeof (ui8RGBAPixel),
                         height,
                         TJPF_RGBX,
                         0) == 0) {
@@ -134,12 +566,9 @@ namespace thekogans {
         }
 
         ui8RGBAFramebuffer::SharedPtr FromJPGFile (const std::string &path) {
-            util::ReadOnlyFile file (util::HostEndian, path);
-            util::ui64 size = file.GetSize ();
-            if (size > 0) {
-                std::vector<util::ui8> buffer (size);
-                file.Read (buffer.data (), size);
-                return FromJPGBuffer (buffer.data (), size);
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromJPGBuffer (file.data, file.size);
             }
             else {
                 THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
@@ -147,8 +576,340 @@ namespace thekogans {
             }
         }
 
+        template<typename PixelType>
+        void FromJPGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                Framebuffer<PixelType> &framebuffer) {
+            TJDecompressHandle handle;
+            int width;
+            int height;
+            int jpegSubsamp;
+            if (tjDecompressHeader2 (
+                    handle.handle,
+                    (util::ui8 *)buffer,
+                    size,
+                    &width,
+                    &height,
+                    &jpegSubsamp) == 0) {
+                if ((util::ui32)width != framebuffer.extents.width ||
+                        (util::ui32)height != framebuffer.extents.height) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Framebuffer (%u x %u) does not match the JPG image (%d x %d).",
+                        framebuffer.extents.width, framebuffer.extents.height,
+                        width, height);
+                }
+                if (tjDecompress2 (
+                        handle.handle,
+                        (util::ui8 *)buffer,
+                        size,
+                        (util::ui8 *)framebuffer.buffer.array,
+                        width, width * sizeof (PixelType),
+                        height,
+                        TJPixelFormat<PixelType>::Value,
+                        0) != 0) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "%s", tjGetErrorStr ());
+                }
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "%s", tjGetErrorStr ());
+            }
+        }
+
+        template void FromJPGBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, ui8RGBAFramebuffer &);
+        template void FromJPGBuffer<ui8BGRAPixel> (
+            const util::ui8 *, std::size_t, ui8BGRAFramebuffer &);
+        template void FromJPGBuffer<ui8ARGBPixel> (
+            const util::ui8 *, std::size_t, ui8ARGBFramebuffer &);
+        template void FromJPGBuffer<ui8ABGRPixel> (
+            const util::ui8 *, std::size_t, ui8ABGRFramebuffer &);
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromJPGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                const FramebufferAllocator &allocator) {
+            typename Framebuffer<PixelType>::SharedPtr framebuffer =
+                allocator.Allocate<PixelType> (ProbeImage (buffer, size).extents);
+            FromJPGBuffer (buffer, size, *framebuffer);
+            return framebuffer;
+        }
+
+        template ui8RGBAFramebuffer::SharedPtr FromJPGBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+        template ui8BGRAFramebuffer::SharedPtr FromJPGBuffer<ui8BGRAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+        template ui8ARGBFramebuffer::SharedPtr FromJPGBuffer<ui8ARGBPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+        template ui8ABGRFramebuffer::SharedPtr FromJPGBuffer<ui8ABGRPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+
+        namespace {
+            tjscalingfactor GetScalingFactor (
+                    int width,
+                    int height,
+                    const util::Rectangle::Extents &targetExtents) {
+                tjscalingfactor best = {1, 1};
+                int count = 0;
+                const tjscalingfactor *scalingFactors = tjGetScalingFactors (&count);
+                if (scalingFactors != 0) {
+                    for (int i = 0; i < count; ++i) {
+                        const tjscalingfactor &scalingFactor = scalingFactors[i];
+                        // Only downscale, and never below the target.
+                        if (scalingFactor.num <= scalingFactor.denom &&
+                                TJSCALED (width, scalingFactor) >= (int)targetExtents.width &&
+                                TJSCALED (height, scalingFactor) >= (int)targetExtents.height &&
+                                scalingFactor.num * best.denom < best.num * scalingFactor.denom) {
+                            best = scalingFactor;
+                        }
+                    }
+                }
+                return best;
+            }
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromJPGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                const util::Rectangle::Extents &targetExtents,
+                bool exact) {
+            TJDecompressHandle handle;
+            int width;
+            int height;
+            int jpegSubsamp;
+            if (tjDecompressHeader2 (
+                    handle.handle,
+                    (util::ui8 *)buffer,
+                    size,
+                    &width,
+                    &height,
+                    &jpegSubsamp) == 0) {
+                tjscalingfactor scalingFactor =
+                    GetScalingFactor (width, height, targetExtents);
+                int scaledWidth = TJSCALED (width, scalingFactor);
+                int scaledHeight = TJSCALED (height, scalingFactor);
+                ui8RGBAFramebuffer::SharedPtr framebuffer (
+                    new ui8RGBAFramebuffer (util::Rectangle::Extents (scaledWidth, scaledHeight)));
+                if (tjDecompress2 (
+                        handle.handle,
+                        (util::ui8 *)buffer,
+                        size,
+                        (util::ui8 *)framebuffer->buffer.array,
+                        scaledWidth, scaledWidth * sizeof (ui8RGBAPixel),
+                        scaledHeight,
+                        TJPF_RGBX,
+                        0) == 0) {
+                    if (exact && framebuffer->extents != targetExtents &&
+                            targetExtents.width > 0 && targetExtents.height > 0) {
+                        ui8RGBAFramebuffer::SharedPtr scaled (
+                            new ui8RGBAFramebuffer (targetExtents));
+                        // ARGBScale doesn't care about the channel order.
+                        libyuv::ARGBScale (
+                            (const util::ui8 *)framebuffer->buffer.array,
+                            scaledWidth * sizeof (ui8RGBAPixel),
+                            scaledWidth, scaledHeight,
+                            (util::ui8 *)scaled->buffer.array,
+                            targetExtents.width * sizeof (ui8RGBAPixel),
+                            targetExtents.width, targetExtents.height,
+                            libyuv::kFilterBox);
+                        return scaled;
+                    }
+                    return framebuffer;
+                }
+                else {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "%s", tjGetErrorStr ());
+                }
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "%s", tjGetErrorStr ());
+            }
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromJPGFile (
+                const std::string &path,
+                const util::Rectangle::Extents &targetExtents,
+                bool exact) {
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromJPGBuffer (file.data, file.size, targetExtents, exact);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty jpg file: %s", path.c_str ());
+            }
+        }
+
+        namespace {
+            // libjpeg reports errors by calling error_exit which is not
+            // supposed to return. Jump back to the caller instead of
+            // letting it exit the process.
+            struct ErrorManager {
+                jpeg_error_mgr manager;
+                jmp_buf jmpBuf;
+                char message[JMSG_LENGTH_MAX];
+            };
+
+            void ErrorExit (j_common_ptr cinfo) {
+                ErrorManager *errorManager = (ErrorManager *)cinfo->err;
+                (*cinfo->err->format_message) (cinfo, errorManager->message);
+                longjmp (errorManager->jmpBuf, 1);
+            }
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromJPGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                const util::Rectangle &region) {
+            jpeg_decompress_struct cinfo;
+            ErrorManager errorManager;
+            cinfo.err = jpeg_std_error (&errorManager.manager);
+            errorManager.manager.error_exit = ErrorExit;
+            // Everything with a dtor is declared before setjmp.
+            // longjmp would skip the dtors of anything declared after.
+            ui8RGBAFramebuffer::SharedPtr framebuffer;
+            std::vector<util::ui8> row;
+            if (setjmp (errorManager.jmpBuf) != 0) {
+                jpeg_destroy_decompress (&cinfo);
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Unable to decode a JPEG region (%s)", errorManager.message);
+            }
+            jpeg_create_decompress (&cinfo);
+            jpeg_mem_src (&cinfo, (util::ui8 *)buffer, (unsigned long)size);
+            jpeg_read_header (&cinfo, TRUE);
+            util::i32 left = std::max (region.origin.x, 0);
+            util::i32 top = std::max (region.origin.y, 0);
+            util::i32 right = std::min (
+                region.origin.x + (util::i32)region.extents.width,
+                (util::i32)cinfo.image_width);
+            util::i32 bottom = std::min (
+                region.origin.y + (util::i32)region.extents.height,
+                (util::i32)cinfo.image_height);
+            if (left >= right || top >= bottom) {
+                jpeg_destroy_decompress (&cinfo);
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Region (%d, %d, %u, %u) is outside the %u x %u image.",
+                    region.origin.x, region.origin.y,
+                    region.extents.width, region.extents.height,
+                    cinfo.image_width, cinfo.image_height);
+            }
+            cinfo.out_color_space = JCS_EXT_RGBX;
+            jpeg_start_decompress (&cinfo);
+            // jpeg_crop_scanline moves xoffset left to the nearest iMCU
+            // boundary and widens width to match.
+            JDIMENSION xoffset = left;
+            JDIMENSION width = right - left;
+            jpeg_crop_scanline (&cinfo, &xoffset, &width);
+            if (top > 0) {
+                jpeg_skip_scanlines (&cinfo, top);
+            }
+            framebuffer.Reset (
+                new ui8RGBAFramebuffer (util::Rectangle::Extents (right - left, bottom - top)));
+            row.resize ((std::size_t)cinfo.output_width * cinfo.output_components);
+            JSAMPROW scanline = row.data ();
+            const util::ui8 *src = row.data () +
+                (std::size_t)(left - xoffset) * sizeof (ui8RGBAPixel);
+            ui8RGBAPixel *dst = framebuffer->buffer.array;
+            for (util::i32 y = top; y < bottom; ++y) {
+                jpeg_read_scanlines (&cinfo, &scanline, 1);
+                memcpy (dst, src, framebuffer->extents.width * sizeof (ui8RGBAPixel));
+                dst += framebuffer->extents.width;
+            }
+            // Whatever is left below the region is never decoded.
+            jpeg_abort_decompress (&cinfo);
+            jpeg_destroy_decompress (&cinfo);
+            return framebuffer;
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromJPGFile (
+                const std::string &path,
+                const util::Rectangle &region) {
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromJPGBuffer (file.data, file.size, region);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty jpg file: %s", path.c_str ());
+            }
+        }
+
+        template<typename PixelType>
+        void ToJPGBuffer (
+                const Framebuffer<PixelType> &framebuffer,
+                TJBuffer &buffer,
+                util::ui32 quality,
+                util::i32 subsamp) {
+            buffer.Reserve (framebuffer.extents.width, framebuffer.extents.height, subsamp);
+            TJCompressHandle handle;
+            util::ui8 *ptr = buffer.data;
+            unsigned long size = (unsigned long)buffer.capacity;
+            if (tjCompress2 (
+                    handle.handle,
+                    (const util::ui8 *)framebuffer.buffer.array,
+                    framebuffer.extents.width,
+                    framebuffer.extents.width * sizeof (PixelType),
+                    framebuffer.extents.height,
+                    TJPixelFormat<PixelType>::Value,
+                    &ptr,
+                    &size,
+                    subsamp,
+                    quality,
+                    TJFLAG_NOREALLOC) == 0) {
+                buffer.size = size;
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "%s", tjGetErrorStr ());
+            }
+        }
+
+        template<typename PixelType>
+        void ToJPGFile (
+                const Framebuffer<PixelType> &framebuffer,
+                const std::string &path,
+                util::ui32 quality,
+                util::i32 subsamp) {
+            TJBuffer buffer;
+            ToJPGBuffer (framebuffer, buffer, quality, subsamp);
+            util::File file (util::HostEndian, path);
+            file.Write (buffer.data, buffer.size);
+        }
+
+        template void ToJPGBuffer<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, TJBuffer &, util::ui32, util::i32);
+        template void ToJPGBuffer<ui8BGRAPixel> (
+            const ui8BGRAFramebuffer &, TJBuffer &, util::ui32, util::i32);
+        template void ToJPGBuffer<ui8ARGBPixel> (
+            const ui8ARGBFramebuffer &, TJBuffer &, util::ui32, util::i32);
+        template void ToJPGBuffer<ui8ABGRPixel> (
+            const ui8ABGRFramebuffer &, TJBuffer &, util::ui32, util::i32);
+
+        template void ToJPGFile<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, const std::string &, util::ui32, util::i32);
+        template void ToJPGFile<ui8BGRAPixel> (
+            const ui8BGRAFramebuffer &, const std::string &, util::ui32, util::i32);
+        template void ToJPGFile<ui8ARGBPixel> (
+            const ui8ARGBFramebuffer &, const std::string &, util::ui32, util::i32);
+        template void ToJPGFile<ui8ABGRPixel> (
+            const ui8ABGRFramebuffer &, const std::string &, util::ui32, util::i32);
+
         namespace {
             const util::i16 BMP_TYPE = 0x4d42;
+            // Serialized FileHeader size (the struct is padded).
+            const std::size_t FILE_HEADER_SIZE = 14;
+            // biCompression values we understand.
+            const util::i32 BI_RGB = 0;
+            const util::i32 BI_BITFIELDS = 3;
+            // BITMAPV3INFOHEADER and up carry an alpha mask.
+            const util::i32 ALPHA_MASK_INFO_HEADER_SIZE = 56;
+            // Same limit as QOI and PNM. Protects against headers that
+            // would have us allocate absurd framebuffers.
+            const util::ui64 BMP_MAX_PIXELS = 400000000;
 
             struct FileHeader {
                 util::i16 bfType;
@@ -221,59 +982,1322 @@ namespace thekogans {
                     infoHeader.biClrImportant;
                 return buffer;
             }
+
+            inline util::Buffer &operator << (
+                    util::Buffer &buffer,
+                    const FileHeader &fileHeader) {
+                buffer <<
+                    fileHeader.bfType <<
+                    fileHeader.bfSize <<
+                    fileHeader.bfReserved1 <<
+                    fileHeader.bfReserved2 <<
+                    fileHeader.bfOffBits;
+                return buffer;
+            }
+
+            inline util::Buffer &operator << (
+                    util::Buffer &buffer,
+                    const InfoHeader &infoHeader) {
+                buffer <<
+                    infoHeader.biSize <<
+                    infoHeader.biWidth <<
+                    infoHeader.biHeight <<
+                    infoHeader.biPlanes <<
+                    infoHeader.biBitCount <<
+                    infoHeader.biCompression <<
+                    infoHeader.biSizeImage <<
+                    infoHeader.biXPelsPerMeter <<
+                    infoHeader.biYPelsPerMeter <<
+                    infoHeader.biClrUsed <<
+                    infoHeader.biClrImportant;
+                return buffer;
+            }
+
+            // Bmp rows are BGR(A). Pixel types we read and write directly
+            // and whether their red and blue need swapping.
+            template<typename PixelType>
+            struct BMPPixelLayout;
+
+            template<>
+            struct BMPPixelLayout<ui8RGBAPixel> {
+                static const bool SwapRB = true;
+            };
+
+            template<>
+            struct BMPPixelLayout<ui8BGRAPixel> {
+                static const bool SwapRB = false;
+            };
+
+            // Rows are at least 4 byte aligned.
+            inline std::size_t GetBMPStride (
+                    util::ui32 width,
+                    util::ui32 bitCount) {
+                return ((std::size_t)width * bitCount + 31) / 32 * 4;
+            }
+
+            // Expand count BGR pixels to BGRA (or RGBA if SwapRB), alpha = 255.
+            template<bool SwapRB>
+            void ExpandBGR (
+                    const util::ui8 *src,
+                    util::ui8 *dst,
+                    std::size_t count) {
+                std::size_t i = 0;
+            #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                // 4 pixels at a time. Every load reads 16 bytes (4 past
+                // the 4 pixels) so stop 6 pixels short of the end.
+                const __m128i alpha = _mm_set1_epi32 ((int)0xff000000);
+                const __m128i g = _mm_set1_epi32 (0x0000ff00);
+                const __m128i low = _mm_set1_epi32 (0x000000ff);
+                for (; i + 6 <= count; i += 4, src += 12, dst += 16) {
+                    __m128i p0 = _mm_loadu_si128 ((const __m128i *)src);
+                    __m128i p = _mm_unpacklo_epi64 (
+                        _mm_unpacklo_epi32 (p0, _mm_srli_si128 (p0, 3)),
+                        _mm_unpacklo_epi32 (_mm_srli_si128 (p0, 6), _mm_srli_si128 (p0, 9)));
+                    if (SwapRB) {
+                        p = _mm_or_si128 (
+                            _mm_or_si128 (_mm_and_si128 (p, g), alpha),
+                            _mm_or_si128 (
+                                _mm_and_si128 (_mm_srli_epi32 (p, 16), low),
+                                _mm_slli_epi32 (_mm_and_si128 (p, low), 16)));
+                    }
+                    else {
+                        p = _mm_or_si128 (p, alpha);
+                    }
+                    _mm_storeu_si128 ((__m128i *)dst, p);
+                }
+            #elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+                const uint8x16_t alpha = vdupq_n_u8 (0xff);
+                for (; i + 16 <= count; i += 16, src += 48, dst += 64) {
+                    uint8x16x3_t bgr = vld3q_u8 (src);
+                    uint8x16x4_t p;
+                    p.val[0] = bgr.val[SwapRB ? 2 : 0];
+                    p.val[1] = bgr.val[1];
+                    p.val[2] = bgr.val[SwapRB ? 0 : 2];
+                    p.val[3] = alpha;
+                    vst4q_u8 (dst, p);
+                }
+            #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                for (; i < count; ++i, src += 3, dst += 4) {
+                    dst[0] = src[SwapRB ? 2 : 0];
+                    dst[1] = src[1];
+                    dst[2] = src[SwapRB ? 0 : 2];
+                    dst[3] = 255;
+                }
+            }
+
+            // Copy count BGRA pixels to BGRA (or RGBA if SwapRB), or'ing
+            // alpha in to their alpha. Swapping red and blue is its own
+            // inverse so this goes both ways.
+            template<bool SwapRB>
+            void CopyBGRA (
+                    const util::ui8 *src,
+                    util::ui8 *dst,
+                    std::size_t count,
+                    util::ui8 alpha) {
+                if (!SwapRB && alpha == 0) {
+                    memcpy (dst, src, count * 4);
+                    return;
+                }
+                std::size_t i = 0;
+            #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                const __m128i alpha_ = _mm_set1_epi32 ((int)((util::ui32)alpha << 24));
+                const __m128i ga = _mm_set1_epi32 ((int)0xff00ff00);
+                const __m128i low = _mm_set1_epi32 (0x000000ff);
+                for (; i + 4 <= count; i += 4, src += 16, dst += 16) {
+                    __m128i p = _mm_loadu_si128 ((const __m128i *)src);
+                    if (SwapRB) {
+                        p = _mm_or_si128 (
+                            _mm_and_si128 (p, ga),
+                            _mm_or_si128 (
+                                _mm_and_si128 (_mm_srli_epi32 (p, 16), low),
+                                _mm_slli_epi32 (_mm_and_si128 (p, low), 16)));
+                    }
+                    _mm_storeu_si128 ((__m128i *)dst, _mm_or_si128 (p, alpha_));
+                }
+            #elif defined (THEKOGANS_CANVAS_HAVE_NEON)
+                const uint8x16_t alpha_ = vdupq_n_u8 (alpha);
+                for (; i + 16 <= count; i += 16, src += 64, dst += 64) {
+                    uint8x16x4_t p = vld4q_u8 (src);
+                    if (SwapRB) {
+                        uint8x16_t b = p.val[0];
+                        p.val[0] = p.val[2];
+                        p.val[2] = b;
+                    }
+                    p.val[3] = vorrq_u8 (p.val[3], alpha_);
+                    vst4q_u8 (dst, p);
+                }
+            #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                for (; i < count; ++i, src += 4, dst += 4) {
+                    util::ui8 b = src[0];
+                    dst[0] = src[SwapRB ? 2 : 0];
+                    dst[1] = src[1];
+                    dst[2] = SwapRB ? b : src[2];
+                    dst[3] = src[3] | alpha;
+                }
+            }
+
+            // Pack count BGRA (or RGBA if SwapRB) pixels to BGR.
+            template<bool SwapRB>
+            void PackBGR (
+                    const util::ui8 *src,
+                    util::ui8 *dst,
+                    std::size_t count) {
+                std::size_t i = 0;
+            #if defined (THEKOGANS_CANVAS_HAVE_NEON)
+                for (; i + 16 <= count; i += 16, src += 64, dst += 48) {
+                    uint8x16x4_t p = vld4q_u8 (src);
+                    uint8x16x3_t bgr;
+                    bgr.val[0] = p.val[SwapRB ? 2 : 0];
+                    bgr.val[1] = p.val[1];
+                    bgr.val[2] = p.val[SwapRB ? 0 : 2];
+                    vst3q_u8 (dst, bgr);
+                }
+            #endif // defined (THEKOGANS_CANVAS_HAVE_NEON)
+                for (; i < count; ++i, src += 4, dst += 3) {
+                    dst[0] = src[SwapRB ? 2 : 0];
+                    dst[1] = src[1];
+                    dst[2] = src[SwapRB ? 0 : 2];
+                }
+            }
+
+            // 32 bpp BI_RGB alpha is officially reserved and most writers
+            // leave it 0. Stop at the first pixel with a non zero alpha.
+            bool HasAlpha (
+                    const util::ui8 *src,
+                    std::ptrdiff_t stride,
+                    util::ui32 width,
+                    util::ui32 height) {
+                for (util::ui32 y = 0; y < height; ++y, src += stride) {
+                    for (util::ui32 x = 0; x < width; ++x) {
+                        if (src[x * 4 + 3] != 0) {
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            // Parsed bmp headers.
+            struct BMPHeader {
+                FileHeader fileHeader;
+                InfoHeader infoHeader;
+                // BI_BITFIELDS masks (0 if not present).
+                util::ui32 redMask;
+                util::ui32 greenMask;
+                util::ui32 blueMask;
+                util::ui32 alphaMask;
+                util::ui32 width;
+                // |biHeight|, negative means top-down rows.
+                util::ui32 height;
+                // Bytes per (padded) row.
+                std::size_t stride;
+
+                BMPHeader () :
+                    redMask (0),
+                    greenMask (0),
+                    blueMask (0),
+                    alphaMask (0),
+                    width (0),
+                    height (0),
+                    stride (0) {}
+            };
+
+            // Parse and validate the bmp headers at the beginning of buffer.
+            // Called by ProbeImage and the decoders before they allocate
+            // anything. For uncompressed images it also checks that the
+            // raster fits in size.
+            BMPHeader ReadBMPHeader (
+                    const util::ui8 *buffer,
+                    std::size_t size) {
+                BMPHeader header;
+                if (size >= FILE_HEADER_SIZE + sizeof (InfoHeader)) {
+                    util::TenantReadBuffer buffer_ (util::LittleEndian, buffer, size);
+                    buffer_ >> header.fileHeader >> header.infoHeader;
+                    // The masks follow a BITMAPINFOHEADER and are the first
+                    // thing after it in the bigger (V2-V5) headers.
+                    if (header.infoHeader.biCompression == BI_BITFIELDS &&
+                            buffer_.GetDataAvailableForReading () >= 4 * util::UI32_SIZE) {
+                        buffer_ >> header.redMask >> header.greenMask >> header.blueMask;
+                        if (header.infoHeader.biSize >= ALPHA_MASK_INFO_HEADER_SIZE) {
+                            buffer_ >> header.alphaMask;
+                        }
+                    }
+                }
+                const FileHeader &fileHeader = header.fileHeader;
+                const InfoHeader &infoHeader = header.infoHeader;
+                // Negate in i64, -INT_MIN does not fit in an i32.
+                util::i64 height = infoHeader.biHeight < 0 ?
+                    -(util::i64)infoHeader.biHeight : infoHeader.biHeight;
+                util::i16 bitCount = infoHeader.biBitCount;
+                if (fileHeader.bfType != BMP_TYPE ||
+                        infoHeader.biSize < (util::i32)sizeof (InfoHeader) ||
+                        infoHeader.biWidth <= 0 || height == 0 ||
+                        (util::ui64)infoHeader.biWidth * (util::ui64)height > BMP_MAX_PIXELS ||
+                        infoHeader.biPlanes != 1 ||
+                        (bitCount != 1 && bitCount != 4 && bitCount != 8 &&
+                            bitCount != 16 && bitCount != 24 && bitCount != 32)) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Invalid bmp header (%d x %d, %d bpp).",
+                        infoHeader.biWidth,
+                        infoHeader.biHeight,
+                        infoHeader.biBitCount);
+                }
+                header.width = infoHeader.biWidth;
+                header.height = (util::ui32)height;
+                header.stride = GetBMPStride (header.width, bitCount);
+                // Compressed (RLE, JPEG, PNG) rasters are smaller than
+                // stride * height, their size can't be checked here.
+                if ((infoHeader.biCompression == BI_RGB ||
+                            infoHeader.biCompression == BI_BITFIELDS) &&
+                        (fileHeader.bfOffBits < 0 ||
+                            (std::size_t)fileHeader.bfOffBits > size ||
+                            (size - fileHeader.bfOffBits) / header.stride < header.height)) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Truncated bmp (%u x %u, %u bytes).",
+                        header.width, header.height, (util::ui32)size);
+                }
+                return header;
+            }
+        }
+
+        template<typename PixelType>
+        void FromBMPBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                Framebuffer<PixelType> &framebuffer) {
+            BMPHeader header = ReadBMPHeader (buffer, size);
+            const InfoHeader &infoHeader = header.infoHeader;
+            // We read the uncompressed true color subset:
+            // - 24 bpp
+            // - 32 bpp, BI_RGB or BI_BITFIELDS with the BGRA masks
+            // - bottom-up (positive height) or top-down (negative height) rows
+            bool bitFields = infoHeader.biCompression == BI_BITFIELDS &&
+                infoHeader.biBitCount == 32 &&
+                header.redMask == 0x00ff0000 &&
+                header.greenMask == 0x0000ff00 &&
+                header.blueMask == 0x000000ff &&
+                (header.alphaMask == 0 || header.alphaMask == 0xff000000);
+            if ((infoHeader.biCompression == BI_RGB &&
+                        (infoHeader.biBitCount == 24 || infoHeader.biBitCount == 32)) ||
+                    bitFields) {
+                util::ui32 width = header.width;
+                util::ui32 height = header.height;
+                if (framebuffer.extents.width != width ||
+                        framebuffer.extents.height != height) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Framebuffer (%u x %u) does not match the BMP image (%u x %u).",
+                        framebuffer.extents.width, framebuffer.extents.height,
+                        width, height);
+                }
+                std::size_t stride = header.stride;
+                // Decode straight out of the caller's buffer one row at a
+                // time, walking bottom-up images backwards.
+                const util::ui8 *src = buffer + header.fileHeader.bfOffBits;
+                std::ptrdiff_t srcStride = stride;
+                if (infoHeader.biHeight > 0) {
+                    src += (height - 1) * stride;
+                    srcStride = -srcStride;
+                }
+                util::ui8 *dst = (util::ui8 *)framebuffer.buffer.array;
+                std::size_t dstStride = width * sizeof (PixelType);
+                if (infoHeader.biBitCount == 24) {
+                    for (util::ui32 y = 0; y < height; ++y, src += srcStride, dst += dstStride) {
+                        ExpandBGR<BMPPixelLayout<PixelType>::SwapRB> (src, dst, width);
+                    }
+                }
+                else {
+                    util::ui8 alpha = (bitFields ? header.alphaMask != 0 :
+                        HasAlpha (src, srcStride, width, height)) ? 0 : 255;
+                    for (util::ui32 y = 0; y < height; ++y, src += srcStride, dst += dstStride) {
+                        CopyBGRA<BMPPixelLayout<PixelType>::SwapRB> (src, dst, width, alpha);
+                    }
+                }
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Unsupported bmp file format (%d x %d, %d bpp, compression %d).",
+                    infoHeader.biWidth,
+                    infoHeader.biHeight,
+                    infoHeader.biBitCount,
+                    infoHeader.biCompression);
+            }
         }
 
+        template void FromBMPBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, ui8RGBAFramebuffer &);
+        template void FromBMPBuffer<ui8BGRAPixel> (
+            const util::ui8 *, std::size_t, ui8BGRAFramebuffer &);
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromBMPBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                const FramebufferAllocator &allocator) {
+            BMPHeader header = ReadBMPHeader (buffer, size);
+            typename Framebuffer<PixelType>::SharedPtr framebuffer =
+                allocator.Allocate<PixelType> (
+                    util::Rectangle::Extents (header.width, header.height));
+            FromBMPBuffer (buffer, size, *framebuffer);
+            return framebuffer;
+        }
+
+        template ui8RGBAFramebuffer::SharedPtr FromBMPBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+        template ui8BGRAFramebuffer::SharedPtr FromBMPBuffer<ui8BGRAPixel> (
+            const util::ui8 *, std::size_t, const FramebufferAllocator &);
+
         ui8RGBAFramebuffer::SharedPtr FromBMPBuffer (
                 const util::ui8 *buffer,
                 std::size_t size) {
-            util::TenantReadBuffer buffer_ (util::LittleEndian, buffer, size);
+            BMPHeader header = ReadBMPHeader (buffer, size);
+            ui8RGBAFramebuffer::SharedPtr framebuffer (
+                new ui8RGBAFramebuffer (
+                    util::Rectangle::Extents (header.width, header.height)));
+            FromBMPBuffer (buffer, size, *framebuffer);
+            return framebuffer;
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromBMPFile (const std::string &path) {
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromBMPBuffer (file.data, file.size);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty bmp file: %s", path.c_str ());
+            }
+        }
+
+        template<typename PixelType>
+        void ToBMPBuffer (
+                const Framebuffer<PixelType> &framebuffer,
+                std::vector<util::ui8> &buffer,
+                bool alpha) {
+            util::ui32 width = framebuffer.extents.width;
+            util::ui32 height = framebuffer.extents.height;
+            util::i16 bitCount = alpha ? 32 : 24;
+            std::size_t stride = GetBMPStride (width, bitCount);
             FileHeader fileHeader;
+            fileHeader.bfType = BMP_TYPE;
+            fileHeader.bfOffBits = (util::i32)(FILE_HEADER_SIZE + sizeof (InfoHeader));
+            fileHeader.bfSize = (util::i32)(fileHeader.bfOffBits + stride * height);
             InfoHeader infoHeader;
-            buffer_ >> fileHeader >> infoHeader;
-            // We read a fairly limited (but common) subset of formats.
-            // - one plane
-            // - 24 or 32 bpp
-            // - no compression
-            if (fileHeader.bfType == BMP_TYPE &&
-                    infoHeader.biSize == sizeof (InfoHeader) &&
-                    infoHeader.biWidth > 0 &&
-                    infoHeader.biHeight > 0 &&
-                    infoHeader.biPlanes == 1 &&
-                    (infoHeader.biBitCount == 24 || infoHeader.biBitCount == 32) &&
-                    infoHeader.biCompression == 0) {
-                ui8RGBAFramebuffer::SharedPtr framebuffer (
-                    new ui8RGBAFramebuffer (
-                        util::Rectangle::Extents (infoHeader.biHeight, infoHeader.biWidth)));
-                buffer_.readOffset = fileHeader.bfOffBits;
-                for (ui8RGBAPixel *dst = framebuffer->buffer.array,
-                         *end = dst + framebuffer->buffer.length; dst != end; ++dst) {
-                    buffer_ >> dst->r >> dst->g >> dst->b;
-                    if (infoHeader.biBitCount == 32) {
-                        buffer_ >> dst->a;
+            infoHeader.biSize = sizeof (InfoHeader);
+            infoHeader.biWidth = width;
+            // Bottom-up, every reader understands those.
+            infoHeader.biHeight = height;
+            infoHeader.biPlanes = 1;
+            infoHeader.biBitCount = bitCount;
+            infoHeader.biCompression = BI_RGB;
+            infoHeader.biSizeImage = (util::i32)(stride * height);
+            // 72 dpi.
+            infoHeader.biXPelsPerMeter = 2835;
+            infoHeader.biYPelsPerMeter = 2835;
+            // resize value initializes the row padding.
+            buffer.clear ();
+            buffer.resize (fileHeader.bfSize);
+            util::TenantWriteBuffer buffer_ (util::LittleEndian, buffer.data (), buffer.size ());
+            buffer_ << fileHeader << infoHeader;
+            const util::ui8 *src = (const util::ui8 *)framebuffer.buffer.array;
+            std::size_t srcStride = width * sizeof (PixelType);
+            util::ui8 *dst = buffer.data () + fileHeader.bfOffBits + (height - 1) * stride;
+            for (util::ui32 y = 0; y < height; ++y, src += srcStride, dst -= stride) {
+                if (alpha) {
+                    CopyBGRA<BMPPixelLayout<PixelType>::SwapRB> (src, dst, width, 0);
+                }
+                else {
+                    PackBGR<BMPPixelLayout<PixelType>::SwapRB> (src, dst, width);
+                }
+            }
+        }
+
+        template<typename PixelType>
+        void ToBMPFile (
+                const Framebuffer<PixelType> &framebuffer,
+                const std::string &path,
+                bool alpha) {
+            std::vector<util::ui8> buffer;
+            ToBMPBuffer (framebuffer, buffer, alpha);
+            util::File file (util::HostEndian, path);
+            file.Write (buffer.data (), buffer.size ());
+        }
+
+        template void ToBMPBuffer<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, std::vector<util::ui8> &, bool);
+        template void ToBMPBuffer<ui8BGRAPixel> (
+            const ui8BGRAFramebuffer &, std::vector<util::ui8> &, bool);
+
+        template void ToBMPFile<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, const std::string &, bool);
+        template void ToBMPFile<ui8BGRAPixel> (
+            const ui8BGRAFramebuffer &, const std::string &, bool);
+
+        template<typename PixelType>
+        void FromQOIBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                Framebuffer<PixelType> &framebuffer,
+                util::ui32 threads) {
+            QOIHeader header;
+            std::size_t offset = header.Read (buffer, size);
+            if (framebuffer.extents != header.extents) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Framebuffer (%u x %u) does not match the QOI image (%u x %u).",
+                    framebuffer.extents.width, framebuffer.extents.height,
+                    header.extents.width, header.extents.height);
+            }
+            if (header.bandSizes.empty ()) {
+                QOIDecoder::State state;
+                state.Decode (
+                    buffer + offset,
+                    size - offset,
+                    framebuffer.buffer.array,
+                    framebuffer.buffer.length);
+            }
+            else {
+                std::size_t bandCount = header.bandSizes.size ();
+                std::vector<std::size_t> bandOffsets (bandCount + 1, offset);
+                for (std::size_t i = 0; i < bandCount; ++i) {
+                    bandOffsets[i + 1] = bandOffsets[i] + header.bandSizes[i];
+                }
+                if (bandOffsets[bandCount] > size) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                        "Truncated qoic stream.");
+                }
+                util::ui32 width = header.extents.width;
+                util::ui32 height = header.extents.height;
+                ParallelFor (0, bandCount,
+                    [&] (std::size_t bandBegin, std::size_t bandEnd) {
+                        for (std::size_t i = bandBegin; i < bandEnd; ++i) {
+                            std::size_t row = i * header.bandRows;
+                            std::size_t rows = std::min<std::size_t> (header.bandRows, height - row);
+                            QOIDecoder::State state;
+                            state.Decode (
+                                buffer + bandOffsets[i],
+                                bandOffsets[i + 1] - bandOffsets[i],
+                                framebuffer.buffer.array + row * width,
+                                rows * width);
+                        }
+                    },
+                    1,
+                    threads);
+            }
+        }
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromQOIBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                util::ui32 threads) {
+            QOIHeader header;
+            header.Read (buffer, size);
+            typename Framebuffer<PixelType>::SharedPtr framebuffer (
+                new Framebuffer<PixelType> (header.extents));
+            FromQOIBuffer (buffer, size, *framebuffer, threads);
+            return framebuffer;
+        }
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromQOIFile (
+                const std::string &path,
+                util::ui32 threads) {
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromQOIBuffer<PixelType> (file.data, file.size, threads);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty qoi file: %s", path.c_str ());
+            }
+        }
+
+        template<typename PixelType>
+        void ToQOIBuffer (
+                const Framebuffer<PixelType> &framebuffer,
+                std::vector<util::ui8> &buffer,
+                util::ui32 bandRows,
+                util::ui32 threads) {
+            buffer.clear ();
+            util::ui32 width = framebuffer.extents.width;
+            util::ui32 height = framebuffer.extents.height;
+            if (bandRows == 0 || bandRows >= height) {
+                QOIEncoder encoder (buffer, framebuffer.extents);
+                encoder.Encode (framebuffer.buffer.array, framebuffer.buffer.length);
+                encoder.End ();
+            }
+            else {
+                // Bands are encoded in to their own buffers (in parallel)
+                // and stitched together behind the header.
+                QOIHeader header;
+                header.extents = framebuffer.extents;
+                header.bandRows = bandRows;
+                header.Validate ();
+                std::size_t bandCount = ((std::size_t)height + bandRows - 1) / bandRows;
+                std::vector<std::vector<util::ui8>> bands (bandCount);
+                ParallelFor (0, bandCount,
+                    [&] (std::size_t bandBegin, std::size_t bandEnd) {
+                        for (std::size_t i = bandBegin; i < bandEnd; ++i) {
+                            std::size_t row = i * bandRows;
+                            std::size_t count = std::min<std::size_t> (bandRows, height - row) * width;
+                            std::vector<util::ui8> &band = bands[i];
+                            band.resize (QOIEncoder::State::GetMaxEncodedSize (count));
+                            QOIEncoder::State state;
+                            std::size_t bandSize = state.Encode (
+                                framebuffer.buffer.array + row * width, count, band.data ());
+                            bandSize += state.Flush (band.data () + bandSize);
+                            band.resize (bandSize);
+                        }
+                    },
+                    1,
+                    threads);
+                header.bandSizes.resize (bandCount);
+                std::size_t size = 0;
+                for (std::size_t i = 0; i < bandCount; ++i) {
+                    header.bandSizes[i] = (util::ui32)bands[i].size ();
+                    size += bands[i].size ();
+                }
+                buffer.reserve (
+                    QOI_HEADER_SIZE + QOI_BAND_INFO_SIZE + bandCount * 4 + size + QOI_END_MARKER_SIZE);
+                header.Write (buffer);
+                for (std::size_t i = 0; i < bandCount; ++i) {
+                    buffer.insert (buffer.end (), bands[i].begin (), bands[i].end ());
+                }
+                buffer.insert (buffer.end (), QOI_END_MARKER_SIZE - 1, 0);
+                buffer.push_back (1);
+            }
+        }
+
+        template<typename PixelType>
+        void ToQOIFile (
+                const Framebuffer<PixelType> &framebuffer,
+                const std::string &path,
+                util::ui32 bandRows,
+                util::ui32 threads) {
+            std::vector<util::ui8> buffer;
+            ToQOIBuffer (framebuffer, buffer, bandRows, threads);
+            util::File file (util::HostEndian, path);
+            file.Write (buffer.data (), buffer.size ());
+        }
+
+        template void FromQOIBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, ui8RGBAFramebuffer &, util::ui32);
+        template void FromQOIBuffer<ui8BGRAPixel> (
+            const util::ui8 *, std::size_t, ui8BGRAFramebuffer &, util::ui32);
+        template void FromQOIBuffer<ui8ARGBPixel> (
+            const util::ui8 *, std::size_t, ui8ARGBFramebuffer &, util::ui32);
+        template void FromQOIBuffer<ui8ABGRPixel> (
+            const util::ui8 *, std::size_t, ui8ABGRFramebuffer &, util::ui32);
+
+        template ui8RGBAFramebuffer::SharedPtr FromQOIBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, util::ui32);
+        template ui8BGRAFramebuffer::SharedPtr FromQOIBuffer<ui8BGRAPixel> (
+            const util::ui8 *, std::size_t, util::ui32);
+        template ui8ARGBFramebuffer::SharedPtr FromQOIBuffer<ui8ARGBPixel> (
+            const util::ui8 *, std::size_t, util::ui32);
+        template ui8ABGRFramebuffer::SharedPtr FromQOIBuffer<ui8ABGRPixel> (
+            const util::ui8 *, std::size_t, util::ui32);
+
+        template ui8RGBAFramebuffer::SharedPtr FromQOIFile<ui8RGBAPixel> (
+            const std::string &, util::ui32);
+        template ui8BGRAFramebuffer::SharedPtr FromQOIFile<ui8BGRAPixel> (
+            const std::string &, util::ui32);
+        template ui8ARGBFramebuffer::SharedPtr FromQOIFile<ui8ARGBPixel> (
+            const std::string &, util::ui32);
+        template ui8ABGRFramebuffer::SharedPtr FromQOIFile<ui8ABGRPixel> (
+            const std::string &, util::ui32);
+
+        template void ToQOIBuffer<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, std::vector<util::ui8> &, util::ui32, util::ui32);
+        template void ToQOIBuffer<ui8BGRAPixel> (
+            const ui8BGRAFramebuffer &, std::vector<util::ui8> &, util::ui32, util::ui32);
+        template void ToQOIBuffer<ui8ARGBPixel> (
+            const ui8ARGBFramebuffer &, std::vector<util::ui8> &, util::ui32, util::ui32);
+        template void ToQOIBuffer<ui8ABGRPixel> (
+            const ui8ABGRFramebuffer &, std::vector<util::ui8> &, util::ui32, util::ui32);
+
+        template void ToQOIFile<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, const std::string &, util::ui32, util::ui32);
+        template void ToQOIFile<ui8BGRAPixel> (
+            const ui8BGRAFramebuffer &, const std::string &, util::ui32, util::ui32);
+        template void ToQOIFile<ui8ARGBPixel> (
+            const ui8ARGBFramebuffer &, const std::string &, util::ui32, util::ui32);
+        template void ToQOIFile<ui8ABGRPixel> (
+            const ui8ABGRFramebuffer &, const std::string &, util::ui32, util::ui32);
+
+        namespace {
+            // Same limit as QOI. Protects against headers that would have
+            // us allocate absurd framebuffers, and keeps the raster size
+            // (at most 8 bytes a pixel) inside a 32 bit std::size_t.
+            const util::ui64 PNM_MAX_PIXELS = 400000000;
+
+            // Parsed Netpbm (P5, P6 or P7) header.
+            struct PNMHeader {
+                util::ui32 width;
+                util::ui32 height;
+                // Samples per pixel (1 = gray, 2 = gray + alpha, 3 = RGB, 4 = RGBA).
+                util::ui32 depth;
+                util::ui32 maxval;
+                // Where the raster starts.
+                std::size_t offset;
+
+                PNMHeader () :
+                    width (0),
+                    height (0),
+                    depth (0),
+                    maxval (0),
+                    offset (0) {}
+
+                // Samples wider than a byte are 16 bit big endian.
+                inline std::size_t GetBytesPerSample () const {
+                    return maxval < 256 ? 1 : 2;
+                }
+
+                // ReadPNMHeader caps width * height at PNM_MAX_PIXELS and
+                // depth at 4, so this can't overflow.
+                inline util::ui64 GetRasterSize () const {
+                    return (util::ui64)width * height * depth * GetBytesPerSample ();
+                }
+            };
+
+            inline bool IsPNMSpace (util::ui8 c) {
+                return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+            }
+
+            // Skip white space and comments ('#' to the end of the line).
+            void SkipPNMSpace (
+                    const util::ui8 *buffer,
+                    std::size_t size,
+                    std::size_t &offset) {
+                while (offset < size) {
+                    if (buffer[offset] == '#') {
+                        while (offset < size && buffer[offset] != '\n') {
+                            ++offset;
+                        }
+                    }
+                    else if (IsPNMSpace (buffer[offset])) {
+                        ++offset;
+                    }
+                    else {
+                        break;
+                    }
+                }
+            }
+
+            std::string ReadPNMToken (
+                    const util::ui8 *buffer,
+                    std::size_t size,
+                    std::size_t &offset) {
+                SkipPNMSpace (buffer, size, offset);
+                std::size_t start = offset;
+                while (offset < size && !IsPNMSpace (buffer[offset])) {
+                    ++offset;
+                }
+                return std::string ((const char *)buffer + start, offset - start);
+            }
+
+            util::ui32 ReadPNMNumber (
+                    const util::ui8 *buffer,
+                    std::size_t size,
+                    std::size_t &offset) {
+                SkipPNMSpace (buffer, size, offset);
+                std::size_t start = offset;
+                util::ui64 value = 0;
+                while (offset < size && buffer[offset] >= '0' && buffer[offset] <= '9') {
+                    value = value * 10 + (buffer[offset++] - '0');
+                    if (value > 0xffffffff) {
+                        break;
+                    }
+                }
+                if (offset == start || value > 0xffffffff) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                        "Invalid Netpbm header.");
+                }
+                return (util::ui32)value;
+            }
+
+            PNMHeader ReadPNMHeader (
+                    const util::ui8 *buffer,
+                    std::size_t size) {
+                if (size < 3 || buffer[0] != 'P' ||
+                        buffer[1] < '5' || buffer[1] > '7' || !IsPNMSpace (buffer[2])) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                        "Not a binary Netpbm (P5, P6 or P7) image.");
+                }
+                PNMHeader header;
+                std::size_t offset = 2;
+                if (buffer[1] == '7') {
+                    // PAM: KEY value lines up to ENDHDR.
+                    while (true) {
+                        std::string key = ReadPNMToken (buffer, size, offset);
+                        if (key.empty ()) {
+                            THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                                "Invalid Netpbm header.");
+                        }
+                        else if (key == "ENDHDR") {
+                            break;
+                        }
+                        else if (key == "WIDTH") {
+                            header.width = ReadPNMNumber (buffer, size, offset);
+                        }
+                        else if (key == "HEIGHT") {
+                            header.height = ReadPNMNumber (buffer, size, offset);
+                        }
+                        else if (key == "DEPTH") {
+                            header.depth = ReadPNMNumber (buffer, size, offset);
+                        }
+                        else if (key == "MAXVAL") {
+                            header.maxval = ReadPNMNumber (buffer, size, offset);
+                        }
+                        else {
+                            // TUPLTYPE is informative, DEPTH says it all.
+                            while (offset < size && buffer[offset] != '\n') {
+                                ++offset;
+                            }
+                        }
+                    }
+                }
+                else {
+                    header.width = ReadPNMNumber (buffer, size, offset);
+                    header.height = ReadPNMNumber (buffer, size, offset);
+                    header.maxval = ReadPNMNumber (buffer, size, offset);
+                    header.depth = buffer[1] == '5' ? 1 : 3;
+                }
+                // A single white space character separates the header
+                // from the raster.
+                if (offset >= size || !IsPNMSpace (buffer[offset]) ||
+                        header.width == 0 || header.height == 0 ||
+                        (util::ui64)header.width * header.height > PNM_MAX_PIXELS ||
+                        header.depth == 0 || header.depth > 4 ||
+                        header.maxval == 0 || header.maxval > 65535) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                        "Invalid Netpbm header.");
+                }
+                header.offset = offset + 1;
+                return header;
+            }
+
+            // Pixel types we read and write directly and the number of
+            // samples they hold.
+            template<typename PixelType>
+            struct PNMPixelLayout;
+
+            template<>
+            struct PNMPixelLayout<ui8RGBAPixel> {
+                static const util::ui32 depth = 4;
+            };
+
+            template<>
+            struct PNMPixelLayout<ui16RGBAPixel> {
+                static const util::ui32 depth = 4;
+            };
+
+            template<>
+            struct PNMPixelLayout<ui8GrayAPixel> {
+                static const util::ui32 depth = 2;
+            };
+
+            template<>
+            struct PNMPixelLayout<ui16GrayAPixel> {
+                static const util::ui32 depth = 2;
+            };
+
+            // true if the raster is already in PixelType's memory layout
+            // (16 bit samples aside, they need swapping to host order).
+            template<typename PixelType>
+            inline bool IsPNMLayout (const PNMHeader &header) {
+                typedef typename PixelType::ComponentType ComponentType;
+                return header.depth == PNMPixelLayout<PixelType>::depth &&
+                    header.maxval == std::numeric_limits<ComponentType>::max ();
+            }
+
+            // Convert count pnm pixels to PixelType. Samples are scaled from
+            // maxval to the full component range, missing alpha is opaque
+            // and gray is replicated to RGB.
+            template<typename PixelType>
+            void FromPNMPixels (
+                    const util::ui8 *src,
+                    const PNMHeader &header,
+                    PixelType *pixels,
+                    std::size_t count) {
+                typedef typename PixelType::ComponentType ComponentType;
+                const util::ui32 depth = PNMPixelLayout<PixelType>::depth;
+                const util::ui32 maxval = std::numeric_limits<ComponentType>::max ();
+                if (header.maxval == maxval) {
+                    if (header.depth == depth) {
+                        if (sizeof (ComponentType) == 1) {
+                            memcpy (pixels, src, count * sizeof (PixelType));
+                        }
+                        else {
+                            SwapBigEndian (src, (util::ui8 *)pixels, count * depth);
+                        }
+                        return;
+                    }
+                    if (sizeof (ComponentType) == 1 && header.depth == 3 && depth == 4) {
+                        ExpandBGR<false> (src, (util::ui8 *)pixels, count);
+                        return;
+                    }
+                }
+                const bool wide = header.GetBytesPerSample () == 2;
+                ComponentType *dst = (ComponentType *)pixels;
+                for (std::size_t i = 0; i < count; ++i, dst += depth) {
+                    ComponentType samples[4] = {0, 0, 0, (ComponentType)maxval};
+                    for (util::ui32 j = 0; j < header.depth; ++j) {
+                        util::ui32 sample = wide ? (util::ui32)(src[0] << 8 | src[1]) : src[0];
+                        src += wide ? 2 : 1;
+                        samples[j] = (ComponentType)(sample >= header.maxval ? maxval :
+                            ((util::ui64)sample * maxval + header.maxval / 2) / header.maxval);
+                    }
+                    if (depth == 4) {
+                        if (header.depth <= 2) {
+                            samples[3] = header.depth == 2 ? samples[1] : (ComponentType)maxval;
+                            samples[1] = samples[2] = samples[0];
+                        }
+                        dst[0] = samples[0];
+                        dst[1] = samples[1];
+                        dst[2] = samples[2];
+                        dst[3] = samples[3];
+                    }
+                    else {
+                        dst[0] = samples[0];
+                        dst[1] = header.depth == 2 ? samples[1] : (ComponentType)maxval;
+                    }
+                }
+            }
+
+            // Convert count PixelType pixels to pnm samples (full range,
+            // big endian if 16 bit). Without alpha, alpha is dropped.
+            template<typename PixelType>
+            void ToPNMPixels (
+                    const PixelType *pixels,
+                    std::size_t count,
+                    bool alpha,
+                    util::ui8 *dst) {
+                typedef typename PixelType::ComponentType ComponentType;
+                const util::ui32 depth = PNMPixelLayout<PixelType>::depth;
+                if (alpha) {
+                    if (sizeof (ComponentType) == 1) {
+                        memcpy (dst, pixels, count * sizeof (PixelType));
                     }
                     else {
-                        dst->a = 255;
+                        SwapBigEndian ((const util::ui8 *)pixels, dst, count * depth);
+                    }
+                }
+                else if (sizeof (ComponentType) == 1 && depth == 4) {
+                    PackBGR<false> ((const util::ui8 *)pixels, dst, count);
+                }
+                else {
+                    const ComponentType *src = (const ComponentType *)pixels;
+                    for (std::size_t i = 0; i < count; ++i, src += depth) {
+                        for (util::ui32 j = 0; j < depth - 1; ++j) {
+                            if (sizeof (ComponentType) == 1) {
+                                *dst++ = (util::ui8)src[j];
+                            }
+                            else {
+                                *dst++ = (util::ui8)(src[j] >> 8);
+                                *dst++ = (util::ui8)src[j];
+                            }
+                        }
+                    }
+                }
+            }
+
+            template<typename PixelType>
+            std::string FormatPNMHeader (
+                    const util::Rectangle::Extents &extents,
+                    bool alpha) {
+                typedef typename PixelType::ComponentType ComponentType;
+                const util::ui32 depth = PNMPixelLayout<PixelType>::depth;
+                const util::ui32 maxval = std::numeric_limits<ComponentType>::max ();
+                if (alpha) {
+                    return util::FormatString (
+                        "P7\nWIDTH %u\nHEIGHT %u\nDEPTH %u\nMAXVAL %u\nTUPLTYPE %s\nENDHDR\n",
+                        extents.width, extents.height, depth, maxval,
+                        depth == 4 ? "RGB_ALPHA" : "GRAYSCALE_ALPHA");
+                }
+                return util::FormatString (
+                    "P%c\n%u %u\n%u\n",
+                    depth == 4 ? '6' : '5', extents.width, extents.height, maxval);
+            }
+        }
+
+        template<typename PixelType>
+        void FromPNMBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                Framebuffer<PixelType> &framebuffer) {
+            PNMHeader header = ReadPNMHeader (buffer, size);
+            if (framebuffer.extents.width != header.width ||
+                    framebuffer.extents.height != header.height) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Framebuffer (%u x %u) does not match the Netpbm image (%u x %u).",
+                    framebuffer.extents.width, framebuffer.extents.height,
+                    header.width, header.height);
+            }
+            if (PNMPixelLayout<PixelType>::depth == 2 && header.depth > 2) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                    "Unable to load a color Netpbm image in to a gray framebuffer.");
+            }
+            if (header.GetRasterSize () > size - header.offset) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                    "Truncated Netpbm raster.");
+            }
+            FromPNMPixels (
+                buffer + header.offset,
+                header,
+                framebuffer.buffer.array,
+                framebuffer.buffer.length);
+        }
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNMBuffer (
+                const util::ui8 *buffer,
+                std::size_t size) {
+            PNMHeader header = ReadPNMHeader (buffer, size);
+            typename Framebuffer<PixelType>::SharedPtr framebuffer (
+                new Framebuffer<PixelType> (
+                    util::Rectangle::Extents (header.width, header.height)));
+            FromPNMBuffer (buffer, size, *framebuffer);
+            return framebuffer;
+        }
+
+        template<typename PixelType>
+        typename Framebuffer<PixelType>::SharedPtr FromPNMFile (const std::string &path) {
+            std::shared_ptr<MappedFile> file (new MappedFile (path, true, true));
+            if (file->size > 0) {
+                PNMHeader header = ReadPNMHeader (file->data, file->size);
+                if (IsPNMLayout<PixelType> (header) &&
+                        header.offset % alignof (PixelType) == 0 &&
+                        header.GetRasterSize () <= file->size - header.offset) {
+                    // The raster is the framebuffer. Alias the (copy on
+                    // write) file contents instead of copying them. The
+                    // framebuffer keeps the file mapped.
+                    PixelType *array = (PixelType *)(file->GetWritableData () + header.offset);
+                    if (sizeof (typename PixelType::ComponentType) == 2) {
+                        SwapBigEndian (
+                            (util::ui16 *)array,
+                            (std::size_t)header.width * header.height * header.depth);
                     }
+                    return typename Framebuffer<PixelType>::SharedPtr (
+                        new Framebuffer<PixelType> (
+                            util::Rectangle::Extents (header.width, header.height),
+                            array,
+                            [file] (PixelType * /*array*/) {}));
                 }
-                return framebuffer;
+                return FromPNMBuffer<PixelType> (file->data, file->size);
             }
             else {
                 THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
-                    "Unsupported bmp file format: %d", fileHeader.bfType);
+                    "Empty Netpbm file: %s", path.c_str ());
             }
         }
 
-        ui8RGBAFramebuffer::SharedPtr FromBMPFile (const std::string &path) {
-            util::ReadOnlyFile file (util::HostEndian, path);
-            util::ui64 size = file.GetSize ();
-            if (size > 0) {
-                std::vector<util::ui8> buffer (size);
-                file.Read (buffer.data (), size);
-                return FromBMPBuffer (buffer.data (), size);
+        template<typename PixelType>
+        void ToPNMBuffer (
+                const Framebuffer<PixelType> &framebuffer,
+                std::vector<util::ui8> &buffer,
+                bool alpha) {
+            std::string header = FormatPNMHeader<PixelType> (framebuffer.extents, alpha);
+            std::size_t pixelSize = (PNMPixelLayout<PixelType>::depth - (alpha ? 0 : 1)) *
+                sizeof (typename PixelType::ComponentType);
+            buffer.clear ();
+            buffer.resize (header.size () + framebuffer.buffer.length * pixelSize);
+            memcpy (buffer.data (), header.data (), header.size ());
+            ToPNMPixels (
+                framebuffer.buffer.array,
+                framebuffer.buffer.length,
+                alpha,
+                buffer.data () + header.size ());
+        }
+
+        template<typename PixelType>
+        void ToPNMFile (
+                const Framebuffer<PixelType> &framebuffer,
+                const std::string &path,
+                bool alpha) {
+            std::string header = FormatPNMHeader<PixelType> (framebuffer.extents, alpha);
+            std::size_t pixelSize = (PNMPixelLayout<PixelType>::depth - (alpha ? 0 : 1)) *
+                sizeof (typename PixelType::ComponentType);
+            util::File file (util::HostEndian, path);
+            file.Write (header.data (), header.size ());
+            util::ui32 width = framebuffer.extents.width;
+            util::ui32 height = framebuffer.extents.height;
+            if (width == 0 || height == 0) {
+                return;
+            }
+            // Convert and write a band of rows at a time so that big
+            // frames don't need a second copy in memory.
+            const std::size_t BAND_SIZE = 4 * 1024 * 1024;
+            std::size_t rowSize = width * pixelSize;
+            util::ui32 bandRows = (util::ui32)std::max<std::size_t> (1, BAND_SIZE / rowSize);
+            std::vector<util::ui8> band ((std::size_t)std::min<util::ui32> (bandRows, height) * rowSize);
+            for (util::ui32 y = 0; y < height; y += bandRows) {
+                util::ui32 rows = std::min<util::ui32> (bandRows, height - y);
+                ToPNMPixels (
+                    framebuffer.buffer.array + (std::size_t)y * width,
+                    (std::size_t)rows * width,
+                    alpha,
+                    band.data ());
+                file.Write (band.data (), rows * rowSize);
+            }
+        }
+
+        template void FromPNMBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t, ui8RGBAFramebuffer &);
+        template void FromPNMBuffer<ui16RGBAPixel> (
+            const util::ui8 *, std::size_t, ui16RGBAFramebuffer &);
+        template void FromPNMBuffer<ui8GrayAPixel> (
+            const util::ui8 *, std::size_t, ui8GrayAFramebuffer &);
+        template void FromPNMBuffer<ui16GrayAPixel> (
+            const util::ui8 *, std::size_t, ui16GrayAFramebuffer &);
+
+        template ui8RGBAFramebuffer::SharedPtr FromPNMBuffer<ui8RGBAPixel> (
+            const util::ui8 *, std::size_t);
+        template ui16RGBAFramebuffer::SharedPtr FromPNMBuffer<ui16RGBAPixel> (
+            const util::ui8 *, std::size_t);
+        template ui8GrayAFramebuffer::SharedPtr FromPNMBuffer<ui8GrayAPixel> (
+            const util::ui8 *, std::size_t);
+        template ui16GrayAFramebuffer::SharedPtr FromPNMBuffer<ui16GrayAPixel> (
+            const util::ui8 *, std::size_t);
+
+        template ui8RGBAFramebuffer::SharedPtr FromPNMFile<ui8RGBAPixel> (const std::string &);
+        template ui16RGBAFramebuffer::SharedPtr FromPNMFile<ui16RGBAPixel> (const std::string &);
+        template ui8GrayAFramebuffer::SharedPtr FromPNMFile<ui8GrayAPixel> (const std::string &);
+        template ui16GrayAFramebuffer::SharedPtr FromPNMFile<ui16GrayAPixel> (const std::string &);
+
+        template void ToPNMBuffer<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, std::vector<util::ui8> &, bool);
+        template void ToPNMBuffer<ui16RGBAPixel> (
+            const ui16RGBAFramebuffer &, std::vector<util::ui8> &, bool);
+        template void ToPNMBuffer<ui8GrayAPixel> (
+            const ui8GrayAFramebuffer &, std::vector<util::ui8> &, bool);
+        template void ToPNMBuffer<ui16GrayAPixel> (
+            const ui16GrayAFramebuffer &, std::vector<util::ui8> &, bool);
+
+        template void ToPNMFile<ui8RGBAPixel> (
+            const ui8RGBAFramebuffer &, const std::string &, bool);
+        template void ToPNMFile<ui16RGBAPixel> (
+            const ui16RGBAFramebuffer &, const std::string &, bool);
+        template void ToPNMFile<ui8GrayAPixel> (
+            const ui8GrayAFramebuffer &, const std::string &, bool);
+        template void ToPNMFile<ui16GrayAPixel> (
+            const ui16GrayAFramebuffer &, const std::string &, bool);
+
+        ImageFormat GetImageFormat (
+                const util::ui8 *buffer,
+                std::size_t size) {
+            static const util::ui8 PNG_MAGIC[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+            static const util::ui8 JPG_MAGIC[] = {0xff, 0xd8, 0xff};
+            static const util::ui8 BMP_MAGIC[] = {'B', 'M'};
+            static const util::ui8 QOI_MAGIC[] = {'q', 'o', 'i', 'f'};
+            static const util::ui8 QOIC_MAGIC[] = {'q', 'o', 'i', 'c'};
+            if (size >= sizeof (PNG_MAGIC) && memcmp (buffer, PNG_MAGIC, sizeof (PNG_MAGIC)) == 0) {
+                return ImageFormatPNG;
+            }
+            if (size >= sizeof (JPG_MAGIC) && memcmp (buffer, JPG_MAGIC, sizeof (JPG_MAGIC)) == 0) {
+                return ImageFormatJPG;
+            }
+            if (size >= sizeof (BMP_MAGIC) && memcmp (buffer, BMP_MAGIC, sizeof (BMP_MAGIC)) == 0) {
+                return ImageFormatBMP;
+            }
+            if (size >= sizeof (QOI_MAGIC) &&
+                    (memcmp (buffer, QOI_MAGIC, sizeof (QOI_MAGIC)) == 0 ||
+                        memcmp (buffer, QOIC_MAGIC, sizeof (QOIC_MAGIC)) == 0)) {
+                return ImageFormatQOI;
+            }
+            if (size >= 3 && buffer[0] == 'P' &&
+                    buffer[1] >= '5' && buffer[1] <= '7' && IsPNMSpace (buffer[2])) {
+                return ImageFormatPNM;
+            }
+            return ImageFormatUnknown;
+        }
+
+        namespace {
+            // Same limit as QOI, PNM and BMP. lodepng_inspect and the jpeg
+            // SOF report any extents, the decoders (and the allocator
+            // overloads) size framebuffers from what ProbeImage returns.
+            const util::ui64 PNG_MAX_PIXELS = 400000000;
+            const util::ui64 JPG_MAX_PIXELS = 400000000;
+        }
+
+        ImageInfo ProbeImage (
+                const util::ui8 *buffer,
+                std::size_t size) {
+            ImageInfo info;
+            info.format = GetImageFormat (buffer, size);
+            switch (info.format) {
+                case ImageFormatPNG: {
+                    LodePNGState state;
+                    lodepng_state_init (&state);
+                    util::ui32 width = 0;
+                    util::ui32 height = 0;
+                    util::ui32 error = lodepng_inspect (&width, &height, &state, buffer, size);
+                    if (error == 0) {
+                        info.extents = util::Rectangle::Extents (width, height);
+                        info.channels = lodepng_get_channels (&state.info_png.color);
+                        info.bitDepth = state.info_png.color.bitdepth;
+                    }
+                    lodepng_state_cleanup (&state);
+                    if (error != 0) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "Unable to read a PNG header (%s)",
+                            lodepng_error_text (error));
+                    }
+                    if ((util::ui64)info.extents.width * info.extents.height > PNG_MAX_PIXELS) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "PNG image too large (%u x %u).",
+                            info.extents.width, info.extents.height);
+                    }
+                    break;
+                }
+                case ImageFormatJPG: {
+                    TJDecompressHandle handle;
+                    int width;
+                    int height;
+                    int jpegSubsamp;
+                    if (tjDecompressHeader2 (
+                            handle.handle,
+                            (util::ui8 *)buffer,
+                            (unsigned long)size,
+                            &width,
+                            &height,
+                            &jpegSubsamp) == 0) {
+                        if (width <= 0 || height <= 0 ||
+                                (util::ui64)width * (util::ui64)height > JPG_MAX_PIXELS) {
+                            THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                                "Invalid JPG extents (%d x %d).",
+                                width, height);
+                        }
+                        info.extents = util::Rectangle::Extents (width, height);
+                        info.channels = jpegSubsamp == TJSAMP_GRAY ? 1 : 3;
+                        info.bitDepth = 8;
+                        info.subsamp = jpegSubsamp;
+                    }
+                    else {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "%s", tjGetErrorStr ());
+                    }
+                    break;
+                }
+                case ImageFormatBMP: {
+                    BMPHeader header = ReadBMPHeader (buffer, size);
+                    info.extents = util::Rectangle::Extents (header.width, header.height);
+                    // <= 8 bpp are palette indices.
+                    switch (header.infoHeader.biBitCount) {
+                        case 1:
+                        case 4:
+                        case 8:
+                            info.channels = 1;
+                            info.bitDepth = header.infoHeader.biBitCount;
+                            break;
+                        case 16:
+                            info.channels = 3;
+                            info.bitDepth = 5;
+                            break;
+                        case 24:
+                        case 32:
+                            info.channels = header.infoHeader.biBitCount / 8;
+                            info.bitDepth = 8;
+                            break;
+                    }
+                    break;
+                }
+                case ImageFormatQOI: {
+                    QOIHeader header;
+                    header.Read (buffer, size);
+                    info.extents = header.extents;
+                    info.channels = header.channels;
+                    info.bitDepth = 8;
+                    break;
+                }
+                case ImageFormatPNM: {
+                    PNMHeader header = ReadPNMHeader (buffer, size);
+                    info.extents = util::Rectangle::Extents (header.width, header.height);
+                    info.channels = header.depth;
+                    info.bitDepth = 1;
+                    while ((1u << info.bitDepth) <= header.maxval) {
+                        ++info.bitDepth;
+                    }
+                    break;
+                }
+                case ImageFormatUnknown:
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                        "Unrecognized image format.");
+            }
+            return info;
+        }
+
+        ImageInfo ProbeImageFile (const std::string &path) {
+            // Only the pages holding the header are ever read.
+            MappedFile file (path, false);
+            return ProbeImage (file.data, file.size);
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromBuffer (
+                const util::ui8 *buffer,
+                std::size_t size) {
+            switch (GetImageFormat (buffer, size)) {
+                case ImageFormatPNG:
+                    return FromPNGBuffer (buffer, size);
+                case ImageFormatJPG:
+                    return FromJPGBuffer (buffer, size);
+                case ImageFormatBMP:
+                    return FromBMPBuffer (buffer, size);
+                case ImageFormatQOI:
+                    return FromQOIBuffer<ui8RGBAPixel> (buffer, size);
+                case ImageFormatPNM:
+                    return FromPNMBuffer<ui8RGBAPixel> (buffer, size);
+                case ImageFormatUnknown:
+                    break;
+            }
+            THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                "Unrecognized image format.");
+        }
+
+        void FromBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                ui8RGBAFramebuffer &framebuffer) {
+            switch (GetImageFormat (buffer, size)) {
+                case ImageFormatPNG:
+                    FromPNGBuffer (buffer, size, framebuffer);
+                    return;
+                case ImageFormatJPG:
+                    FromJPGBuffer (buffer, size, framebuffer);
+                    return;
+                case ImageFormatBMP:
+                    FromBMPBuffer (buffer, size, framebuffer);
+                    return;
+                case ImageFormatQOI:
+                    FromQOIBuffer (buffer, size, framebuffer);
+                    return;
+                case ImageFormatPNM:
+                    FromPNMBuffer (buffer, size, framebuffer);
+                    return;
+                case ImageFormatUnknown:
+                    break;
+            }
+            THEKOGANS_UTIL_THROW_STRING_EXCEPTION ("%s",
+                "Unrecognized image format.");
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromBuffer (
+                const util::ui8 *buffer,
+                std::size_t size,
+                const FramebufferAllocator &allocator) {
+            ui8RGBAFramebuffer::SharedPtr framebuffer =
+                allocator.Allocate<ui8RGBAPixel> (ProbeImage (buffer, size).extents);
+            FromBuffer (buffer, size, *framebuffer);
+            return framebuffer;
+        }
+
+        ui8RGBAFramebuffer::SharedPtr FromFile (const std::string &path) {
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromBuffer (file.data, file.size);
             }
             else {
                 THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
-                    "Empty bmp file: %s", path.c_str ());
+                    "Empty image file: %s", path.c_str ());
             }
         }
 
@@ -28,6 +28,8 @@
 #include "thekogans/util/File.h"
 #include "thekogans/canvas/TJUtils.h"
 #include "thekogans/canvas/lodepng.h"
+#include "thekogans/canvas/Parallel.h"
+#include "thekogans/canvas/YUVAConverter.h"
 #include "thekogans/canvas/YUVImage.h"
 #include "thekogans/canvas/RGBImage.h"
 
@@ -163,6 +165,31 @@ namespace thekogans {
             }
         }
 
+        namespace {
+            int ComponentIndicesToTJPixelFormat (
+                    util::ui32 componentIndices,
+                    util::ui32 pixelStride) {
+                if (pixelStride == 3) {
+                    return
+                        componentIndices == RGBImage::R0G1B2A3 ? TJPF_RGB :
+                        componentIndices == RGBImage::R2G1B0A3 ? TJPF_BGR : 0;
+                }
+                return
+                    componentIndices == RGBImage::R0G1B2A3 ? TJPF_RGBX :
+                    componentIndices == RGBImage::R2G1B0A3 ? TJPF_BGRX :
+                    componentIndices == RGBImage::R1G2B3A0 ? TJPF_XRGB :
+                    componentIndices == RGBImage::R3G2B1A0 ? TJPF_XBGR : 0;
+            }
+
+            inline int ChromaToTJChroma (RGBImage::Chroma chroma) {
+                return
+                    chroma == RGBImage::CHROMA_NONE ? TJSAMP_444 :
+                    chroma == RGBImage::CHROMA_2x1 ? TJSAMP_422 :
+                    chroma == RGBImage::CHROMA_1x2 ? TJSAMP_440 :
+                    chroma == RGBImage::CHROMA_2x2 ? TJSAMP_420 : 0;
+            }
+        }
+
         RGBImage::UniquePtr RGBImage::FromJPGBuffer (
                 const util::ui8 *buffer,
                 util::ui32 size,
@@ -363,7 +390,7 @@ namespace thekogans {
 
         void RGBImage::Clear (
                 const util::Rectangle &rectangle,
-                const Color &color) {
+                const ui8RGBAColor &color) {
             util::Rectangle srcRectangle = rectangle.Intersection (GetRectangle ());
             if (!srcRectangle.IsDegenerate ()) {
                 util::ui8 *srcData = data +
@@ -463,6 +490,10 @@ namespace thekogans {
         }
 
         namespace {
+            // Distance (squared) under which a rotated sample is
+            // taken to be on a source grid point.
+            const util::f32 EPSILON = 1e-6f;
+
             struct f32Point {
                 util::f32 x;
                 util::f32 y;
@@ -488,7 +519,7 @@ namespace thekogans {
         RGBImage::UniquePtr RGBImage::Rotate (
                 util::f32 angle,
                 const util::Point &centerOfRotation,
-                const Color &fillColor) const {
+                const ui8RGBAColor &fillColor) const {
             const util::ui32 srcHeight = extents.height;
             const util::ui32 srcWidth = extents.width;
             const util::f32 cosAngle = cos (util::RAD (angle));
@@ -826,75 +857,43 @@ namespace thekogans {
             file.Write (&buffer[0], buffer.size ());
         }
 
-        namespace {
-            #define RGB2YUV_SHIFT 15
-
-            #define RY ( (int)(0.299 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define GY ( (int)(0.587 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define BY ( (int)(0.114 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-
-            #define RU (-(int)(0.169 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define GU (-(int)(0.331 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define BU ( (int)(0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-
-            #define RV ( (int)(0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define GV (-(int)(0.419 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define BV (-(int)(0.081 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-        }
-
         YUVImage::UniquePtr RGBImage::ToYUVImage (bool hasAlpha) const {
             assert (IsValid ());
             YUVImage::UniquePtr image (new YUVImage (extents, hasAlpha));
             if (image.get () != 0) {
-                util::ui32 rIndex =
-                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, R_INDEX);
-                util::ui32 gIndex =
-                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, G_INDEX);
-                util::ui32 bIndex =
-                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, B_INDEX);
-                util::ui32 aIndex =
-                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, A_INDEX);
-                util::ui32 width = extents.width;
-                util::ui32 height = extents.height;
-                util::ui32 planeSize = width * height;
-                const util::ui8 *srcData = data;
-                util::ui8 *yPlane = image->GetYPlane ();
-                util::ui8 *uPlane = image->GetUPlane ();
-                util::ui8 *vPlane = image->GetVPlane ();
-                util::ui8 *aPlane = image->GetAPlane ();
-                util::Array<util::ui8> u (planeSize);
-                util::Array<util::ui8> v (planeSize);
-                // YA pass.
-                for (util::ui32 y = 0, i = 0; y < height; ++y) {
-                    for (util::ui32 x = 0; x < width; ++x, ++i) {
-                        util::ui32 pixelIndex = x * pixelStride;
-                        util::ui32 r = srcData[pixelIndex + rIndex];
-                        util::ui32 g = srcData[pixelIndex + gIndex];
-                        util::ui32 b = srcData[pixelIndex + bIndex];
-                        yPlane[i] = ((RY * r + GY * g + BY * b) >> RGB2YUV_SHIFT) + 16;
-                        if (hasAlpha) {
-                            aPlane[i] = srcData[pixelIndex + aIndex];
+                // One fused pass; two rows at a time write Y, 2x2
+                // averaged U/V and A directly in to the image planes.
+                PackedRGBALayout layout (
+                    pixelStride,
+                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, R_INDEX),
+                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, G_INDEX),
+                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, B_INDEX),
+                    THEKOGANS_UTIL_UI32_GET_UI8_AT_INDEX (componentIndices, A_INDEX));
+                const YUVImage &dst = *image;
+                ParallelFor (0, (extents.height + 1) / 2,
+                    [this, &dst, &layout, hasAlpha] (std::size_t begin, std::size_t end) {
+                        for (std::size_t chromaRow = begin; chromaRow < end; ++chromaRow) {
+                            std::size_t row = chromaRow * 2;
+                            const util::ui8 *row0 = data + row * rowStride;
+                            util::ui8 *y0 = dst.GetYPlane () + row * dst.GetYStride ();
+                            util::ui8 *a0 = hasAlpha ?
+                                dst.GetAPlane () + row * dst.GetAStride () : 0;
+                            YUVASpanConverter<YUVEncoding<YUVMatrixBT601, YUVRangeLimited>>::FromRGBA (
+                                row0,
+                                row + 1 < extents.height ? row0 + rowStride : 0,
+                                layout,
+                                extents.width,
+                                y0,
+                                y0 + dst.GetYStride (),
+                                dst.GetUPlane () + chromaRow * dst.GetUStride (),
+                                dst.GetVPlane () + chromaRow * dst.GetVStride (),
+                                1,
+                                true,
+                                a0,
+                                a0 != 0 ? a0 + dst.GetAStride () : 0);
                         }
-                        u[i] = ((RU * r + GU * g + BU * b) >> RGB2YUV_SHIFT) + 128;
-                        v[i] = ((RV * r + GV * g + BV * b) >> RGB2YUV_SHIFT) + 128;
-                    }
-                    srcData += rowStride;
-                }
-                // UV pass, 2 x 2 downsampling.
-                for (util::ui32 y = 0, i = 0; y < height; y += 2) {
-                    for (util::ui32 x = 0; x < width; x += 2, ++i) {
-                        util::ui32 pixelIndex0 = y * width + x;
-                        util::ui32 pixelIndex1 = pixelIndex0 + 1;
-                        util::ui32 pixelIndex2 = pixelIndex0 + width;
-                        util::ui32 pixelIndex3 = pixelIndex1 + width;
-                        uPlane[i] =
-                            (u[pixelIndex0] + u[pixelIndex1] +
-                            u[pixelIndex2] + u[pixelIndex3]) >> 2;
-                        vPlane[i] =
-                            (v[pixelIndex0] + v[pixelIndex1] +
-                            v[pixelIndex2] + v[pixelIndex3]) >> 2;
-                    }
-                }
+                    },
+                    32);
             }
             return image;
         }
@@ -912,7 +911,7 @@ namespace thekogans {
             return *this;
         }
 
-        void RGBImage::ColorToPixel (const Color &color,
+        void RGBImage::ColorToPixel (const ui8RGBAColor &color,
                 std::vector<util::ui8> &pixel) const {
             pixel.resize (pixelStride);
             memset (&pixel[0], 0, pixelStride);
@@ -15,24 +15,134 @@
 // You should have received a copy of the GNU General Public License
 // along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
 
+#include <climits>
+#include <vector>
+#include <atomic>
 #include "thekogans/canvas/TJUtils.h"
 
 namespace thekogans {
     namespace canvas {
 
-        _LIB_THEKOGANS_CANVAS_DECL int _LIB_THEKOGANS_CANVAS_API ComponentIndicesToTJPixelFormat (
-                util::ui32 componentIndices,
-                util::ui32 pixelStride) {
-            if (pixelStride == 3) {
-                return
-                    componentIndices == RGBImage::R0G1B2A3 ? TJPF_RGB :
-                    componentIndices == RGBImage::R2G1B0A3 ? TJPF_BGR : 0;
+        namespace {
+            std::atomic<util::ui64> compressCreated (0);
+            std::atomic<util::ui64> compressReused (0);
+            std::atomic<util::ui64> decompressCreated (0);
+            std::atomic<util::ui64> decompressReused (0);
+
+            struct Handles {
+                std::vector<tjhandle> handles;
+
+                ~Handles () {
+                    for (std::size_t i = 0, count = handles.size (); i < count; ++i) {
+                        tjDestroy (handles[i]);
+                    }
+                }
+
+                tjhandle Acquire (
+                        tjhandle (*init) (),
+                        std::atomic<util::ui64> &created,
+                        std::atomic<util::ui64> &reused) {
+                    if (!handles.empty ()) {
+                        tjhandle handle = handles.back ();
+                        handles.pop_back ();
+                        ++reused;
+                        return handle;
+                    }
+                    tjhandle handle = init ();
+                    if (handle == 0) {
+                        THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                            "%s", tjGetErrorStr ());
+                    }
+                    ++created;
+                    return handle;
+                }
+
+                void Release (tjhandle handle) {
+                    if (handle != 0) {
+                        if (handles.size () < TJHandleCache::MAX_CACHED_HANDLES) {
+                            handles.push_back (handle);
+                        }
+                        else {
+                            tjDestroy (handle);
+                        }
+                    }
+                }
+            };
+
+            thread_local Handles compressHandles;
+            thread_local Handles decompressHandles;
+        }
+
+        tjhandle TJHandleCache::AcquireCompressHandle () {
+            return compressHandles.Acquire (
+                tjInitCompress, compressCreated, compressReused);
+        }
+
+        void TJHandleCache::ReleaseCompressHandle (tjhandle handle) {
+            compressHandles.Release (handle);
+        }
+
+        tjhandle TJHandleCache::AcquireDecompressHandle () {
+            return decompressHandles.Acquire (
+                tjInitDecompress, decompressCreated, decompressReused);
+        }
+
+        void TJHandleCache::ReleaseDecompressHandle (tjhandle handle) {
+            decompressHandles.Release (handle);
+        }
+
+        TJHandleCache::Stats TJHandleCache::GetStats () {
+            Stats stats;
+            stats.compressCreated = compressCreated;
+            stats.compressReused = compressReused;
+            stats.decompressCreated = decompressCreated;
+            stats.decompressReused = decompressReused;
+            return stats;
+        }
+
+        void TJHandleCache::ResetStats () {
+            compressCreated = 0;
+            compressReused = 0;
+            decompressCreated = 0;
+            decompressReused = 0;
+        }
+
+        void TJBuffer::Reserve (std::size_t capacity_) {
+            if (capacity < capacity_) {
+                // tjAlloc takes an int.
+                if (capacity_ > INT_MAX) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Jpeg buffer too large (more than %d bytes).",
+                        INT_MAX);
+                }
+                if (data != 0) {
+                    tjFree (data);
+                    data = 0;
+                    capacity = 0;
+                }
+                size = 0;
+                data = tjAlloc ((int)capacity_);
+                if (data == 0) {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "Unable to allocate a %u byte jpeg buffer.",
+                        (util::ui32)capacity_);
+                }
+                capacity = capacity_;
+            }
+        }
+
+        void TJBuffer::Reserve (
+                util::ui32 width,
+                util::ui32 height,
+                util::i32 subsamp) {
+            unsigned long bufSize = width <= INT_MAX && height <= INT_MAX ?
+                tjBufSize ((int)width, (int)height, subsamp) : (unsigned long)-1;
+            if (bufSize == (unsigned long)-1) {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Invalid jpeg extents (%u x %u) or subsampling (%d).",
+                    width, height, subsamp);
             }
-            return
-                componentIndices == RGBImage::R0G1B2A3 ? TJPF_RGBX :
-                componentIndices == RGBImage::R2G1B0A3 ? TJPF_BGRX :
-                componentIndices == RGBImage::R1G2B3A0 ? TJPF_XRGB :
-                componentIndices == RGBImage::R3G2B1A0 ? TJPF_XBGR : 0;
+            Reserve ((std::size_t)bufSize);
         }
 
     } // namespace canvas
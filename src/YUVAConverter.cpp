@@ -0,0 +1,564 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <algorithm>
+#include "thekogans/canvas/Config.h"
+#if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+    #include <emmintrin.h>
+#endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/RGBAColor.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/YUVAColor.h"
+#include "thekogans/canvas/YUVAPixel.h"
+#include "thekogans/canvas/YUVAConverter.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        template<>
+        ui8YUVAColor Converter<ui8YUVAColor>::Convert (const ui8YUVAColor &inColor) {
+            return inColor;
+        }
+
+        template<>
+        ui8YUVAColor Converter<ui8YUVAColor>::Convert (const f32YUVAColor &inColor) {
+            return DefaultYUVEncoding::Quantize (inColor);
+        }
+
+        template<>
+        ui8YUVAColor Converter<ui8YUVAColor>::Convert (const f32RGBAColor &inColor) {
+            return DefaultYUVEncoding::Quantize (DefaultYUVEncoding::FromRGBA (inColor));
+        }
+
+        template<>
+        f32YUVAColor Converter<f32YUVAColor>::Convert (const f32YUVAColor &inColor) {
+            return inColor;
+        }
+
+        template<>
+        f32YUVAColor Converter<f32YUVAColor>::Convert (const ui8YUVAColor &inColor) {
+            return DefaultYUVEncoding::Normalize (inColor);
+        }
+
+        template<>
+        f32YUVAColor Converter<f32YUVAColor>::Convert (const f32RGBAColor &inColor) {
+            return DefaultYUVEncoding::FromRGBA (inColor);
+        }
+
+        namespace {
+            // RGB -> YUV uses Q14 coefficients (they are all < 1).
+            // YUV -> RGB coefficients go up to ~2.2, so it uses Q13
+            // to stay within the 16 bit range of _mm_madd_epi16.
+            const util::i32 ENCODE_SHIFT = 14;
+            const util::i32 DECODE_SHIFT = 13;
+
+            inline util::i32 Fixed (
+                    util::f32 value,
+                    util::i32 shift) {
+                value *= (util::f32)(1 << shift);
+                return (util::i32)(value < 0.0f ? value - 0.5f : value + 0.5f);
+            }
+
+            inline util::ui8 Clamp (util::i32 value) {
+                return (util::ui8)(value < 0 ? 0 : value > 255 ? 255 : value);
+            }
+
+            template<typename Encoding>
+            struct FixedPointCoefficients {
+                typedef typename Encoding::MatrixType MatrixType;
+                typedef typename Encoding::RangeType RangeType;
+
+                util::i32 yr, yg, yb;
+                util::i32 ur, ug, ub;
+                util::i32 vr, vg, vb;
+                util::i32 cy, crv, cgu, cgv, cbu;
+
+                FixedPointCoefficients () {
+                    const util::f32 kr = MatrixType::Kr ();
+                    const util::f32 kb = MatrixType::Kb ();
+                    const util::f32 kg = 1.0f - kr - kb;
+                    const util::f32 ys = RangeType::Y_SCALE / 255.0f;
+                    const util::f32 cs = RangeType::C_SCALE / 255.0f;
+                    yr = Fixed (kr * ys, ENCODE_SHIFT);
+                    yb = Fixed (kb * ys, ENCODE_SHIFT);
+                    // Make sure the rows add up exactly so that
+                    // greys stay grey (u == v == 128) and white
+                    // maps to exactly Y_OFFSET + Y_SCALE.
+                    yg = Fixed (ys, ENCODE_SHIFT) - yr - yb;
+                    ur = Fixed (-kr / (2.0f * (1.0f - kb)) * cs, ENCODE_SHIFT);
+                    ub = Fixed (0.5f * cs, ENCODE_SHIFT);
+                    ug = -ur - ub;
+                    vr = Fixed (0.5f * cs, ENCODE_SHIFT);
+                    vb = Fixed (-kb / (2.0f * (1.0f - kr)) * cs, ENCODE_SHIFT);
+                    vg = -vr - vb;
+                    cy = Fixed (1.0f / ys, DECODE_SHIFT);
+                    crv = Fixed (2.0f * (1.0f - kr) / cs, DECODE_SHIFT);
+                    cgu = Fixed (2.0f * kb * (1.0f - kb) / kg / cs, DECODE_SHIFT);
+                    cgv = Fixed (2.0f * kr * (1.0f - kr) / kg / cs, DECODE_SHIFT);
+                    cbu = Fixed (2.0f * (1.0f - kb) / cs, DECODE_SHIFT);
+                }
+
+                inline util::ui8 EncodeY (
+                        util::i32 r,
+                        util::i32 g,
+                        util::i32 b) const {
+                    return Clamp ((yr * r + yg * g + yb * b +
+                        (RangeType::Y_OFFSET << ENCODE_SHIFT) + (1 << (ENCODE_SHIFT - 1))) >> ENCODE_SHIFT);
+                }
+
+                inline util::ui8 EncodeU (
+                        util::i32 r,
+                        util::i32 g,
+                        util::i32 b) const {
+                    return Clamp ((ur * r + ug * g + ub * b +
+                        (128 << ENCODE_SHIFT) + (1 << (ENCODE_SHIFT - 1))) >> ENCODE_SHIFT);
+                }
+
+                inline util::ui8 EncodeV (
+                        util::i32 r,
+                        util::i32 g,
+                        util::i32 b) const {
+                    return Clamp ((vr * r + vg * g + vb * b +
+                        (128 << ENCODE_SHIFT) + (1 << (ENCODE_SHIFT - 1))) >> ENCODE_SHIFT);
+                }
+
+                inline void Encode (
+                        const ui8RGBAPixel &in,
+                        ui8YUVAPixel &out) const {
+                    out.y = EncodeY (in.r, in.g, in.b);
+                    out.u = EncodeU (in.r, in.g, in.b);
+                    out.v = EncodeV (in.r, in.g, in.b);
+                    out.a = in.a;
+                }
+
+                inline void Decode (
+                        util::i32 y,
+                        util::i32 u,
+                        util::i32 v,
+                        util::ui8 a,
+                        ui8RGBAPixel &out) const {
+                    y = cy * (y - RangeType::Y_OFFSET) + (1 << (DECODE_SHIFT - 1));
+                    u -= 128;
+                    v -= 128;
+                    out.r = Clamp ((y + crv * v) >> DECODE_SHIFT);
+                    out.g = Clamp ((y - cgu * u - cgv * v) >> DECODE_SHIFT);
+                    out.b = Clamp ((y + cbu * u) >> DECODE_SHIFT);
+                    out.a = a;
+                }
+
+                inline void Decode (
+                        const ui8YUVAPixel &in,
+                        ui8RGBAPixel &out) const {
+                    Decode (in.y, in.u, in.v, in.a, out);
+                }
+            };
+
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            // Two 16 bit coefficients for _mm_madd_epi16 (even lane, odd lane).
+            inline __m128i Pair (
+                    util::i32 even,
+                    util::i32 odd) {
+                return _mm_set1_epi32 ((util::i32)(
+                    ((util::ui32)(util::ui16)even) | ((util::ui32)(util::ui16)odd << 16)));
+            }
+
+            // Split 8 four byte pixels in to 4 vectors of 8 16 bit components.
+            inline void Deinterleave (
+                    const util::ui8 *in,
+                    __m128i &c0,
+                    __m128i &c1,
+                    __m128i &c2,
+                    __m128i &c3) {
+                const __m128i mask = _mm_set1_epi32 (0xff);
+                __m128i p0 = _mm_loadu_si128 ((const __m128i *)in);
+                __m128i p1 = _mm_loadu_si128 ((const __m128i *)(in + 16));
+                c0 = _mm_packs_epi32 (_mm_and_si128 (p0, mask), _mm_and_si128 (p1, mask));
+                c1 = _mm_packs_epi32 (
+                    _mm_and_si128 (_mm_srli_epi32 (p0, 8), mask),
+                    _mm_and_si128 (_mm_srli_epi32 (p1, 8), mask));
+                c2 = _mm_packs_epi32 (
+                    _mm_and_si128 (_mm_srli_epi32 (p0, 16), mask),
+                    _mm_and_si128 (_mm_srli_epi32 (p1, 16), mask));
+                c3 = _mm_packs_epi32 (_mm_srli_epi32 (p0, 24), _mm_srli_epi32 (p1, 24));
+            }
+
+            // Extract the byte at (bit) shift from 8 four byte pixels
+            // (p0, p1) in to a vector of 8 16 bit components.
+            inline __m128i Component (
+                    __m128i p0,
+                    __m128i p1,
+                    __m128i shift) {
+                const __m128i mask = _mm_set1_epi32 (0xff);
+                return _mm_packs_epi32 (
+                    _mm_and_si128 (_mm_srl_epi32 (p0, shift), mask),
+                    _mm_and_si128 (_mm_srl_epi32 (p1, shift), mask));
+            }
+
+            // Inverse of Deinterleave. Components are clamped to [0, 255].
+            inline void Interleave (
+                    __m128i c0,
+                    __m128i c1,
+                    __m128i c2,
+                    __m128i c3,
+                    util::ui8 *out) {
+                const __m128i zero = _mm_setzero_si128 ();
+                __m128i c01 = _mm_unpacklo_epi8 (_mm_packus_epi16 (c0, zero), _mm_packus_epi16 (c1, zero));
+                __m128i c23 = _mm_unpacklo_epi8 (_mm_packus_epi16 (c2, zero), _mm_packus_epi16 (c3, zero));
+                _mm_storeu_si128 ((__m128i *)out, _mm_unpacklo_epi16 (c01, c23));
+                _mm_storeu_si128 ((__m128i *)(out + 16), _mm_unpackhi_epi16 (c01, c23));
+            }
+
+            // (ab . ab_coefficients + c0 . c0_coefficients + bias) >> shift for 8 lanes.
+            // ab holds interleaved (a, b) pairs, c0 interleaved (c, 0) pairs.
+            inline __m128i Dot (
+                    __m128i ab_lo,
+                    __m128i ab_hi,
+                    __m128i ab_coefficients,
+                    __m128i c0_lo,
+                    __m128i c0_hi,
+                    __m128i c0_coefficients,
+                    __m128i bias,
+                    int shift) {
+                __m128i lo = _mm_add_epi32 (
+                    _mm_add_epi32 (
+                        _mm_madd_epi16 (ab_lo, ab_coefficients),
+                        _mm_madd_epi16 (c0_lo, c0_coefficients)),
+                    bias);
+                __m128i hi = _mm_add_epi32 (
+                    _mm_add_epi32 (
+                        _mm_madd_epi16 (ab_hi, ab_coefficients),
+                        _mm_madd_epi16 (c0_hi, c0_coefficients)),
+                    bias);
+                return _mm_packs_epi32 (
+                    _mm_srai_epi32 (lo, shift),
+                    _mm_srai_epi32 (hi, shift));
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+        }
+
+        // The SIMD kernels below produce bit identical results to
+        // FixedPointCoefficients::Encode/Decode used for the tail.
+
+        template<typename Encoding>
+        void YUVASpanConverter<Encoding>::FromRGBA (
+                const ui8RGBAPixel *in,
+                ui8YUVAPixel *out,
+                std::size_t count) {
+            const FixedPointCoefficients<Encoding> coefficients;
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            const __m128i zero = _mm_setzero_si128 ();
+            const __m128i yrg = Pair (coefficients.yr, coefficients.yg);
+            const __m128i yb0 = Pair (coefficients.yb, 0);
+            const __m128i urg = Pair (coefficients.ur, coefficients.ug);
+            const __m128i ub0 = Pair (coefficients.ub, 0);
+            const __m128i vrg = Pair (coefficients.vr, coefficients.vg);
+            const __m128i vb0 = Pair (coefficients.vb, 0);
+            const __m128i ybias = _mm_set1_epi32 (
+                (Encoding::RangeType::Y_OFFSET << ENCODE_SHIFT) + (1 << (ENCODE_SHIFT - 1)));
+            const __m128i cbias = _mm_set1_epi32 ((128 << ENCODE_SHIFT) + (1 << (ENCODE_SHIFT - 1)));
+            for (; count >= 8; count -= 8, in += 8, out += 8) {
+                __m128i r, g, b, a;
+                Deinterleave (&in->r, r, g, b, a);
+                __m128i rg_lo = _mm_unpacklo_epi16 (r, g);
+                __m128i rg_hi = _mm_unpackhi_epi16 (r, g);
+                __m128i b0_lo = _mm_unpacklo_epi16 (b, zero);
+                __m128i b0_hi = _mm_unpackhi_epi16 (b, zero);
+                Interleave (
+                    Dot (rg_lo, rg_hi, yrg, b0_lo, b0_hi, yb0, ybias, ENCODE_SHIFT),
+                    Dot (rg_lo, rg_hi, urg, b0_lo, b0_hi, ub0, cbias, ENCODE_SHIFT),
+                    Dot (rg_lo, rg_hi, vrg, b0_lo, b0_hi, vb0, cbias, ENCODE_SHIFT),
+                    a,
+                    &out->y);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count-- != 0; ++in, ++out) {
+                coefficients.Encode (*in, *out);
+            }
+        }
+
+        template<typename Encoding>
+        void YUVASpanConverter<Encoding>::ToRGBA (
+                const ui8YUVAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count) {
+            const FixedPointCoefficients<Encoding> coefficients;
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            const __m128i zero = _mm_setzero_si128 ();
+            const __m128i yoffset = _mm_set1_epi16 (Encoding::RangeType::Y_OFFSET);
+            const __m128i coffset = _mm_set1_epi16 (128);
+            const __m128i bias = _mm_set1_epi32 (1 << (DECODE_SHIFT - 1));
+            const __m128i r_yv = Pair (coefficients.cy, coefficients.crv);
+            const __m128i g_yu = Pair (coefficients.cy, -coefficients.cgu);
+            const __m128i g_v0 = Pair (-coefficients.cgv, 0);
+            const __m128i b_yu = Pair (coefficients.cy, coefficients.cbu);
+            for (; count >= 8; count -= 8, in += 8, out += 8) {
+                __m128i y, u, v, a;
+                Deinterleave (&in->y, y, u, v, a);
+                y = _mm_sub_epi16 (y, yoffset);
+                u = _mm_sub_epi16 (u, coffset);
+                v = _mm_sub_epi16 (v, coffset);
+                __m128i yu_lo = _mm_unpacklo_epi16 (y, u);
+                __m128i yu_hi = _mm_unpackhi_epi16 (y, u);
+                __m128i yv_lo = _mm_unpacklo_epi16 (y, v);
+                __m128i yv_hi = _mm_unpackhi_epi16 (y, v);
+                __m128i v0_lo = _mm_unpacklo_epi16 (v, zero);
+                __m128i v0_hi = _mm_unpackhi_epi16 (v, zero);
+                Interleave (
+                    Dot (yv_lo, yv_hi, r_yv, zero, zero, zero, bias, DECODE_SHIFT),
+                    Dot (yu_lo, yu_hi, g_yu, v0_lo, v0_hi, g_v0, bias, DECODE_SHIFT),
+                    Dot (yu_lo, yu_hi, b_yu, zero, zero, zero, bias, DECODE_SHIFT),
+                    a,
+                    &out->r);
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            for (; count-- != 0; ++in, ++out) {
+                coefficients.Decode (*in, *out);
+            }
+        }
+
+        template<typename Encoding>
+        void YUVASpanConverter<Encoding>::FromRGBA (
+                const util::ui8 *row0,
+                const util::ui8 *row1,
+                const PackedRGBALayout &layout,
+                util::ui32 width,
+                util::ui8 *y0,
+                util::ui8 *y1,
+                util::ui8 *u,
+                util::ui8 *v,
+                util::ui32 uvStep,
+                bool subsampleX,
+                util::ui8 *a0,
+                util::ui8 *a1) {
+            const FixedPointCoefficients<Encoding> coefficients;
+            const bool hasAlpha = layout.a < layout.pixelStride;
+            const util::ui32 step = subsampleX ? 2 : 1;
+            util::ui32 x = 0;
+        #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            if (layout.pixelStride == 4) {
+                const __m128i zero = _mm_setzero_si128 ();
+                const __m128i opaque = _mm_set1_epi16 (255);
+                const __m128i rShift = _mm_cvtsi32_si128 (8 * layout.r);
+                const __m128i gShift = _mm_cvtsi32_si128 (8 * layout.g);
+                const __m128i bShift = _mm_cvtsi32_si128 (8 * layout.b);
+                const __m128i aShift = _mm_cvtsi32_si128 (8 * (layout.a & 3));
+                const __m128i yrg = Pair (coefficients.yr, coefficients.yg);
+                const __m128i yb0 = Pair (coefficients.yb, 0);
+                const __m128i urg = Pair (coefficients.ur, coefficients.ug);
+                const __m128i ub0 = Pair (coefficients.ub, 0);
+                const __m128i vrg = Pair (coefficients.vr, coefficients.vg);
+                const __m128i vb0 = Pair (coefficients.vb, 0);
+                const __m128i ybias = _mm_set1_epi32 (
+                    (Encoding::RangeType::Y_OFFSET << ENCODE_SHIFT) + (1 << (ENCODE_SHIFT - 1)));
+                const __m128i cbias = _mm_set1_epi32 ((128 << ENCODE_SHIFT) + (1 << (ENCODE_SHIFT - 1)));
+                // Rounding term and shift that turn a sum of 2 (one row)
+                // or 4 (two rows) samples in to their average.
+                const __m128i round = _mm_set1_epi32 (row1 != 0 ? 2 : 1);
+                const int averageShift = row1 != 0 ? 2 : 1;
+                // NV21 stores v first.
+                const bool vFirst = uvStep == 2 && v < u;
+                for (; x + 8 <= width; x += 8) {
+                    __m128i r, g, b;
+                    {
+                        __m128i p0 = _mm_loadu_si128 ((const __m128i *)(row0 + 4 * x));
+                        __m128i p1 = _mm_loadu_si128 ((const __m128i *)(row0 + 4 * x + 16));
+                        r = Component (p0, p1, rShift);
+                        g = Component (p0, p1, gShift);
+                        b = Component (p0, p1, bShift);
+                        _mm_storel_epi64 ((__m128i *)(y0 + x), _mm_packus_epi16 (
+                            Dot (
+                                _mm_unpacklo_epi16 (r, g), _mm_unpackhi_epi16 (r, g), yrg,
+                                _mm_unpacklo_epi16 (b, zero), _mm_unpackhi_epi16 (b, zero), yb0,
+                                ybias, ENCODE_SHIFT),
+                            zero));
+                        if (a0 != 0) {
+                            _mm_storel_epi64 ((__m128i *)(a0 + x), _mm_packus_epi16 (
+                                hasAlpha ? Component (p0, p1, aShift) : opaque, zero));
+                        }
+                    }
+                    if (row1 != 0) {
+                        __m128i p0 = _mm_loadu_si128 ((const __m128i *)(row1 + 4 * x));
+                        __m128i p1 = _mm_loadu_si128 ((const __m128i *)(row1 + 4 * x + 16));
+                        __m128i r1 = Component (p0, p1, rShift);
+                        __m128i g1 = Component (p0, p1, gShift);
+                        __m128i b1 = Component (p0, p1, bShift);
+                        _mm_storel_epi64 ((__m128i *)(y1 + x), _mm_packus_epi16 (
+                            Dot (
+                                _mm_unpacklo_epi16 (r1, g1), _mm_unpackhi_epi16 (r1, g1), yrg,
+                                _mm_unpacklo_epi16 (b1, zero), _mm_unpackhi_epi16 (b1, zero), yb0,
+                                ybias, ENCODE_SHIFT),
+                            zero));
+                        if (a1 != 0) {
+                            _mm_storel_epi64 ((__m128i *)(a1 + x), _mm_packus_epi16 (
+                                hasAlpha ? Component (p0, p1, aShift) : opaque, zero));
+                        }
+                        if (subsampleX) {
+                            // Column sums; the pairs are summed below.
+                            r = _mm_add_epi16 (r, r1);
+                            g = _mm_add_epi16 (g, g1);
+                            b = _mm_add_epi16 (b, b1);
+                        }
+                        else {
+                            // (a + b + 1) >> 1 == scalar average of 2.
+                            r = _mm_avg_epu16 (r, r1);
+                            g = _mm_avg_epu16 (g, g1);
+                            b = _mm_avg_epu16 (b, b1);
+                        }
+                    }
+                    __m128i uv;
+                    if (subsampleX) {
+                        // 4 chroma samples, each the average of 2 or 4 pixels.
+                        const __m128i ones = _mm_set1_epi16 (1);
+                        __m128i ra = _mm_srai_epi32 (
+                            _mm_add_epi32 (_mm_madd_epi16 (r, ones), round), averageShift);
+                        __m128i ga = _mm_srai_epi32 (
+                            _mm_add_epi32 (_mm_madd_epi16 (g, ones), round), averageShift);
+                        __m128i ba = _mm_srai_epi32 (
+                            _mm_add_epi32 (_mm_madd_epi16 (b, ones), round), averageShift);
+                        __m128i rg = _mm_or_si128 (ra, _mm_slli_epi32 (ga, 16));
+                        __m128i uc = _mm_srai_epi32 (
+                            _mm_add_epi32 (
+                                _mm_add_epi32 (_mm_madd_epi16 (rg, urg), _mm_madd_epi16 (ba, ub0)),
+                                cbias),
+                            ENCODE_SHIFT);
+                        __m128i vc = _mm_srai_epi32 (
+                            _mm_add_epi32 (
+                                _mm_add_epi32 (_mm_madd_epi16 (rg, vrg), _mm_madd_epi16 (ba, vb0)),
+                                cbias),
+                            ENCODE_SHIFT);
+                        // u0 u1 u2 u3 v0 v1 v2 v3
+                        uv = _mm_packus_epi16 (_mm_packs_epi32 (uc, vc), zero);
+                        if (uvStep == 1) {
+                            util::i32 uu = _mm_cvtsi128_si32 (uv);
+                            util::i32 vv = _mm_cvtsi128_si32 (_mm_srli_si128 (uv, 4));
+                            memcpy (u + x / 2, &uu, 4);
+                            memcpy (v + x / 2, &vv, 4);
+                        }
+                        else {
+                            __m128i vu = _mm_srli_si128 (uv, 4);
+                            _mm_storel_epi64 (
+                                (__m128i *)((vFirst ? v : u) + x),
+                                vFirst ? _mm_unpacklo_epi8 (vu, uv) : _mm_unpacklo_epi8 (uv, vu));
+                        }
+                    }
+                    else {
+                        // One chroma sample per pixel.
+                        __m128i rg_lo = _mm_unpacklo_epi16 (r, g);
+                        __m128i rg_hi = _mm_unpackhi_epi16 (r, g);
+                        __m128i b0_lo = _mm_unpacklo_epi16 (b, zero);
+                        __m128i b0_hi = _mm_unpackhi_epi16 (b, zero);
+                        __m128i uc = _mm_packus_epi16 (
+                            Dot (rg_lo, rg_hi, urg, b0_lo, b0_hi, ub0, cbias, ENCODE_SHIFT), zero);
+                        __m128i vc = _mm_packus_epi16 (
+                            Dot (rg_lo, rg_hi, vrg, b0_lo, b0_hi, vb0, cbias, ENCODE_SHIFT), zero);
+                        if (uvStep == 1) {
+                            _mm_storel_epi64 ((__m128i *)(u + x), uc);
+                            _mm_storel_epi64 ((__m128i *)(v + x), vc);
+                        }
+                        else {
+                            _mm_storeu_si128 (
+                                (__m128i *)((vFirst ? v : u) + 2 * x),
+                                vFirst ? _mm_unpacklo_epi8 (vc, uc) : _mm_unpacklo_epi8 (uc, vc));
+                        }
+                    }
+                }
+            }
+        #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+            u += (x / step) * uvStep;
+            v += (x / step) * uvStep;
+            for (; x < width; x += step, u += uvStep, v += uvStep) {
+                util::ui32 columns = std::min (step, width - x);
+                util::i32 r = 0;
+                util::i32 g = 0;
+                util::i32 b = 0;
+                for (util::ui32 i = 0; i < columns; ++i) {
+                    const util::ui8 *pixel = row0 + (std::size_t)(x + i) * layout.pixelStride;
+                    y0[x + i] = coefficients.EncodeY (pixel[layout.r], pixel[layout.g], pixel[layout.b]);
+                    if (a0 != 0) {
+                        a0[x + i] = hasAlpha ? pixel[layout.a] : 255;
+                    }
+                    r += pixel[layout.r];
+                    g += pixel[layout.g];
+                    b += pixel[layout.b];
+                }
+                util::i32 count = columns;
+                if (row1 != 0) {
+                    for (util::ui32 i = 0; i < columns; ++i) {
+                        const util::ui8 *pixel = row1 + (std::size_t)(x + i) * layout.pixelStride;
+                        y1[x + i] = coefficients.EncodeY (pixel[layout.r], pixel[layout.g], pixel[layout.b]);
+                        if (a1 != 0) {
+                            a1[x + i] = hasAlpha ? pixel[layout.a] : 255;
+                        }
+                        r += pixel[layout.r];
+                        g += pixel[layout.g];
+                        b += pixel[layout.b];
+                    }
+                    count += columns;
+                }
+                // Chroma is computed from the (rounded) average
+                // color of the pixels the sample covers.
+                r = (r + count / 2) / count;
+                g = (g + count / 2) / count;
+                b = (b + count / 2) / count;
+                *u = coefficients.EncodeU (r, g, b);
+                *v = coefficients.EncodeV (r, g, b);
+            }
+        }
+
+        template<typename Encoding>
+        void YUVASpanConverter<Encoding>::ToRGBA (
+                const util::ui8 *y,
+                const util::ui8 *u,
+                const util::ui8 *v,
+                util::ui32 uvStep,
+                bool subsampleX,
+                const util::ui8 *a,
+                ui8RGBAPixel *out,
+                util::ui32 width) {
+            const FixedPointCoefficients<Encoding> coefficients;
+            const util::ui32 shift = subsampleX ? 1 : 0;
+            for (util::ui32 x = 0; x < width; ++x) {
+                std::size_t uv = (std::size_t)(x >> shift) * uvStep;
+                coefficients.Decode (y[x], u[uv], v[uv], a != 0 ? a[x] : 255, out[x]);
+            }
+        }
+
+        template struct _LIB_THEKOGANS_CANVAS_DECL YUVASpanConverter<YUVEncoding<YUVMatrixBT601, YUVRangeLimited>>;
+        template struct _LIB_THEKOGANS_CANVAS_DECL YUVASpanConverter<YUVEncoding<YUVMatrixBT601, YUVRangeFull>>;
+        template struct _LIB_THEKOGANS_CANVAS_DECL YUVASpanConverter<YUVEncoding<YUVMatrixBT709, YUVRangeLimited>>;
+        template struct _LIB_THEKOGANS_CANVAS_DECL YUVASpanConverter<YUVEncoding<YUVMatrixBT709, YUVRangeFull>>;
+        template struct _LIB_THEKOGANS_CANVAS_DECL YUVASpanConverter<YUVEncoding<YUVMatrixBT2020, YUVRangeLimited>>;
+        template struct _LIB_THEKOGANS_CANVAS_DECL YUVASpanConverter<YUVEncoding<YUVMatrixBT2020, YUVRangeFull>>;
+
+        void SpanConverter<ui8RGBAPixel, ui8YUVAPixel>::Convert (
+                const ui8RGBAPixel *in,
+                ui8YUVAPixel *out,
+                std::size_t count) {
+            YUVASpanConverter<DefaultYUVEncoding>::FromRGBA (in, out, count);
+        }
+
+        void SpanConverter<ui8YUVAPixel, ui8RGBAPixel>::Convert (
+                const ui8YUVAPixel *in,
+                ui8RGBAPixel *out,
+                std::size_t count) {
+            YUVASpanConverter<DefaultYUVEncoding>::ToRGBA (in, out, count);
+        }
+
+    } // namespace canvas
+} // namespace thekogans
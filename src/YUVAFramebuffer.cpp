@@ -0,0 +1,393 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <vector>
+#include "thekogans/util/File.h"
+#include "thekogans/canvas/YUVAFramebuffer.h"
+#include "thekogans/canvas/TJUtils.h"
+#include "thekogans/canvas/MappedFile.h"
+
+namespace thekogans {
+    namespace canvas {
+
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui8YUVAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui16YUVAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui32YUVAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (f32YUVAFramebuffer)
+
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui8VUYAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui16VUYAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui32VUYAFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (f32VUYAFramebuffer)
+
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui8AYUVFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui16AYUVFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui32AYUVFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (f32AYUVFramebuffer)
+
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui8AVUYFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui16AVUYFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (ui32AVUYFramebuffer)
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (f32AVUYFramebuffer)
+
+        THEKOGANS_UTIL_IMPLEMENT_HEAP_FUNCTIONS_T (PlanarYUVAFramebuffer)
+
+        namespace {
+            inline util::ui32 AlignStride (util::ui32 stride) {
+                return (stride + PlanarYUVAFramebuffer::STRIDE_ALIGNMENT - 1) &
+                    ~(util::ui32)(PlanarYUVAFramebuffer::STRIDE_ALIGNMENT - 1);
+            }
+
+            util::ui32 GetChromaWidth (
+                    util::ui32 width,
+                    PlanarYUVAFramebuffer::Format format) {
+                return format == PlanarYUVAFramebuffer::I444 ? width : (width + 1) / 2;
+            }
+
+            util::ui32 GetChromaHeight (
+                    util::ui32 height,
+                    PlanarYUVAFramebuffer::Format format) {
+                return format == PlanarYUVAFramebuffer::I444 ||
+                    format == PlanarYUVAFramebuffer::I422 ? height : (height + 1) / 2;
+            }
+
+            PlanarYUVAFramebuffer::Strides GetStrides (
+                    const util::Rectangle::Extents &extents,
+                    PlanarYUVAFramebuffer::Format format,
+                    bool hasAlpha) {
+                util::ui32 chromaWidth = GetChromaWidth (extents.width, format);
+                if (format == PlanarYUVAFramebuffer::NV12 ||
+                        format == PlanarYUVAFramebuffer::NV21) {
+                    return PlanarYUVAFramebuffer::Strides (
+                        AlignStride (extents.width),
+                        AlignStride (2 * chromaWidth),
+                        0,
+                        hasAlpha ? AlignStride (extents.width) : 0);
+                }
+                return PlanarYUVAFramebuffer::Strides (
+                    AlignStride (extents.width),
+                    AlignStride (chromaWidth),
+                    AlignStride (chromaWidth),
+                    hasAlpha ? AlignStride (extents.width) : 0);
+            }
+
+            std::size_t GetSize (
+                    const util::Rectangle::Extents &extents,
+                    PlanarYUVAFramebuffer::Format format,
+                    const PlanarYUVAFramebuffer::Strides &strides) {
+                std::size_t chromaHeight = GetChromaHeight (extents.height, format);
+                return
+                    (std::size_t)strides[PlanarYUVAFramebuffer::Y_INDEX] * extents.height +
+                    (std::size_t)strides[PlanarYUVAFramebuffer::U_INDEX] * chromaHeight +
+                    (std::size_t)strides[PlanarYUVAFramebuffer::V_INDEX] * chromaHeight +
+                    (std::size_t)strides[PlanarYUVAFramebuffer::A_INDEX] * extents.height;
+            }
+
+            void CopyPlane (
+                    const util::ui8 *src,
+                    util::ui32 srcStride,
+                    util::ui8 *dst,
+                    util::ui32 dstStride,
+                    std::size_t width,
+                    util::ui32 height) {
+                while (height-- != 0) {
+                    memcpy (dst, src, width);
+                    src += srcStride;
+                    dst += dstStride;
+                }
+            }
+
+            void FillPlane (
+                    util::ui8 *dst,
+                    util::ui32 stride,
+                    std::size_t width,
+                    util::ui32 height,
+                    util::ui8 value) {
+                while (height-- != 0) {
+                    memset (dst, value, width);
+                    dst += stride;
+                }
+            }
+        }
+
+        Framebuffer<PlanarYUVAPixel>::Framebuffer (
+                const util::Rectangle::Extents &extents_,
+                Format format_,
+                bool hasAlpha) :
+                extents (extents_),
+                format (format_),
+                strides (GetStrides (extents_, format_, hasAlpha)),
+                buffer (GetSize (extents_, format_, strides)) {
+            std::size_t chromaHeight = GetChromaHeight (extents.height, format);
+            planes.planes[Y_INDEX] = buffer.array;
+            planes.planes[U_INDEX] = planes[Y_INDEX] + (std::size_t)strides[Y_INDEX] * extents.height;
+            planes.planes[V_INDEX] = IsSemiPlanar () ?
+                0 : planes[U_INDEX] + (std::size_t)strides[U_INDEX] * chromaHeight;
+            planes.planes[A_INDEX] = hasAlpha ?
+                planes[U_INDEX] + (std::size_t)(strides[U_INDEX] + strides[V_INDEX]) * chromaHeight : 0;
+        }
+
+        Framebuffer<PlanarYUVAPixel>::Framebuffer (
+            const util::Rectangle::Extents &extents_,
+            Format format_,
+            const Planes &planes_,
+            const Strides &strides_,
+            util::ui8 *buffer_,
+            const util::Array<util::ui8>::Deleter &deleter) :
+            extents (extents_),
+            format (format_),
+            planes (planes_),
+            strides (strides_),
+            buffer (0, buffer_, deleter) {}
+
+        PlanarYUVAFramebuffer::ColorType Framebuffer<PlanarYUVAPixel>::ColorAt (
+                util::ui32 x,
+                util::ui32 y) const {
+            const util::ui8 *u;
+            const util::ui8 *v;
+            GetChromaRow (IsSubsampledY () ? y >> 1 : y, u, v);
+            std::size_t chroma = (std::size_t)(IsSubsampledX () ? x >> 1 : x) *
+                (IsSemiPlanar () ? 2 : 1);
+            return ColorType (
+                planes[Y_INDEX][(std::size_t)y * strides[Y_INDEX] + x],
+                u[chroma],
+                v[chroma],
+                HasAlpha () ? planes[A_INDEX][(std::size_t)y * strides[A_INDEX] + x] : 255);
+        }
+
+        PlanarYUVAFramebuffer::SharedPtr Framebuffer<PlanarYUVAPixel>::Copy () const {
+            SharedPtr framebuffer (new Framebuffer (extents, format, HasAlpha ()));
+            util::Rectangle::Extents chromaExtents = GetChromaExtents ();
+            CopyPlane (
+                planes[Y_INDEX], strides[Y_INDEX],
+                framebuffer->planes[Y_INDEX], framebuffer->strides[Y_INDEX],
+                extents.width, extents.height);
+            if (IsSemiPlanar ()) {
+                CopyPlane (
+                    planes[U_INDEX], strides[U_INDEX],
+                    framebuffer->planes[U_INDEX], framebuffer->strides[U_INDEX],
+                    2 * (std::size_t)chromaExtents.width, chromaExtents.height);
+            }
+            else {
+                CopyPlane (
+                    planes[U_INDEX], strides[U_INDEX],
+                    framebuffer->planes[U_INDEX], framebuffer->strides[U_INDEX],
+                    chromaExtents.width, chromaExtents.height);
+                CopyPlane (
+                    planes[V_INDEX], strides[V_INDEX],
+                    framebuffer->planes[V_INDEX], framebuffer->strides[V_INDEX],
+                    chromaExtents.width, chromaExtents.height);
+            }
+            if (HasAlpha ()) {
+                CopyPlane (
+                    planes[A_INDEX], strides[A_INDEX],
+                    framebuffer->planes[A_INDEX], framebuffer->strides[A_INDEX],
+                    extents.width, extents.height);
+            }
+            return framebuffer;
+        }
+
+        void Framebuffer<PlanarYUVAPixel>::Clear (const ColorType &color) {
+            util::Rectangle::Extents chromaExtents = GetChromaExtents ();
+            FillPlane (
+                planes[Y_INDEX], strides[Y_INDEX],
+                extents.width, extents.height, color.y);
+            if (IsSemiPlanar ()) {
+                for (util::ui32 row = 0; row < chromaExtents.height; ++row) {
+                    util::ui8 *u;
+                    util::ui8 *v;
+                    GetChromaRow (row, u, v);
+                    for (util::ui32 width = chromaExtents.width; width-- != 0; u += 2, v += 2) {
+                        *u = color.u;
+                        *v = color.v;
+                    }
+                }
+            }
+            else {
+                FillPlane (
+                    planes[U_INDEX], strides[U_INDEX],
+                    chromaExtents.width, chromaExtents.height, color.u);
+                FillPlane (
+                    planes[V_INDEX], strides[V_INDEX],
+                    chromaExtents.width, chromaExtents.height, color.v);
+            }
+            if (HasAlpha ()) {
+                FillPlane (
+                    planes[A_INDEX], strides[A_INDEX],
+                    extents.width, extents.height, color.a);
+            }
+        }
+
+        PlanarYUVAFramebuffer::SharedPtr Framebuffer<PlanarYUVAPixel>::FromJPGBuffer (
+                const util::ui8 *buffer,
+                std::size_t size) {
+            TJDecompressHandle handle;
+            int width;
+            int height;
+            int jpegSubsamp;
+            int jpegColorspace;
+            if (tjDecompressHeader3 (
+                    handle.handle,
+                    buffer,
+                    size,
+                    &width,
+                    &height,
+                    &jpegSubsamp,
+                    &jpegColorspace) == 0) {
+                Format format;
+                switch (jpegSubsamp) {
+                    case TJSAMP_420:
+                    case TJSAMP_GRAY:
+                        format = I420;
+                        break;
+                    case TJSAMP_422:
+                        format = I422;
+                        break;
+                    case TJSAMP_444:
+                        format = I444;
+                        break;
+                    default:
+                        // No planar format for 4:4:0 and 4:1:1.
+                        return FromRGBA<JPEGYUVEncoding> (*canvas::FromJPGBuffer (buffer, size));
+                }
+                SharedPtr framebuffer (
+                    new Framebuffer (util::Rectangle::Extents (width, height), format));
+                util::ui8 *dstPlanes[3] = {
+                    framebuffer->planes[Y_INDEX],
+                    framebuffer->planes[U_INDEX],
+                    framebuffer->planes[V_INDEX]
+                };
+                int dstStrides[3] = {
+                    (int)framebuffer->strides[Y_INDEX],
+                    (int)framebuffer->strides[U_INDEX],
+                    (int)framebuffer->strides[V_INDEX]
+                };
+                if (tjDecompressToYUVPlanes (
+                        handle.handle,
+                        buffer,
+                        size,
+                        dstPlanes,
+                        width,
+                        dstStrides,
+                        height,
+                        0) == 0) {
+                    if (jpegSubsamp == TJSAMP_GRAY) {
+                        util::Rectangle::Extents chromaExtents = framebuffer->GetChromaExtents ();
+                        FillPlane (
+                            framebuffer->planes[U_INDEX], framebuffer->strides[U_INDEX],
+                            chromaExtents.width, chromaExtents.height, 128);
+                        FillPlane (
+                            framebuffer->planes[V_INDEX], framebuffer->strides[V_INDEX],
+                            chromaExtents.width, chromaExtents.height, 128);
+                    }
+                    return framebuffer;
+                }
+                else {
+                    THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                        "%s", tjGetErrorStr ());
+                }
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "%s", tjGetErrorStr ());
+            }
+        }
+
+        PlanarYUVAFramebuffer::SharedPtr Framebuffer<PlanarYUVAPixel>::FromJPGFile (
+                const std::string &path) {
+            MappedFile file (path);
+            if (file.size > 0) {
+                return FromJPGBuffer (file.data, file.size);
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "Empty jpg file: %s", path.c_str ());
+            }
+        }
+
+        void Framebuffer<PlanarYUVAPixel>::ToJPGBuffer (
+                TJBuffer &buffer,
+                util::ui32 quality) const {
+            util::Rectangle::Extents chromaExtents = GetChromaExtents ();
+            const util::ui8 *srcPlanes[3] = {
+                planes[Y_INDEX],
+                planes[U_INDEX],
+                planes[V_INDEX]
+            };
+            int srcStrides[3] = {
+                (int)strides[Y_INDEX],
+                (int)strides[U_INDEX],
+                (int)strides[V_INDEX]
+            };
+            // turbojpeg only speaks planar. Split the interleaved chroma.
+            std::vector<util::ui8> chroma;
+            if (IsSemiPlanar ()) {
+                std::size_t chromaSize = (std::size_t)chromaExtents.width * chromaExtents.height;
+                chroma.resize (2 * chromaSize);
+                util::ui8 *dstU = chroma.data ();
+                util::ui8 *dstV = dstU + chromaSize;
+                srcPlanes[U_INDEX] = dstU;
+                srcPlanes[V_INDEX] = dstV;
+                srcStrides[U_INDEX] = srcStrides[V_INDEX] = (int)chromaExtents.width;
+                for (util::ui32 row = 0; row < chromaExtents.height; ++row) {
+                    const util::ui8 *u;
+                    const util::ui8 *v;
+                    GetChromaRow (row, u, v);
+                    for (util::ui32 width = chromaExtents.width; width-- != 0; u += 2, v += 2) {
+                        *dstU++ = *u;
+                        *dstV++ = *v;
+                    }
+                }
+            }
+            int subsamp =
+                format == I444 ? TJSAMP_444 :
+                format == I422 ? TJSAMP_422 : TJSAMP_420;
+            buffer.Reserve (extents.width, extents.height, subsamp);
+            TJCompressHandle handle;
+            util::ui8 *ptr = buffer.data;
+            unsigned long size = (unsigned long)buffer.capacity;
+            if (tjCompressFromYUVPlanes (
+                    handle.handle,
+                    srcPlanes,
+                    extents.width,
+                    srcStrides,
+                    extents.height,
+                    subsamp,
+                    &ptr,
+                    &size,
+                    quality,
+                    TJFLAG_NOREALLOC) == 0) {
+                buffer.size = size;
+            }
+            else {
+                THEKOGANS_UTIL_THROW_STRING_EXCEPTION (
+                    "%s", tjGetErrorStr ());
+            }
+        }
+
+        void Framebuffer<PlanarYUVAPixel>::ToJPGFile (
+                const std::string &path,
+                util::ui32 quality) const {
+            TJBuffer buffer;
+            ToJPGBuffer (buffer, quality);
+            util::File file (util::HostEndian, path);
+            file.Write (buffer.data, buffer.size);
+        }
+
+    } // namespace canvas
+} // namespace thekogans
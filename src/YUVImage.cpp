@@ -16,9 +16,19 @@
 // along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
 
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <vector>
+#include "thekogans/canvas/Config.h"
+#if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+    #include <emmintrin.h>
+#endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
 #include <libyuv.h>
 #include "thekogans/util/SpinLock.h"
+#include "thekogans/util/Constants.h"
+#include "thekogans/canvas/Parallel.h"
+#include "thekogans/canvas/YUVAConverter.h"
 #include "thekogans/canvas/RGBImage.h"
 #include "thekogans/canvas/YUVImage.h"
 
@@ -31,48 +41,49 @@ namespace thekogans {
                 const util::Rectangle::Extents &extents_,
                 bool hasAlpha,
                 bool clear) :
+                // Chroma extents are rounded up so that odd
+                // widths and heights keep their last column/row.
                 data (
                     new util::ui8[
                         extents_.GetArea () + // Y
-                        extents_.GetArea () / 2 + // UV
+                        2 * ((extents_.width + 1) / 2) * ((extents_.height + 1) / 2) + // UV
                         (hasAlpha ? extents_.GetArea () : 0)]), // A
                 extents (extents_),
                 owner (true) {
+            util::ui32 chromaWidth = (extents.width + 1) / 2;
+            util::ui32 chromaArea = chromaWidth * ((extents.height + 1) / 2);
             planes.planes[Y_INDEX] = data;
             planes.planes[U_INDEX] = data + extents.GetArea ();
-            planes.planes[V_INDEX] = data + 5 * extents.GetArea () / 4;
-            planes.planes[A_INDEX] = hasAlpha ? data + 3 * extents.GetArea () / 2 : 0;
+            planes.planes[V_INDEX] = planes.planes[U_INDEX] + chromaArea;
+            planes.planes[A_INDEX] = hasAlpha ? planes.planes[V_INDEX] + chromaArea : 0;
             strides.strides[Y_INDEX] = extents.width;
             strides.strides[U_INDEX] =
-            strides.strides[V_INDEX] = extents.width / 2;
+            strides.strides[V_INDEX] = chromaWidth;
             strides.strides[A_INDEX] = hasAlpha ? extents.width : 0;
         }
 
         namespace {
-            #define RGB2YUV_SHIFT 15
-
-            #define RY ( (int)(0.299 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define GY ( (int)(0.587 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define BY ( (int)(0.114 * 219 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-
-            #define RU (-(int)(0.169 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define GU (-(int)(0.331 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define BU ( (int)(0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-
-            #define RV ( (int)(0.500 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define GV (-(int)(0.419 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
-            #define BV (-(int)(0.081 * 224 / 255 * (1 << RGB2YUV_SHIFT) + 0.5))
+            // Encode a color the way RGBImage::ToYUVImage encodes its
+            // pixels (BT.601 limited range), so that cleared and filled
+            // areas match converted content exactly.
+            inline ui8YUVAPixel EncodeColor (const ui8RGBAColor &color) {
+                ui8RGBAPixel in (color);
+                ui8YUVAPixel out;
+                YUVASpanConverter<YUVEncoding<YUVMatrixBT601, YUVRangeLimited>>::FromRGBA (
+                    &in, &out, 1);
+                return out;
+            }
         }
 
         void YUVImage::Clear (
                 const util::Rectangle &rectangle,
-                const Color &color) {
+                const ui8RGBAColor &color) {
             util::Rectangle srcRectangle = rectangle.Intersection (GetRectangle ());
             if (!srcRectangle.IsDegenerate ()) {
+                ui8YUVAPixel pixel = EncodeColor (color);
                 // Y
                 {
-                    util::ui8 y =
-                        ((RY * color.r + GY * color.g + BY * color.b) >> RGB2YUV_SHIFT) + 16;
+                    util::ui8 y = pixel.y;
                     util::ui32 yStride = strides[Y_INDEX];
                     util::ui8 *yPlane = planes[Y_INDEX] +
                         srcRectangle.origin.y * yStride + srcRectangle.origin.x;
@@ -85,10 +96,8 @@ namespace thekogans {
                 }
                 // UV
                 {
-                    util::ui8 u =
-                        ((RU * color.r + GU * color.g + BU * color.b) >> RGB2YUV_SHIFT) + 128;
-                    util::ui8 v =
-                        ((RV * color.r + GV * color.g + BV * color.b) >> RGB2YUV_SHIFT) + 128;
+                    util::ui8 u = pixel.u;
+                    util::ui8 v = pixel.v;
                     util::ui32 uStride = strides[U_INDEX];
                     util::ui32 vStride = strides[V_INDEX];
                     util::ui8 *uPlane = planes[U_INDEX] +
@@ -198,11 +207,156 @@ namespace thekogans {
                 angle == Angle180 ? libyuv::kRotate180 : libyuv::kRotate270);
         }
 
+        namespace {
+            struct Rotation {
+                util::f32 cosAngle;
+                util::f32 sinAngle;
+                // Center of rotation.
+                util::f32 x0;
+                util::f32 y0;
+                // Top left corner of the rotated bounds.
+                util::f32 left;
+                util::f32 top;
+            };
+
+            // Rotate one plane by inverse mapping each destination sample in
+            // to the source plane and bilinearly interpolating it there.
+            // scale is the subsampling factor of the plane (1 for Y and A, 2
+            // for I420 chroma). Chroma samples are sited at the center of the
+            // 2x2 luma block they cover, so they are mapped through the luma
+            // grid (and back) to keep them aligned with the rotated luma.
+            void RotatePlane (
+                    const util::ui8 *src,
+                    util::ui32 srcStride,
+                    util::ui32 srcWidth,
+                    util::ui32 srcHeight,
+                    util::ui8 *dst,
+                    util::ui32 dstStride,
+                    util::ui32 dstWidth,
+                    util::ui32 dstHeight,
+                    const Rotation &rotation,
+                    util::f32 scale,
+                    util::ui8 fill) {
+                const util::f32 center = (scale - 1.0f) * 0.5f;
+                // Source coordinates are stepped in 16.16 fixed point.
+                // Along a destination row they advance by (cos, -sin).
+                const util::i64 dx = (util::i64)floor (rotation.cosAngle * 65536.0f + 0.5f);
+                const util::i64 dy = (util::i64)floor (-rotation.sinAngle * 65536.0f + 0.5f);
+                // Samples within half a pixel of the plane are clamped to it.
+                const util::i64 minX = -(1 << 15);
+                const util::i64 maxX = ((util::i64)srcWidth << 16) - (1 << 15);
+                const util::i64 minY = -(1 << 15);
+                const util::i64 maxY = ((util::i64)srcHeight << 16) - (1 << 15);
+                const util::i64 lastX = (util::i64)(srcWidth - 1) << 16;
+                const util::i64 lastY = (util::i64)(srcHeight - 1) << 16;
+                ParallelFor (0, dstHeight,
+                    [&] (std::size_t begin, std::size_t end) {
+                        for (std::size_t j = begin; j < end; ++j) {
+                            util::f32 x = rotation.left + center - rotation.x0;
+                            util::f32 y = rotation.top + scale * j + center - rotation.y0;
+                            util::f32 px = (rotation.x0 +
+                                x * rotation.cosAngle + y * rotation.sinAngle - center) / scale;
+                            util::f32 py = (rotation.y0 +
+                                y * rotation.cosAngle - x * rotation.sinAngle - center) / scale;
+                            util::i64 fx = (util::i64)floor (px * 65536.0f + 0.5f);
+                            util::i64 fy = (util::i64)floor (py * 65536.0f + 0.5f);
+                            util::ui8 *dstRow = dst + j * dstStride;
+                            for (util::ui32 i = 0; i < dstWidth; ++i, fx += dx, fy += dy) {
+                                if (fx > minX && fx < maxX && fy > minY && fy < maxY) {
+                                    util::i64 cx = std::max<util::i64> (0, std::min (fx, lastX));
+                                    util::i64 cy = std::max<util::i64> (0, std::min (fy, lastY));
+                                    util::ui32 x0 = (util::ui32)(cx >> 16);
+                                    util::ui32 y0 = (util::ui32)(cy >> 16);
+                                    util::ui32 x1 = std::min (x0 + 1, srcWidth - 1);
+                                    util::ui32 y1 = std::min (y0 + 1, srcHeight - 1);
+                                    util::ui32 wx = (util::ui32)(cx >> 8) & 0xff;
+                                    util::ui32 wy = (util::ui32)(cy >> 8) & 0xff;
+                                    const util::ui8 *row0 = src + y0 * srcStride;
+                                    const util::ui8 *row1 = src + y1 * srcStride;
+                                    util::ui32 top = row0[x0] * (256 - wx) + row0[x1] * wx;
+                                    util::ui32 bottom = row1[x0] * (256 - wx) + row1[x1] * wx;
+                                    dstRow[i] = (util::ui8)
+                                        ((top * (256 - wy) + bottom * wy + 32768) >> 16);
+                                }
+                                else {
+                                    dstRow[i] = fill;
+                                }
+                            }
+                        }
+                    },
+                    16);
+            }
+        }
+
         YUVImage::UniquePtr YUVImage::Rotate (util::f32 angle,
-                const util::Point &centerOfRotation, const Color &fillColor) const {
-            // FIXME: implement
-            assert (0);
-            return YUVImage::UniquePtr ();
+                const util::Point &centerOfRotation, const ui8RGBAColor &fillColor) const {
+            Rotation rotation;
+            rotation.cosAngle = cos (util::RAD (angle));
+            rotation.sinAngle = sin (util::RAD (angle));
+            rotation.x0 = (util::f32)centerOfRotation.x;
+            rotation.y0 = (util::f32)centerOfRotation.y;
+            // Bounds of the rotated image (same as RGBImage::Rotate).
+            util::f32 minX = rotation.x0;
+            util::f32 minY = rotation.y0;
+            util::f32 maxX = rotation.x0;
+            util::f32 maxY = rotation.y0;
+            const util::f32 corners[4][2] = {
+                {0.0f, 0.0f},
+                {0.0f, (util::f32)extents.height},
+                {(util::f32)extents.width, 0.0f},
+                {(util::f32)extents.width, (util::f32)extents.height}
+            };
+            for (std::size_t i = 0; i < 4; ++i) {
+                util::f32 x = corners[i][0] - rotation.x0;
+                util::f32 y = corners[i][1] - rotation.y0;
+                util::f32 rx = rotation.x0 + x * rotation.cosAngle - y * rotation.sinAngle;
+                util::f32 ry = rotation.y0 + y * rotation.cosAngle + x * rotation.sinAngle;
+                if (i == 0) {
+                    minX = maxX = rx;
+                    minY = maxY = ry;
+                }
+                else {
+                    minX = std::min (minX, rx);
+                    maxX = std::max (maxX, rx);
+                    minY = std::min (minY, ry);
+                    maxY = std::max (maxY, ry);
+                }
+            }
+            rotation.left = floor (minX);
+            rotation.top = floor (minY);
+            util::Rectangle::Extents dstExtents (
+                (util::ui32)(ceil (maxX) - rotation.left) + 1,
+                (util::ui32)(ceil (maxY) - rotation.top) + 1);
+            UniquePtr dst (new YUVImage (dstExtents, planes[A_INDEX] != 0));
+            ui8YUVAPixel fill = EncodeColor (fillColor);
+            // Y
+            RotatePlane (
+                planes[Y_INDEX], strides[Y_INDEX], extents.width, extents.height,
+                dst->planes[Y_INDEX], dst->strides[Y_INDEX], dstExtents.width, dstExtents.height,
+                rotation, 1.0f, fill.y);
+            // UV
+            {
+                util::ui32 srcWidth = (extents.width + 1) / 2;
+                util::ui32 srcHeight = (extents.height + 1) / 2;
+                util::ui32 dstWidth = (dstExtents.width + 1) / 2;
+                util::ui32 dstHeight = (dstExtents.height + 1) / 2;
+                RotatePlane (
+                    planes[U_INDEX], strides[U_INDEX], srcWidth, srcHeight,
+                    dst->planes[U_INDEX], dst->strides[U_INDEX], dstWidth, dstHeight,
+                    rotation, 2.0f, fill.u);
+                RotatePlane (
+                    planes[V_INDEX], strides[V_INDEX], srcWidth, srcHeight,
+                    dst->planes[V_INDEX], dst->strides[V_INDEX], dstWidth, dstHeight,
+                    rotation, 2.0f, fill.v);
+            }
+            // A
+            if (planes[A_INDEX] != 0) {
+                RotatePlane (
+                    planes[A_INDEX], strides[A_INDEX], extents.width, extents.height,
+                    dst->planes[A_INDEX], dst->strides[A_INDEX], dstExtents.width, dstExtents.height,
+                    rotation, 1.0f, fillColor.a);
+            }
+            return dst;
         }
 
         std::string YUVImage::AxisTostring (Axis axis) {
@@ -488,6 +642,253 @@ namespace thekogans {
             }
         }
 
+        namespace {
+            inline util::i32 FloorDiv2 (util::i32 value) {
+                return value >= 0 ? value / 2 : -((1 - value) / 2);
+            }
+
+            // Exact (value + 127) / 255 for value in [0, 255 * 255].
+            inline util::ui32 Div255 (util::ui32 value) {
+                value += 128;
+                return (value + (value >> 8)) >> 8;
+            }
+
+            // c' = (c - 128) * scale + 128, scale in Q9 fixed point.
+            // (c - 128) << 7 fits in 16 bits, so the product's high
+            // half (_mm_mulhi_epi16) is ((c - 128) * scale) >> 9.
+            void ScaleRow (
+                    util::ui8 *row,
+                    util::ui32 width,
+                    util::i32 scale) {
+                util::ui32 x = 0;
+            #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                const __m128i zero = _mm_setzero_si128 ();
+                const __m128i offset = _mm_set1_epi16 (128);
+                const __m128i scale16 = _mm_set1_epi16 ((util::i16)scale);
+                for (; x + 16 <= width; x += 16) {
+                    __m128i value = _mm_loadu_si128 ((const __m128i *)(row + x));
+                    __m128i lo = _mm_slli_epi16 (_mm_sub_epi16 (_mm_unpacklo_epi8 (value, zero), offset), 7);
+                    __m128i hi = _mm_slli_epi16 (_mm_sub_epi16 (_mm_unpackhi_epi8 (value, zero), offset), 7);
+                    lo = _mm_add_epi16 (_mm_mulhi_epi16 (lo, scale16), offset);
+                    hi = _mm_add_epi16 (_mm_mulhi_epi16 (hi, scale16), offset);
+                    _mm_storeu_si128 ((__m128i *)(row + x), _mm_packus_epi16 (lo, hi));
+                }
+            #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                for (; x < width; ++x) {
+                    // (c - 128) can be negative, so scale it with * 128, not << 7.
+                    util::i32 value = (((((util::i32)row[x] - 128) * 128) * scale) >> 16) + 128;
+                    row[x] = (util::ui8)(value < 0 ? 0 : value > 255 ? 255 : value);
+                }
+            }
+
+            // dst = (src * alpha + dst * (255 - alpha)) / 255
+            void BlendRow (
+                    const util::ui8 *src,
+                    const util::ui8 *alpha,
+                    util::ui8 *dst,
+                    util::ui32 width) {
+                util::ui32 x = 0;
+            #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                const __m128i zero = _mm_setzero_si128 ();
+                const __m128i opaque = _mm_set1_epi16 (255);
+                const __m128i half = _mm_set1_epi16 (128);
+                for (; x + 16 <= width; x += 16) {
+                    __m128i s = _mm_loadu_si128 ((const __m128i *)(src + x));
+                    __m128i a = _mm_loadu_si128 ((const __m128i *)(alpha + x));
+                    __m128i d = _mm_loadu_si128 ((const __m128i *)(dst + x));
+                    __m128i alo = _mm_unpacklo_epi8 (a, zero);
+                    __m128i ahi = _mm_unpackhi_epi8 (a, zero);
+                    __m128i lo = _mm_add_epi16 (
+                        _mm_add_epi16 (
+                            _mm_mullo_epi16 (_mm_unpacklo_epi8 (s, zero), alo),
+                            _mm_mullo_epi16 (_mm_unpacklo_epi8 (d, zero), _mm_sub_epi16 (opaque, alo))),
+                        half);
+                    __m128i hi = _mm_add_epi16 (
+                        _mm_add_epi16 (
+                            _mm_mullo_epi16 (_mm_unpackhi_epi8 (s, zero), ahi),
+                            _mm_mullo_epi16 (_mm_unpackhi_epi8 (d, zero), _mm_sub_epi16 (opaque, ahi))),
+                        half);
+                    lo = _mm_srli_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+                    hi = _mm_srli_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+                    _mm_storeu_si128 ((__m128i *)(dst + x), _mm_packus_epi16 (lo, hi));
+                }
+            #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                for (; x < width; ++x) {
+                    dst[x] = (util::ui8)Div255 (src[x] * alpha[x] + dst[x] * (255 - alpha[x]));
+                }
+            }
+
+            // Chroma alpha is the average of the 2x2 luma alpha block
+            // a chroma sample covers. alpha0 and alpha1 point at the
+            // block's two alpha rows, alphaWidth is the number of alpha
+            // samples available in them (the last block may be 1 wide).
+            void ChromaAlphaRow (
+                    const util::ui8 *alpha0,
+                    const util::ui8 *alpha1,
+                    util::ui32 alphaWidth,
+                    util::ui8 *chromaAlpha,
+                    util::ui32 width) {
+                util::ui32 x = 0;
+            #if defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                const __m128i mask = _mm_set1_epi16 (0xff);
+                const __m128i zero = _mm_setzero_si128 ();
+                for (; x + 8 <= width && 2 * x + 16 <= alphaWidth; x += 8) {
+                    __m128i a0 = _mm_loadu_si128 ((const __m128i *)(alpha0 + 2 * x));
+                    __m128i a1 = _mm_loadu_si128 ((const __m128i *)(alpha1 + 2 * x));
+                    __m128i even0 = _mm_and_si128 (a0, mask);
+                    __m128i odd0 = _mm_srli_epi16 (a0, 8);
+                    __m128i even1 = _mm_and_si128 (a1, mask);
+                    __m128i odd1 = _mm_srli_epi16 (a1, 8);
+                    __m128i sum = _mm_add_epi16 (_mm_add_epi16 (even0, odd0), _mm_add_epi16 (even1, odd1));
+                    _mm_storel_epi64 ((__m128i *)(chromaAlpha + x), _mm_packus_epi16 (
+                        _mm_srli_epi16 (_mm_add_epi16 (sum, _mm_set1_epi16 (2)), 2), zero));
+                }
+            #endif // defined (THEKOGANS_CANVAS_HAVE_SSE2)
+                for (; x < width; ++x) {
+                    util::ui32 left = 2 * x;
+                    util::ui32 right = std::min (left + 1, alphaWidth - 1);
+                    chromaAlpha[x] = (util::ui8)(
+                        (alpha0[left] + alpha0[right] + alpha1[left] + alpha1[right] + 2) >> 2);
+                }
+            }
+        }
+
+        void YUVImage::ApplyLumaCurve (
+                const util::ui8 *curve,
+                const util::Rectangle &rectangle) {
+            util::Rectangle dstRectangle = rectangle.Intersection (GetRectangle ());
+            if (!dstRectangle.IsDegenerate ()) {
+                util::ui32 stride = strides[Y_INDEX];
+                util::ui8 *yPlane = planes[Y_INDEX] +
+                    dstRectangle.origin.y * stride + dstRectangle.origin.x;
+                for (util::ui32 height = dstRectangle.extents.height; height-- != 0;) {
+                    for (util::ui32 x = 0; x < dstRectangle.extents.width; ++x) {
+                        yPlane[x] = curve[yPlane[x]];
+                    }
+                    yPlane += stride;
+                }
+            }
+        }
+
+        void YUVImage::AdjustBrightnessContrast (
+                util::f32 brightness,
+                util::f32 contrast,
+                const util::Rectangle &rectangle) {
+            util::ui8 curve[256];
+            for (util::ui32 i = 0; i < 256; ++i) {
+                util::f32 value = ((util::f32)i - 128.0f) * contrast + 128.0f + brightness;
+                curve[i] = (util::ui8)(value < 0.0f ? 0 : value > 255.0f ? 255 : (util::ui32)(value + 0.5f));
+            }
+            ApplyLumaCurve (curve, rectangle);
+        }
+
+        void YUVImage::ScaleSaturation (
+                util::f32 saturation,
+                const util::Rectangle &rectangle) {
+            util::Rectangle dstRectangle = rectangle.Intersection (GetRectangle ());
+            if (!dstRectangle.IsDegenerate ()) {
+                // Q9 fixed point (see ScaleRow).
+                util::i32 scale = (util::i32)(std::max (0.0f, std::min (saturation, 63.0f)) * 512.0f + 0.5f);
+                // Chroma samples touched by the rectangle.
+                util::i32 left = dstRectangle.origin.x / 2;
+                util::i32 top = dstRectangle.origin.y / 2;
+                util::ui32 width = (dstRectangle.origin.x + dstRectangle.extents.width + 1) / 2 - left;
+                util::ui32 height = (dstRectangle.origin.y + dstRectangle.extents.height + 1) / 2 - top;
+                for (util::ui32 j = 0; j < height; ++j) {
+                    ScaleRow (planes[U_INDEX] + (top + j) * strides[U_INDEX] + left, width, scale);
+                    ScaleRow (planes[V_INDEX] + (top + j) * strides[V_INDEX] + left, width, scale);
+                }
+            }
+        }
+
+        void YUVImage::Overlay (
+                const YUVImage &overlay,
+                const util::Point &origin) {
+            util::Rectangle dstRectangle =
+                util::Rectangle (origin, overlay.extents).Intersection (GetRectangle ());
+            if (dstRectangle.IsDegenerate ()) {
+                return;
+            }
+            const util::ui8 *overlayAlpha = overlay.planes[A_INDEX];
+            // Y (and A, if we have one; A = A_overlay over A).
+            {
+                util::Point offset = dstRectangle.origin - origin;
+                util::ui32 width = dstRectangle.extents.width;
+                for (util::ui32 j = 0; j < dstRectangle.extents.height; ++j) {
+                    util::ui32 srcRow = offset.y + j;
+                    util::ui32 dstRow = dstRectangle.origin.y + j;
+                    const util::ui8 *srcY = overlay.planes[Y_INDEX] +
+                        srcRow * overlay.strides[Y_INDEX] + offset.x;
+                    util::ui8 *dstY = planes[Y_INDEX] + dstRow * strides[Y_INDEX] + dstRectangle.origin.x;
+                    if (overlayAlpha != 0) {
+                        const util::ui8 *srcA = overlayAlpha +
+                            srcRow * overlay.strides[A_INDEX] + offset.x;
+                        BlendRow (srcY, srcA, dstY, width);
+                        if (planes[A_INDEX] != 0) {
+                            util::ui8 *dstA = planes[A_INDEX] +
+                                dstRow * strides[A_INDEX] + dstRectangle.origin.x;
+                            for (util::ui32 x = 0; x < width; ++x) {
+                                dstA[x] = (util::ui8)(srcA[x] + Div255 (dstA[x] * (255 - srcA[x])));
+                            }
+                        }
+                    }
+                    else {
+                        memcpy (dstY, srcY, width);
+                        if (planes[A_INDEX] != 0) {
+                            memset (planes[A_INDEX] + dstRow * strides[A_INDEX] + dstRectangle.origin.x,
+                                255, width);
+                        }
+                    }
+                }
+            }
+            // UV. Overlay chroma sample (i, j) lands on our chroma sample
+            // (i + FloorDiv2 (origin.x), j + FloorDiv2 (origin.y)).
+            {
+                util::i32 chromaX = FloorDiv2 (origin.x);
+                util::i32 chromaY = FloorDiv2 (origin.y);
+                util::i32 overlayChromaWidth = (overlay.extents.width + 1) / 2;
+                util::i32 overlayChromaHeight = (overlay.extents.height + 1) / 2;
+                util::i32 chromaWidth = (extents.width + 1) / 2;
+                util::i32 chromaHeight = (extents.height + 1) / 2;
+                util::i32 left = std::max (0, -chromaX);
+                util::i32 top = std::max (0, -chromaY);
+                util::i32 right = std::min (overlayChromaWidth, chromaWidth - chromaX);
+                util::i32 bottom = std::min (overlayChromaHeight, chromaHeight - chromaY);
+                if (right > left && bottom > top) {
+                    util::ui32 width = right - left;
+                    std::vector<util::ui8> chromaAlpha (width);
+                    for (util::i32 j = top; j < bottom; ++j) {
+                        const util::ui8 *srcU = overlay.planes[U_INDEX] + j * overlay.strides[U_INDEX] + left;
+                        const util::ui8 *srcV = overlay.planes[V_INDEX] + j * overlay.strides[V_INDEX] + left;
+                        util::ui8 *dstU = planes[U_INDEX] + (j + chromaY) * strides[U_INDEX] + left + chromaX;
+                        util::ui8 *dstV = planes[V_INDEX] + (j + chromaY) * strides[V_INDEX] + left + chromaX;
+                        if (overlayAlpha != 0) {
+                            util::ui32 row0 = 2 * j;
+                            util::ui32 row1 = std::min (row0 + 1, overlay.extents.height - 1);
+                            ChromaAlphaRow (
+                                overlayAlpha + row0 * overlay.strides[A_INDEX] + 2 * left,
+                                overlayAlpha + row1 * overlay.strides[A_INDEX] + 2 * left,
+                                overlay.extents.width - 2 * left,
+                                chromaAlpha.data (),
+                                width);
+                            BlendRow (srcU, chromaAlpha.data (), dstU, width);
+                            BlendRow (srcV, chromaAlpha.data (), dstV, width);
+                        }
+                        else {
+                            memcpy (dstU, srcU, width);
+                            memcpy (dstV, srcV, width);
+                        }
+                    }
+                }
+            }
+        }
+
+        void YUVImage::Overlay (
+                const RGBImage &overlay,
+                const util::Point &origin) {
+            Overlay (*overlay.ToYUVImage (true), origin);
+        }
+
         RGBImage::UniquePtr YUVImage::ToRGBImage (util::ui32 componentIndices) const {
             RGBImage::UniquePtr dst;
             if (RGBImage::IsValidComponentIndices (componentIndices)) {
@@ -553,15 +954,42 @@ namespace thekogans {
         }
 
         YUVImage::UniquePtr YUVImage::MirrorX () const {
-            // FIXME: implement
-            assert (0);
-            return YUVImage::UniquePtr ();
+            UniquePtr dst (new YUVImage (extents, planes[A_INDEX] != 0));
+            // A negative height makes libyuv walk the source bottom up.
+            libyuv::I420Copy (
+                planes[Y_INDEX], strides[Y_INDEX],
+                planes[U_INDEX], strides[U_INDEX],
+                planes[V_INDEX], strides[V_INDEX],
+                dst->planes[Y_INDEX], dst->strides[Y_INDEX],
+                dst->planes[U_INDEX], dst->strides[U_INDEX],
+                dst->planes[V_INDEX], dst->strides[V_INDEX],
+                extents.width, -(int)extents.height);
+            if (planes[A_INDEX] != 0) {
+                libyuv::CopyPlane (
+                    planes[A_INDEX], strides[A_INDEX],
+                    dst->planes[A_INDEX], dst->strides[A_INDEX],
+                    extents.width, -(int)extents.height);
+            }
+            return dst;
         }
 
         YUVImage::UniquePtr YUVImage::MirrorY () const {
-            // FIXME: implement
-            assert (0);
-            return YUVImage::UniquePtr ();
+            UniquePtr dst (new YUVImage (extents, planes[A_INDEX] != 0));
+            libyuv::I420Mirror (
+                planes[Y_INDEX], strides[Y_INDEX],
+                planes[U_INDEX], strides[U_INDEX],
+                planes[V_INDEX], strides[V_INDEX],
+                dst->planes[Y_INDEX], dst->strides[Y_INDEX],
+                dst->planes[U_INDEX], dst->strides[U_INDEX],
+                dst->planes[V_INDEX], dst->strides[V_INDEX],
+                extents.width, extents.height);
+            if (planes[A_INDEX] != 0) {
+                libyuv::MirrorPlane (
+                    planes[A_INDEX], strides[A_INDEX],
+                    dst->planes[A_INDEX], dst->strides[A_INDEX],
+                    extents.width, extents.height);
+            }
+            return dst;
         }
 
     } // namespace canvas
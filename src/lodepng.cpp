@@ -29,9 +29,17 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 */
 
 #include "thekogans/canvas/lodepng.h"
+#include "thekogans/canvas/Config.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(THEKOGANS_CANVAS_HAVE_NEON)
+#include <arm_neon.h>
+#endif
 
 #ifdef LODEPNG_COMPILE_CPP
 #include <fstream>
@@ -3898,6 +3906,68 @@ static unsigned char paethPredictor(short a, short b, short c)
   else return (unsigned char)a;
 }
 
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)
+/*Helpers shared by the SIMD filters and unfilters (thekogans addition).*/
+
+/*bytewidth is 3 or 4, callers pass it as a constant so these fold to plain moves*/
+static unsigned loadPixel(const unsigned char* p, size_t bytewidth)
+{
+  unsigned v;
+  if(bytewidth == 4) memcpy(&v, p, 4);
+  else v = (unsigned)p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16);
+  return v;
+}
+
+static void storePixel(unsigned char* p, unsigned v, size_t bytewidth)
+{
+  if(bytewidth == 4) memcpy(p, &v, 4);
+  else
+  {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+  }
+}
+
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+static __m128i abs16(__m128i x)
+{
+  return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static __m128i select128(__m128i c, __m128i t, __m128i e)
+{
+  return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+}
+
+/*paethPredictor on 8 16 bit lanes. Ties favor a over b over c, as in the PNG spec.*/
+static __m128i paeth16(__m128i a, __m128i b, __m128i c)
+{
+  __m128i pa = _mm_sub_epi16(b, c);
+  __m128i pb = _mm_sub_epi16(a, c);
+  __m128i pc = _mm_add_epi16(pa, pb);
+  __m128i smallest;
+  pa = abs16(pa);
+  pb = abs16(pb);
+  pc = abs16(pc);
+  smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+  return select128(_mm_cmpeq_epi16(smallest, pa), a,
+         select128(_mm_cmpeq_epi16(smallest, pb), b, c));
+}
+#else /*THEKOGANS_CANVAS_HAVE_NEON*/
+/*paethPredictor on 8 lanes. Ties favor a over b over c, as in the PNG spec.*/
+static uint8x8_t paeth8(uint8x8_t a, uint8x8_t b, uint8x8_t c)
+{
+  uint16x8_t pa = vabdl_u8(b, c);
+  uint16x8_t pb = vabdl_u8(a, c);
+  uint16x8_t pc = vabdq_u16(vaddl_u8(a, b), vaddl_u8(c, c));
+  uint8x8_t useA = vmovn_u16(vandq_u16(vcleq_u16(pa, pb), vcleq_u16(pa, pc)));
+  uint8x8_t bOrC = vbsl_u8(vmovn_u16(vcleq_u16(pb, pc)), b, c);
+  return vbsl_u8(useA, a, bOrC);
+}
+#endif
+#endif /*defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)*/
+
 /*shared values used by multiple Adam7 related functions*/
 
 static const unsigned ADAM7_IX[7] = { 0, 4, 0, 2, 0, 1, 0 }; /*x start values*/
@@ -4012,6 +4082,189 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   return state->error;
 }
 
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)
+/*
+SIMD unfilter (thekogans addition). The SIMD instruction set is picked at
+compile time (see thekogans/canvas/Config.h); SSE2 and NEON are the x86-64 and
+AArch64 baselines so there is nothing to dispatch at run time. Up is data
+parallel and works 16 bytes at a time for any bytewidth. Sub on 3 and 4 byte
+pixels does a prefix sum across 4 pixels. Average and Paeth depend on the
+reconstructed pixel to the left and do all channels of one pixel at a time
+(the formulations libpng uses). The results are identical to the scalar code.
+precon must not be null, recon and scanline MAY be the same memory address or
+recon may trail scanline (see unfilter).
+*/
+
+static void unfilterUpSIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                           size_t length)
+{
+  size_t i = 0;
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+  for(; i + 16 <= length; i += 16)
+  {
+    _mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(
+      _mm_loadu_si128((const __m128i*)&scanline[i]), _mm_loadu_si128((const __m128i*)&precon[i])));
+  }
+#else /*THEKOGANS_CANVAS_HAVE_NEON*/
+  for(; i + 16 <= length; i += 16)
+  {
+    vst1q_u8(&recon[i], vaddq_u8(vld1q_u8(&scanline[i]), vld1q_u8(&precon[i])));
+  }
+#endif
+  for(; i < length; i++) recon[i] = scanline[i] + precon[i];
+}
+
+static void unfilterSubSIMD(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length)
+{
+  size_t i;
+  for(i = 0; i < bytewidth; i++) recon[i] = scanline[i];
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+  {
+    /*the carry holds the last reconstructed pixel in its first bytewidth bytes*/
+    __m128i carry = _mm_cvtsi32_si128((int)loadPixel(recon, bytewidth));
+    if(bytewidth == 4)
+    {
+      for(; i + 16 <= length; i += 16)
+      {
+        __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i*)&scanline[i]), carry);
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+        _mm_storeu_si128((__m128i*)&recon[i], x);
+        carry = _mm_srli_si128(x, 12);
+      }
+    }
+    else
+    {
+      /*4 pixels = 12 bytes per step, the last 4 bytes of the register are not stored*/
+      const __m128i mask = _mm_cvtsi32_si128(0xffffff);
+      for(; i + 16 <= length; i += 12)
+      {
+        __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i*)&scanline[i]), carry);
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+        _mm_storel_epi64((__m128i*)&recon[i], x);
+        storePixel(&recon[i + 8], (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(x, 8)), 4);
+        carry = _mm_and_si128(_mm_srli_si128(x, 9), mask);
+      }
+    }
+  }
+#else /*THEKOGANS_CANVAS_HAVE_NEON*/
+  {
+    uint8x8_t a = vreinterpret_u8_u32(vdup_n_u32(loadPixel(recon, bytewidth)));
+    for(; i + bytewidth <= length; i += bytewidth)
+    {
+      a = vadd_u8(vreinterpret_u8_u32(vdup_n_u32(loadPixel(&scanline[i], bytewidth))), a);
+      storePixel(&recon[i], vget_lane_u32(vreinterpret_u32_u8(a), 0), bytewidth);
+    }
+  }
+#endif
+  for(; i < length; i++) recon[i] = scanline[i] + recon[i - bytewidth];
+}
+
+static void unfilterAverageSIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, size_t length)
+{
+  size_t i;
+  for(i = 0; i < bytewidth; i++) recon[i] = scanline[i] + precon[i] / 2;
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+  {
+    /*_mm_avg_epu8 rounds up, (a + b) / 2 rounds down, they differ by the low bit of a ^ b*/
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_cvtsi32_si128((int)loadPixel(recon, bytewidth));
+    for(; i + bytewidth <= length; i += bytewidth)
+    {
+      __m128i b = _mm_cvtsi32_si128((int)loadPixel(&precon[i], bytewidth));
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(_mm_cvtsi32_si128((int)loadPixel(&scanline[i], bytewidth)), avg);
+      storePixel(&recon[i], (unsigned)_mm_cvtsi128_si32(a), bytewidth);
+    }
+  }
+#else /*THEKOGANS_CANVAS_HAVE_NEON*/
+  {
+    uint8x8_t a = vreinterpret_u8_u32(vdup_n_u32(loadPixel(recon, bytewidth)));
+    for(; i + bytewidth <= length; i += bytewidth)
+    {
+      uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32(loadPixel(&precon[i], bytewidth)));
+      a = vadd_u8(vreinterpret_u8_u32(vdup_n_u32(loadPixel(&scanline[i], bytewidth))), vhadd_u8(a, b));
+      storePixel(&recon[i], vget_lane_u32(vreinterpret_u32_u8(a), 0), bytewidth);
+    }
+  }
+#endif
+  for(; i < length; i++) recon[i] = scanline[i] + ((recon[i - bytewidth] + precon[i]) / 2);
+}
+
+static void unfilterPaethSIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                              size_t bytewidth, size_t length)
+{
+  size_t i;
+  /*paethPredictor(0, precon[i], 0) is always precon[i]*/
+  for(i = 0; i < bytewidth; i++) recon[i] = scanline[i] + precon[i];
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)loadPixel(recon, bytewidth)), zero);
+    __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)loadPixel(precon, bytewidth)), zero);
+    for(; i + bytewidth <= length; i += bytewidth)
+    {
+      __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)loadPixel(&precon[i], bytewidth)), zero);
+      __m128i p = paeth16(a, b, c);
+      __m128i x = _mm_add_epi8(_mm_packus_epi16(p, p),
+        _mm_cvtsi32_si128((int)loadPixel(&scanline[i], bytewidth)));
+      storePixel(&recon[i], (unsigned)_mm_cvtsi128_si32(x), bytewidth);
+      a = _mm_unpacklo_epi8(x, zero);
+      c = b;
+    }
+  }
+#else /*THEKOGANS_CANVAS_HAVE_NEON*/
+  {
+    uint8x8_t a = vreinterpret_u8_u32(vdup_n_u32(loadPixel(recon, bytewidth)));
+    uint8x8_t c = vreinterpret_u8_u32(vdup_n_u32(loadPixel(precon, bytewidth)));
+    for(; i + bytewidth <= length; i += bytewidth)
+    {
+      uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32(loadPixel(&precon[i], bytewidth)));
+      a = vadd_u8(vreinterpret_u8_u32(vdup_n_u32(loadPixel(&scanline[i], bytewidth))), paeth8(a, b, c));
+      storePixel(&recon[i], vget_lane_u32(vreinterpret_u32_u8(a), 0), bytewidth);
+      c = b;
+    }
+  }
+#endif
+  for(; i < length; i++)
+  {
+    recon[i] = (scanline[i] + paethPredictor(recon[i - bytewidth], precon[i], precon[i - bytewidth]));
+  }
+}
+
+/*returns 1 if the SIMD code handled the scanline*/
+static int unfilterScanlineSIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, unsigned char filterType, size_t length)
+{
+  if(!precon) return 0;
+  if(filterType == 2)
+  {
+    unfilterUpSIMD(recon, scanline, precon, length);
+    return 1;
+  }
+  if(bytewidth != 3 && bytewidth != 4) return 0;
+  switch(filterType)
+  {
+    /*literal bytewidths let the compiler specialize the per pixel loops*/
+    case 1:
+      if(bytewidth == 3) unfilterSubSIMD(recon, scanline, 3, length);
+      else unfilterSubSIMD(recon, scanline, 4, length);
+      return 1;
+    case 3:
+      if(bytewidth == 3) unfilterAverageSIMD(recon, scanline, precon, 3, length);
+      else unfilterAverageSIMD(recon, scanline, precon, 4, length);
+      return 1;
+    case 4:
+      if(bytewidth == 3) unfilterPaethSIMD(recon, scanline, precon, 3, length);
+      else unfilterPaethSIMD(recon, scanline, precon, 4, length);
+      return 1;
+    default: return 0;
+  }
+}
+#endif /*defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
                                  size_t bytewidth, unsigned char filterType, size_t length)
 {
@@ -4025,6 +4278,9 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
 
   size_t i;
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)
+  if(unfilterScanlineSIMD(recon, scanline, precon, bytewidth, filterType, length)) return 0;
+#endif
   switch(filterType)
   {
     case 0:
@@ -4086,7 +4342,35 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   return 0;
 }
 
-static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+static unsigned isLittleEndian(void)
+{
+  const unsigned short one = 1;
+  return *(const unsigned char*)&one;
+}
+
+/*byte swap the 16 bit samples of a scanline (thekogans addition)*/
+static void swapScanline16(unsigned char* line, size_t linebytes)
+{
+  size_t i = 0;
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+  for(; i + 16 <= linebytes; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&line[i]);
+    _mm_storeu_si128((__m128i*)&line[i], _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+  }
+#elif defined(THEKOGANS_CANVAS_HAVE_NEON)
+  for(; i + 16 <= linebytes; i += 16) vst1q_u8(&line[i], vrev16q_u8(vld1q_u8(&line[i])));
+#endif
+  for(; i + 2 <= linebytes; i += 2)
+  {
+    unsigned char t = line[i];
+    line[i] = line[i + 1];
+    line[i + 1] = t;
+  }
+}
+
+static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp,
+                         unsigned swap16)
 {
   /*
   For PNG filter method 0
@@ -4094,6 +4378,7 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
   out must have enough bytes allocated already, in must have the scanlines + 1 filtertype byte per scanline
   w and h are image dimensions or dimensions of reduced image, bpp is bits per pixel
   in and out are allowed to be the same memory address (but aren't the same size since in has the extra filter bytes)
+  swap16: byte swap the 16 bit samples. A scanline is swapped once the next one no longer needs it as precon.
   */
 
   unsigned y;
@@ -4111,8 +4396,10 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
 
     CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes));
 
+    if(swap16 && prevline) swapScanline16(prevline, linebytes);
     prevline = &out[outindex];
   }
+  if(swap16 && prevline) swapScanline16(prevline, linebytes);
 
   return 0;
 }
@@ -4209,7 +4496,7 @@ static void removePaddingBits(unsigned char* out, const unsigned char* in,
 the IDAT chunks (with filter index bytes and possible padding bits)
 return value is error*/
 static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
-                                     unsigned w, unsigned h, const LodePNGInfo* info_png)
+                                     unsigned w, unsigned h, const LodePNGInfo* info_png, unsigned swap16)
 {
   /*
   This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype.
@@ -4225,11 +4512,11 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
   {
     if(bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
     {
-      CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp));
+      CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp, 0));
       removePaddingBits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
     }
     /*we can immediatly filter into the out buffer, no other steps needed*/
-    else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp));
+    else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp, swap16));
   }
   else /*interlace_method is 1 (Adam7)*/
   {
@@ -4240,7 +4527,7 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
 
     for(i = 0; i < 7; i++)
     {
-      CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
+      CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp, swap16));
       /*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline,
       move bytes instead of bits or move not at all*/
       if(bpp < 8)
@@ -4730,12 +5017,40 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
     if(!state->error)
     {
-      ucvector outv;
-      ucvector_init(&outv);
-      if(!ucvector_resizev(&outv,
-          lodepng_get_raw_size(*w, *h, &state->info_png.color), 0)) state->error = 83; /*alloc fail*/
-      if(!state->error) state->error = postProcessScanlines(outv.data, scanlines.data, *w, *h, &state->info_png);
-      *out = outv.data;
+      size_t rawsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
+      /*only the bit level Adam7_deinterlace needs a zeroed out buffer, everything else overwrites it*/
+      unsigned zero = lodepng_get_bpp(&state->info_png.color) < 8;
+      unsigned convert = state->decoder.color_convert &&
+        !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color);
+      /*the samples stay big endian until the end if they are going to be color converted*/
+      unsigned swap16 = state->decoder.host_endian_16 && state->info_png.color.bitdepth == 16 &&
+        isLittleEndian() && !convert;
+      if(state->decoder.out_buffer && !convert)
+      {
+        /*no conversion, unfilter straight in to the caller's buffer*/
+        if(state->decoder.out_capacity < rawsize) state->error = 90;
+        else
+        {
+          if(zero) memset(state->decoder.out_buffer, 0, rawsize);
+          state->error = postProcessScanlines(state->decoder.out_buffer, scanlines.data, *w, *h,
+                                              &state->info_png, swap16);
+        }
+        *out = state->decoder.out_buffer;
+      }
+      else
+      {
+        ucvector outv;
+        ucvector_init(&outv);
+        if(!(zero ? ucvector_resizev(&outv, rawsize, 0) : ucvector_resize(&outv, rawsize)))
+        {
+          state->error = 83; /*alloc fail*/
+        }
+        if(!state->error)
+        {
+          state->error = postProcessScanlines(outv.data, scanlines.data, *w, *h, &state->info_png, swap16);
+        }
+        *out = outv.data;
+      }
     }
     ucvector_cleanup(&scanlines);
   }
@@ -4776,12 +5091,20 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
     }
 
     outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
-    *out = (unsigned char*)lodepng_malloc(outsize);
-    if(!(*out))
+    if(state->decoder.out_buffer)
     {
-      state->error = 83; /*alloc fail*/
+      *out = state->decoder.out_buffer;
+      if(state->decoder.out_capacity < outsize) state->error = 90;
+    }
+    else
+    {
+      *out = (unsigned char*)lodepng_malloc(outsize);
+      if(!(*out)) state->error = 83; /*alloc fail*/
+    }
+    if(!state->error)
+    {
+      state->error = lodepng_convert(*out, data, &state->info_raw, &state->info_png.color, *w, *h, state->decoder.fix_png);
     }
-    else state->error = lodepng_convert(*out, data, &state->info_raw, &state->info_png.color, *w, *h, state->decoder.fix_png);
     lodepng_free(data);
   }
   return state->error;
@@ -4843,6 +5166,9 @@ void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
   settings->ignore_crc = 0;
   settings->fix_png = 0;
+  settings->host_endian_16 = 0;
+  settings->out_buffer = 0;
+  settings->out_capacity = 0;
   lodepng_decompress_settings_init(&settings->zlibsettings);
 }
 
@@ -5164,10 +5490,160 @@ static unsigned addChunk_pHYs(ucvector* out, const LodePNGInfo* info)
 
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)
+/*
+SIMD filters and filter heuristic (thekogans addition). Unlike unfiltering,
+filtering only reads the (known) input so all four filters are data parallel
+and work 16 bytes at a time for any bytewidth. The results are identical to
+the scalar code. prevline must not be null.
+*/
+
+/*returns 1 if the SIMD code handled the scanline*/
+static int filterScanlineSIMD(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
+                              size_t length, size_t bytewidth, unsigned char filterType)
+{
+  size_t i;
+  if(!prevline || filterType < 1 || filterType > 4) return 0;
+  i = 0;
+  if(filterType != 2)
+  {
+    for(; i < bytewidth; i++)
+    {
+      out[i] = filterType == 1 ? scanline[i] :
+               filterType == 3 ? scanline[i] - prevline[i] / 2 :
+               scanline[i] - prevline[i]; /*paethPredictor(0, prevline[i], 0) is always prevline[i]*/
+    }
+  }
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for(; i + 16 <= length; i += 16)
+    {
+      __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+      __m128i up = _mm_loadu_si128((const __m128i*)&prevline[i]);
+      __m128i left, upleft, predictor;
+      switch(filterType)
+      {
+        case 1:
+          predictor = _mm_loadu_si128((const __m128i*)&scanline[i - bytewidth]);
+          break;
+        case 2:
+          predictor = up;
+          break;
+        case 3:
+          left = _mm_loadu_si128((const __m128i*)&scanline[i - bytewidth]);
+          predictor = _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one));
+          break;
+        default:
+          left = _mm_loadu_si128((const __m128i*)&scanline[i - bytewidth]);
+          upleft = _mm_loadu_si128((const __m128i*)&prevline[i - bytewidth]);
+          predictor = _mm_packus_epi16(
+            paeth16(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(up, zero), _mm_unpacklo_epi8(upleft, zero)),
+            paeth16(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(up, zero), _mm_unpackhi_epi8(upleft, zero)));
+          break;
+      }
+      _mm_storeu_si128((__m128i*)&out[i], _mm_sub_epi8(x, predictor));
+    }
+  }
+#else /*THEKOGANS_CANVAS_HAVE_NEON*/
+  for(; i + 16 <= length; i += 16)
+  {
+    uint8x16_t x = vld1q_u8(&scanline[i]);
+    uint8x16_t up = vld1q_u8(&prevline[i]);
+    uint8x16_t left, upleft, predictor;
+    switch(filterType)
+    {
+      case 1:
+        predictor = vld1q_u8(&scanline[i - bytewidth]);
+        break;
+      case 2:
+        predictor = up;
+        break;
+      case 3:
+        predictor = vhaddq_u8(vld1q_u8(&scanline[i - bytewidth]), up);
+        break;
+      default:
+        left = vld1q_u8(&scanline[i - bytewidth]);
+        upleft = vld1q_u8(&prevline[i - bytewidth]);
+        predictor = vcombine_u8(
+          paeth8(vget_low_u8(left), vget_low_u8(up), vget_low_u8(upleft)),
+          paeth8(vget_high_u8(left), vget_high_u8(up), vget_high_u8(upleft)));
+        break;
+    }
+    vst1q_u8(&out[i], vsubq_u8(x, predictor));
+  }
+#endif
+  for(; i < length; i++)
+  {
+    switch(filterType)
+    {
+      case 1: out[i] = scanline[i] - scanline[i - bytewidth]; break;
+      case 2: out[i] = scanline[i] - prevline[i]; break;
+      case 3: out[i] = scanline[i] - ((scanline[i - bytewidth] + prevline[i]) / 2); break;
+      default: out[i] = (scanline[i] - paethPredictor(scanline[i - bytewidth], prevline[i], prevline[i - bytewidth]));
+    }
+  }
+  return 1;
+}
+
+/*
+The LFS_MINSUM cost of a filtered scanline: sum of the bytes for filter type 0,
+sum of the absolute values of the bytes (as signed char) for the others.
+|(signed char)x| == min(x, 256 - x) when treated as unsigned.
+*/
+static size_t sumFilteredScanline(const unsigned char* data, size_t length, unsigned type)
+{
+  size_t sum = 0;
+  size_t i = 0;
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    unsigned long long lanes[2];
+    for(; i + 16 <= length; i += 16)
+    {
+      __m128i x = _mm_loadu_si128((const __m128i*)&data[i]);
+      if(type != 0) x = _mm_min_epu8(x, _mm_sub_epi8(zero, x));
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(x, zero));
+    }
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    sum = (size_t)(lanes[0] + lanes[1]);
+  }
+#else /*THEKOGANS_CANVAS_HAVE_NEON*/
+  {
+    const uint8x16_t zero = vdupq_n_u8(0);
+    uint32x4_t acc = vdupq_n_u32(0);
+    for(; i + 16 <= length; i += 16)
+    {
+      uint8x16_t x = vld1q_u8(&data[i]);
+      if(type != 0) x = vminq_u8(x, vsubq_u8(zero, x));
+      acc = vpadalq_u16(acc, vpaddlq_u8(x));
+    }
+    sum = (size_t)vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) +
+          vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+  }
+#endif
+  for(; i < length; i++)
+  {
+    if(type == 0) sum += data[i];
+    else
+    {
+      signed char s = (signed char)(data[i]);
+      sum += s < 0 ? -s : s;
+    }
+  }
+  return sum;
+}
+#endif /*defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)*/
+
 static void filterScanline(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
                            size_t length, size_t bytewidth, unsigned char filterType)
 {
   size_t i;
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)
+  if(filterScanlineSIMD(out, scanline, prevline, length, bytewidth, filterType)) return;
+#endif
   switch(filterType)
   {
     case 0: /*None*/
@@ -5309,6 +5785,9 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
           filterScanline(attempt[type].data, &in[y * linebytes], prevline, linebytes, bytewidth, type);
 
           /*calculate the sum of the result*/
+#if defined(THEKOGANS_CANVAS_HAVE_SSE2) || defined(THEKOGANS_CANVAS_HAVE_NEON)
+          sum[type] = sumFilteredScanline(attempt[type].data, linebytes, type);
+#else
           sum[type] = 0;
           if(type == 0)
           {
@@ -5325,6 +5804,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
               sum[type] += s < 0 ? -s : s;
             }
           }
+#endif
 
           /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
           if(type == 0 || sum[type] < smallest)
@@ -6028,6 +6508,7 @@ const char* lodepng_error_text(unsigned code)
     case 87: return "must provide custom zlib function pointer if LODEPNG_COMPILE_ZLIB is not defined";
     case 88: return "invalid filter strategy given for LodePNGEncoderSettings.filter_strategy";
     case 89: return "text chunk keyword too short or long: must have size 1-79";
+    case 90: return "LodePNGDecoderSettings.out_buffer is too small for the image";
   }
   return "unknown error code";
 }
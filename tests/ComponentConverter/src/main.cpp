@@ -0,0 +1,169 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+// Exhaustive check of the *ScaleComponentConverter structs. Every ui8 and
+// ui16 input (and a sample of ui32 inputs) is run through the scalar and
+// the span (SIMD) Convert and compared against the exact, rounded to
+// nearest, value * OutMax / InMax. Spans are converted at every offset
+// and length up to a few SIMD registers so both the vector bodies and
+// the scalar tails are covered. Build it with and without
+// THEKOGANS_CANVAS_NO_SIMD. Returns 0 if every value matches.
+
+#include <cstdio>
+#include <limits>
+#include <vector>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/ComponentConverter.h"
+
+using namespace thekogans;
+
+namespace {
+    // Exact round (value * OutMax / InMax) without overflowing ui64:
+    // OutMax = q * InMax + r, so value * OutMax / InMax =
+    // value * q + value * r / InMax.
+    template<typename In, typename Out>
+    Out Reference (In value_) {
+        const util::ui64 value = value_;
+        const util::ui64 inMax = std::numeric_limits<In>::max ();
+        const util::ui64 outMax = std::numeric_limits<Out>::max ();
+        const util::ui64 q = outMax / inMax;
+        const util::ui64 r = outMax % inMax;
+        return (Out)(value * q + (2 * value * r + inMax) / (2 * inMax));
+    }
+
+    template<typename Converter>
+    bool Check (
+            const char *name,
+            const std::vector<typename Converter::InComponentType> &inputs) {
+        typedef typename Converter::InComponentType In;
+        typedef typename Converter::OutComponentType Out;
+        std::size_t errors = 0;
+        // Scalar.
+        for (std::size_t i = 0, count = inputs.size (); i < count; ++i) {
+            Out expected = Reference<In, Out> (inputs[i]);
+            Out actual = Converter::Convert (inputs[i]);
+            if (actual != expected && errors++ < 10) {
+                printf ("%s: Convert (%llu) = %llu, expected %llu\n", name,
+                    (unsigned long long)inputs[i],
+                    (unsigned long long)actual,
+                    (unsigned long long)expected);
+            }
+        }
+        // Span, whole.
+        std::vector<Out> out (inputs.size ());
+        Converter::Convert (inputs.data (), out.data (), inputs.size ());
+        for (std::size_t i = 0, count = inputs.size (); i < count; ++i) {
+            Out expected = Reference<In, Out> (inputs[i]);
+            if (out[i] != expected && errors++ < 10) {
+                printf ("%s: span Convert (%llu) = %llu, expected %llu\n", name,
+                    (unsigned long long)inputs[i],
+                    (unsigned long long)out[i],
+                    (unsigned long long)expected);
+            }
+        }
+        // Span, every (mis)alignment and tail length. A guard past the
+        // end catches kernels that write too much.
+        const std::size_t MAX_SPAN = 67;
+        for (std::size_t offset = 0; offset < 16 && offset < inputs.size (); ++offset) {
+            for (std::size_t length = 0;
+                    length <= MAX_SPAN && offset + length <= inputs.size (); ++length) {
+                std::vector<Out> span (offset + length + 1, (Out)0x5a);
+                Converter::Convert (
+                    inputs.data () + offset, span.data () + offset, length);
+                for (std::size_t i = 0; i < length; ++i) {
+                    Out expected = Reference<In, Out> (inputs[offset + i]);
+                    if (span[offset + i] != expected && errors++ < 10) {
+                        printf ("%s: span [%u, %u) Convert (%llu) = %llu, expected %llu\n", name,
+                            (unsigned int)offset,
+                            (unsigned int)(offset + length),
+                            (unsigned long long)inputs[offset + i],
+                            (unsigned long long)span[offset + i],
+                            (unsigned long long)expected);
+                    }
+                }
+                if (span[offset + length] != (Out)0x5a && errors++ < 10) {
+                    printf ("%s: span [%u, %u) wrote past its end\n", name,
+                        (unsigned int)offset,
+                        (unsigned int)(offset + length));
+                }
+            }
+        }
+        printf ("%s: %u inputs, %s\n", name,
+            (unsigned int)inputs.size (), errors == 0 ? "ok" : "FAILED");
+        return errors == 0;
+    }
+
+    template<typename T>
+    std::vector<T> All () {
+        std::vector<T> inputs;
+        for (util::ui32 value = 0; value <= std::numeric_limits<T>::max (); ++value) {
+            inputs.push_back ((T)value);
+        }
+        return inputs;
+    }
+
+    // Sample ui32 inputs around every exact value and rounding boundary
+    // of ui32 -> ui16 (multiples of 65537) and ui32 -> ui8 (multiples of
+    // 16843009), plus a strided sweep.
+    void SampleAround (
+            util::ui64 step,
+            util::ui64 count,
+            std::vector<util::ui32> &inputs) {
+        for (util::ui64 i = 0; i <= count; ++i) {
+            util::i64 centers[2] = {
+                (util::i64)(i * step),
+                (util::i64)(i * step + step / 2)
+            };
+            for (std::size_t j = 0; j < 2; ++j) {
+                for (util::i64 delta = -2; delta <= 2; ++delta) {
+                    util::i64 value = centers[j] + delta;
+                    if (value >= 0 && value <= 0xffffffff) {
+                        inputs.push_back ((util::ui32)value);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<util::ui32> SampleUI32 () {
+        std::vector<util::ui32> inputs;
+        SampleAround (65537, 65535, inputs);
+        SampleAround (16843009, 255, inputs);
+        for (util::ui64 value = 0; value <= 0xffffffff; value += 65521) {
+            inputs.push_back ((util::ui32)value);
+        }
+        inputs.push_back (0xffffffff);
+        return inputs;
+    }
+}
+
+int main () {
+    std::vector<util::ui8> ui8All = All<util::ui8> ();
+    std::vector<util::ui16> ui16All = All<util::ui16> ();
+    std::vector<util::ui32> ui32Sample = SampleUI32 ();
+    bool ok = true;
+    ok &= Check<canvas::ui8Toui16ScaleComponentConverter> ("ui8Toui16", ui8All);
+    ok &= Check<canvas::ui8Toui32ScaleComponentConverter> ("ui8Toui32", ui8All);
+    ok &= Check<canvas::ui8Toui64ScaleComponentConverter> ("ui8Toui64", ui8All);
+    ok &= Check<canvas::ui16Toui8ScaleComponentConverter> ("ui16Toui8", ui16All);
+    ok &= Check<canvas::ui16Toui32ScaleComponentConverter> ("ui16Toui32", ui16All);
+    ok &= Check<canvas::ui16Toui64ScaleComponentConverter> ("ui16Toui64", ui16All);
+    ok &= Check<canvas::ui32Toui8ScaleComponentConverter> ("ui32Toui8", ui32Sample);
+    ok &= Check<canvas::ui32Toui16ScaleComponentConverter> ("ui32Toui16", ui32Sample);
+    ok &= Check<canvas::ui32Toui64ScaleComponentConverter> ("ui32Toui64", ui32Sample);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+// Feed header only PNG and BMP files claiming huge extents to ProbeImage
+// and the FramebufferAllocator decoders. Every call must throw, and the
+// allocator must never be asked for memory. A small valid image is
+// decoded through the same allocator as a control. Returns 0 on success.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/Framebuffer.h"
+#include "thekogans/canvas/RGBAFramebuffer.h"
+
+using namespace thekogans;
+
+namespace {
+    void PutBE32 (
+            std::vector<util::ui8> &buffer,
+            util::ui32 value) {
+        buffer.push_back ((util::ui8)(value >> 24));
+        buffer.push_back ((util::ui8)(value >> 16));
+        buffer.push_back ((util::ui8)(value >> 8));
+        buffer.push_back ((util::ui8)value);
+    }
+
+    void PutLE (
+            std::vector<util::ui8> &buffer,
+            util::ui32 value,
+            std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            buffer.push_back ((util::ui8)(value >> (i * 8)));
+        }
+    }
+
+    util::ui32 CRC32 (
+            const util::ui8 *data,
+            std::size_t size) {
+        util::ui32 crc = 0xffffffff;
+        for (std::size_t i = 0; i < size; ++i) {
+            crc ^= data[i];
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+            }
+        }
+        return crc ^ 0xffffffff;
+    }
+
+    // PNG signature and IHDR (8 bit RGBA), nothing else.
+    std::vector<util::ui8> PNGHeader (
+            util::ui32 width,
+            util::ui32 height) {
+        static const util::ui8 SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        std::vector<util::ui8> buffer (SIGNATURE, SIGNATURE + sizeof (SIGNATURE));
+        PutBE32 (buffer, 13);
+        std::size_t chunk = buffer.size ();
+        buffer.push_back ('I');
+        buffer.push_back ('H');
+        buffer.push_back ('D');
+        buffer.push_back ('R');
+        PutBE32 (buffer, width);
+        PutBE32 (buffer, height);
+        buffer.push_back (8);
+        buffer.push_back (6);
+        buffer.push_back (0);
+        buffer.push_back (0);
+        buffer.push_back (0);
+        PutBE32 (buffer, CRC32 (&buffer[chunk], buffer.size () - chunk));
+        return buffer;
+    }
+
+    // BITMAPFILEHEADER and BITMAPINFOHEADER (24 bpp), nothing else.
+    std::vector<util::ui8> BMPHeader (
+            util::i32 width,
+            util::i32 height) {
+        std::vector<util::ui8> buffer;
+        buffer.push_back ('B');
+        buffer.push_back ('M');
+        PutLE (buffer, 54, 4);
+        PutLE (buffer, 0, 4);
+        PutLE (buffer, 54, 4);
+        PutLE (buffer, 40, 4);
+        PutLE (buffer, (util::ui32)width, 4);
+        PutLE (buffer, (util::ui32)height, 4);
+        PutLE (buffer, 1, 2);
+        PutLE (buffer, 24, 2);
+        buffer.resize (54, 0);
+        return buffer;
+    }
+
+    std::size_t allocations = 0;
+
+    canvas::FramebufferAllocator CountingAllocator () {
+        return canvas::FramebufferAllocator (
+            [] (std::size_t size, std::size_t /*alignment*/) -> void * {
+                ++allocations;
+                return malloc (size);
+            },
+            [] (void *ptr, std::size_t /*size*/) {
+                free (ptr);
+            });
+    }
+
+    template<typename F>
+    bool Throws (
+            const std::string &name,
+            F f) {
+        try {
+            f ();
+        }
+        catch (const std::exception &exception) {
+            printf ("%s: %s\n", name.c_str (), exception.what ());
+            return true;
+        }
+        printf ("%s: did not throw\n", name.c_str ());
+        return false;
+    }
+
+    bool Check (
+            const std::string &name,
+            const std::vector<util::ui8> &image,
+            bool png) {
+        const util::ui8 *buffer = image.data ();
+        std::size_t size = image.size ();
+        canvas::FramebufferAllocator allocator = CountingAllocator ();
+        allocations = 0;
+        bool ok = true;
+        ok &= Throws (name + " ProbeImage",
+            [&] () {canvas::ProbeImage (buffer, size);});
+        ok &= Throws (name + " FromBuffer",
+            [&] () {canvas::FromBuffer (buffer, size, allocator);});
+        if (png) {
+            ok &= Throws (name + " FromPNGBuffer",
+                [&] () {canvas::FromPNGBuffer<canvas::ui8RGBAPixel> (buffer, size, allocator);});
+        }
+        else {
+            ok &= Throws (name + " FromBMPBuffer",
+                [&] () {canvas::FromBMPBuffer<canvas::ui8RGBAPixel> (buffer, size, allocator);});
+        }
+        if (allocations != 0) {
+            printf ("%s: %u allocations\n", name.c_str (), (unsigned int)allocations);
+            ok = false;
+        }
+        return ok;
+    }
+}
+
+int main () {
+    bool ok = true;
+    // Largest legal PNG extents.
+    ok &= Check ("PNG 0x7fffffff x 0x7fffffff", PNGHeader (0x7fffffff, 0x7fffffff), true);
+    // width * height wraps to 65536 in ui32.
+    ok &= Check ("PNG 65536 x 65537", PNGHeader (65536, 65537), true);
+    ok &= Check ("BMP 0x7fffffff x 0x7fffffff", BMPHeader (0x7fffffff, 0x7fffffff), false);
+    ok &= Check ("BMP 1 x INT_MIN", BMPHeader (1, (util::i32)0x80000000), false);
+    // Under the pixel limit, but the raster is not there.
+    ok &= Check ("BMP 1000 x 1000", BMPHeader (1000, 1000), false);
+    // Control: a real 2 x 2 bmp goes through the allocator.
+    {
+        std::vector<util::ui8> image = BMPHeader (2, 2);
+        image.resize (image.size () + 16, 0x80);
+        allocations = 0;
+        canvas::ui8RGBAFramebuffer::SharedPtr framebuffer =
+            canvas::FromBMPBuffer<canvas::ui8RGBAPixel> (
+                image.data (), image.size (), CountingAllocator ());
+        if (framebuffer->extents.width != 2 || framebuffer->extents.height != 2 ||
+                framebuffer->buffer.array[0].r != 0x80 || allocations != 1) {
+            printf ("BMP 2 x 2: decode failed\n");
+            ok = false;
+        }
+    }
+    printf ("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+// Check that the ui8RGBA <-> f32HSLA SpanConverter kernels (the bulk path
+// Framebuffer::Convert takes) agree with the per pixel Converter chain
+// (the path it takes for custom converters). Random ui8 pixels are run
+// through both paths to f32HSLA (equal within float noise) and back to
+// ui8 (bit identical, both paths round). Spans are odd length so both
+// the SIMD body and the scalar tail are covered. Build it with and
+// without THEKOGANS_CANVAS_NO_SIMD. Returns 0 if every pixel matches.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/RGBAPixel.h"
+#include "thekogans/canvas/HSLAPixel.h"
+#include "thekogans/canvas/RGBAConverter.h"
+#include "thekogans/canvas/HSLAConverter.h"
+#include "thekogans/canvas/SpanConverter.h"
+
+using namespace thekogans;
+
+namespace {
+    // Deterministic, so failures reproduce.
+    util::ui32 Random (util::ui32 &seed) {
+        seed = seed * 1664525 + 1013904223;
+        return seed >> 8;
+    }
+
+    canvas::f32HSLAPixel ToHSLA (const canvas::ui8RGBAPixel &pixel) {
+        return canvas::Converter<canvas::f32HSLAColor>::Convert (
+            canvas::Converter<canvas::f32RGBAColor>::Convert (pixel.ToColor ()));
+    }
+
+    canvas::ui8RGBAPixel ToRGBA (const canvas::f32HSLAPixel &pixel) {
+        return canvas::Converter<canvas::ui8RGBAColor>::Convert (
+            canvas::Converter<canvas::f32RGBAColor>::Convert (pixel.ToColor ()));
+    }
+
+    bool Close (
+            const canvas::f32HSLAPixel &a,
+            const canvas::f32HSLAPixel &b) {
+        // Hue wraps at 360, and is meaningless for grays.
+        util::f32 dh = std::fabs (a.h - b.h);
+        dh = std::min (dh, 360.0f - dh);
+        return (dh < 0.05f || a.s < 0.01f) &&
+            std::fabs (a.s - b.s) < 0.01f &&
+            std::fabs (a.l - b.l) < 0.01f &&
+            std::fabs (a.a - b.a) < 1e-6f;
+    }
+}
+
+int main () {
+    const std::size_t COUNT = 1000003;
+    util::ui32 seed = 1;
+    std::vector<canvas::ui8RGBAPixel> rgba (COUNT);
+    for (std::size_t i = 0; i < COUNT; ++i) {
+        util::ui32 value = Random (seed);
+        rgba[i].r = (util::ui8)value;
+        rgba[i].g = (util::ui8)(value >> 8);
+        rgba[i].b = (util::ui8)(value >> 16);
+        rgba[i].a = (util::ui8)Random (seed);
+    }
+    std::size_t errors = 0;
+    std::vector<canvas::f32HSLAPixel> hsla (COUNT);
+    canvas::SpanConverter<canvas::ui8RGBAPixel, canvas::f32HSLAPixel>::Convert (
+        rgba.data (), hsla.data (), COUNT);
+    for (std::size_t i = 0; i < COUNT; ++i) {
+        canvas::f32HSLAPixel expected = ToHSLA (rgba[i]);
+        if (!Close (hsla[i], expected) && errors++ < 10) {
+            printf ("ui8RGBA -> f32HSLA (%u, %u, %u, %u): span (%f, %f, %f, %f), "
+                "per pixel (%f, %f, %f, %f)\n",
+                rgba[i].r, rgba[i].g, rgba[i].b, rgba[i].a,
+                hsla[i].h, hsla[i].s, hsla[i].l, hsla[i].a,
+                expected.h, expected.s, expected.l, expected.a);
+        }
+    }
+    std::vector<canvas::ui8RGBAPixel> out (COUNT);
+    canvas::SpanConverter<canvas::f32HSLAPixel, canvas::ui8RGBAPixel>::Convert (
+        hsla.data (), out.data (), COUNT);
+    for (std::size_t i = 0; i < COUNT; ++i) {
+        canvas::ui8RGBAPixel expected = ToRGBA (hsla[i]);
+        if ((out[i].r != expected.r || out[i].g != expected.g ||
+                out[i].b != expected.b || out[i].a != expected.a) && errors++ < 10) {
+            printf ("f32HSLA -> ui8RGBA (%f, %f, %f, %f): span (%u, %u, %u, %u), "
+                "per pixel (%u, %u, %u, %u)\n",
+                hsla[i].h, hsla[i].s, hsla[i].l, hsla[i].a,
+                out[i].r, out[i].g, out[i].b, out[i].a,
+                expected.r, expected.g, expected.b, expected.a);
+        }
+    }
+    printf ("%u pixels, %s\n", (unsigned int)COUNT, errors == 0 ? "ok" : "FAILED");
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+// Copyright 2011 Boris Kogan (boris@thekogans.net)
+//
+// This file is part of libthekogans_canvas.
+//
+// libthekogans_canvas is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// libthekogans_canvas is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with libthekogans_canvas. If not, see <http://www.gnu.org/licenses/>.
+
+// PNG encode/decode throughput, lodepng's built-in inflate/deflate vs.
+// the zlib toolchain backed ZlibDecompress/ZlibCompress (PNGUtils.h),
+// serial and parallel. Every encoding is decoded by every decoder and
+// compared against the source pixels. Usage:
+//
+//   canvas_PNG_benchmark [image.png] [iterations]
+//
+// Without an image, a 1024x768 synthetic RGBA image (smooth gradients
+// with a little noise, roughly photo like) is used. Returns 0 if every
+// round trip is lossless.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "thekogans/util/Types.h"
+#include "thekogans/canvas/lodepng.h"
+#include "thekogans/canvas/PNGUtils.h"
+
+using namespace thekogans;
+
+namespace {
+    struct Image {
+        std::vector<util::ui8> pixels;
+        unsigned width;
+        unsigned height;
+
+        Image () :
+            width (0),
+            height (0) {}
+    };
+
+    bool LoadImage (
+            const char *path,
+            Image &image) {
+        unsigned char *pixels = 0;
+        unsigned error = lodepng_decode32_file (&pixels, &image.width, &image.height, path);
+        if (error != 0) {
+            printf ("%s: %s\n", path, lodepng_error_text (error));
+            return false;
+        }
+        image.pixels.assign (pixels, pixels + (std::size_t)image.width * image.height * 4);
+        free (pixels);
+        return true;
+    }
+
+    void MakeImage (Image &image) {
+        image.width = 1024;
+        image.height = 768;
+        image.pixels.resize ((std::size_t)image.width * image.height * 4);
+        util::ui32 seed = 1;
+        for (unsigned y = 0; y < image.height; ++y) {
+            for (unsigned x = 0; x < image.width; ++x) {
+                seed = seed * 1103515245 + 12345;
+                util::ui32 noise = (seed >> 16) & 7;
+                util::ui8 *pixel = &image.pixels[((std::size_t)y * image.width + x) * 4];
+                pixel[0] = (util::ui8)((x >> 2) + noise);
+                pixel[1] = (util::ui8)((y >> 2) + noise);
+                pixel[2] = (util::ui8)(((x + y) >> 3) + noise);
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    double Now () {
+        return std::chrono::duration<double> (
+            std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+    }
+
+    struct Encoder {
+        const char *name;
+        bool zlib;
+        canvas::ZlibCompressContext context;
+    };
+
+    struct Decoder {
+        const char *name;
+        bool zlib;
+    };
+
+    // Megabytes of raw pixels per second.
+    double Throughput (
+            const Image &image,
+            double seconds) {
+        return image.pixels.size () / seconds / (1024.0 * 1024.0);
+    }
+}
+
+int main (
+        int argc,
+        const char *argv[]) {
+    Image image;
+    if (argc > 1) {
+        if (!LoadImage (argv[1], image)) {
+            return 1;
+        }
+    }
+    else {
+        MakeImage (image);
+    }
+    int iterations = argc > 2 ? atoi (argv[2]) : 10;
+    if (iterations < 1) {
+        iterations = 1;
+    }
+    printf ("%ux%u RGBA, %d iterations\n", image.width, image.height, iterations);
+    Encoder encoders[] = {
+        {"lodepng", false, canvas::ZlibCompressContext ()},
+        {"zlib", true, canvas::ZlibCompressContext ()},
+        {"zlib parallel", true, canvas::ZlibCompressContext (-1, 0, 0)}
+    };
+    Decoder decoders[] = {
+        {"lodepng", false},
+        {"zlib", true}
+    };
+    bool ok = true;
+    for (std::size_t i = 0; i < sizeof (encoders) / sizeof (encoders[0]); ++i) {
+        Encoder &encoder = encoders[i];
+        LodePNGState state;
+        lodepng_state_init (&state);
+        if (encoder.zlib) {
+            canvas::UseZlib (state);
+            state.encoder.zlibsettings.custom_context = &encoder.context;
+        }
+        unsigned char *png = 0;
+        std::size_t pngSize = 0;
+        unsigned error = 0;
+        double start = Now ();
+        for (int j = 0; j < iterations && error == 0; ++j) {
+            free (png);
+            png = 0;
+            error = lodepng_encode (&png, &pngSize,
+                image.pixels.data (), image.width, image.height, &state);
+        }
+        double seconds = (Now () - start) / iterations;
+        lodepng_state_cleanup (&state);
+        if (error != 0) {
+            printf ("encode %s: %s\n", encoder.name, lodepng_error_text (error));
+            free (png);
+            ok = false;
+            continue;
+        }
+        printf ("encode %-14s %8.2f ms %8.1f MB/s %10u bytes\n", encoder.name,
+            seconds * 1000.0, Throughput (image, seconds), (unsigned int)pngSize);
+        for (std::size_t j = 0; j < sizeof (decoders) / sizeof (decoders[0]); ++j) {
+            const Decoder &decoder = decoders[j];
+            lodepng_state_init (&state);
+            state.info_raw.colortype = LCT_RGBA;
+            state.info_raw.bitdepth = 8;
+            if (decoder.zlib) {
+                canvas::UseZlib (state);
+            }
+            unsigned char *pixels = 0;
+            unsigned width = 0;
+            unsigned height = 0;
+            start = Now ();
+            for (int k = 0; k < iterations && error == 0; ++k) {
+                free (pixels);
+                pixels = 0;
+                error = lodepng_decode (&pixels, &width, &height, &state, png, pngSize);
+            }
+            seconds = (Now () - start) / iterations;
+            lodepng_state_cleanup (&state);
+            bool match = error == 0 &&
+                width == image.width && height == image.height &&
+                memcmp (pixels, image.pixels.data (), image.pixels.size ()) == 0;
+            if (error != 0) {
+                printf ("  decode %-7s %s\n", decoder.name, lodepng_error_text (error));
+                error = 0;
+            }
+            else {
+                printf ("  decode %-7s %8.2f ms %8.1f MB/s %s\n", decoder.name,
+                    seconds * 1000.0, Throughput (image, seconds), match ? "ok" : "MISMATCH");
+            }
+            ok &= match;
+            free (pixels);
+        }
+        free (png);
+    }
+    return ok ? 0 : 1;
+}